@@ -0,0 +1,105 @@
+/**
+ *  \file
+ *  \brief     BenchmarkReport class implementation
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#include "benchmark_report.h"
+#include <common/compiled_definitions.h>
+// third-party
+#include <time.h>
+#include <algorithm>
+#include <iomanip>
+
+namespace
+{
+
+/**
+ * Helper function to get value of the given percentile from sorted samples
+ * @param samples - sorted samples
+ * @param percentile - percentile in range [0;100]
+ * @returns - value of the percentile
+ */
+boost::uint64_t GetPercentile(const std::vector<boost::uint64_t>& samples, const double percentile)
+{
+   size_t index = static_cast<size_t>(percentile / 100.0 * (samples.size() - 1) + 0.5);
+   return samples[std::min(index, samples.size() - 1)];
+}
+
+} // unnamed namespace
+
+
+namespace cs
+{
+namespace benchmark
+{
+
+boost::uint64_t GetMonotonicTime()
+{
+   timespec now;
+   ::clock_gettime(CLOCK_MONOTONIC, &now);
+   return static_cast<boost::uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+void BenchmarkResult::AddParameter(const std::string& name, const long value)
+{
+   parameters.push_back(std::make_pair(name, value));
+}
+
+void BenchmarkReport::AddResult(const BenchmarkResult& result)
+{
+   m_results.push_back(result);
+}
+
+void BenchmarkReport::WriteJson(std::ostream& out) const
+{
+   out << std::fixed << std::setprecision(1);
+   out << "{\n"
+       << "  \"product\": \"" << CORE_PRODUCT_NAME << "\",\n"
+       << "  \"version\": \"" << CORE_VERSION << "\",\n"
+       << "  \"benchmarks\": [";
+
+   for (std::list<BenchmarkResult>::const_iterator it = m_results.begin(); it != m_results.end(); ++it)
+   {
+      const BenchmarkResult& result = *it;
+      const double operations = result.operations ? result.operations : 1;
+      const double nsPerOperation = result.totalTime / operations;
+      const double operationsPerSecond = result.totalTime ? result.operations * 1e9 / result.totalTime : 0;
+
+      out << (it == m_results.begin() ? "\n" : ",\n")
+          << "    {\n"
+          << "      \"name\": \"" << result.name << "\",\n"
+          << "      \"parameters\": {";
+      for (std::list<std::pair<std::string, long> >::const_iterator param = result.parameters.begin();
+         param != result.parameters.end();
+         ++param)
+      {
+         out << (param == result.parameters.begin() ? "" : ", ") << "\"" << param->first << "\": " << param->second;
+      }
+      out << "},\n"
+          << "      \"operations\": " << result.operations << ",\n"
+          << "      \"total_ns\": " << result.totalTime << ",\n"
+          << "      \"ns_per_op\": " << nsPerOperation << ",\n"
+          << "      \"ops_per_sec\": " << operationsPerSecond;
+
+      if (!result.samples.empty())
+      {
+         std::vector<boost::uint64_t> samples(result.samples);
+         std::sort(samples.begin(), samples.end());
+         out << ",\n"
+             << "      \"latency_ns\": {"
+             << "\"min\": " << samples.front()
+             << ", \"p50\": " << GetPercentile(samples, 50)
+             << ", \"p90\": " << GetPercentile(samples, 90)
+             << ", \"p99\": " << GetPercentile(samples, 99)
+             << ", \"max\": " << samples.back() << "}";
+      }
+      out << "\n    }";
+   }
+
+   out << "\n  ]\n}\n";
+}
+
+} // namespace benchmark
+} // namespace cs
@@ -0,0 +1,99 @@
+/**
+ *  \file
+ *  \brief     BenchmarkReport class declaration
+ *  \details   Holds helper types to collect microbenchmark measurements and print them
+ *             in a stable JSON form that can be diffed between commits
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#ifndef CS_BENCHMARK_BENCHMARK_REPORT_H
+#define CS_BENCHMARK_BENCHMARK_REPORT_H
+
+// third-party
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <list>
+
+namespace cs
+{
+namespace benchmark
+{
+
+/**
+ * Read monotonic clock
+ * @returns - current value of the monotonic clock in nanoseconds
+ */
+boost::uint64_t GetMonotonicTime();
+
+/**
+ *  \struct    cs::benchmark::BenchmarkResult
+ *  \brief     Result of a single benchmark case
+ */
+struct BenchmarkResult
+{
+   /**
+    * Constructor, initializes internal variables with default values
+    */
+   BenchmarkResult()
+      : operations(0)
+      , totalTime(0)
+   {}
+
+   /**
+    * Add case parameter to be printed along with the measurements
+    * @param name - name of the parameter
+    * @param value - value of the parameter
+    */
+   void AddParameter(const std::string& name, const long value);
+
+   /// unique name of the case, e.g. 'thread_pool.add_task_throughput'
+   std::string                                  name;
+   /// case parameters in the order they were added
+   std::list<std::pair<std::string, long> >     parameters;
+   /// number of measured operations
+   boost::uint64_t                              operations;
+   /// time spent on all measured operations, nanoseconds
+   boost::uint64_t                              totalTime;
+   /// optional per-operation samples, nanoseconds. Percentiles are reported if not empty
+   std::vector<boost::uint64_t>                 samples;
+};
+
+/**
+ *  \class     cs::benchmark::BenchmarkReport
+ *  \brief     Collects results of benchmark cases and prints them as JSON
+ *  \details   Output keeps the order of cases and fields and uses fixed number formatting,
+ *             so that two reports produced by different builds can be compared with diff.
+ */
+class BenchmarkReport : public boost::noncopyable
+{
+public:
+   /**
+    * Store result of the finished case
+    * @param result - result to be stored
+    */
+   void AddResult(const BenchmarkResult& result);
+
+   /**
+    * Print all stored results
+    * @param out - output stream
+    */
+   void WriteJson(std::ostream& out) const;
+
+private:
+   /// results of the finished cases
+   std::list<BenchmarkResult>    m_results;
+};
+
+} // namespace benchmark
+} // namespace cs
+
+/**
+ *  \namespace cs::benchmark
+ *  \brief     Holds microbenchmarks of chat server internals
+ */
+
+#endif // CS_BENCHMARK_BENCHMARK_REPORT_H
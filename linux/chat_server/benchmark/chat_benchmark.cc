@@ -0,0 +1,698 @@
+/**
+ *  \file
+ *  \brief     Microbenchmarks of chat server internals
+ *  \details   Measures the building blocks of the data processing chain in isolation: log
+ *             level check, thread pool, connection read/framing, message parsing, answer fan-out
+ *             and connection container operations. Sockets are emulated with UNIX socketpairs,
+ *             the opposite ends are drained by a helper thread. Results are printed as JSON.
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#include "benchmark_report.h"
+#include <config/configuration_manager.h>
+#include <common/exception_dispatcher.h>
+#include <network/connection/connection_manager.h>
+#include <core/data_processing/process_message_task.h>
+#include <core/data_processing/write_answer_task.h>
+#include <core/data_processing/fan_out_scheduler.h>
+#include <core/data_processing/outbound_coalescer.h>
+#include <thread_pool/thread_pool.h>
+#include <logger/logger.h>
+// third-party
+#include <sys/socket.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <boost/detail/atomic_count.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+
+using namespace cs;
+using namespace cs::benchmark;
+
+/// benchmark run options
+struct BenchmarkOptions
+{
+   BenchmarkOptions()
+      : scale(1)
+   {}
+
+   /// only cases whose name starts with this prefix are executed
+   std::string    filter;
+   /// multiplier for the number of iterations of each case
+   long           scale;
+   /// file to write report to, standard output is used if empty
+   std::string    outputFile;
+};
+
+/// number of connections used by the connection container benchmarks
+static const int ManagedConnectionsCount = 256;
+/// time given to the pools to complete tasks posted asynchronously by the case, milliseconds
+static const int SettleTimeout = 200;
+
+/**
+ *  \class     SocketSink
+ *  \brief     Helper class that reads and drops everything written to the given sockets
+ *  \details   Keeps writers of the measured code from blocking on full socket buffers.
+ *             Owns the sockets and closes them on destruction.
+ */
+class SocketSink : public boost::noncopyable
+{
+public:
+   SocketSink()
+      : m_stopRequested(false)
+   {}
+
+   ~SocketSink()
+   {
+      Stop();
+      for (std::vector<pollfd>::const_iterator it = m_sockets.begin(); it != m_sockets.end(); ++it)
+         ::close(it->fd);
+   }
+
+   /// add socket to be drained, must be called before Start
+   void AddSocket(const network::SocketDescriptor socket)
+   {
+      ::fcntl(socket, F_SETFL, ::fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+      pollfd item;
+      item.fd = socket;
+      item.events = POLLIN;
+      item.revents = 0;
+      m_sockets.push_back(item);
+   }
+
+   void Start()
+   {
+      m_sinkThread.reset( new boost::thread( boost::bind(&SocketSink::SinkThreadRoutine, this) ) );
+   }
+
+   void Stop()
+   {
+      m_stopRequested = true;
+      if (m_sinkThread.get())
+      {
+         m_sinkThread->join();
+         m_sinkThread.reset();
+      }
+   }
+
+private:
+   void SinkThreadRoutine()
+   {
+      static const int PollTimeout = 10;
+      char dataBuffer[65536];
+      while (!m_stopRequested)
+      {
+         if (::poll(&m_sockets[0], m_sockets.size(), PollTimeout) <= 0)
+            continue;
+
+         for (std::vector<pollfd>::const_iterator it = m_sockets.begin(); it != m_sockets.end(); ++it)
+         {
+            if (it->revents & POLLIN)
+               while (::read(it->fd, dataBuffer, sizeof(dataBuffer)) > 0);
+         }
+      }
+   }
+
+   /// sockets to be drained
+   std::vector<pollfd>                 m_sockets;
+   /// flag that the thread should exit
+   boost::atomic<bool>                 m_stopRequested;
+   /// wrapper for the sink thread
+   boost::scoped_ptr<boost::thread>    m_sinkThread;
+};
+
+/**
+ * Open connected pair of sockets
+ * @param sockets - output array with two socket descriptors
+ */
+void OpenSocketPair(network::SocketDescriptor sockets[2])
+{
+   if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+      THROW_NETWORK_EXCEPTION(errno) << "Unable to create socket pair";
+}
+
+/**
+ * Create connection over the socketpair, the other end of the pair is drained by the sink
+ * @param sink - sink to drain data written to the connection
+ * @param username - name to be associated with the connection
+ * @returns - new connection
+ */
+network::ConnectionHolderPtr CreateConnection(SocketSink& sink, const std::string& username)
+{
+   network::SocketDescriptor sockets[2];
+   OpenSocketPair(sockets);
+   sink.AddSocket(sockets[1]);
+
+   network::ConnectionHolderPtr holder = boost::make_shared<network::ConnectionHolder>(sockets[0], false);
+   holder->SetUsername(username);
+   return holder;
+}
+
+/**
+ * Remove connections from ConnectionManager and wait for tasks they might have triggered
+ * @param connections - connections to be removed, list is cleared
+ */
+void ReleaseConnections(network::ConnectionHolderList& connections)
+{
+   network::ConnectionManager& manager = network::ConnectionManager::GetInstance();
+   for (network::ConnectionHolderList::const_iterator it = connections.begin(); it != connections.end(); ++it)
+      manager.RemoveConnection((*it)->GetSocketDescriptor());
+   manager.ProcessConnections(0);
+   connections.clear();
+   boost::this_thread::sleep(boost::posix_time::milliseconds(SettleTimeout));
+}
+
+void IncrementCounter(boost::detail::atomic_count* counter)
+{
+   ++(*counter);
+}
+
+/// helper structure to measure time between posting a task and its execution
+struct WakeupProbe
+{
+   WakeupProbe()
+      : isExecuted(false)
+      , executionTime(0)
+   {}
+
+   boost::mutex               guard;
+   boost::condition_variable  event;
+   bool                       isExecuted;
+   boost::uint64_t            executionTime;
+};
+
+void MarkWakeup(WakeupProbe* probe)
+{
+   boost::uint64_t now = GetMonotonicTime();
+   boost::lock_guard<boost::mutex> lock(probe->guard);
+   probe->executionTime = now;
+   probe->isExecuted = true;
+   probe->event.notify_one();
+}
+
+/**
+ * Cost of the LOG statements filtered out by the log level: the runtime check of a disabled
+ * LOGDBG, or nothing at all if debug statements are compiled out with LOG_MIN_LEVEL
+ */
+void BenchmarkLogger(const BenchmarkOptions& options, BenchmarkReport& report)
+{
+   const long statementCount = 50000000 * options.scale;
+   logger::LevelId logLevel = logger::Log::GetLogLevel();
+   SET_LOG_LEVEL(logger::Fatal);
+
+   BenchmarkResult result;
+   result.name = "logger.disabled_debug";
+   result.AddParameter("compiled_min_level", CS_LOG_MIN_LEVEL);
+   result.AddParameter("statements", statementCount);
+
+   boost::uint64_t startTime = GetMonotonicTime();
+   for (long i = 0; i < statementCount; ++i)
+   {
+      LOGDBG << "Disabled debug statement " << i;
+   }
+   result.totalTime = GetMonotonicTime() - startTime;
+   result.operations = statementCount;
+   report.AddResult(result);
+
+   SET_LOG_LEVEL(logLevel);
+}
+
+/**
+ * ThreadPool::AddTask throughput: time to post and execute a batch of trivial tasks, and
+ * wakeup latency: time between posting a task to an idle pool and the start of its execution
+ */
+void BenchmarkThreadPool(const BenchmarkOptions& options, BenchmarkReport& report)
+{
+   static const int ThreadCounts[] = {1, 4};
+   for (size_t i = 0; i < sizeof(ThreadCounts)/sizeof(ThreadCounts[0]); ++i)
+   {
+      const long taskCount = 100000 * options.scale;
+      thread_pool::ThreadPool pool(ThreadCounts[i]);
+      pool.Initialize();
+
+      boost::detail::atomic_count counter(0);
+      boost::uint64_t startTime = GetMonotonicTime();
+      for (long task = 0; task < taskCount; ++task)
+         pool.AddTask( boost::bind(&IncrementCounter, &counter) );
+      while (counter < taskCount)
+         boost::this_thread::yield();
+
+      BenchmarkResult result;
+      result.name = "thread_pool.add_task_throughput";
+      result.AddParameter("threads", ThreadCounts[i]);
+      result.AddParameter("tasks", taskCount);
+      result.operations = taskCount;
+      result.totalTime = GetMonotonicTime() - startTime;
+      report.AddResult(result);
+      pool.Shutdown();
+   }
+
+   const long sampleCount = 2000 * options.scale;
+   thread_pool::ThreadPool pool(2);
+   pool.Initialize();
+
+   BenchmarkResult result;
+   result.name = "thread_pool.wakeup_latency";
+   result.AddParameter("threads", 2);
+   result.AddParameter("samples", sampleCount);
+   for (long sample = 0; sample < sampleCount; ++sample)
+   {
+      WakeupProbe probe;
+      boost::unique_lock<boost::mutex> lock(probe.guard);
+      boost::uint64_t postTime = GetMonotonicTime();
+      pool.AddTask( boost::bind(&MarkWakeup, &probe) );
+      while (!probe.isExecuted)
+         probe.event.wait(lock);
+
+      result.samples.push_back(probe.executionTime - postTime);
+      result.totalTime += probe.executionTime - postTime;
+      ++result.operations;
+   }
+   report.AddResult(result);
+   pool.Shutdown();
+}
+
+/**
+ * ConnectionHolder read and framing: ReadAndAppendSocketData followed by GetNextSocketData
+ * over a socketpair with a batch of chat lines waiting in the socket
+ */
+void BenchmarkConnectionHolder(const BenchmarkOptions& options, BenchmarkReport& report)
+{
+   static const int LinesPerRead = 64;
+   const long readCount = 20000 * options.scale;
+   std::string batch;
+   for (int i = 0; i < LinesPerRead; ++i)
+      batch += "benchmark chat line with some payload 0123456789\n";
+
+   network::SocketDescriptor sockets[2];
+   OpenSocketPair(sockets);
+   network::SocketWrapper socket(sockets[0]);
+   socket.SetNonblocking();
+   network::ConnectionHolderPtr holder = boost::make_shared<network::ConnectionHolder>(socket.Release(), false);
+
+   BenchmarkResult result;
+   result.name = "connection_holder.read_framing";
+   result.AddParameter("lines_per_read", LinesPerRead);
+   result.AddParameter("bytes_per_read", batch.length());
+   result.AddParameter("reads", readCount);
+
+   std::string data;
+   for (long i = 0; i < readCount; ++i)
+   {
+      if (::write(sockets[1], batch.c_str(), batch.length()) != static_cast<ssize_t>(batch.length()))
+         THROW_NETWORK_EXCEPTION(errno) << "Unable to write benchmark data";
+
+      boost::uint64_t startTime = GetMonotonicTime();
+      holder->ReadAndAppendSocketData();
+      result_t error = holder->GetNextSocketData(data);
+      result.totalTime += GetMonotonicTime() - startTime;
+
+      if (error != result_code::sOk || data.length() != batch.length())
+         THROW_BASIC_EXCEPTION(result_code::eUnexpected) << "Unexpected framing result: " << data.length();
+   }
+   result.operations = readCount * LinesPerRead;
+   report.AddResult(result);
+
+   holder.reset();
+   ::close(sockets[1]);
+}
+
+/**
+ * ProcessMessageTask parsing: execution of the task with a block of chat lines or chat
+ * commands. Answers are written to a socketpair by the fast pool asynchronously
+ */
+void BenchmarkProcessMessageTask(const BenchmarkOptions& options, BenchmarkReport& report)
+{
+   static const struct
+   {
+      const char* name;
+      const char* line;
+   }
+   Inputs[] =
+   {
+      {"chat", "hello everybody in the chat\n"},
+      {"help", "\\help\n"},
+      {"listall", "\\listall\n"},
+      {"private_unknown", "\\private nobody are you there?\n"},
+      {"unknown_command", "\\foo flood of unknown commands\n"},
+      {"malformed_command", "\\\\ 42 !\n"}
+   };
+   static const int LinesPerTask = 16;
+   const long taskCount = 5000 * options.scale;
+
+   network::ConnectionManager& manager = network::ConnectionManager::GetInstance();
+   SocketSink sink;
+   network::ConnectionHolderPtr sender = CreateConnection(sink, "bench_sender");
+   manager.AddConnection(sender);
+   sink.Start();
+
+   for (size_t input = 0; input < sizeof(Inputs)/sizeof(Inputs[0]); ++input)
+   {
+      std::string data;
+      for (int i = 0; i < LinesPerTask; ++i)
+         data += Inputs[input].line;
+
+      BenchmarkResult result;
+      result.name = std::string("process_message_task.") + Inputs[input].name;
+      result.AddParameter("lines_per_task", LinesPerTask);
+      result.AddParameter("tasks", taskCount);
+      for (long i = 0; i < taskCount; ++i)
+      {
+         engine::MessageDescription message;
+         message.sender = sender;
+         message.senderSocket = sender->GetSocketDescriptor();
+         message.senderName = sender->GetUsername();
+         message.data = data;
+         engine::ProcessMessageTask task(message);
+
+         boost::uint64_t startTime = GetMonotonicTime();
+         task.Execute();
+         result.totalTime += GetMonotonicTime() - startTime;
+      }
+      result.operations = taskCount * LinesPerTask;
+      report.AddResult(result);
+   }
+
+   network::ConnectionHolderList connections(1, sender);
+   sender.reset();
+   ReleaseConnections(connections);
+}
+
+/**
+ * WriteAnswerTask fan-out: delivery of a list of chat lines to every active connection
+ * handled by a single chunk
+ */
+void BenchmarkWriteAnswerTask(const BenchmarkOptions& options, BenchmarkReport& report)
+{
+   static const int ConnectionCounts[] = {8, 64, 64};
+   // the last run merges lines written to the same receiver, see OutboundCoalescer
+   static const int CoalescingWindows[] = {0, 0, 1000};
+   static const int LinesPerTask = 8;
+   network::ConnectionManager& manager = network::ConnectionManager::GetInstance();
+
+   for (size_t i = 0; i < sizeof(ConnectionCounts)/sizeof(ConnectionCounts[0]); ++i)
+   {
+      engine::OutboundCoalescer::GetInstance().SetWindow(CoalescingWindows[i], 16384);
+      const long taskCount = 160000 * options.scale / ConnectionCounts[i];
+      SocketSink sink;
+      network::ConnectionHolderList connections;
+      for (int connection = 0; connection < ConnectionCounts[i]; ++connection)
+      {
+         connections.push_back( CreateConnection(sink, "receiver_" + boost::lexical_cast<std::string>(connection)) );
+         manager.AddConnection(connections.back());
+      }
+      sink.Start();
+
+      BenchmarkResult result;
+      result.name = CoalescingWindows[i] != 0 ? "write_answer_task.coalesced_fan_out" : "write_answer_task.fan_out";
+      result.AddParameter("connections", ConnectionCounts[i]);
+      result.AddParameter("lines_per_task", LinesPerTask);
+      result.AddParameter("tasks", taskCount);
+      for (long task = 0; task < taskCount; ++task)
+      {
+         engine::MessageList messageList(LinesPerTask, "bench_sender> fan-out chat line with some payload\n");
+         engine::MessageDescription message;
+
+         boost::uint64_t startTime = GetMonotonicTime();
+         network::ConnectionHolderList activeConnections;
+         manager.GetActiveConnections(activeConnections);
+         engine::FanOutPtr fanOut( new engine::FanOut(message, messageList, activeConnections) );
+         engine::WriteAnswerTask answerTask(fanOut, 0, fanOut->receivers.size());
+         answerTask.Execute();
+         result.totalTime += GetMonotonicTime() - startTime;
+      }
+      result.operations = taskCount * LinesPerTask * ConnectionCounts[i];
+      report.AddResult(result);
+
+      // let the event loop flush the kept data before the connections are closed
+      manager.ProcessConnections(CoalescingWindows[i] / 1000 + 1);
+      ReleaseConnections(connections);
+   }
+   engine::OutboundCoalescer::GetInstance().SetWindow(0, 16384);
+}
+
+/**
+ * FanOutScheduler broadcast latency: time from posting chat lines to all users until every
+ * chunk is written by the fast pool
+ */
+void BenchmarkFanOut(const BenchmarkOptions& options, BenchmarkReport& report)
+{
+   static const int ConnectionCounts[] = {256, 2048};
+   static const int LinesPerBroadcast = 4;
+   static const int DrainTimeout = 10000;
+   network::ConnectionManager& manager = network::ConnectionManager::GetInstance();
+
+   for (size_t i = 0; i < sizeof(ConnectionCounts)/sizeof(ConnectionCounts[0]); ++i)
+   {
+      const long broadcastCount = 400000 * options.scale / ConnectionCounts[i];
+      SocketSink sink;
+      network::ConnectionHolderList connections;
+      for (int connection = 0; connection < ConnectionCounts[i]; ++connection)
+      {
+         connections.push_back( CreateConnection(sink, "receiver_" + boost::lexical_cast<std::string>(connection)) );
+         manager.AddConnection(connections.back());
+      }
+      sink.Start();
+
+      BenchmarkResult result;
+      result.name = "fan_out.broadcast";
+      result.AddParameter("connections", ConnectionCounts[i]);
+      result.AddParameter("chunk_size", static_cast<long>(engine::FanOutChunkSize));
+      result.AddParameter("broadcasts", broadcastCount);
+      for (long broadcast = 0; broadcast < broadcastCount; ++broadcast)
+      {
+         engine::MessageList messageList(LinesPerBroadcast, "bench_sender> broadcast chat line with some payload\n");
+         engine::MessageDescription message;
+
+         boost::uint64_t startTime = GetMonotonicTime();
+         engine::FanOutScheduler::GetInstance().PostBroadcast(message, messageList);
+         manager.Drain(DrainTimeout);
+         result.totalTime += GetMonotonicTime() - startTime;
+      }
+      result.operations = broadcastCount;
+      report.AddResult(result);
+
+      ReleaseConnections(connections);
+   }
+}
+
+/**
+ * ConnectionManager container operations: add, lookup by name, snapshot and removal
+ */
+void BenchmarkConnectionManager(const BenchmarkOptions& options, BenchmarkReport& report)
+{
+   network::ConnectionManager& manager = network::ConnectionManager::GetInstance();
+   SocketSink sink;
+   network::ConnectionHolderList connections;
+   std::vector<std::string> usernames;
+   for (int i = 0; i < ManagedConnectionsCount; ++i)
+   {
+      usernames.push_back("user_" + boost::lexical_cast<std::string>(i));
+      connections.push_back( CreateConnection(sink, usernames.back()) );
+   }
+   sink.Start();
+
+   BenchmarkResult addResult;
+   addResult.name = "connection_manager.add_connection";
+   addResult.AddParameter("connections", ManagedConnectionsCount);
+   boost::uint64_t startTime = GetMonotonicTime();
+   for (network::ConnectionHolderList::const_iterator it = connections.begin(); it != connections.end(); ++it)
+      manager.AddConnection(*it);
+   addResult.totalTime = GetMonotonicTime() - startTime;
+   addResult.operations = ManagedConnectionsCount;
+   report.AddResult(addResult);
+
+   const long roundCount = 200 * options.scale;
+   BenchmarkResult findResult;
+   findResult.name = "connection_manager.find_by_username";
+   findResult.AddParameter("connections", ManagedConnectionsCount);
+   findResult.AddParameter("rounds", roundCount);
+   network::ConnectionHolderPtr found;
+   startTime = GetMonotonicTime();
+   for (long round = 0; round < roundCount; ++round)
+   {
+      for (std::vector<std::string>::const_iterator it = usernames.begin(); it != usernames.end(); ++it)
+         manager.FindConnectionByUsername(*it, found);
+   }
+   findResult.totalTime = GetMonotonicTime() - startTime;
+   findResult.operations = roundCount * ManagedConnectionsCount;
+   report.AddResult(findResult);
+   found.reset();
+
+   // connections are idle: nothing is buffered, usernames are short
+   BenchmarkResult memoryResult;
+   memoryResult.name = "connection_manager.memory_statistics";
+   network::ConnectionMemoryStatistics statistics;
+   startTime = GetMonotonicTime();
+   for (long round = 0; round < roundCount; ++round)
+      manager.GetMemoryStatistics(statistics);
+   memoryResult.totalTime = GetMonotonicTime() - startTime;
+   memoryResult.operations = roundCount;
+   memoryResult.AddParameter("connections", statistics.connectionCount);
+   memoryResult.AddParameter("bytes_per_connection", statistics.totalBytes / std::max<size_t>(1, statistics.connectionCount));
+   report.AddResult(memoryResult);
+
+   BenchmarkResult snapshotResult;
+   snapshotResult.name = "connection_manager.get_active_connections";
+   snapshotResult.AddParameter("connections", ManagedConnectionsCount);
+   snapshotResult.AddParameter("rounds", roundCount * 10);
+   startTime = GetMonotonicTime();
+   for (long round = 0; round < roundCount * 10; ++round)
+   {
+      network::ConnectionHolderList activeConnections;
+      manager.GetActiveConnections(activeConnections);
+   }
+   snapshotResult.totalTime = GetMonotonicTime() - startTime;
+   snapshotResult.operations = roundCount * 10;
+   report.AddResult(snapshotResult);
+
+   BenchmarkResult removeResult;
+   removeResult.name = "connection_manager.remove_connection";
+   removeResult.AddParameter("connections", ManagedConnectionsCount);
+   startTime = GetMonotonicTime();
+   for (network::ConnectionHolderList::const_iterator it = connections.begin(); it != connections.end(); ++it)
+      manager.RemoveConnection((*it)->GetSocketDescriptor());
+   manager.ProcessConnections(0);
+   removeResult.totalTime = GetMonotonicTime() - startTime;
+   removeResult.operations = ManagedConnectionsCount;
+   report.AddResult(removeResult);
+
+   ReleaseConnections(connections);
+}
+
+/// type of the benchmark case routine
+typedef void (*BenchmarkRoutine)(const BenchmarkOptions& options, BenchmarkReport& report);
+
+/// list of benchmark cases in the order of execution
+static const struct
+{
+   const char*       name;
+   BenchmarkRoutine  routine;
+}
+BenchmarkCases[] =
+{
+   {"logger", &BenchmarkLogger},
+   {"thread_pool", &BenchmarkThreadPool},
+   {"connection_holder", &BenchmarkConnectionHolder},
+   {"process_message_task", &BenchmarkProcessMessageTask},
+   {"write_answer_task", &BenchmarkWriteAnswerTask},
+   {"fan_out", &BenchmarkFanOut},
+   {"connection_manager", &BenchmarkConnectionManager}
+};
+
+/**
+ * Parse command line arguments
+ * @param argc - number of arguments
+ * @param argv - array with arguments
+ * @param options - output options
+ * @returns - true if benchmarks should be executed, false otherwise
+ */
+bool ReadCommandLineArguments(const int argc, char *argv[], BenchmarkOptions& options)
+{
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string argument(argv[i]);
+      if (argument == "--filter" && i + 1 < argc)
+         options.filter = argv[++i];
+      else if (argument == "--scale" && i + 1 < argc)
+         options.scale = std::max(1L, ::strtol(argv[++i], 0, 10));
+      else if (argument == "--output" && i + 1 < argc)
+         options.outputFile = argv[++i];
+      else
+      {
+         LOGEMPTY << "Usage: " << argv[0] << " [--filter <case prefix>] [--scale <iterations multiplier>] [--output <json file>]\n"
+            "Available cases:";
+         for (size_t i = 0; i < sizeof(BenchmarkCases)/sizeof(BenchmarkCases[0]); ++i)
+            LOGEMPTY << "\t" << BenchmarkCases[i].name;
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * Load settings required by ConnectionManager from the temporary config file
+ */
+void LoadBenchmarkSettings()
+{
+   char configName[] = "/tmp/chat_benchmark_XXXXXX";
+   int configFile = ::mkstemp(configName);
+   if (configFile == -1)
+      THROW_BASIC_EXCEPTION(result_code::eFail) << "Unable to create temporary config file";
+   ::close(configFile);
+
+   std::ofstream outFile(configName);
+   outFile << "fast_pool_size=4\nslow_pool_size=2\npresence_window=0\n";
+   outFile.close();
+
+   result_t error = config::ConfigurationManager::GetInstance().LoadSettingsFromFile(configName);
+   ::unlink(configName);
+   if (error != result_code::sOk)
+      THROW_BASIC_EXCEPTION(error) << "Unable to load benchmark settings";
+}
+
+} // unnamed namespace
+
+/**
+ * Entry point of the benchmark application
+ * @param argc - number of input arguments (handled by OS)
+ * @param argv - pointer to the array with input arguments (handled by OS)
+ * @returns - application resulting code
+ */
+int main(int argc, char *argv[])
+{
+   BenchmarkOptions options;
+   if (!ReadCommandLineArguments(argc, argv, options))
+      return result_code::eFail;
+
+   // keep the report clean, measured code is not supposed to log anything above this level
+   SET_LOG_LEVEL(logger::Fatal);
+   // writes to the socket whose sink is already closed must not kill the process
+   ::signal(SIGPIPE, SIG_IGN);
+
+   try
+   {
+      LoadBenchmarkSettings();
+      network::ConnectionManager& manager = network::ConnectionManager::GetInstance();
+      manager.Initialize();
+      engine::OutboundCoalescer::GetInstance().Initialize();
+
+      BenchmarkReport report;
+      for (size_t i = 0; i < sizeof(BenchmarkCases)/sizeof(BenchmarkCases[0]); ++i)
+      {
+         if (std::string(BenchmarkCases[i].name).compare(0, options.filter.length(), options.filter) == 0)
+            BenchmarkCases[i].routine(options, report);
+      }
+      engine::OutboundCoalescer::GetInstance().Shutdown();
+      manager.Shutdown();
+
+      if (options.outputFile.empty())
+      {
+         report.WriteJson(std::cout);
+      }
+      else
+      {
+         std::ofstream outFile(options.outputFile.c_str());
+         report.WriteJson(outFile);
+      }
+   }
+   catch(const std::exception&)
+   {
+      return helpers::ExceptionDispatcher::Dispatch(BOOST_CURRENT_FUNCTION);
+   }
+
+   return result_code::sOk;
+}
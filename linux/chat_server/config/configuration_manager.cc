@@ -32,7 +32,23 @@ ParameterName[] =
    {TcpPort, "tcp_port"},
    {LogLevel, "loglevel"},
    {FastPoolSize, "fast_pool_size"},
-   {SlowPoolSize, "slow_pool_size"}
+   {SlowPoolSize, "slow_pool_size"},
+   {PresenceWindow, "presence_window"},
+   {DrainTimeout, "drain_timeout"},
+   {NodeName, "node_name"},
+   {FederationListen, "federation_listen"},
+   {FederationPeers, "federation_peers"},
+   {TraceSampleRate, "trace_sample_rate"},
+   {TraceBufferSize, "trace_buffer_size"},
+   {TraceFile, "trace_file"},
+   {OverloadQueueSize, "overload_queue_size"},
+   {OverloadQueueWait, "overload_queue_wait"},
+   {BusyPoll, "busy_poll"},
+   {BusyPollSocket, "busy_poll_socket"},
+   {BusyPollCpus, "busy_poll_cpus"},
+   {CaptureFile, "capture_file"},
+   {CoalescingWindow, "coalescing_window"},
+   {CoalescingBytes, "coalescing_bytes"}
 };
 
 /**
@@ -91,6 +107,107 @@ result_t CheckSettingValue(const ParameterId id, const int settingValue)
             LOGERR << "FastPoolSize/SlowPoolSize configurations value must be within these bounds [" << minimumLevel << ";" << maximumLevel << "]";
             return cs::result_code::eInvalidArgument;
          }
+         break;
+      }
+      case PresenceWindow:
+      {
+         const int minimumLevel = 0;
+         const int maximumLevel = 60000;
+         if (settingValue < minimumLevel || settingValue > maximumLevel)
+         {
+            LOGERR << "PresenceWindow configuration value must be within these bounds [" << minimumLevel << ";" << maximumLevel << "]";
+            return cs::result_code::eInvalidArgument;
+         }
+         break;
+      }
+      case TraceSampleRate:
+      {
+         const int minimumLevel = 0;
+         const int maximumLevel = 1000000;
+         if (settingValue < minimumLevel || settingValue > maximumLevel)
+         {
+            LOGERR << "TraceSampleRate configuration value must be within these bounds [" << minimumLevel << ";" << maximumLevel << "]";
+            return cs::result_code::eInvalidArgument;
+         }
+         break;
+      }
+      case TraceBufferSize:
+      {
+         const int minimumLevel = 1;
+         const int maximumLevel = 1000000;
+         if (settingValue < minimumLevel || settingValue > maximumLevel)
+         {
+            LOGERR << "TraceBufferSize configuration value must be within these bounds [" << minimumLevel << ";" << maximumLevel << "]";
+            return cs::result_code::eInvalidArgument;
+         }
+         break;
+      }
+      case OverloadQueueSize:
+      {
+         const int minimumLevel = 0;
+         const int maximumLevel = 10000000;
+         if (settingValue < minimumLevel || settingValue > maximumLevel)
+         {
+            LOGERR << "OverloadQueueSize configuration value must be within these bounds [" << minimumLevel << ";" << maximumLevel << "]";
+            return cs::result_code::eInvalidArgument;
+         }
+         break;
+      }
+      case BusyPoll:
+      {
+         const int minimumLevel = 0;
+         const int maximumLevel = 50;
+         if (settingValue < minimumLevel || settingValue > maximumLevel)
+         {
+            LOGERR << "BusyPoll configuration value must be within these bounds [" << minimumLevel << ";" << maximumLevel << "]";
+            return cs::result_code::eInvalidArgument;
+         }
+         break;
+      }
+      case BusyPollSocket:
+      {
+         const int minimumLevel = 0;
+         const int maximumLevel = 1000000;
+         if (settingValue < minimumLevel || settingValue > maximumLevel)
+         {
+            LOGERR << "BusyPollSocket configuration value must be within these bounds [" << minimumLevel << ";" << maximumLevel << "]";
+            return cs::result_code::eInvalidArgument;
+         }
+         break;
+      }
+      case CoalescingWindow:
+      {
+         const int minimumLevel = 0;
+         const int maximumLevel = 100000;
+         if (settingValue < minimumLevel || settingValue > maximumLevel)
+         {
+            LOGERR << "CoalescingWindow configuration value must be within these bounds [" << minimumLevel << ";" << maximumLevel << "]";
+            return cs::result_code::eInvalidArgument;
+         }
+         break;
+      }
+      case CoalescingBytes:
+      {
+         const int minimumLevel = 1024;
+         const int maximumLevel = 1048576;
+         if (settingValue < minimumLevel || settingValue > maximumLevel)
+         {
+            LOGERR << "CoalescingBytes configuration value must be within these bounds [" << minimumLevel << ";" << maximumLevel << "]";
+            return cs::result_code::eInvalidArgument;
+         }
+         break;
+      }
+      case OverloadQueueWait:
+      case DrainTimeout:
+      {
+         const int minimumLevel = 0;
+         const int maximumLevel = 60000;
+         if (settingValue < minimumLevel || settingValue > maximumLevel)
+         {
+            LOGERR << "DrainTimeout/OverloadQueueWait configuration values must be within these bounds [" << minimumLevel << ";" << maximumLevel << "]";
+            return cs::result_code::eInvalidArgument;
+         }
+         break;
       }
       default:
          break;
@@ -116,7 +233,23 @@ void GenerateConfigFile(const std::string& configName)
       {TcpPort, "6667"},
       {LogLevel, "1"},
       {FastPoolSize, "10"},
-      {SlowPoolSize, "5"}
+      {SlowPoolSize, "5"},
+      {PresenceWindow, "0"},
+      {DrainTimeout, "5000"},
+      {NodeName, ""},
+      {FederationListen, ""},
+      {FederationPeers, ""},
+      {TraceSampleRate, "0"},
+      {TraceBufferSize, "65536"},
+      {TraceFile, "chat_server_trace.json"},
+      {OverloadQueueSize, "10000"},
+      {OverloadQueueWait, "500"},
+      {BusyPoll, "0"},
+      {BusyPollSocket, "0"},
+      {BusyPollCpus, ""},
+      {CaptureFile, ""},
+      {CoalescingWindow, "0"},
+      {CoalescingBytes, "16384"}
    };
 
    std::ofstream outFile(configName.c_str(), std::fstream::out);
@@ -234,7 +367,7 @@ result_t ConfigurationManager::LoadSettingsFromFile(const std::string& configFil
 
 
       static const size_t ConfigFileMaximumLines = 512;
-      static const boost::regex   ConfigFileRegExpression("(\\w*?)[[:blank:]]*=[[:blank:]]*([A-Za-z0-9\\\\.]*?)");
+      static const boost::regex   ConfigFileRegExpression("(\\w*?)[[:blank:]]*=[[:blank:]]*([A-Za-z0-9\\\\.:,/_-]*?)");
 
       ConfigDataStorage tempConfigData;
       std::string line, name, value;
@@ -272,16 +405,59 @@ result_t ConfigurationManager::LoadSettingsFromFile(const std::string& configFil
 }
 
 result_t ConfigurationManager::GetSetting(const ParameterId id, std::string& settingValue)
+{
+   result_t error = FindSetting(id, settingValue);
+   if (error == result_code::eNotFound)
+   {
+      LOGERR << "Unable to find requested setting, id = " << id << ", name = " << GetParameterNameById(id);
+   }
+   return error;
+}
+
+result_t ConfigurationManager::GetSetting(const ParameterId id, int& value)
+{
+   std::string tempValue;
+   result_t error = GetSetting(id, tempValue);
+   if (error != result_code::sOk)
+      return error;
+   return ConvertSetting(id, tempValue, value);
+}
+
+result_t ConfigurationManager::GetOptionalSetting(const ParameterId id, std::string& value,
+   const std::string& defaultValue)
+{
+   result_t error = FindSetting(id, value);
+   if (error != result_code::eNotFound)
+      return error;
+
+   LOGDBG << "Setting is not specified, use default value: [" << (int)id << ", " << defaultValue << "]";
+   value = defaultValue;
+   return result_code::sOk;
+}
+
+result_t ConfigurationManager::GetOptionalSetting(const ParameterId id, int& value, const int defaultValue)
+{
+   std::string tempValue;
+   result_t error = FindSetting(id, tempValue);
+   if (error == result_code::eNotFound)
+   {
+      LOGDBG << "Setting is not specified, use default value: [" << (int)id << ", " << defaultValue << "]";
+      value = defaultValue;
+      return result_code::sOk;
+   }
+   if (error != result_code::sOk)
+      return error;
+   return ConvertSetting(id, tempValue, value);
+}
+
+result_t ConfigurationManager::FindSetting(const ParameterId id, std::string& settingValue)
 {
    try
    {
       LOCK lock(m_settingsAccessGuard);
       ConfigDataStorage::const_iterator it = m_configData.find(id);
       if (it == m_configData.end())
-      {
-         LOGERR << "Unable to find requested setting, id = " << id << ", name = " << GetParameterNameById(id);
          return result_code::eNotFound;
-      }
 
       settingValue = it->second;
       LOGDBG << "Got setting pair: [" << (int)id << ", " << settingValue << "]";
@@ -293,16 +469,11 @@ result_t ConfigurationManager::GetSetting(const ParameterId id, std::string& set
    }
 }
 
-result_t ConfigurationManager::GetSetting(const ParameterId id, int& value)
+result_t ConfigurationManager::ConvertSetting(const ParameterId id, const std::string& settingValue, int& value)
 {
    try
    {
-      std::string tempValue;
-      result_t error = GetSetting(id, tempValue);
-      if (error != result_code::sOk)
-         return error;
-
-      std::istringstream stream(tempValue);
+      std::istringstream stream(settingValue);
       stream >> value;
       return CheckSettingValue(id, value);
    }
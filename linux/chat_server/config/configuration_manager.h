@@ -48,7 +48,86 @@ enum ParameterId
    /// Integer setting that defines size of the 'back-end' thread pool responsible for
    /// processing client data, commutating clients between each other, processing
    /// service messages. Acceptable values: 2, ...
-   SlowPoolSize
+   SlowPoolSize,
+
+   /// Integer setting that defines window in milliseconds during which join/leave/rename
+   /// notifications are collected and then broadcasted as one summary message. Value 0
+   /// means that each notification is broadcasted immediately. Acceptable values: 0, 500, ...
+   PresenceWindow,
+
+   /// Integer setting that defines time in milliseconds given to the server on shutdown to
+   /// complete messages that are already received and to deliver them to clients. Value 0
+   /// means that unprocessed messages are dropped. Acceptable values: 0, 5000, ...
+   DrainTimeout,
+
+   /// String setting that defines unique name of this server instance among federated chat
+   /// nodes. Federation is disabled if the name is not set. Acceptable values: node1, ...
+   NodeName,
+
+   /// String setting that defines address and port where this node accepts links from other
+   /// federated nodes. Inbound links are not accepted if the setting is not set.
+   /// Acceptable values: 127.0.0.1:7001, ...
+   FederationListen,
+
+   /// String setting that defines comma separated list of federated nodes this node links to.
+   /// Acceptable values: 127.0.0.1:7002,127.0.0.1:7003, ...
+   FederationPeers,
+
+   /// Integer setting that defines how often messages are traced: one of N received messages
+   /// is sampled. Value 0 disables tracing. Acceptable values: 0, 1000, ...
+   TraceSampleRate,
+
+   /// Integer setting that defines maximum number of trace spans kept in memory, older spans
+   /// are overwritten. Acceptable values: 1, 65536, ...
+   TraceBufferSize,
+
+   /// String setting that defines file where trace spans are written in Chrome trace event
+   /// format on SIGUSR1 and on shutdown. Acceptable values: /tmp/chat_server_trace.json, ...
+   TraceFile,
+
+   /// Integer setting that defines number of tasks in a thread pool queue beyond which server
+   /// is overloaded: reads from the noisiest clients are paused and new clients are deferred.
+   /// Beyond the doubled value new clients are rejected. Value 0 disables the limit.
+   /// Acceptable values: 0, 10000, ...
+   OverloadQueueSize,
+
+   /// Integer setting that defines time in milliseconds a task may wait in a thread pool queue
+   /// before server is overloaded, see OverloadQueueSize. Value 0 disables the limit.
+   /// Acceptable values: 0, 500, ...
+   OverloadQueueWait,
+
+   /// Integer setting that defines number of workers in each thread pool that poll their queue
+   /// instead of sleeping. Any non-zero value also makes the event loop poll connections without
+   /// sleeping. Trades CPU for latency, so spinning threads better get dedicated cores, see
+   /// BusyPollCpus. Value 0 disables busy polling. Acceptable values: 0, 1, ...
+   BusyPoll,
+
+   /// Integer setting that defines time in microseconds the kernel polls the network device for
+   /// new data on a read from the client socket (SO_BUSY_POLL socket option). Values above
+   /// net.core.busy_read require CAP_NET_ADMIN. Value 0 disables it. Acceptable values: 0, 50, ...
+   BusyPollSocket,
+
+   /// String setting that defines comma separated list of CPU cores for the busy polling threads:
+   /// the first core is taken by the event loop, the following ones by the spinning workers of
+   /// the fast pool and then of the slow pool. Threads beyond the list are not bound.
+   /// Acceptable values: 2,3,4, ...
+   BusyPollCpus,
+
+   /// String setting that defines file where data received from clients is recorded together
+   /// with connection identifiers and timestamps, to be replayed later by chat_replay tool.
+   /// Empty value disables the capture. Applied on SIGHUP as well, so capture could be started
+   /// and stopped without restart. Acceptable values: /tmp/chat_server.cap, ...
+   CaptureFile,
+
+   /// Integer setting that defines time in microseconds chat lines to a connection are kept to
+   /// be merged into one write if the connection was written to less than this time ago. The
+   /// first line after a quiet period is written at once. Value 0 disables coalescing.
+   /// Acceptable values: 0, 500, 2000, ...
+   CoalescingWindow,
+
+   /// Integer setting that defines amount of kept data in bytes that is written without waiting
+   /// for the end of the coalescing window. Acceptable values: 1024, 16384, ...
+   CoalescingBytes
 };
 
 /**
@@ -114,12 +193,39 @@ public:
     */
    result_t GetSetting(const ParameterId id, int& value);
 
+   /**
+    * Get value of the optional string setting by id. Setting missing in the configuration
+    * file (e.g. in files written before the setting was added) is not reported as an error
+    * @param id - id of the setting we want to get a value for
+    * @param value - output string where value of the setting will be copied to
+    * @param defaultValue - value to be used if setting was not specified
+    * @returns - result code of the operation:
+    *            - sOk if either setting or default value was copied
+    *            - eInvalidArgument if invalid parameter id was passed in
+    */
+   result_t GetOptionalSetting(const ParameterId id, std::string& value, const std::string& defaultValue);
+
+   /**
+    * Get value of the optional integer setting by id, see the string version
+    * @param id - id of the setting we want to get a value for
+    * @param value - output integer where value of the setting will be copied to
+    * @param defaultValue - value to be used if setting was not specified
+    * @returns - result code of the operation:
+    *            - sOk if either setting or default value was copied
+    *            - eInvalidArgument if invalid parameter id or setting value was passed in
+    */
+   result_t GetOptionalSetting(const ParameterId id, int& value, const int defaultValue);
+
 private:
    typedef std::map<ParameterId, std::string> ConfigDataStorage;
    typedef boost::lock_guard<boost::mutex> LOCK;
 
    /// Make default constructor private to fit singleton pattern
    ConfigurationManager(){}
+   /// Find setting value by id without reporting missing setting
+   result_t FindSetting(const ParameterId id, std::string& value);
+   /// Convert setting value to integer and validate it
+   result_t ConvertSetting(const ParameterId id, const std::string& settingValue, int& value);
 
    /// file name with configuration settings
    std::string       m_configFileName;
@@ -0,0 +1,141 @@
+/**
+ *  \file
+ *  \brief     FanOutScheduler class implementation
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#include "fan_out_scheduler.h"
+#include "write_answer_task.h"
+#include <logger/logger.h>
+// third-party
+#include <algorithm>
+
+namespace
+{
+
+/**
+ * Select receivers of the delivery among active connections
+ * @param activeConnections - connections opened at the moment
+ * @param senderSocket - socket of the sender
+ * @returns - connections the delivery is written to
+ */
+std::vector<cs::network::ConnectionHolderPtr> SelectReceivers(const cs::network::ConnectionHolderList& activeConnections,
+   cs::network::SocketDescriptor senderSocket)
+{
+   // don't send in 2 cases: either it's a listening socket or it's a sender itself
+   std::vector<cs::network::ConnectionHolderPtr> receivers;
+   receivers.reserve(activeConnections.size());
+   for (cs::network::ConnectionHolderList::const_iterator it = activeConnections.begin();
+      it != activeConnections.end();
+      ++it)
+   {
+      if (!(*it)->IsListeningSocket() && (*it)->GetSocketDescriptor() != senderSocket)
+         receivers.push_back(*it);
+   }
+   return receivers;
+}
+
+} // unnamed namespace
+
+
+namespace cs
+{
+namespace engine
+{
+
+/////////////////////////////////////////////////////////////////
+// FanOut
+
+FanOut::FanOut(const MessageDescription& message, const MessageList& messageList,
+   const network::ConnectionHolderList& activeConnections)
+   : description(message)
+   , receivers(SelectReceivers(activeConnections, message.senderSocket))
+   // chunks are counted over the receivers, the same way Start() posts them
+   , chunkCount(std::max<size_t>(1, (receivers.size() + FanOutChunkSize - 1) / FanOutChunkSize))
+   , pendingChunks(chunkCount)
+   , isSequenced(false)
+{
+   // connection of the sender is not needed anymore
+   description.sender.reset();
+
+   for (MessageList::const_iterator it = messageList.begin(); it != messageList.end(); ++it)
+      data += *it;
+}
+
+/////////////////////////////////////////////////////////////////
+// FanOutScheduler
+
+FanOutScheduler& FanOutScheduler::GetInstance()
+{
+   // g++ guarantees thread-safe initialization for static variable
+   static FanOutScheduler scheduler;
+   return scheduler;
+}
+
+FanOutScheduler::FanOutScheduler()
+   : m_isFanOutActive(false)
+{}
+
+void FanOutScheduler::PostBroadcast(const MessageDescription& message, const MessageList& messageList)
+{
+   network::ConnectionHolderList activeConnections;
+   network::ConnectionManager::GetInstance().GetActiveConnections(activeConnections);
+   FanOutPtr fanOut( new FanOut(message, messageList, activeConnections) );
+   if (fanOut->receivers.empty())
+      return;
+
+   {
+      LOCK lock(m_fanOutAccessGuard);
+      if (m_isFanOutActive)
+      {
+         fanOut->isSequenced = true;
+         m_pendingFanOuts.push_back(fanOut);
+         return;
+      }
+
+      if (fanOut->chunkCount > 1)
+      {
+         fanOut->isSequenced = true;
+         m_isFanOutActive = true;
+      }
+   }
+
+   Start(fanOut);
+}
+
+void FanOutScheduler::OnChunkCompleted(const FanOutPtr& fanOut)
+{
+   if (--fanOut->pendingChunks != 0 || !fanOut->isSequenced)
+      return;
+
+   FanOutPtr nextFanOut;
+   {
+      LOCK lock(m_fanOutAccessGuard);
+      if (m_pendingFanOuts.empty())
+      {
+         m_isFanOutActive = false;
+         return;
+      }
+
+      nextFanOut = m_pendingFanOuts.front();
+      m_pendingFanOuts.pop_front();
+   }
+
+   Start(nextFanOut);
+}
+
+void FanOutScheduler::Start(const FanOutPtr& fanOut)
+{
+   LOGDBG << "Fan-out to " << fanOut->receivers.size() << " receivers in " << fanOut->chunkCount << " chunks";
+   network::ConnectionManager& connectionManager = network::ConnectionManager::GetInstance();
+   const size_t receiverCount = fanOut->receivers.size();
+   for (size_t first = 0; first < receiverCount; first += FanOutChunkSize)
+   {
+      TaskPtr newTask( new WriteAnswerTask(fanOut, first, std::min(first + FanOutChunkSize, receiverCount)) );
+      connectionManager.PostFastTask(newTask);
+   }
+}
+
+} // namespace engine
+} // namespace cs
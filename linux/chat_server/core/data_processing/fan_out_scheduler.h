@@ -0,0 +1,122 @@
+/**
+ *  \file
+ *  \brief     FanOutScheduler class declaration
+ *  \details   Holds declaration of the class that splits delivery of chat lines to all users
+ *             into chunks processed by several fast pool workers
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#ifndef CS_ENGINE_FAN_OUT_SCHEDULER_H
+#define CS_ENGINE_FAN_OUT_SCHEDULER_H
+
+#include "message_description.h"
+#include <network/connection/connection_manager.h>
+// third-party
+#include <boost/noncopyable.hpp>
+#include <boost/detail/atomic_count.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <list>
+#include <vector>
+
+namespace cs
+{
+namespace engine
+{
+
+/// maximum number of receivers handled by one WriteAnswerTask. Chunk is small enough to keep
+/// its connections in the worker cache and large enough to keep the task overhead negligible
+static const size_t FanOutChunkSize = 256;
+
+/**
+ *  \struct    cs::engine::FanOut
+ *  \brief     Delivery of chat lines to all users
+ *  \details   Shared by the WriteAnswerTask chunks of the delivery. Counts the chunks that are
+ *             not written yet, so that the next delivery starts when the current one is over.
+ */
+struct FanOut : public boost::noncopyable
+{
+   /**
+    * Constructor, prepares data and receivers of the delivery
+    * @param message - description of message context, data of sender socket is not delivered
+    * @param messageList - list of chat lines to be delivered
+    * @param activeConnections - connections opened at the moment
+    */
+   FanOut(const MessageDescription& message, const MessageList& messageList,
+      const network::ConnectionHolderList& activeConnections);
+
+   /// description of message context
+   MessageDescription                        description;
+   /// all chat lines of the delivery, written to each receiver at once
+   std::string                               data;
+   /// receivers of the delivery
+   std::vector<network::ConnectionHolderPtr> receivers;
+   /// number of chunks the receivers are split into
+   const size_t                              chunkCount;
+   /// number of chunks that are not written yet
+   boost::detail::atomic_count               pendingChunks;
+   /// flag that the next delivery waits for completion of this one
+   bool                                      isSequenced;
+};
+
+/// type of the delivery shared by the tasks
+typedef boost::shared_ptr<FanOut> FanOutPtr;
+
+/**
+ *  \class     cs::engine::FanOutScheduler
+ *  \brief     Schedules delivery of chat lines to all users
+ *  \details   Delivery to a large audience is split into chunks of FanOutChunkSize receivers,
+ *             each chunk is written by its own WriteAnswerTask, so the fast pool workers share
+ *             the delivery and its latency doesn't grow with the number of users. Chunks of
+ *             different deliveries could be written in any order, therefore a delivery split
+ *             into chunks is started only when the previous one is completed: each receiver
+ *             gets chat lines in the order they were posted. Small deliveries are written by
+ *             a single task and are queued only while a chunked delivery is in progress.
+ *             Object implemented as a singleton and can be accessed from other
+ *             parts of application.
+ */
+class FanOutScheduler : public boost::noncopyable
+{
+public:
+   /**
+    * Method to get access to singleton object
+    * @returns - reference to current instance of FanOutScheduler object
+    */
+   static FanOutScheduler& GetInstance();
+
+   /**
+    * Deliver chat lines to all users except the sender. Active connections are captured
+    * here, so it is better be called in the slow pool
+    * @param message - description of message context
+    * @param messageList - list of chat lines, each terminated with ChatTerminationSymbol
+    */
+   void PostBroadcast(const MessageDescription& message, const MessageList& messageList);
+
+   /**
+    * Notification from WriteAnswerTask that the chunk is written
+    * @param fanOut - delivery the chunk belongs to
+    */
+   void OnChunkCompleted(const FanOutPtr& fanOut);
+
+private:
+   typedef boost::lock_guard<boost::mutex> LOCK;
+
+   /// restrict default constructor to meet singleton pattern
+   FanOutScheduler();
+   /// Post WriteAnswerTask for each chunk of the delivery
+   void Start(const FanOutPtr& fanOut);
+
+   /// deliveries waiting for completion of the current one
+   std::list<FanOutPtr>    m_pendingFanOuts;
+   /// flag that sequenced delivery is in progress
+   bool                    m_isFanOutActive;
+   /// sync object to guard access to the deliveries
+   boost::mutex            m_fanOutAccessGuard;
+};
+
+} // namespace engine
+} // namespace cs
+
+#endif // CS_ENGINE_FAN_OUT_SCHEDULER_H
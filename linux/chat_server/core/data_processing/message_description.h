@@ -9,6 +9,10 @@
 #define CS_ENGINE_MESSAGE_DESCRIPTION_H
 
 #include <network/connection/connection_holder.h>
+#include <tracer/tracer.h>
+// third-party
+#include <list>
+#include <string>
 
 namespace cs
 {
@@ -24,6 +28,9 @@ static const char ChatServiceSymbol = '\\';
 /// nickname that is used in responses from Server
 static const std::string ServerSenderName = "SERVER";
 
+/// list of chat lines delivered at once
+typedef std::list<std::string> MessageList;
+
 /// enum with acceptable chat commands
 enum ChatCommandId
 {
@@ -41,7 +48,7 @@ enum ChatCommandId
    CommandNickName,
 
    /// Description: send private message to the dedicated user
-   /// Format: \private <nickname> message
+   /// Format: \private <nickname>[@<node>] message, node is given for a user of another federated node
    CommandPrivateMessage,
 
    /// Description: force server to close connection for the user who entered this command
@@ -82,6 +89,8 @@ struct MessageDescription
    /// raw data received from network. ProcessMessageTask however assumes
    /// that this block of data has ChatTerminationSymbol at the last position
    std::string                   data;
+   /// trace context of the sampled message, empty if message is not traced
+   tracer::TraceContextPtr       trace;
 };
 
 } // namespace engine
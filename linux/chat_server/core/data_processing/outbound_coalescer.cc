@@ -0,0 +1,240 @@
+/**
+ *  \file
+ *  \brief     OutboundCoalescer class implementation
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#include "outbound_coalescer.h"
+#include <common/exception_dispatcher.h>
+#include <network/connection/connection_manager.h>
+// third-party
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <list>
+
+namespace
+{
+
+using namespace cs;
+
+/// list of connections to be flushed by one task
+typedef std::list<network::ConnectionWeakPtr> FlushList;
+
+/**
+ * Helper function to read monotonic clock, the same clock is used by the flush timer
+ * @returns - current value of the monotonic clock in nanoseconds
+ */
+boost::uint64_t GetMonotonicTime()
+{
+   timespec now;
+   ::clock_gettime(CLOCK_MONOTONIC, &now);
+   return static_cast<boost::uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+/**
+ *  \class     FlushCoalescedDataTask
+ *  \brief     Writes data kept for the connections whose coalescing window is over
+ */
+class FlushCoalescedDataTask
+   : public boost::noncopyable
+   , public engine::ITask
+{
+public:
+   /**
+    * Constructor
+    * @param connections - connections to be flushed, list is taken over
+    */
+   explicit FlushCoalescedDataTask(FlushList& connections)
+   {
+      m_connections.swap(connections);
+   }
+
+   /**
+    * Interface method, writes kept data of the connections that are still alive
+    */
+   virtual void Execute()
+   {
+      try
+      {
+         for (FlushList::const_iterator it = m_connections.begin(); it != m_connections.end(); ++it)
+         {
+            network::ConnectionHolderPtr connection = it->lock();
+            if (connection.get())
+               engine::OutboundCoalescer::GetInstance().Flush(connection);
+         }
+      }
+      catch(const std::exception&)
+      {
+         helpers::ExceptionDispatcher::Dispatch(BOOST_CURRENT_FUNCTION);
+      }
+   }
+
+private:
+   /// connections to be flushed
+   FlushList   m_connections;
+};
+
+} // unnamed namespace
+
+
+namespace cs
+{
+namespace engine
+{
+
+OutboundCoalescer& OutboundCoalescer::GetInstance()
+{
+   // g++ guarantees thread-safe initialization for static variable
+   static OutboundCoalescer coalescer;
+   return coalescer;
+}
+
+OutboundCoalescer::OutboundCoalescer()
+   : m_window(0)
+   , m_maxBytes(0)
+   , m_timerExpiration(0)
+   , m_timer(network::INVALID_DESCRIPTOR)
+   , m_shutdownRequested(false)
+{}
+
+OutboundCoalescer::~OutboundCoalescer()
+{
+   if (m_timer != network::INVALID_DESCRIPTOR)
+      ::close(m_timer);
+}
+
+void OutboundCoalescer::Initialize()
+{
+   if (m_timer != network::INVALID_DESCRIPTOR)
+      THROW_BASIC_EXCEPTION(result_code::eUnexpected) << "Outbound coalescer is already initialized!";
+
+   LOGDBG << "Initializing OutboundCoalescer";
+   int timer = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+   if (timer == network::INVALID_DESCRIPTOR)
+      THROW_NETWORK_EXCEPTION(errno) << "Unable to create coalescing timer";
+
+   network::ConnectionManager::GetInstance().AddEventSource(timer, EPOLLIN,
+      boost::bind(&OutboundCoalescer::OnTimer, this, _1));
+   LOCK lock(m_flushAccessGuard);
+   m_timer = timer;
+}
+
+void OutboundCoalescer::Shutdown()
+{
+   FlushQueue pendingFlushes;
+   int timer = network::INVALID_DESCRIPTOR;
+   {
+      LOCK lock(m_flushAccessGuard);
+      if (m_shutdownRequested)
+         return;
+      m_shutdownRequested = true;
+      m_window.store(0, boost::memory_order_relaxed);
+      pendingFlushes.swap(m_pendingFlushes);
+      std::swap(timer, m_timer);
+   }
+
+   LOGDBG << "Shutdown OutboundCoalescer, connections to flush: " << pendingFlushes.size();
+   for (FlushQueue::const_iterator it = pendingFlushes.begin(); it != pendingFlushes.end(); ++it)
+   {
+      network::ConnectionHolderPtr connection = it->second.lock();
+      if (connection.get())
+         Flush(connection);
+   }
+
+   if (timer != network::INVALID_DESCRIPTOR)
+   {
+      network::ConnectionManager::GetInstance().RemoveEventSource(timer);
+      ::close(timer);
+   }
+}
+
+void OutboundCoalescer::SetWindow(const int window, const size_t maxBytes)
+{
+   LOCK lock(m_flushAccessGuard);
+   if (m_shutdownRequested)
+      return;
+
+   m_window.store(static_cast<boost::uint64_t>(window) * 1000, boost::memory_order_relaxed);
+   m_maxBytes.store(maxBytes, boost::memory_order_relaxed);
+}
+
+void OutboundCoalescer::Write(const network::ConnectionHolderPtr& connection, const std::string& data)
+{
+   // disabled coalescing still goes through the connection: data kept before the window was
+   // turned off must be written first
+   boost::uint64_t flushTime = 0;
+   const boost::uint64_t window = m_window.load(boost::memory_order_relaxed);
+   const size_t maxBytes = m_maxBytes.load(boost::memory_order_relaxed);
+   if (connection->CoalesceDataToSocket(data, GetMonotonicTime(), window, maxBytes, flushTime) == network::FlushRequired)
+      ScheduleFlush(connection, flushTime);
+}
+
+void OutboundCoalescer::Flush(const network::ConnectionHolderPtr& connection)
+{
+   boost::uint64_t flushTime = 0;
+   if (connection->FlushCoalescedData(GetMonotonicTime(), flushTime) == network::FlushRequired)
+      ScheduleFlush(connection, flushTime);
+}
+
+void OutboundCoalescer::ScheduleFlush(const network::ConnectionHolderPtr& connection, const boost::uint64_t flushTime)
+{
+   {
+      LOCK lock(m_flushAccessGuard);
+      if (m_timer != network::INVALID_DESCRIPTOR)
+      {
+         m_pendingFlushes.insert(std::make_pair(flushTime, network::ConnectionWeakPtr(connection)));
+         if (m_timerExpiration == 0 || flushTime < m_timerExpiration)
+            ArmTimer(flushTime);
+         return;
+      }
+   }
+
+   // timer is not running, nobody is going to flush the data later
+   boost::uint64_t retryTime = 0;
+   if (connection->FlushCoalescedData(GetMonotonicTime(), retryTime) == network::FlushRequired)
+      connection->DiscardCoalescedData();
+}
+
+void OutboundCoalescer::OnTimer(const uint32_t /*events*/)
+{
+   FlushList dueConnections;
+   {
+      LOCK lock(m_flushAccessGuard);
+      if (m_timer == network::INVALID_DESCRIPTOR)
+         return;
+
+      uint64_t expirations = 0;
+      if (::read(m_timer, &expirations, sizeof(expirations)) != sizeof(expirations))
+         return;
+
+      m_timerExpiration = 0;
+      FlushQueue::iterator lastDue = m_pendingFlushes.upper_bound(GetMonotonicTime());
+      for (FlushQueue::const_iterator it = m_pendingFlushes.begin(); it != lastDue; ++it)
+         dueConnections.push_back(it->second);
+      m_pendingFlushes.erase(m_pendingFlushes.begin(), lastDue);
+      if (!m_pendingFlushes.empty())
+         ArmTimer(m_pendingFlushes.begin()->first);
+   }
+
+   if (!dueConnections.empty())
+   {
+      TaskPtr flushTask( new FlushCoalescedDataTask(dueConnections) );
+      network::ConnectionManager::GetInstance().PostFastTask(flushTask);
+   }
+}
+
+void OutboundCoalescer::ArmTimer(const boost::uint64_t expirationTime)
+{
+   itimerspec expiration = itimerspec();
+   expiration.it_value.tv_sec = expirationTime / 1000000000;
+   expiration.it_value.tv_nsec = expirationTime % 1000000000;
+   if (::timerfd_settime(m_timer, TFD_TIMER_ABSTIME, &expiration, 0) != 0)
+      THROW_NETWORK_EXCEPTION(errno) << "Unable to set coalescing timer";
+   m_timerExpiration = expirationTime;
+}
+
+} // namespace engine
+} // namespace cs
@@ -0,0 +1,121 @@
+/**
+ *  \file
+ *  \brief     OutboundCoalescer class declaration
+ *  \details   Holds declaration of the class that merges chat lines sent to a busy connection
+ *             into fewer socket writes
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#ifndef CS_ENGINE_OUTBOUND_COALESCER_H
+#define CS_ENGINE_OUTBOUND_COALESCER_H
+
+#include <network/connection/connection_holder.h>
+// third-party
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <map>
+
+namespace cs
+{
+namespace engine
+{
+
+/**
+ *  \class     cs::engine::OutboundCoalescer
+ *  \brief     Merges outbound data of busy connections into fewer socket writes
+ *  \details   Client sockets are opened with TCP_NODELAY, so each write is sent as a separate
+ *             packet. In a chatty room every receiver gets a line per message, therefore data of
+ *             a connection that was written to during the coalescing window is kept and merged
+ *             with the following lines until the window is over or the amount of kept data
+ *             reaches the limit. Window adapts to the traffic by itself: the first line after a
+ *             quiet period is written at once, a busy connection gets one write per window.
+ *             Kept data is flushed by the fast pool when the timer of the event loop expires.
+ *             Coalescing is disabled by default. Object implemented as a singleton and can be
+ *             accessed from other parts of application.
+ */
+class OutboundCoalescer : public boost::noncopyable
+{
+public:
+   /**
+    * Method to get access to singleton object
+    * @returns - reference to current instance of OutboundCoalescer object
+    */
+   static OutboundCoalescer& GetInstance();
+
+   /**
+    * Destructor, closes the timer
+    */
+   ~OutboundCoalescer();
+
+   /**
+    * Add flush timer to the event loop. ConnectionManager must be initialized prior to this call.
+    * Until then all data is written at once
+    */
+   void Initialize();
+
+   /**
+    * Write all kept data and remove the timer from the event loop. Data written afterwards,
+    * e.g. by the drain of the thread pools, is written at once
+    */
+   void Shutdown();
+
+   /**
+    * Set coalescing parameters. Can be changed at runtime, data that is kept already is
+    * flushed as scheduled.
+    * @param window - coalescing window in microseconds, 0 disables coalescing
+    * @param maxBytes - amount of kept data that is written without waiting for the window end
+    */
+   void SetWindow(const int window, const size_t maxBytes);
+
+   /**
+    * Write data to the connection at once or as a part of the coalesced write
+    * @param connection - receiver of the data
+    * @param data - data to be written
+    */
+   void Write(const network::ConnectionHolderPtr& connection, const std::string& data);
+
+   /**
+    * Write data kept for the connection. Data that doesn't fit into the socket buffer is
+    * scheduled to be written once more
+    * @param connection - connection to be flushed
+    */
+   void Flush(const network::ConnectionHolderPtr& connection);
+
+private:
+   typedef boost::lock_guard<boost::mutex> LOCK;
+   /// connections waiting for flush, ordered by the flush time
+   typedef std::multimap<boost::uint64_t, network::ConnectionWeakPtr> FlushQueue;
+
+   /// restrict default constructor to meet singleton pattern
+   OutboundCoalescer();
+   /// Register connection to be flushed at the given time
+   void ScheduleFlush(const network::ConnectionHolderPtr& connection, const boost::uint64_t flushTime);
+   /// Handler of the timer, posts flush of the connections whose time has come
+   void OnTimer(const uint32_t events);
+   /// Set timer to the given time of the monotonic clock. Must be called under m_flushAccessGuard
+   void ArmTimer(const boost::uint64_t expirationTime);
+
+   /// coalescing window in nanoseconds, 0 if coalescing is disabled
+   boost::atomic<boost::uint64_t> m_window;
+   /// amount of kept data that is written without waiting for the window end
+   boost::atomic<size_t>      m_maxBytes;
+   /// connections waiting for flush
+   FlushQueue                 m_pendingFlushes;
+   /// time the timer is set to, 0 if timer is not set
+   boost::uint64_t            m_timerExpiration;
+   /// descriptor of the flush timer, INVALID_DESCRIPTOR until initialized
+   int                        m_timer;
+   /// flag that shutdown was requested
+   bool                       m_shutdownRequested;
+   /// sync object to guard pending flushes and the timer
+   boost::mutex               m_flushAccessGuard;
+};
+
+} // namespace engine
+} // namespace cs
+
+#endif // CS_ENGINE_OUTBOUND_COALESCER_H
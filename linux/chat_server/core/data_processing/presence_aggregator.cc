@@ -0,0 +1,294 @@
+/**
+ *  \file
+ *  \brief     PresenceAggregator class implementation
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#include "presence_aggregator.h"
+#include "process_message_task.h"
+#include <common/exception_dispatcher.h>
+#include <network/connection/connection_manager.h>
+// third-party
+#include <boost/bind.hpp>
+
+namespace
+{
+
+using namespace cs::engine;
+
+/// maximum number of names listed in one summary line. The rest of names is only counted,
+/// otherwise summary of a connection storm would become a message of several megabytes
+static const size_t MaxNamesPerSummaryLine = 20;
+
+/**
+ * Helper function to post server message to all participants except the one
+ * with the given socket
+ * @param text - text of the message, must be terminated with ChatTerminationSymbol
+ * @param senderSocket - socket to be excluded from the list of receivers
+ */
+void PostServerBroadcast(const std::string& text, const cs::network::SocketDescriptor senderSocket)
+{
+   MessageDescription message;
+   message.senderName = ServerSenderName;
+   message.senderSocket = senderSocket;
+   message.data = text;
+   TaskPtr newTask( new ProcessMessageTask(message) );
+   cs::network::ConnectionManager::GetInstance().PostSlowTask(newTask);
+}
+
+/**
+ * Helper function to compose single summary line out of the list of names
+ * @param title - title of the summary line
+ * @param names - list of names to be enumerated
+ * @param output - stream where summary line is appended to
+ */
+template <typename Container, typename Formatter>
+void AppendSummaryLine(
+   const std::string& title,
+   const Container& names,
+   Formatter format,
+   std::ostringstream& output)
+{
+   if (names.empty())
+      return;
+
+   output << title << " (" << names.size() << "): ";
+   size_t count = 0;
+   for (typename Container::const_iterator it = names.begin();
+      it != names.end() && count < MaxNamesPerSummaryLine;
+      ++it, ++count)
+   {
+      if (count)
+         output << ", ";
+      output << format(*it);
+   }
+
+   if (names.size() > MaxNamesPerSummaryLine)
+      output << " and " << names.size() - MaxNamesPerSummaryLine << " more";
+   output << ChatTerminationSymbol;
+}
+
+/// formatter for plain names
+std::string FormatName(const std::string& name)
+{
+   return "'" + name + "'";
+}
+
+/// formatter for nickname changes
+std::string FormatRename(const std::pair<std::string, std::string>& rename)
+{
+   return "'" + rename.first + "' is now known as '" + rename.second + "'";
+}
+
+} // unnamed namespace
+
+
+namespace cs
+{
+namespace engine
+{
+
+PresenceAggregator& PresenceAggregator::GetInstance()
+{
+   // g++ guarantees thread-safe initialization for static variable
+   static PresenceAggregator aggregator;
+   return aggregator;
+}
+
+PresenceAggregator::PresenceAggregator()
+   : m_windowSize(0)
+   , m_shutdownRequested(false)
+{}
+
+void PresenceAggregator::Initialize()
+{
+   if (m_flushingThread.get())
+      THROW_BASIC_EXCEPTION(result_code::eUnexpected) << "Presence aggregator is already initialized!";
+
+   LOGDBG << "Initializing PresenceAggregator";
+   m_flushingThread.reset( new boost::thread( boost::bind(&PresenceAggregator::FlushingThreadRoutine, this) ) );
+}
+
+void PresenceAggregator::Shutdown()
+{
+   {
+      LOCK lock(m_eventsAccessGuard);
+      if (m_shutdownRequested)
+         return;
+      m_shutdownRequested = true;
+   }
+
+   LOGDBG << "Shutdown PresenceAggregator";
+   m_eventsCondition.notify_all();
+   if (m_flushingThread.get())
+   {
+      m_flushingThread->join();
+      m_flushingThread.reset();
+   }
+}
+
+void PresenceAggregator::SetWindowSize(const int windowSize)
+{
+   LOCK lock(m_eventsAccessGuard);
+   m_windowSize = windowSize;
+   // let flushing thread re-evaluate deadline of the current window
+   m_eventsCondition.notify_all();
+}
+
+bool PresenceAggregator::IsEnabled() const
+{
+   LOCK lock(m_eventsAccessGuard);
+   return m_windowSize > 0;
+}
+
+void PresenceAggregator::OnUserJoined(const std::string& username, const network::SocketDescriptor socket)
+{
+   LOCK lock(m_eventsAccessGuard);
+   if (m_windowSize <= 0)
+   {
+      lock.unlock();
+      PostServerBroadcast("User '" + username + "' has joined the chat" + ChatTerminationSymbol, socket);
+      return;
+   }
+
+   if (!HasPendingEvents())
+   {
+      m_windowStart = boost::get_system_time();
+      m_eventsCondition.notify_all();
+   }
+
+   m_joinedIndex[username] = m_joined.insert(m_joined.end(), username);
+}
+
+void PresenceAggregator::OnUserLeft(const std::string& username)
+{
+   LOCK lock(m_eventsAccessGuard);
+   if (m_windowSize <= 0)
+   {
+      lock.unlock();
+      PostServerBroadcast(std::string("User '") + username + "' has left the chat " + ChatTerminationSymbol,
+         network::INVALID_DESCRIPTOR);
+      return;
+   }
+
+   // participant has joined and left within the same window - nobody needs to know about it
+   NameIndex::iterator joined = m_joinedIndex.find(username);
+   if (joined != m_joinedIndex.end())
+   {
+      m_joined.erase(joined->second);
+      m_joinedIndex.erase(joined);
+      return;
+   }
+
+   if (!HasPendingEvents())
+   {
+      m_windowStart = boost::get_system_time();
+      m_eventsCondition.notify_all();
+   }
+
+   // other participants still know this user by the name before the rename
+   std::string knownName(username);
+   for (RenameList::iterator it = m_renamed.begin(); it != m_renamed.end(); ++it)
+   {
+      if (it->second == username)
+      {
+         knownName = it->first;
+         m_renamed.erase(it);
+         break;
+      }
+   }
+   m_left.push_back(knownName);
+}
+
+void PresenceAggregator::OnUserRenamed(const std::string& oldName, const std::string& newName)
+{
+   LOCK lock(m_eventsAccessGuard);
+
+   // join is not delivered yet - just announce participant with the new name
+   NameIndex::iterator joined = m_joinedIndex.find(oldName);
+   if (joined != m_joinedIndex.end())
+   {
+      *joined->second = newName;
+      m_joinedIndex[newName] = joined->second;
+      m_joinedIndex.erase(joined);
+      return;
+   }
+
+   if (!HasPendingEvents())
+   {
+      m_windowStart = boost::get_system_time();
+      m_eventsCondition.notify_all();
+   }
+
+   // collapse chain of renames within the window into a single one
+   for (RenameList::iterator it = m_renamed.begin(); it != m_renamed.end(); ++it)
+   {
+      if (it->second == oldName)
+      {
+         if (it->first == newName)
+            m_renamed.erase(it);
+         else
+            it->second = newName;
+         return;
+      }
+   }
+   m_renamed.push_back(std::make_pair(oldName, newName));
+}
+
+void PresenceAggregator::FlushingThreadRoutine()
+{
+   try
+   {
+      LOGDBG << "Presence flushing thread routine";
+      LOCK lock(m_eventsAccessGuard);
+      while (!m_shutdownRequested)
+      {
+         if (!HasPendingEvents())
+         {
+            m_eventsCondition.wait(lock);
+            continue;
+         }
+
+         if (m_windowSize > 0)
+         {
+            boost::system_time windowEnd = m_windowStart + boost::posix_time::milliseconds(m_windowSize);
+            // woken up before the window end - shutdown or window size change, re-evaluate
+            if (m_eventsCondition.timed_wait(lock, windowEnd))
+               continue;
+         }
+
+         FlushPendingEvents();
+      }
+   }
+   catch(const std::exception&)
+   {
+      helpers::ExceptionDispatcher::Dispatch(BOOST_CURRENT_FUNCTION);
+   }
+   LOGDBG << "Exiting from presence flushing thread routine";
+}
+
+void PresenceAggregator::FlushPendingEvents()
+{
+   std::ostringstream summary;
+   AppendSummaryLine("Users joined the chat", m_joined, FormatName, summary);
+   AppendSummaryLine("Users left the chat", m_left, FormatName, summary);
+   AppendSummaryLine("Users changed nickname", m_renamed, FormatRename, summary);
+
+   m_joined.clear();
+   m_joinedIndex.clear();
+   m_left.clear();
+   m_renamed.clear();
+
+   LOGDBG << "Flush presence summary: " << summary.str();
+   if (!summary.str().empty())
+      PostServerBroadcast(summary.str(), network::INVALID_DESCRIPTOR);
+}
+
+bool PresenceAggregator::HasPendingEvents() const
+{
+   return !m_joined.empty() || !m_left.empty() || !m_renamed.empty();
+}
+
+} // namespace engine
+} // namespace cs
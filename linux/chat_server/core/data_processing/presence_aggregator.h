@@ -0,0 +1,137 @@
+/**
+ *  \file
+ *  \brief     PresenceAggregator class declaration
+ *  \details   Holds declaration of PresenceAggregator class responsible for batching
+ *             join/leave/rename notifications into periodic summary broadcasts
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#ifndef CS_ENGINE_PRESENCE_AGGREGATOR_H
+#define CS_ENGINE_PRESENCE_AGGREGATOR_H
+
+#include <network/descriptor.h>
+// third-party
+#include <boost/noncopyable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/smart_ptr/scoped_ptr.hpp>
+#include <string>
+#include <list>
+#include <map>
+
+namespace cs
+{
+namespace engine
+{
+
+/**
+ *  \class     cs::engine::PresenceAggregator
+ *  \brief     Class that coalesces presence events of chat participants
+ *  \details   Every connect/disconnect/nickname change used to be broadcasted to all
+ *             participants immediately, so a burst of N connections produced N broadcasts
+ *             to N users. When aggregation window is set, events are collected during the
+ *             window and delivered as one summary broadcast. Events which cancel each other
+ *             (user joined and left within the same window) are not delivered at all.
+ *             With zero window every event is broadcasted immediately as before.
+ *             Object implemented as a singleton and can be accessed from other
+ *             parts of application.
+ */
+class PresenceAggregator : public boost::noncopyable
+{
+public:
+   /**
+    * Method to get access to singleton object
+    * @returns - reference to current instance of PresenceAggregator object
+    */
+   static PresenceAggregator& GetInstance();
+
+   /**
+    * Starts flushing thread. Window size should be set prior to this call.
+    */
+   void Initialize();
+
+   /**
+    * Stops flushing thread. Pending events are dropped as there is nobody to deliver them to.
+    */
+   void Shutdown();
+
+   /**
+    * Set size of the aggregation window. Can be changed at runtime, pending events
+    * are flushed immediately if aggregation is turned off.
+    * @param windowSize - aggregation window in milliseconds, 0 turns aggregation off
+    */
+   void SetWindowSize(const int windowSize);
+
+   /**
+    * Helper function to see if presence events are aggregated or delivered immediately
+    * @returns - true if aggregation window is set, false otherwise
+    */
+   bool IsEnabled() const;
+
+   /**
+    * Register new chat participant
+    * @param username - auto-generated name of the new participant
+    * @param socket - socket of the new participant. Used to exclude the participant
+    *                 from immediate notification when aggregation is off
+    */
+   void OnUserJoined(const std::string& username, const network::SocketDescriptor socket);
+
+   /**
+    * Register participant disconnect
+    * @param username - name of the participant that has left the chat
+    */
+   void OnUserLeft(const std::string& username);
+
+   /**
+    * Register nickname change. Should be used only when aggregation is enabled, otherwise
+    * rename notification is delivered by ProcessMessageTask in order with chat messages.
+    * @param oldName - previous name of the participant
+    * @param newName - new name of the participant
+    */
+   void OnUserRenamed(const std::string& oldName, const std::string& newName);
+
+private:
+   typedef boost::unique_lock<boost::mutex> LOCK;
+   typedef std::list<std::string> NameList;
+   typedef std::map<std::string, NameList::iterator> NameIndex;
+   typedef std::list<std::pair<std::string, std::string> > RenameList;
+
+   /// restrict default constructor to meet singleton pattern
+   PresenceAggregator();
+   /// Routine for the thread that waits for the window end and flushes pending events
+   void FlushingThreadRoutine();
+   /// Compose summary of pending events and post it to all participants. Pending
+   /// events are cleared. Must be called under m_eventsAccessGuard
+   void FlushPendingEvents();
+   /// Helper method to see if there is anything to flush
+   bool HasPendingEvents() const;
+
+   /// names of participants joined within current window, in order of arrival
+   NameList                            m_joined;
+   /// index of m_joined to cancel join/leave pairs without traversing the list
+   NameIndex                           m_joinedIndex;
+   /// names of participants left within current window, in order of arrival
+   NameList                            m_left;
+   /// nickname changes within current window (old name, new name)
+   RenameList                          m_renamed;
+   /// time when the first event of current window has arrived
+   boost::system_time                  m_windowStart;
+   /// sync object to guard pending events and window settings
+   mutable boost::mutex                m_eventsAccessGuard;
+   /// event to wake up flushing thread on first pending event or shutdown
+   boost::condition_variable           m_eventsCondition;
+   /// aggregation window in milliseconds
+   int                                 m_windowSize;
+   /// flag that shutdown was requested
+   bool                                m_shutdownRequested;
+   /// wrapper for flushing thread
+   boost::scoped_ptr<boost::thread>    m_flushingThread;
+};
+
+} // namespace engine
+} // namespace cs
+
+#endif // CS_ENGINE_PRESENCE_AGGREGATOR_H
@@ -8,9 +8,12 @@
  */
 
 #include "process_message_task.h"
+#include "presence_aggregator.h"
+#include "fan_out_scheduler.h"
 #include <common/exception_dispatcher.h>
 #include <common/compiled_definitions.h>
 #include <network/connection/connection_manager.h>
+#include <network/federation/federation_manager.h>
 // third-party
 #include <boost/regex.hpp>
 #include <boost/algorithm/string.hpp>
@@ -21,12 +24,15 @@ namespace
 using namespace cs::engine;
 
 /**
- * Local function to get command id by the given name. Caller must be prepared to handle exception
- * with eInvalidArgument code if input command id doesn't match any of the hard-coded commands
+ * Local function to get command id by the given name. Command name comes from the client,
+ * so mismatch is a regular case and is reported with result code
  * @param commandName - name of the command to be validated
  * @param id - id of the command if any was found
+ * @returns - result of the operation performed:
+ *             - sOk if command id was found
+ *             - eNotFound if input command name doesn't match any of the hard-coded commands
  */
-void GetCommandIdByName(const std::string& commandName, cs::engine::ChatCommandId& id)
+result_t GetCommandIdByName(const std::string& commandName, cs::engine::ChatCommandId& id)
 {
    static const struct
    {
@@ -49,10 +55,11 @@ void GetCommandIdByName(const std::string& commandName, cs::engine::ChatCommandI
       if (ChatCommandNames[i].name == commandName)
       {
          id = ChatCommandNames[i].id;
-         return;
+         return cs::result_code::sOk;
       }
 
-   THROW_INVALID_ARGUMENT << "Unable to get command id by name: " << commandName;
+   LOGDBG << "Unable to get command id by name: " << commandName;
+   return cs::result_code::eNotFound;
 }
 
 /**
@@ -73,7 +80,7 @@ result_t ValidateNickname(const std::string& nickname, std::string& errorMessage
    boost::to_upper(upperNickname);
 
    if ( nickname.empty() || (nickname.length() > MaxNicknameLength) ||
-        (upperNickname == ServerSenderName) )
+        (upperNickname == ServerSenderName) || (nickname.find(cs::network::RemoteNodeSeparator) != std::string::npos) )
    {
       message << "Nickname error: \nNickname can contain only letters [a-z] and digits [0-9].\n"
          << "Empty nicknames are not allowed.\n"
@@ -86,18 +93,15 @@ result_t ValidateNickname(const std::string& nickname, std::string& errorMessage
 }
 
 /**
- * Helper function to fire WriteAnswerTask with specific message list. Intended for delivery
- * of several chat messages to all users. This helper function happens to
+ * Helper function to deliver specific message list to all users. Active connections are
+ * captured here - small trick to save time for fast pool
  * @param messageDescription - message context description to be passed to WriteAnswerTask
  * @param messageList - list of chat messages
  */
 void PostMultipleMessages(const MessageDescription& messageDescription, MessageList& messageList)
 {
-   WriteAnswerTask* task = new WriteAnswerTask(messageDescription, messageList);
-   // capture new connections for it - small trick to save time for fast pool
-   task->CaptureActiveConnections(messageDescription.senderSocket);
-   cs::engine::TaskPtr newTask(task);
-   cs::network::ConnectionManager::GetInstance().PostFastTask(newTask);
+   FanOutScheduler::GetInstance().PostBroadcast(messageDescription, messageList);
+   messageList.clear();
 }
 
 /**
@@ -136,26 +140,36 @@ namespace engine
 {
 
 ProcessMessageTask::ProcessMessageTask(const MessageDescription& message)
+   : m_stageTrace("process_queue", "process")
 {
    size_t length = message.data.length();
    CHECK_ARGUMENT(length > 1, "Message data is empty!");
    CHECK_ARGUMENT(message.data[length-1] == ChatTerminationSymbol, "No termination symbol!");
 
    m_messageDescription = message;
+   m_stageTrace.Queued(message.trace);
 }
 
 void ProcessMessageTask::Execute()
 {
    try
    {
+      tracer::StageScope stageScope(m_stageTrace);
       // split socket data into smaller pieces using termination symbol
       LOGDBG << "Processing: " << m_messageDescription.data;
       std::string singleChatMessage;
-      size_t terminationPosition = m_messageDescription.data.find(ChatTerminationSymbol) + 1;
-
-      for (size_t i = 0; i < m_messageDescription.data.size(); i += terminationPosition)
+      const std::string& data = m_messageDescription.data;
+      size_t lineStart = 0;
+      while (lineStart < data.length())
       {
-         singleChatMessage = m_messageDescription.data.substr(i, terminationPosition);
+         // data is guaranteed to end with termination symbol, so every line has one
+         size_t lineEnd = data.find(ChatTerminationSymbol, lineStart) + 1;
+         singleChatMessage.assign(data, lineStart, lineEnd - lineStart);
+         lineStart = lineEnd;
+
+         // skip empty lines
+         if (singleChatMessage[0] == ChatTerminationSymbol)
+            continue;
 
          if (singleChatMessage[0] == ChatServiceSymbol)
          {
@@ -178,8 +192,6 @@ void ProcessMessageTask::Execute()
          {
             StoreChatMessage(m_messageDescription.senderName, singleChatMessage);
          }
-
-         terminationPosition = m_messageDescription.data.find(ChatTerminationSymbol, i) + 1;
       }
 
       ProcessChatMessages();
@@ -200,6 +212,8 @@ void ProcessMessageTask::ProcessChatMessages()
       return;
    }
 
+   // relay before posting, as posting takes over the content of the list
+   network::FederationManager::GetInstance().RelayBroadcast(m_messageList);
    PostMultipleMessages(m_messageDescription, m_messageList);
 }
 
@@ -212,7 +226,8 @@ result_t ProcessMessageTask::ProcessServiceMessage(const std::string& serviceMes
 {
    try
    {
-      static const boost::regex ServiceMessageRegExpression("^\\\\([A-Za-z]{1,})\\s*(\\s{1,}[A-Za-z0-9]{1,})?(\\s{1,}.*)?[\r]?\n$");
+      // argument can be a name of the remote user in the form 'name@node', as \listall prints it
+      static const boost::regex ServiceMessageRegExpression("^\\\\([A-Za-z]{1,})\\s*(\\s{1,}[A-Za-z0-9]{1,}(?:@[A-Za-z0-9_.-]{1,})?)?(\\s{1,}.*)?[\r]?\n$");
       LOGDBG << "Process service message: " << serviceMessage;
       boost::smatch matches;
 
@@ -227,7 +242,9 @@ result_t ProcessMessageTask::ProcessServiceMessage(const std::string& serviceMes
             " text length " << commandText.length();
 
       ChatCommandId id;
-      GetCommandIdByName(chatCommand, id);
+      result_t error = GetCommandIdByName(chatCommand, id);
+      if (error != result_code::sOk)
+         return error;
       return AssembleServiceMessage(id, commandArgument, commandText);
    }
    catch(const std::exception&)
@@ -258,7 +275,7 @@ result_t ProcessMessageTask::AssembleServiceMessage(
                << "\t\\quit - quit chat\n"
                << "\t\\listall - list all active participants\n"
                << "\t\\nickname <new nickname> - change your nickname to a new one\n"
-               << "\t\\private <nickname> <message> - post a private message to the dedicated participant";
+               << "\t\\private <nickname>[@<node>] <message> - post a private message to the dedicated participant";
          PostServerMessage(m_messageDescription, helpMessage.str());
          break;
       }
@@ -277,6 +294,11 @@ result_t ProcessMessageTask::AssembleServiceMessage(
             messageText = messageText + ChatTerminationSymbol + " " + (*it)->GetUsername();
          }
 
+         network::UsernameList remoteUsernames;
+         network::FederationManager::GetInstance().GetRemoteUsernames(remoteUsernames);
+         for (network::UsernameList::const_iterator it = remoteUsernames.begin(); it != remoteUsernames.end(); ++it)
+            messageText = messageText + ChatTerminationSymbol + " " + *it;
+
          PostServerMessage(m_messageDescription, messageText);
          break;
       }
@@ -288,8 +310,11 @@ result_t ProcessMessageTask::AssembleServiceMessage(
             return result_code::sOk;
          }
 
+         network::FederationManager& federation = network::FederationManager::GetInstance();
          network::SocketDescriptor socket = m_messageDescription.senderSocket;
-         result_t error = manager.SetClientUsername(socket, commandArgument);
+         result_t error = federation.IsRemoteUsername(commandArgument) ?
+            static_cast<result_t>(result_code::eAlreadyDefined) :
+            static_cast<result_t>(manager.SetClientUsername(socket, commandArgument));
          if (error == result_code::eAlreadyDefined)
          {
             // respond to user with error server message
@@ -304,32 +329,61 @@ result_t ProcessMessageTask::AssembleServiceMessage(
          }
 
          PostServerMessage(m_messageDescription, "ok.");
-         messageText = "User '" + m_messageDescription.senderName +
-               "' is now known as '" + commandArgument + "'" + ChatTerminationSymbol;
-         StoreChatMessage(ServerSenderName, messageText);
+         federation.OnLocalUserRenamed(m_messageDescription.senderName, commandArgument);
+         PresenceAggregator& aggregator = PresenceAggregator::GetInstance();
+         if (aggregator.IsEnabled())
+         {
+            aggregator.OnUserRenamed(m_messageDescription.senderName, commandArgument);
+         }
+         else
+         {
+            messageText = "User '" + m_messageDescription.senderName +
+                  "' is now known as '" + commandArgument + "'" + ChatTerminationSymbol;
+            StoreChatMessage(ServerSenderName, messageText);
+         }
 
          m_messageDescription.senderName = commandArgument;
          break;
       }
       case CommandPrivateMessage:
       {
+         // user of another federated node can be addressed as 'name@node'
+         network::FederationManager& federation = network::FederationManager::GetInstance();
+         std::string receiverName(commandArgument);
+         std::string receiverNode;
+         const size_t nodeStart = commandArgument.find(network::RemoteNodeSeparator);
+         if (nodeStart != std::string::npos)
+         {
+            receiverNode = commandArgument.substr(nodeStart + 1);
+            receiverName.erase(nodeStart);
+            if (federation.IsLocalNode(receiverNode))
+               receiverNode.clear();
+         }
+
          // don't allow sending loop-back messages
-         if (commandArgument == m_messageDescription.senderName)
+         if (receiverNode.empty() && receiverName == m_messageDescription.senderName)
          {
             messageText = "Private loop-back messages are not allowed.";
             PostServerMessage(m_messageDescription, messageText);
             return result_code::sOk;
          }
 
-         if (ValidateNickname(commandArgument, messageText) != result_code::sOk)
+         if (ValidateNickname(receiverName, messageText) != result_code::sOk)
          {
             PostServerMessage(m_messageDescription, messageText);
             return result_code::sOk;
          }
 
-         result_t error = manager.FindConnectionByUsername(commandArgument, m_messageDescription.receiver);
-         if (error == result_code::eNotFound )
+         result_t error = receiverNode.empty() ?
+            static_cast<result_t>(manager.FindConnectionByUsername(receiverName, m_messageDescription.receiver)) :
+            static_cast<result_t>(result_code::eNotFound);
+         if (error == result_code::eNotFound)
          {
+            // receiver may be connected to another federated node
+            messageText = m_messageDescription.senderName + ":private> " + commandText + ChatTerminationSymbol;
+            if (federation.RelayPrivateMessage(receiverName, receiverNode, messageText) == result_code::sOk)
+               break;
+
             // respond to user with error server message
             messageText = "User with the nickname '" + commandArgument + "' doesn't exist.";
             PostServerMessage(m_messageDescription, messageText);
@@ -355,8 +409,10 @@ result_t ProcessMessageTask::AssembleServiceMessage(
             "may want to use the '\\nickname' command to change it. For detailed list of available commands and options "
             "plese use the \\help command." << ChatTerminationSymbol;
 
-         m_messageDescription.data = m_messageDescription.senderName + "> " + introMessage.str();
-         PostSingleMessage(m_messageDescription);
+         // received data is still being split into lines by Execute, so it is not overwritten
+         MessageDescription newMessage(m_messageDescription);
+         newMessage.data = newMessage.senderName + "> " + introMessage.str();
+         PostSingleMessage(newMessage);
          break;
       }
       default:
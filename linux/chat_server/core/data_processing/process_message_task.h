@@ -64,6 +64,8 @@ private:
    MessageDescription   m_messageDescription;
    /// list of text chat messages decomposed from network data
    MessageList          m_messageList;
+   /// trace of the task stage
+   tracer::StageTrace   m_stageTrace;
 };
 
 } // namespace engine
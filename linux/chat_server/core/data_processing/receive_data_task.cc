@@ -15,17 +15,26 @@ namespace engine
 {
 
 ReceiveDataTask::ReceiveDataTask(const network::ConnectionHolderPtr& holder)
+   : m_stageTrace("receive_queue", "receive")
 {
    CHECK_ARGUMENT(holder.get() != 0, "Empty connection holder!");
-   CHECK_ARGUMENT(holder->IsSocketValid(), "Invalid socket");
 
    m_connection = holder;
+   m_stageTrace.Queued(tracer::Tracer::GetInstance().StartTrace());
 }
 
 void ReceiveDataTask::Execute()
 {
    try
    {
+      tracer::StageScope stageScope(m_stageTrace);
+      // connection could be closed by another task after the read event has been triggered
+      if (!m_connection->IsSocketValid())
+      {
+         LOGDBG << "Skip read on closed connection";
+         return;
+      }
+
       network::SocketDescriptor currentSocket = m_connection->GetSocketDescriptor();
 
       result_t error = m_connection->ReadAndAppendSocketData();
@@ -54,8 +63,8 @@ void ReceiveDataTask::Execute()
          return;
       }
 
-      // skip empty string
-      if (tempString[0] == ChatTerminationSymbol)
+      // skip data that consists of empty lines only
+      if (tempString.find_first_not_of(ChatTerminationSymbol) == std::string::npos)
          return;
 
       // dispatch write task further
@@ -64,6 +73,7 @@ void ReceiveDataTask::Execute()
       message.senderSocket = currentSocket;
       message.senderName = m_connection->GetUsername();
       message.data = tempString;
+      message.trace = m_stageTrace.GetContext();
       engine::TaskPtr newTask( new ProcessMessageTask(message) );
       network::ConnectionManager::GetInstance().PostSlowTask(newTask);
    }
@@ -13,6 +13,7 @@
 
 #include <network/connection/connection_holder.h>
 #include "task.h"
+#include <tracer/tracer.h>
 // third-party
 #include <boost/noncopyable.hpp>
 
@@ -47,6 +48,8 @@ public:
 private:
    /// holds active network connection that we need to receive data from
    network::ConnectionHolderPtr  m_connection;
+   /// trace of the task stage, the task decides whether received data is sampled
+   tracer::StageTrace            m_stageTrace;
 };
 
 } // namespace engine
@@ -5,6 +5,7 @@
  *  \date      2012
  */
 #include "write_answer_task.h"
+#include "outbound_coalescer.h"
 #include <common/exception_dispatcher.h>
 #include <network/connection/connection_manager.h>
 
@@ -13,51 +14,43 @@ namespace cs
 namespace engine
 {
 
-WriteAnswerTask::WriteAnswerTask(const MessageDescription& message, MessageList& messageList)
-   : m_messageDescription(message)
+WriteAnswerTask::WriteAnswerTask(const FanOutPtr& fanOut, const size_t firstReceiver, const size_t lastReceiver)
+   : m_fanOut(fanOut)
+   , m_firstReceiver(firstReceiver)
+   , m_lastReceiver(lastReceiver)
+   , m_stageTrace("write_queue", "write")
 {
-   // we don't really care here if source socket is closed, because aim of this task is to send
-   // to another opened connections. So just store socket descriptor for future use
-   m_messageList.swap(messageList);
-   LOGDBG << "Process message list: " << m_messageList.size();
-
-   m_messageDescription.sender.reset(); // force connection release as we don't need it anymore
+   // context of the message is shared by all the chunks, so it's not copied here
+   m_stageTrace.Queued(fanOut->description.trace);
 }
 
 WriteAnswerTask::WriteAnswerTask(const MessageDescription& message)
-   : m_messageDescription(message)
+   : m_firstReceiver(0)
+   , m_lastReceiver(0)
+   , m_messageDescription(message)
+   , m_stageTrace("write_queue", "write")
 {
    LOGDBG << "Process single message ";
    m_messageDescription.sender.reset();
+   m_stageTrace.Queued(message.trace);
 }
 
 void WriteAnswerTask::Execute()
 {
    try
    {
-      if (!m_messageList.empty())
+      tracer::StageScope stageScope(m_stageTrace);
+      OutboundCoalescer& coalescer = OutboundCoalescer::GetInstance();
+      if (m_fanOut)
       {
-         LOGDBG << "Handle message list: " << m_messageList.size();
-         for (MessageList::const_iterator msg = m_messageList.begin();
-            msg != m_messageList.end();
-            ++msg)
-         {
-            for (network::ConnectionHolderList::const_iterator it = m_activeConnections.begin();
-               it != m_activeConnections.end();
-               ++it)
-            {
-               // don't allow sending in 2 cases: either it's a listening socket or it's a sender itself
-               if ((*it)->IsListeningSocket() || ((*it)->GetSocketDescriptor() == m_messageDescription.senderSocket))
-                  continue;
-
-               (*it)->WriteDataToSocket(*msg);
-            }
-         }
+         LOGDBG << "Handle chunk of receivers: " << m_firstReceiver << "-" << m_lastReceiver;
+         for (size_t i = m_firstReceiver; i < m_lastReceiver; ++i)
+            coalescer.Write(m_fanOut->receivers[i], m_fanOut->data);
       }
       else if (!m_messageDescription.data.empty())
       {
          LOGDBG << "Handle single message";
-         m_messageDescription.receiver->WriteDataToSocket(m_messageDescription.data);
+         coalescer.Write(m_messageDescription.receiver, m_messageDescription.data);
       }
       else
       {
@@ -68,11 +61,10 @@ void WriteAnswerTask::Execute()
    {
       helpers::ExceptionDispatcher::Dispatch(BOOST_CURRENT_FUNCTION);
    }
-}
 
-void WriteAnswerTask::CaptureActiveConnections(network::SocketDescriptor sourceDescriptor)
-{
-   network::ConnectionManager::GetInstance().GetActiveConnections(m_activeConnections);
+   // chunk is over even if it failed, otherwise the following deliveries would never start
+   if (m_fanOut)
+      FanOutScheduler::GetInstance().OnChunkCompleted(m_fanOut);
 }
 
 } // namespace engine
@@ -10,21 +10,17 @@
 #ifndef CS_ENGINE_WRITE_ANSWER_TASK_H
 #define CS_ENGINE_WRITE_ANSWER_TASK_H
 
+#include "fan_out_scheduler.h"
 #include "message_description.h"
 #include "task.h"
-#include <network/connection/connection_manager.h>
-#include <network/descriptor.h>
 // third-party
 #include <boost/noncopyable.hpp>
-#include <list>
 
 namespace cs
 {
 namespace engine
 {
 
-typedef std::list<std::string> MessageList;
-
 /**
  *  \class     cs::engine::WriteAnswerTask
  *  \brief     Class that implements writing response data back to network interface
@@ -32,7 +28,8 @@ typedef std::list<std::string> MessageList;
  *             back to opened connection. Data can be either broadcast chat messages from other
  *             user or p2p private chat messages or server messages to a dedicated client.
  *             Quite light class that does not perform data processing, therefore can be
- *             executed in a fast pool.
+ *             executed in a fast pool. Delivery to all users is split by FanOutScheduler, so
+ *             each task handles one chunk of receivers only.
  */
 class WriteAnswerTask
    : public boost::noncopyable
@@ -40,11 +37,12 @@ class WriteAnswerTask
 {
 public:
    /**
-    * Custom constructor, intended for sending list of messages to all users
-    * @param message - description of message context
-    * @param messageList - list of messages to be sent
+    * Custom constructor, intended for sending chat lines to the chunk of all users
+    * @param fanOut - delivery the chunk belongs to
+    * @param firstReceiver - index of the first receiver of the chunk
+    * @param lastReceiver - index past the last receiver of the chunk
     */
-   WriteAnswerTask(const MessageDescription& message, MessageList& messageList);
+   WriteAnswerTask(const FanOutPtr& fanOut, const size_t firstReceiver, const size_t lastReceiver);
 
    /**
     * Custom constructor, intended for sending single message to one/all users
@@ -57,23 +55,17 @@ public:
     */
    virtual void Execute();
 
-   /**
-    * Helper function to obtain list of active connections and store them locally
-    * in container. Aim of this is to get connections at the point when WriteAnswerTask has
-    * been constructed already but is not being processed yet. Trick to save time for the
-    * fast pool, therefore this method better be called in slow pool
-    * @param sourceDescriptor - descriptor of the source sender, need it to exclude source
-    *                           connection from the list of active connections
-    */
-   void CaptureActiveConnections(network::SocketDescriptor sourceDescriptor);
- 
 private:
-   /// list of active connections that will be targeted while sending simple chat message
-   network::ConnectionHolderList m_activeConnections;
+   /// delivery to all users, empty for a single message
+   FanOutPtr                     m_fanOut;
+   /// index of the first receiver of the delivery handled by the task
+   size_t                        m_firstReceiver;
+   /// index past the last receiver of the delivery handled by the task
+   size_t                        m_lastReceiver;
    /// context of the message to be sent
    MessageDescription            m_messageDescription;
-   /// list of messages to be sent
-   MessageList                   m_messageList;
+   /// trace of the task stage
+   tracer::StageTrace            m_stageTrace;
 };
 
 } // namespace engine
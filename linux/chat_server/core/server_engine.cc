@@ -6,11 +6,64 @@
  */
 
 #include "server_engine.h"
+#include "data_processing/presence_aggregator.h"
+#include "data_processing/outbound_coalescer.h"
+#include <network/federation/federation_manager.h>
+#include <network/connection/connection_manager.h>
 #include <config/configuration_manager.h>
 #include <common/exception_dispatcher.h>
+#include <tracer/tracer.h>
+#include <capture/traffic_capture.h>
 // third-party
 #include <unistd.h>
+#include <sched.h>
 #include <boost/bind.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <list>
+#include <vector>
+
+namespace
+{
+
+/**
+ * Helper function to parse comma separated list of CPU cores. Never throws.
+ * @param cpuList - list of cores, e.g. "2,3,4"
+ * @param cpus - output container with indexes of the cores
+ * @returns - result code of the operation:
+ *             - sOk if list is parsed, empty list is valid as well
+ *             - eInvalidArgument if list contains something else than core indexes
+ */
+result_t ParseCpuList(const std::string& cpuList, std::vector<int>& cpus)
+{
+   std::list<std::string> items;
+   boost::split(items, cpuList, boost::is_any_of(","), boost::token_compress_on);
+   items.remove(std::string(""));
+
+   std::vector<int> tempCpus;
+   for (std::list<std::string>::const_iterator it = items.begin(); it != items.end(); ++it)
+   {
+      try
+      {
+         tempCpus.push_back(boost::lexical_cast<int>(*it));
+      }
+      catch(const boost::bad_lexical_cast&)
+      {
+         LOGERR << "Invalid CPU core in the list: " << *it;
+         return cs::result_code::eInvalidArgument;
+      }
+      if (tempCpus.back() < 0 || tempCpus.back() >= CPU_SETSIZE)
+      {
+         LOGERR << "CPU core is out of range: " << *it;
+         return cs::result_code::eInvalidArgument;
+      }
+   }
+   cpus.swap(tempCpus);
+   return cs::result_code::sOk;
+}
+
+} // unnamed namespace
+
 
 namespace cs
 {
@@ -62,13 +115,27 @@ void ServerEngine::Start()
       // Need to do it here, before any child thread starts. In this case every child thread
       // will inherit the same signal mask and SignalManager will be able handle signals properly
       signal::SignalHandler handler = boost::bind(&ServerEngine::OnSystemSignal, this, _1);
-      const long signalWaitTimeout = 300;
-      m_signalManager->Initialize(signalWaitTimeout, handler);
+      m_signalManager->Initialize(handler);
+
+      // Initialize PresenceAggregator before any connection is accepted
+      PresenceAggregator::GetInstance().Initialize();
+
+      // Initialize FederationManager before any connection is accepted, so no local user is missed
+      network::FederationManager& federation = network::FederationManager::GetInstance();
+      federation.Initialize();
 
       // Initialize NetworkManager
       m_networkManager->Initialize();
-      m_networkManager->Start();
-      m_signalManager->ProcessSignals();
+      OutboundCoalescer::GetInstance().Initialize();
+
+      // signals are delivered through the same event loop that handles connections
+      network::ConnectionManager::GetInstance().AddEventSource(m_signalManager->GetDescriptor(), EPOLLIN,
+         boost::bind(&signal::SignalManager::ProcessSignals, m_signalManager.get()));
+      federation.Start();
+
+      // blocking call, returns once shutdown is requested
+      m_networkManager->Run();
+      Shutdown();
    }
    catch(const std::exception& ex)
    {
@@ -83,8 +150,15 @@ void ServerEngine::Shutdown()
    {
       LOGDBG << "Start server shutdown procedure";
       m_shutdownRequested = true;
+      network::FederationManager::GetInstance().Shutdown();
+      // event loop is over, so kept data is written now and the drain writes at once
+      OutboundCoalescer::GetInstance().Shutdown();
       m_networkManager->Shutdown();
+      PresenceAggregator::GetInstance().Shutdown();
       m_signalManager->Shutdown();
+      if (tracer::Tracer::GetInstance().IsEnabled())
+         DumpTrace();
+      capture::TrafficRecorder::GetInstance().Stop();
       m_engineStarted = false;
    }
 }
@@ -97,7 +171,7 @@ void ServerEngine::OnSystemSignal(signal::SignalId id)
       case SIGTERM:
       case SIGINT:
       case SIGKILL:
-         Shutdown();
+         m_networkManager->Stop();
          break;
       case SIGHUP:
       {
@@ -107,6 +181,12 @@ void ServerEngine::OnSystemSignal(signal::SignalId id)
          ApplyConfigSettigns();
          break;
       }
+      case SIGUSR1:
+         DumpTrace();
+         break;
+      case SIGUSR2:
+         DumpStatistics();
+         break;
       default:
          break;
    }
@@ -130,9 +210,94 @@ result_t ServerEngine::ApplyConfigSettigns()
       return error;
    SET_LOG_LEVEL(tempValue);
 
+   // presence window, optional setting - older configuration files don't have it
+   error = configManager.GetOptionalSetting(config::PresenceWindow, tempValue, 0);
+   if (error != result_code::sOk)
+      return error;
+   PresenceAggregator::GetInstance().SetWindowSize(tempValue);
+
+   // message tracing, optional settings - older configuration files don't have them
+   int traceBufferSize = 0;
+   error = configManager.GetOptionalSetting(config::TraceBufferSize, traceBufferSize, 65536);
+   if (error != result_code::sOk)
+      return error;
+   error = configManager.GetOptionalSetting(config::TraceSampleRate, tempValue, 0);
+   if (error != result_code::sOk)
+      return error;
+   tracer::Tracer::GetInstance().Configure(tempValue, traceBufferSize);
+
+   // admission control, optional settings - older configuration files don't have them
+   int queueSizeLimit = 0;
+   error = configManager.GetOptionalSetting(config::OverloadQueueSize, queueSizeLimit, 10000);
+   if (error != result_code::sOk)
+      return error;
+   error = configManager.GetOptionalSetting(config::OverloadQueueWait, tempValue, 500);
+   if (error != result_code::sOk)
+      return error;
+   network::ConnectionManager::GetInstance().SetAdmissionLimits(queueSizeLimit, tempValue);
+
+   // busy poll mode, optional settings - older configuration files don't have them
+   int busyPollWorkers = 0;
+   error = configManager.GetOptionalSetting(config::BusyPoll, busyPollWorkers, 0);
+   if (error != result_code::sOk)
+      return error;
+   error = configManager.GetOptionalSetting(config::BusyPollSocket, tempValue, 0);
+   if (error != result_code::sOk)
+      return error;
+   std::string cpuList;
+   error = configManager.GetOptionalSetting(config::BusyPollCpus, cpuList, "");
+   if (error != result_code::sOk)
+      return error;
+   std::vector<int> cpus;
+   error = ParseCpuList(cpuList, cpus);
+   if (error != result_code::sOk)
+      return error;
+   network::ConnectionManager::GetInstance().SetBusyPoll(busyPollWorkers, tempValue, cpus);
+
+   // outbound coalescing, optional settings - older configuration files don't have them
+   int coalescingWindow = 0;
+   error = configManager.GetOptionalSetting(config::CoalescingWindow, coalescingWindow, 0);
+   if (error != result_code::sOk)
+      return error;
+   error = configManager.GetOptionalSetting(config::CoalescingBytes, tempValue, 16384);
+   if (error != result_code::sOk)
+      return error;
+   OutboundCoalescer::GetInstance().SetWindow(coalescingWindow, tempValue);
+
+   // traffic capture, optional setting - older configuration files don't have it
+   std::string captureFile;
+   error = configManager.GetOptionalSetting(config::CaptureFile, captureFile, "");
+   if (error != result_code::sOk)
+      return error;
+   error = capture::TrafficRecorder::GetInstance().Start(captureFile);
+   if (error != result_code::sOk)
+      return error;
+
    return result_code::sOk;
 }
 
+void ServerEngine::DumpTrace()
+{
+   std::string traceFile;
+   config::ConfigurationManager::GetInstance().GetOptionalSetting(config::TraceFile, traceFile, "chat_server_trace.json");
+   if (tracer::Tracer::GetInstance().Dump(traceFile) != result_code::sOk)
+   {
+      LOGERR << "Unable to write trace to the file: " << traceFile;
+      return;
+   }
+   LOGDBG << "Trace is written to the file: " << traceFile;
+}
+
+void ServerEngine::DumpStatistics()
+{
+   network::ConnectionMemoryStatistics statistics;
+   network::ConnectionManager::GetInstance().GetMemoryStatistics(statistics);
+   const size_t perConnection = statistics.connectionCount != 0 ?
+      statistics.totalBytes / statistics.connectionCount : 0;
+   LOGEMPTY << "Client connections: " << statistics.connectionCount << ", memory: "
+      << statistics.totalBytes << " bytes, " << perConnection << " bytes per connection";
+}
+
 
 } // namespace engine
 } // namespace cs
@@ -63,6 +63,10 @@ private:
    void OnSystemSignal(signal::SignalId id);
    /// Apply system-wide configuration settings
    result_t ApplyConfigSettigns();
+   /// Write collected trace spans to the configured trace file
+   void DumpTrace();
+   /// Write memory statistics of the connections to the log
+   void DumpStatistics();
 
    /// network manager holder
    boost::scoped_ptr<cs::network::NetworkManager>  m_networkManager;
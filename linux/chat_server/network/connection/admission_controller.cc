@@ -0,0 +1,81 @@
+/**
+ *  \file
+ *  \brief     AdmissionController class implementation
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#include "admission_controller.h"
+
+namespace
+{
+
+/**
+ * Helper function to compare measured value with the limit
+ * @param value - measured value
+ * @param limit - limit of the value, 0 means no limit
+ * @param factor - multiplier of the limit, in percents
+ * @returns - true if limit is set and value exceeds the given share of it, false otherwise
+ */
+template <typename T>
+bool IsExceeded(const T value, const T limit, const int factor)
+{
+   return limit != 0 && value * 100 > limit * factor;
+}
+
+} // unnamed namespace
+
+
+namespace cs
+{
+namespace network
+{
+
+AdmissionController::AdmissionController()
+   : m_queueSizeLimit(0)
+   , m_queueWaitLimit(0)
+   , m_loadLevel(NormalLoad)
+{}
+
+void AdmissionController::SetLimits(const size_t queueSizeLimit, const int queueWaitLimit)
+{
+   m_queueSizeLimit = queueSizeLimit;
+   m_queueWaitLimit = queueWaitLimit;
+   if (!IsEnabled())
+      m_loadLevel.store(NormalLoad, boost::memory_order_relaxed);
+}
+
+bool AdmissionController::IsEnabled() const
+{
+   return m_queueSizeLimit != 0 || m_queueWaitLimit != 0;
+}
+
+LoadLevel AdmissionController::Evaluate(const size_t queueSize, const int queueWait)
+{
+   if (IsExceeded(queueSize, m_queueSizeLimit, 200) || IsExceeded(queueWait, m_queueWaitLimit, 200))
+   {
+      m_loadLevel.store(CriticalLoad, boost::memory_order_relaxed);
+   }
+   else if (IsExceeded(queueSize, m_queueSizeLimit, 100) || IsExceeded(queueWait, m_queueWaitLimit, 100))
+   {
+      m_loadLevel.store(HighLoad, boost::memory_order_relaxed);
+   }
+   else if (!IsExceeded(queueSize, m_queueSizeLimit, 50) && !IsExceeded(queueWait, m_queueWaitLimit, 50))
+   {
+      m_loadLevel.store(NormalLoad, boost::memory_order_relaxed);
+   }
+   else if (m_loadLevel.load(boost::memory_order_relaxed) == CriticalLoad)
+   {
+      // still above the half of the limits: keep deferring, but stop rejecting
+      m_loadLevel.store(HighLoad, boost::memory_order_relaxed);
+   }
+   return m_loadLevel.load(boost::memory_order_relaxed);
+}
+
+LoadLevel AdmissionController::GetLoadLevel() const
+{
+   return m_loadLevel.load(boost::memory_order_relaxed);
+}
+
+} // namespace network
+} // namespace cs
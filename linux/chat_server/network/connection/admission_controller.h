@@ -0,0 +1,89 @@
+/**
+ *  \file
+ *  \brief     AdmissionController class declaration
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#ifndef CS_NETWORK_ADMISSION_CONTROLLER_H
+#define CS_NETWORK_ADMISSION_CONTROLLER_H
+
+// third-party
+#include <boost/noncopyable.hpp>
+#include <boost/atomic.hpp>
+#include <cstddef>
+
+namespace cs
+{
+namespace network
+{
+
+/// server load as seen by the admission control
+enum LoadLevel
+{
+   /// all the work is accepted
+   NormalLoad,
+   /// reads from the noisiest connections are paused and new connections wait in the backlog
+   HighLoad,
+   /// in addition to HighLoad measures new connections are rejected with a server message
+   CriticalLoad
+};
+
+/**
+ *  \class     cs::network::AdmissionController
+ *  \brief     Decides how much new work server is able to accept
+ *  \details   Load is estimated by the size of thread pool queues and by the time the oldest
+ *             queued task has been waiting. Load is high once any of the configured limits is
+ *             exceeded and critical once it is exceeded twice. Load returns to normal only when
+ *             both values fall below the half of the limits, so that server doesn't flap between
+ *             the levels. Class only keeps the policy, measures are applied by ConnectionManager.
+ */
+class AdmissionController : public boost::noncopyable
+{
+public:
+   /**
+    * Constructor, admission control is disabled by default
+    */
+   AdmissionController();
+
+   /**
+    * Set limits of the load
+    * @param queueSizeLimit - maximum number of tasks in a pool queue, 0 disables the limit
+    * @param queueWaitLimit - maximum time in milliseconds a task waits in a pool queue,
+    *                         0 disables the limit
+    */
+   void SetLimits(const size_t queueSizeLimit, const int queueWaitLimit);
+
+   /**
+    * Helper function to see if any of the limits is set
+    * @returns - true if load has to be evaluated, false otherwise
+    */
+   bool IsEnabled() const;
+
+   /**
+    * Estimate load using the latest measurements
+    * @param queueSize - size of the longest pool queue
+    * @param queueWait - waiting time in milliseconds of the oldest queued task among the pools
+    * @returns - new level of the load
+    */
+   LoadLevel Evaluate(const size_t queueSize, const int queueWait);
+
+   /**
+    * Get the level estimated by the latest Evaluate call
+    * @returns - current level of the load
+    */
+   LoadLevel GetLoadLevel() const;
+
+private:
+   /// maximum number of tasks in a pool queue, 0 if the limit is disabled
+   size_t               m_queueSizeLimit;
+   /// maximum waiting time in milliseconds, 0 if the limit is disabled
+   int                  m_queueWaitLimit;
+   /// current level of the load. Written by the event loop, read by any thread
+   boost::atomic<LoadLevel> m_loadLevel;
+};
+
+} // namespace network
+} // namespace cs
+
+#endif // CS_NETWORK_ADMISSION_CONTROLLER_H
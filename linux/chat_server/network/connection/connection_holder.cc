@@ -8,7 +8,50 @@
 #include "connection_holder.h"
 #include <common/exception_dispatcher.h>
 #include <network/connection/connection_manager.h>
-#include <core/data_processing/process_message_task.h>
+#include <core/data_processing/message_description.h>
+#include <core/data_processing/presence_aggregator.h>
+#include <network/federation/federation_manager.h>
+#include <capture/traffic_capture.h>
+// third-party
+#include <stdio.h>
+#include <errno.h>
+#include <boost/detail/atomic_count.hpp>
+
+namespace
+{
+
+/**
+ * Helper function to get heap memory held by the string. Short strings are stored
+ * inside the object by the standard library and hold no heap memory
+ * @param data - string to be checked
+ * @returns - number of bytes allocated by the string
+ */
+size_t GetHeapUsage(const std::string& data)
+{
+   const char* objectStart = reinterpret_cast<const char*>(&data);
+   if (data.data() >= objectStart && data.data() < objectStart + sizeof(data))
+      return 0;
+   return data.capacity() + 1;
+}
+
+/**
+ * Helper function to get number of bytes that don't have to be written again
+ * @param writeResult - value returned by the socket write
+ * @param length - length of the data passed to the write
+ * @returns - number of bytes written, whole length if the connection is broken and
+ *            the data can't be delivered anyway
+ */
+size_t GetCompletedBytes(const ssize_t writeResult, const size_t length)
+{
+   if (writeResult >= 0)
+      return writeResult;
+   if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return 0;
+   return length;
+}
+
+} // unnamed namespace
+
 
 namespace cs
 {
@@ -17,24 +60,33 @@ namespace network
 
 static const size_t MaxDataBufferSize = 1024;
 static const size_t MaximumMessageLength = 8192;
+/// source of connection identifiers, incremented by the event loop and the federation threads
+static boost::detail::atomic_count LastConnectionId(0);
+/// estimated size of the reference counter allocated together with the object by make_shared
+static const size_t SharedCounterSize = 2 * sizeof(void*) + 2 * sizeof(long);
+/// beginning of the default username
+static const std::string DefaultUsernamePrefix = "user_";
+/// delay before data that didn't fit into the socket buffer is written again, nanoseconds
+static const boost::uint64_t OutboundRetryDelay = 1000000;
+/// amount of kept data beyond which the client is considered not reading and is disconnected
+static const size_t MaxOutboundDataSize = 1024 * 1024;
 
-ConnectionHolder::ConnectionHolder(const SocketWrapperPtr socket, const bool isListeningSocket)
-   : m_isListeningSocket(isListeningSocket)
+ConnectionHolder::ConnectionHolder(const SocketDescriptor socket, const bool isListeningSocket)
+   : m_socketWrapper(socket)
+   , m_lastWriteTime(0)
+   , m_connectionId(++LastConnectionId)
+   , m_connectionTime(::time(0))
+   , m_readEventPeriod(0)
+   , m_readEventCount(0)
+   , m_isListeningSocket(isListeningSocket)
    , m_isConnectionClosed(false)
-{
-   CHECK_ARGUMENT(socket.get(), "Empty socket!");
-   CHECK_ARGUMENT(socket->IsValid(), "Inavlid socket!");
-   m_socketWrapper = socket;
-}
+   , m_isFlushScheduled(false)
+{}
 
 ConnectionHolder::~ConnectionHolder()
 {
-   engine::MessageDescription message;
-   message.senderName = engine::ServerSenderName;
-   message.senderSocket = m_socketWrapper->GetDescriptor();
-   message.data = std::string("User '") + GetUsername() + "' has left the chat " + engine::ChatTerminationSymbol;
-   engine::TaskPtr newTask( new engine::ProcessMessageTask(message) );
-   ConnectionManager::GetInstance().PostSlowTask(newTask);
+   engine::PresenceAggregator::GetInstance().OnUserLeft(GetUsername());
+   FederationManager::GetInstance().OnLocalUserLeft(GetUsername());
 }
 
 bool ConnectionHolder::IsListeningSocket() const
@@ -51,31 +103,38 @@ result_t ConnectionHolder::ReadAndAppendSocketData()
 {
    try
    {
-      char dataBuffer[MaxDataBufferSize] = {0};
-      ssize_t readResult = 0;
+      char dataBuffer[MaxDataBufferSize];
+      size_t bytesRead = 0;
       std::string tempData;
 
       LOCK lock(m_socketDataAccessGuard);
-      do
-      {
-         readResult = m_socketWrapper->Read(dataBuffer, MaxDataBufferSize);
-         tempData.append(dataBuffer);
-         ::memset(&dataBuffer, 0, MaxDataBufferSize);
-      }
-      while (readResult > 0);
+      // reserve one byte for the zero symbol added by SocketWrapper
+      result_t error = result_code::sOk;
+      while ((error = m_socketWrapper.Read(dataBuffer, MaxDataBufferSize - 1, bytesRead)) == result_code::sOk)
+         tempData.append(dataBuffer, bytesRead);
 
       size_t sumLength = tempData.length() + m_socketData.length();
       if (sumLength >= MaximumMessageLength)
       {
-         LOGERR << "Message length is exceeded on socket: " << m_socketWrapper->GetDescriptor();
+         LOGERR << "Message length is exceeded on socket: " << m_socketWrapper.GetDescriptor();
          return result_code::eBufferOverflow;
       }
-      m_socketData.append(tempData);
 
-      if (readResult == 0)
-         return result_code::eConnectionClosed;
+      if (!tempData.empty() && capture::TrafficRecorder::GetInstance().IsEnabled())
+      {
+         capture::TrafficRecorder::GetInstance().Record(static_cast<boost::uint32_t>(m_connectionId), tempData);
+      }
+
+      // usually buffer is empty, so data is taken over without copying
+      if (m_socketData.empty())
+         m_socketData.swap(tempData);
       else
+         m_socketData.append(tempData);
+
+      // all available data is read
+      if (error == result_code::eNotReady)
          return result_code::sOk;
+      return error;
    }
    catch(const std::exception&)
    {
@@ -94,7 +153,15 @@ result_t ConnectionHolder::GetNextSocketData(std::string& tempString)
 
       ++terminationPosition; // increment by one to capture '\n' symbol as well
 
-      tempString.assign(m_socketData.substr(0, terminationPosition));
+      if (terminationPosition == m_socketData.length())
+      {
+         // all data is taken, connection doesn't hold the buffer until the next read
+         tempString.clear();
+         tempString.swap(m_socketData);
+         return result_code::sOk;
+      }
+
+      tempString.assign(m_socketData, 0, terminationPosition);
       m_socketData.erase(0, terminationPosition);
       return result_code::sOk;
    }
@@ -106,31 +173,36 @@ result_t ConnectionHolder::GetNextSocketData(std::string& tempString)
 
 void ConnectionHolder::SetUsername(const std::string& newUsername)
 {
-   if (!newUsername.empty())
-   {
-      m_username = newUsername;
-      return;
-   }
-
-   //  if newUsername is empty - simply assign a random one
-   static long userId = 0;
-   time_t rawTime;
-   ::time(&rawTime);
-   std::ostringstream out;
-   out << "user_" << rawTime << "_" << ++userId;
-   m_username = out.str();
+   m_username = newUsername;
 }
 
 std::string ConnectionHolder::GetUsername() const
 {
-   return m_username;
+   if (!m_username.empty())
+      return m_username;
+
+   // default username is not stored, anonymous connections don't spend memory on it
+   char defaultUsername[64];
+   ::snprintf(defaultUsername, sizeof(defaultUsername), "%s%ld_%ld",
+      DefaultUsernamePrefix.c_str(), static_cast<long>(m_connectionTime), m_connectionId);
+   return defaultUsername;
+}
+
+bool ConnectionHolder::HasUsername(const std::string& username) const
+{
+   if (!m_username.empty())
+      return m_username == username;
+
+   // don't generate default username unless the given one looks like it
+   return username.compare(0, DefaultUsernamePrefix.length(), DefaultUsernamePrefix) == 0 &&
+      GetUsername() == username;
 }
 
 void ConnectionHolder::Close()
 {
    m_isConnectionClosed = true;
-   ConnectionManager::GetInstance().RemoveConnection(m_socketWrapper->GetDescriptor());
-   m_socketWrapper->Close();
+   ConnectionManager::GetInstance().RemoveConnection(m_socketWrapper.GetDescriptor());
+   m_socketWrapper.Close();
 }
 
 void ConnectionHolder::SetConnectionCarrier(ConnectionCarrierPtr carrier)
@@ -144,26 +216,156 @@ void ConnectionHolder::SetConnectionCarrier(ConnectionCarrierPtr carrier)
    m_carrier = carrier;
 }
 
+ConnectionCarrier* ConnectionHolder::GetConnectionCarrier() const
+{
+   return m_carrier.get();
+}
+
+void ConnectionHolder::CountReadEvent(const unsigned int period)
+{
+   if (m_readEventPeriod != period)
+   {
+      m_readEventPeriod = period;
+      m_readEventCount = 0;
+   }
+   ++m_readEventCount;
+}
+
+int ConnectionHolder::GetReadEventCount(const unsigned int period) const
+{
+   return m_readEventPeriod == period ? m_readEventCount : 0;
+}
+
+long ConnectionHolder::GetConnectionId() const
+{
+   return m_connectionId;
+}
+
+size_t ConnectionHolder::GetMemoryUsage()
+{
+   size_t usage = sizeof(ConnectionHolder) + sizeof(ConnectionCarrier) + 2 * SharedCounterSize;
+   usage += GetHeapUsage(m_username);
+   {
+      LOCK lock(m_outboundDataAccessGuard);
+      usage += GetHeapUsage(m_outboundData);
+   }
+   LOCK lock(m_socketDataAccessGuard);
+   return usage + GetHeapUsage(m_socketData);
+}
+
 bool ConnectionHolder::IsSocketValid() const
 {
-   return m_socketWrapper->IsValid();
+   return m_socketWrapper.IsValid();
 }
 
 SocketDescriptor ConnectionHolder::GetSocketDescriptor() const
 {
-   return m_socketWrapper->GetDescriptor();
+   return m_socketWrapper.GetDescriptor();
 }
 
 SocketDescriptor ConnectionHolder::AcceptNewConnection(SocketAddressHolder& socketAddress)
 {
-   return m_socketWrapper->Accept(socketAddress);
+   return m_socketWrapper.Accept(socketAddress);
 }
 
 ssize_t ConnectionHolder::WriteDataToSocket(const std::string& dataBuffer)
 {
-   return m_socketWrapper->Write(dataBuffer);
+   return m_socketWrapper.Write(dataBuffer);
+}
+
+CoalescingResult ConnectionHolder::CoalesceDataToSocket(const std::string& dataBuffer, const boost::uint64_t now,
+   const boost::uint64_t window, const size_t maxBytes, boost::uint64_t& flushTime)
+{
+   LOCK lock(m_outboundDataAccessGuard);
+   if (!m_isFlushScheduled && (window == 0 || now >= m_lastWriteTime + window))
+   {
+      // nothing was written during the window, there is no traffic to merge the data with
+      m_lastWriteTime = now;
+      const size_t written = GetCompletedBytes(m_socketWrapper.Write(dataBuffer), dataBuffer.length());
+      if (written == dataBuffer.length())
+         return DataWritten;
+
+      // socket buffer is full, the rest is written by the flush
+      if (!KeepOutboundData(dataBuffer, written))
+         return DataWritten;
+      return RequestFlush(now + OutboundRetryDelay, flushTime);
+   }
+
+   if (!KeepOutboundData(dataBuffer, 0))
+      return DataWritten;
+   if (m_outboundData.length() >= maxBytes)
+   {
+      // scheduled flush, if any, finds nothing to write
+      m_lastWriteTime = now;
+      if (WriteOutboundData())
+         return DataWritten;
+      return RequestFlush(now + OutboundRetryDelay, flushTime);
+   }
+
+   return RequestFlush(m_lastWriteTime + window, flushTime);
 }
 
+CoalescingResult ConnectionHolder::FlushCoalescedData(const boost::uint64_t now, boost::uint64_t& flushTime)
+{
+   LOCK lock(m_outboundDataAccessGuard);
+   m_isFlushScheduled = false;
+   if (m_outboundData.empty())
+      return DataWritten;
+
+   m_lastWriteTime = now;
+   if (WriteOutboundData())
+      return DataWritten;
+   return RequestFlush(now + OutboundRetryDelay, flushTime);
+}
+
+void ConnectionHolder::DiscardCoalescedData()
+{
+   LOCK lock(m_outboundDataAccessGuard);
+   if (!m_outboundData.empty())
+   {
+      LOGWRN << "Unable to write " << m_outboundData.length() << " bytes to the connection " << m_connectionId;
+   }
+   std::string().swap(m_outboundData);
+   m_isFlushScheduled = false;
+}
+
+bool ConnectionHolder::KeepOutboundData(const std::string& dataBuffer, const size_t offset)
+{
+   if (m_outboundData.length() + dataBuffer.length() - offset <= MaxOutboundDataSize)
+   {
+      m_outboundData.append(dataBuffer, offset, std::string::npos);
+      return true;
+   }
+
+   // following writes fail at once and the event loop closes the connection as usual
+   LOGWRN << "Pending output limit is reached, shut down connection " << m_connectionId << " on socket "
+          << m_socketWrapper.GetDescriptor();
+   std::string().swap(m_outboundData);
+   ::shutdown(m_socketWrapper.GetDescriptor(), SHUT_RDWR);
+   return false;
+}
+
+bool ConnectionHolder::WriteOutboundData()
+{
+   const size_t written = GetCompletedBytes(m_socketWrapper.Write(m_outboundData), m_outboundData.length());
+   if (written == m_outboundData.length())
+   {
+      std::string().swap(m_outboundData);
+      return true;
+   }
+
+   m_outboundData.erase(0, written);
+   return false;
+}
+
+CoalescingResult ConnectionHolder::RequestFlush(const boost::uint64_t flushTime, boost::uint64_t& requestedTime)
+{
+   if (m_isFlushScheduled)
+      return DataKept;
+   m_isFlushScheduled = true;
+   requestedTime = flushTime;
+   return FlushRequired;
+}
 
 } // namespace network
 } // namespace cs
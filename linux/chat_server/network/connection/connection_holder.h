@@ -15,7 +15,11 @@
 #include <logger/logger.h>
 // third-party
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include <boost/weak_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/cstdint.hpp>
+#include <time.h>
 
 namespace cs
 {
@@ -27,17 +31,40 @@ struct ConnectionCarrier;
 typedef boost::shared_ptr<ConnectionHolder> ConnectionHolderPtr;
 typedef boost::weak_ptr<ConnectionHolder> ConnectionWeakPtr;
 typedef boost::shared_ptr<ConnectionCarrier> ConnectionCarrierPtr;
+/// type of the functor invoked when service descriptor is signalled, accepts epoll events
+typedef boost::function<void(const uint32_t events)> EventHandler;
+
+/// outcome of the coalesced write to the connection
+enum CoalescingResult
+{
+   /// data is written to the socket
+   DataWritten,
+   /// data is kept, flush of the connection is scheduled already
+   DataKept,
+   /// data is kept, caller has to schedule flush of the connection
+   FlushRequired
+};
 
 /**
  *  \struct    cs::network::ConnectionCarrier
  *  \brief     Helper structure to hold weak reference to the connection
  *  \details   Helper structure to be used with epoll object. It holds weak reference
  *             to connection object and therefore can be passed to epoll object and retrieved
- *             back from it.
+ *             back from it. Carriers of service descriptors (signals, timers, wake-up events)
+ *             hold event handler instead of the connection.
  */
 struct ConnectionCarrier
 {
+   ConnectionCarrier()
+      : isEventSource(false)
+   {}
+
+   /// connection the carrier belongs to
    ConnectionWeakPtr holder;
+   /// flag that the carrier belongs to service descriptor
+   bool              isEventSource;
+   /// handler of the service descriptor, empty once descriptor is removed
+   EventHandler      handler;
 };
 
 
@@ -49,17 +76,19 @@ struct ConnectionCarrier
  *              - username associated with this connection/socket
  *              - buffer with raw data received from the network
  *              - several helper flags and methods to simplify work with the object
+ *             Most of the connections are idle most of the time, so the object is kept compact:
+ *             socket is stored inline, default username is generated on request and the
+ *             buffer is released as soon as all received data is taken from it.
  */
 class ConnectionHolder : public boost::noncopyable
 {
 public:
    /**
-    * Constructor
-    * @param socket - smart object with the SocketWrapper to be associated with this
-    *                 connection
+    * Constructor, takes ownership of the socket
+    * @param socket - descriptor of the socket to be associated with this connection
     * @param isListeningSocket - flag if this should be a listening socket
     */
-   ConnectionHolder(SocketWrapperPtr socket, const bool isListeningSocket = false);
+   ConnectionHolder(const SocketDescriptor socket, const bool isListeningSocket = false);
 
    /**
     * Destructor that posts a farewell message to all chat participants about client
@@ -87,13 +116,57 @@ public:
     *             - eBufferOverflow if new data being appended to existing buffer will
     *               exceed allowed message size
     *             - eConnectionClosed if socket was closed during the read procedure
+    *             - eFail if read procedure failed due to some system error
     */
    result_t ReadAndAppendSocketData();
    result_t GetNextSocketData(std::string& data);
+
+   /**
+    * Associate username with the connection
+    * @param newUsername - username to be set, empty value restores the default username
+    *                      generated from the connection identifier
+    */
    void SetUsername(const std::string& newUsername = "");
    std::string GetUsername() const;
+
+   /**
+    * Check username of the connection. Cheaper than GetUsername for the connections with
+    * the default username, so it is better be used to search connections
+    * @param username - username to be compared with
+    * @returns - true if connection has the given username, false otherwise
+    */
+   bool HasUsername(const std::string& username) const;
    void Close();
    void SetConnectionCarrier(ConnectionCarrierPtr carrier);
+   ConnectionCarrier* GetConnectionCarrier() const;
+
+   /**
+    * Register read event of the connection. Must be called by the event loop thread only
+    * @param period - number of the current admission control period
+    */
+   void CountReadEvent(const unsigned int period);
+
+   /**
+    * Get number of read events registered during the given period. Must be called by the
+    * event loop thread only
+    * @param period - number of the admission control period
+    * @returns - number of read events, 0 if connection had no events during the period
+    */
+   int GetReadEventCount(const unsigned int period) const;
+
+   /**
+    * Get identifier of the connection, unique within the process lifetime. Unlike socket
+    * descriptor it is never reused, so it identifies the client in the traffic capture
+    * @returns - identifier of the connection
+    */
+   long GetConnectionId() const;
+
+   /**
+    * Estimate memory consumed by the connection in the process: the object itself, its
+    * carrier, their reference counters and heap buffers. Kernel socket buffers are not included
+    * @returns - number of bytes
+    */
+   size_t GetMemoryUsage();
 
    /// Functions to work with Socket Wrapper
 
@@ -124,24 +197,84 @@ public:
     */
    ssize_t WriteDataToSocket(const std::string& dataBuffer);
 
+   /**
+    * Write data to the wrapped socket or keep it to be merged with the following data into one
+    * write. Data is written at once if nothing was written to the connection during the window,
+    * so a quiet connection gets data immediately and a busy one gets a single write per window.
+    * Kept data is written once its amount reaches the limit or by FlushCoalescedData. Data that
+    * doesn't fit into the socket buffer is kept as well and written by the flush. Once kept data
+    * exceeds 1 MB the client is considered not reading: data is dropped and connection is shut down
+    * @param dataBuffer - reference to the string with data available for writing
+    * @param now - current time of the monotonic clock, nanoseconds
+    * @param window - coalescing window in nanoseconds, 0 writes data at once unless there is
+    *                 data kept from the time coalescing was enabled
+    * @param maxBytes - amount of kept data that is written without waiting for the flush
+    * @param flushTime - output time of the monotonic clock the flush has to be executed at,
+    *                    set only if FlushRequired is returned
+    * @returns - outcome of the write, see CoalescingResult
+    */
+   CoalescingResult CoalesceDataToSocket(const std::string& dataBuffer, const boost::uint64_t now,
+      const boost::uint64_t window, const size_t maxBytes, boost::uint64_t& flushTime);
+
+   /**
+    * Write all kept data to the wrapped socket, see CoalesceDataToSocket
+    * @param now - current time of the monotonic clock, nanoseconds
+    * @param flushTime - output time of the monotonic clock the next flush has to be executed at,
+    *                    set only if FlushRequired is returned
+    * @returns - DataWritten if all kept data is written, FlushRequired if the part that didn't
+    *            fit into the socket buffer is kept
+    */
+   CoalescingResult FlushCoalescedData(const boost::uint64_t now, boost::uint64_t& flushTime);
+
+   /**
+    * Drop kept data when no flush can be executed anymore
+    */
+   void DiscardCoalescedData();
+
 private:
    typedef boost::lock_guard<boost::mutex> LOCK;
 
+   /// Keep data starting from the offset to be written later, the connection is shut down instead if
+   /// the limit of kept data is exceeded. Must be called under m_outboundDataAccessGuard
+   /// @returns - false if data is dropped
+   bool KeepOutboundData(const std::string& dataBuffer, const size_t offset);
+   /// Write kept data, the part that is written is removed. Must be called under m_outboundDataAccessGuard
+   /// @returns - true if no data is kept anymore
+   bool WriteOutboundData();
+   /// Mark flush of the kept data as scheduled. Must be called under m_outboundDataAccessGuard
+   CoalescingResult RequestFlush(const boost::uint64_t flushTime, boost::uint64_t& requestedTime);
+
    /// smart object with strong reference to the carreir. Each connection
    /// controls timespan of the carrier that holds this connection
    ConnectionCarrierPtr    m_carrier;
    /// socket wrapper that this connection is associated with
-   SocketWrapperPtr        m_socketWrapper;
+   SocketWrapper           m_socketWrapper;
    /// sync object to guard access to the socket data
    boost::mutex            m_socketDataAccessGuard;
+   /// string that holds raw data received from socket, has no capacity while it is empty
+   std::string             m_socketData;
+   /// string that holds username set by the user, empty for the default username
+   std::string             m_username;
+   /// sync object to guard writes to the socket and the data kept for coalesced write
+   boost::mutex            m_outboundDataAccessGuard;
+   /// data kept for coalesced write, has no capacity while it is empty
+   std::string             m_outboundData;
+   /// time of the last write to the socket, nanoseconds of the monotonic clock
+   boost::uint64_t         m_lastWriteTime;
+   /// identifier of the connection, unique within the process lifetime
+   const long              m_connectionId;
+   /// time the connection was created at, part of the default username
+   const time_t            m_connectionTime;
+   /// admission control period the read events are counted for
+   unsigned int            m_readEventPeriod;
+   /// number of read events during m_readEventPeriod
+   int                     m_readEventCount;
    /// flag that indicates if current connection is holding a listening socket
    bool                    m_isListeningSocket;
    /// flag that indicates if connection is closed
    bool                    m_isConnectionClosed;
-   /// string that holds raw data received from socket
-   std::string             m_socketData;
-   /// string that holds username associated with this connection/socket
-   std::string             m_username;
+   /// flag that flush of the kept data is scheduled
+   bool                    m_isFlushScheduled;
 };
 
 } // namespace network
@@ -10,6 +10,90 @@
 #include <config/configuration_manager.h>
 #include <core/data_processing/receive_data_task.h>
 #include <core/data_processing/process_message_task.h>
+#include <core/data_processing/presence_aggregator.h>
+#include <network/federation/federation_manager.h>
+// third-party
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+/**
+ * Helper function to be bound as a handler of the timer descriptor. Resets the timer and
+ * invokes the user handler
+ * @param timer - descriptor of the timer
+ * @param handler - user handler of the timer
+ * @param events - triggered epoll events
+ */
+void OnTimerExpired(const int timer, cs::network::EventHandler handler, const uint32_t events)
+{
+   uint64_t expirations = 0;
+   if (::read(timer, &expirations, sizeof(expirations)) == sizeof(expirations))
+      handler(events);
+}
+
+/**
+ * Helper function to start, restart or stop the periodic timer
+ * @param timer - descriptor of the timer
+ * @param interval - timer period in milliseconds, 0 stops the timer
+ * @returns - true if the timer is set, false in case of system error
+ */
+bool SetTimerInterval(const int timer, const int interval)
+{
+   itimerspec period;
+   period.it_interval.tv_sec = interval / 1000;
+   period.it_interval.tv_nsec = (interval % 1000) * 1000000;
+   period.it_value = period.it_interval;
+   return ::timerfd_settime(timer, 0, &period, 0) == 0;
+}
+
+/**
+ * Helper function to let the client receive all the data written to the socket before it is closed.
+ * Sends FIN after the outbound data and discards unread inbound data, because closing a socket
+ * with unread data resets the connection and drops everything that is not sent yet.
+ * @param socket - socket of the client connection
+ */
+void FlushClientSocket(const cs::network::SocketDescriptor socket)
+{
+   ::shutdown(socket, SHUT_WR);
+
+   char buffer[4096];
+   while (::recv(socket, buffer, sizeof(buffer), MSG_DONTWAIT) > 0)
+      ;
+}
+
+/// time given to the thread pools to stop during shutdown, seconds
+const int PoolShutdownTimeout = 5;
+
+/// period of the load evaluation, milliseconds
+const int AdmissionCheckInterval = 100;
+
+/// minimum number of read events per period that makes connection a candidate for pausing
+const int MinNoisyReadEvents = 3;
+
+/// share of the candidates paused per period while server is overloaded, percents
+const size_t NoisyConnectionsShare = 10;
+
+/**
+ * Helper function to order connections by number of read events, the noisiest go first
+ * @param left - pair of read events count and connection
+ * @param right - pair of read events count and connection
+ * @returns - true if left connection is noisier
+ */
+bool IsNoisier(const std::pair<int, cs::network::ConnectionHolderPtr>& left,
+   const std::pair<int, cs::network::ConnectionHolderPtr>& right)
+{
+   return left.first > right.first;
+}
+
+} // unnamed namespace
+
 
 namespace cs
 {
@@ -24,7 +108,15 @@ ConnectionManager& ConnectionManager::GetInstance()
 }
 
 ConnectionManager::ConnectionManager()
-   : m_epollDescriptor(INVALID_DESCRIPTOR)
+   : m_admissionTimer(INVALID_DESCRIPTOR)
+   , m_isAdmissionTimerArmed(false)
+   , m_admissionPeriod(0)
+   , m_acceptsDeferred(false)
+   , m_busyPollWorkerCount(0)
+   , m_socketBusyPoll(0)
+   , m_eventLoopCpu(-1)
+   , m_epollDescriptor(INVALID_DESCRIPTOR)
+   , m_wakeupDescriptor(INVALID_DESCRIPTOR)
    , m_shutdownRequested(false)
    , m_managerIsInitialized(false)
 {
@@ -47,6 +139,9 @@ ConnectionManager::ConnectionManager()
 
 ConnectionManager::~ConnectionManager()
 {
+   if (m_wakeupDescriptor != INVALID_DESCRIPTOR)
+      ::close(m_wakeupDescriptor);
+
    if (m_epollDescriptor == INVALID_DESCRIPTOR)
    {
       LOGERR << "Close attempt on invalid epoll descriptor";
@@ -75,6 +170,60 @@ void ConnectionManager::Initialize(const unsigned int backlogSize)
       THROW_NETWORK_EXCEPTION(errno) << "Unable to create epoll object";
 
    m_epollDescriptor = descriptor;
+
+   m_wakeupDescriptor = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if (m_wakeupDescriptor == INVALID_DESCRIPTOR)
+      THROW_NETWORK_EXCEPTION(errno) << "Unable to create wake-up event";
+   AddEventSource(m_wakeupDescriptor, EPOLLIN, boost::bind(&ConnectionManager::OnWakeup, this));
+
+   UpdateAdmissionTimer();
+}
+
+bool ConnectionManager::Drain(const int timeout)
+{
+   if (m_shutdownRequested || !m_managerIsInitialized)
+      return true;
+
+   LOGDBG << "Drain ConnectionManager, timeout: " << timeout << " ms";
+   const boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeout);
+
+   // stop accepting: listening sockets are closed, so new clients are refused by the system
+   // instead of waiting in the backlog of the server which is about to exit
+   ConnectionHolderList listeningConnections;
+   {
+      LOCK lock(m_activeConnectionAccessGuard);
+      ConnectionStorage::iterator it = m_activeConnections.begin();
+      while (it != m_activeConnections.end())
+      {
+         if (it->second->IsListeningSocket())
+         {
+            ::epoll_ctl(m_epollDescriptor, EPOLL_CTL_DEL, it->first, 0);
+            listeningConnections.push_back(it->second);
+            m_activeConnections.erase(it++);
+         }
+         else
+         {
+            ++it;
+         }
+      }
+   }
+   listeningConnections.clear();
+
+   // tasks of one pool spawn tasks of another one (received data is parsed in the slow pool,
+   // answers are written in the fast one), so pools are drained in turn until both are idle
+   bool isDrained = false;
+   while (!isDrained && boost::get_system_time() < deadline)
+      isDrained = m_slowPool->Drain(deadline) && m_fastPool->Drain(deadline) && m_slowPool->IsIdle();
+
+   if (isDrained)
+   {
+      LOGDBG << "ConnectionManager is drained";
+   }
+   else
+   {
+      LOGWRN << "ConnectionManager drain deadline expired, unprocessed tasks will be dropped";
+   }
+   return isDrained;
 }
 
 void ConnectionManager::Shutdown()
@@ -84,8 +233,10 @@ void ConnectionManager::Shutdown()
       m_shutdownRequested = true;
       m_managerIsInitialized = false;
       LOGDBG << "Shutdown ConnectionManager";
-      m_fastPool->Shutdown();
-      m_slowPool->Shutdown();
+      // both pools share the same deadline, so shutdown time doesn't depend on the pools number
+      const boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(PoolShutdownTimeout);
+      m_fastPool->Shutdown(deadline);
+      m_slowPool->Shutdown(deadline);
 
       // carefully close each of the remained connections
       SocketDescriptor socket;
@@ -102,8 +253,20 @@ void ConnectionManager::Shutdown()
             LOGWRN << "Error deleting socket " << socket
                   << " from epoll, system error message: " << ::strerror(errno);
          }
+         if (!it->second->IsListeningSocket() && !it->second->IsConnectionClosed())
+            FlushClientSocket(socket);
       }
       m_activeConnections.clear();
+
+      LOCK eventSourcesLock(m_eventSourcesAccessGuard);
+      for (std::map<int, ConnectionCarrierPtr>::const_iterator it = m_eventSources.begin();
+         it != m_eventSources.end();
+         ++it)
+      {
+         ::epoll_ctl(m_epollDescriptor, EPOLL_CTL_DEL, it->first, 0);
+      }
+      m_eventSources.clear();
+      m_retiredEventSources.clear();
    }
 }
 
@@ -118,7 +281,7 @@ void ConnectionManager::ProcessConnections(const int timeout)
       return;
    }
 
-   if (epollResult == INVALID_DESCRIPTOR)
+   if (epollResult == INVALID_DESCRIPTOR && errno != EINTR)
       THROW_NETWORK_EXCEPTION(errno) << "Failed to wait on incoming connection";
 
    // traverse through triggered events and process them one by one
@@ -126,13 +289,32 @@ void ConnectionManager::ProcessConnections(const int timeout)
    ConnectionCarrier* carrier;
    for (int i = 0; i < epollResult; ++i)
    {
+      carrier = (ConnectionCarrier*)m_epollEvents[i].data.ptr;
+      if (carrier->isEventSource)
+      {
+         EventHandler handler;
+         {
+            LOCK lock(m_eventSourcesAccessGuard);
+            handler = carrier->handler;
+         }
+         try
+         {
+            if (handler)
+               handler(m_epollEvents[i].events);
+         }
+         catch(const std::exception&)
+         {
+            helpers::ExceptionDispatcher::Dispatch(BOOST_CURRENT_FUNCTION);
+         }
+         continue;
+      }
+
       if (m_epollEvents[i].events & EPOLLERR)
       {
          LOGERR << "TCP/IP stack error";
       }
       else
       {
-         carrier = (ConnectionCarrier*)m_epollEvents[i].data.ptr;
          triggeredConnection = carrier->holder.lock();
          if (triggeredConnection.get())
          {
@@ -143,6 +325,94 @@ void ConnectionManager::ProcessConnections(const int timeout)
    triggeredConnection.reset();
 
    ApplyDeleteList();
+
+   LOCK lock(m_eventSourcesAccessGuard);
+   m_retiredEventSources.clear();
+}
+
+void ConnectionManager::Wakeup()
+{
+   const uint64_t increment = 1;
+   if (::write(m_wakeupDescriptor, &increment, sizeof(increment)) != sizeof(increment) && errno != EAGAIN)
+   {
+         LOGERR << "Unable to signal wake-up event, system error message: " << ::strerror(errno);
+   }
+}
+
+void ConnectionManager::OnWakeup()
+{
+   uint64_t counter = 0;
+   ssize_t readResult = ::read(m_wakeupDescriptor, &counter, sizeof(counter));
+   (void)readResult;
+}
+
+void ConnectionManager::AddEventSource(const int descriptor, const uint32_t events, EventHandler handler)
+{
+   CHECK_ARGUMENT(descriptor != INVALID_DESCRIPTOR, "Invalid descriptor!");
+
+   ConnectionCarrierPtr carrier( new ConnectionCarrier );
+   carrier->isEventSource = true;
+   carrier->handler = handler;
+
+   LOCK lock(m_eventSourcesAccessGuard);
+   epoll_event event;
+   event.events = events;
+   event.data.ptr = carrier.get();
+   if (::epoll_ctl(m_epollDescriptor, EPOLL_CTL_ADD, descriptor, &event) != 0)
+      THROW_NETWORK_EXCEPTION(errno) << "Unable to add service descriptor to the epoll object";
+
+   m_eventSources[descriptor] = carrier;
+}
+
+void ConnectionManager::ModifyEventSource(const int descriptor, const uint32_t events)
+{
+   LOCK lock(m_eventSourcesAccessGuard);
+   std::map<int, ConnectionCarrierPtr>::const_iterator it = m_eventSources.find(descriptor);
+   if (it == m_eventSources.end())
+      return;
+
+   epoll_event event;
+   event.events = events;
+   event.data.ptr = it->second.get();
+   if (::epoll_ctl(m_epollDescriptor, EPOLL_CTL_MOD, descriptor, &event) != 0)
+   {
+         LOGERR << "Unable to modify service descriptor " << descriptor << ", system error message: " << ::strerror(errno);
+   }
+}
+
+void ConnectionManager::RemoveEventSource(const int descriptor)
+{
+   LOCK lock(m_eventSourcesAccessGuard);
+   std::map<int, ConnectionCarrierPtr>::iterator it = m_eventSources.find(descriptor);
+   if (it == m_eventSources.end())
+      return;
+
+   ::epoll_ctl(m_epollDescriptor, EPOLL_CTL_DEL, descriptor, 0);
+   it->second->handler.clear();
+   m_retiredEventSources.push_back(it->second);
+   m_eventSources.erase(it);
+}
+
+int ConnectionManager::AddTimer(const int interval, EventHandler handler)
+{
+   int timer = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+   if (timer == INVALID_DESCRIPTOR)
+      THROW_NETWORK_EXCEPTION(errno) << "Unable to create timer";
+
+   if (!SetTimerInterval(timer, interval))
+   {
+      ::close(timer);
+      THROW_NETWORK_EXCEPTION(errno) << "Unable to start timer";
+   }
+
+   AddEventSource(timer, EPOLLIN, boost::bind(&OnTimerExpired, timer, handler, _1));
+   return timer;
+}
+
+void ConnectionManager::RemoveTimer(const int timer)
+{
+   RemoveEventSource(timer);
+   ::close(timer);
 }
 
 void ConnectionManager::AddConnection(const ConnectionHolderPtr connectionHolder)
@@ -157,7 +427,7 @@ void ConnectionManager::AddConnection(const ConnectionHolderPtr connectionHolder
       edgeTriggeredFlag |= EPOLLET;
 
    SocketDescriptor socket = connectionHolder->GetSocketDescriptor();
-   ConnectionCarrierPtr carrier( new ConnectionCarrier );
+   ConnectionCarrierPtr carrier = boost::make_shared<ConnectionCarrier>();
    connectionHolder->SetConnectionCarrier(carrier);
    carrier->holder = connectionHolder;
 
@@ -180,8 +450,13 @@ void ConnectionManager::RemoveConnection(const SocketDescriptor socket)
 {
    LOGDBG << "Add pending removal for socket " << socket;
 
-   LOCK lock(m_pendingConnectionsAccessGuard);
-   m_pendingConnectionsToDelete.push_back(socket);
+   {
+      LOCK lock(m_pendingConnectionsAccessGuard);
+      m_pendingConnectionsToDelete.push_back(socket);
+   }
+
+   // connection processing thread doesn't wake up by timeout, so let it apply removal right away
+   Wakeup();
 }
 
 void ConnectionManager::PostFastTask(engine::TaskPtr task)
@@ -228,7 +503,7 @@ result_t ConnectionManager::FindConnectionByUsername(const std::string& username
       it != m_activeConnections.end();
       ++it)
    {
-      if (it->second->GetUsername() == username)
+      if (it->second->HasUsername(username))
       {
          connectionHolder = it->second;
          return result_code::sOk;
@@ -238,6 +513,26 @@ result_t ConnectionManager::FindConnectionByUsername(const std::string& username
    return result_code::eNotFound;
 }
 
+void ConnectionManager::GetMemoryStatistics(ConnectionMemoryStatistics& statistics)
+{
+   // node of the container: value and three links with the color of the tree node
+   static const size_t StorageNodeSize = sizeof(ConnectionStorage::value_type) + 4 * sizeof(void*);
+
+   ConnectionMemoryStatistics tempStatistics;
+   LOCK lock(m_activeConnectionAccessGuard);
+   for (ConnectionStorage::const_iterator it = m_activeConnections.begin();
+      it != m_activeConnections.end();
+      ++it)
+   {
+      if (it->second->IsListeningSocket())
+         continue;
+
+      ++tempStatistics.connectionCount;
+      tempStatistics.totalBytes += it->second->GetMemoryUsage() + StorageNodeSize;
+   }
+   statistics = tempStatistics;
+}
+
 result_t ConnectionManager::SetClientUsername(const SocketDescriptor sourceSocket, const std::string& username)
 {
    CHECK_ARGUMENT(sourceSocket != INVALID_DESCRIPTOR, "Invalid socket descriptor!");
@@ -249,7 +544,7 @@ result_t ConnectionManager::SetClientUsername(const SocketDescriptor sourceSocke
       it != m_activeConnections.end();
       ++it)
    {
-      if (it->second->GetUsername() == username)
+      if (it->second->HasUsername(username))
          return result_code::eAlreadyDefined;
 
       if (it->first == sourceSocket)
@@ -269,6 +564,8 @@ void ConnectionManager::OnConnectionEvent(ConnectionHolderPtr triggeredConnectio
    {
       CHECK_ARGUMENT(triggeredConnection.get() != 0, "Invalid incoming connection!");
       CHECK_ARGUMENT(triggeredConnection->IsSocketValid(), "Invalid socket descriptor");
+      // new work arrives, load has to be watched again
+      ArmAdmissionTimer();
 
       if (triggeredConnection->IsListeningSocket())
       {
@@ -276,31 +573,45 @@ void ConnectionManager::OnConnectionEvent(ConnectionHolderPtr triggeredConnectio
          SocketAddressHolder newSocketAddress;
          SocketDescriptor socket = triggeredConnection->AcceptNewConnection(newSocketAddress);
          LOGDBG << "New connect on socket " << socket;
-         SocketWrapperPtr newSocket( new SocketWrapper(socket) );
-         newSocket->SetNonblocking();
+         SocketWrapper newSocket(socket);
+
+         if (m_admissionController.GetLoadLevel() == CriticalLoad)
+         {
+            // socket is closed by the wrapper, client doesn't join the chat at all
+            LOGWRN << "Server is overloaded, reject connection on socket " << socket;
+            newSocket.Write(engine::ServerSenderName + "> Server is overloaded, please try again later" +
+               engine::ChatTerminationSymbol);
+            FlushClientSocket(socket);
+            return;
+         }
+         newSocket.SetNonblocking();
          // TCP_NODELAY option will help us to achieve lower latency on little
          // portions of data to be sent out
-         newSocket->SetSocketOption(SOL_TCP, TCP_NODELAY, 1);
+         newSocket.SetSocketOption(SOL_TCP, TCP_NODELAY, 1);
          // set keep-alive option as we are working with connection-oriented socket
-         newSocket->SetSocketOption(SOL_TCP, SO_KEEPALIVE, 1);
+         newSocket.SetSocketOption(SOL_TCP, SO_KEEPALIVE, 1);
+         if (m_socketBusyPoll != 0 &&
+            ::setsockopt(socket, SOL_SOCKET, SO_BUSY_POLL, &m_socketBusyPoll, sizeof(m_socketBusyPoll)) != 0)
+         {
+            // not fatal, connection is simply served without kernel busy polling
+            LOGWRN << "Unable to set busy poll option on socket " << socket << ", system error message: " << strerror(errno);
+         }
 
          // mark this connection holder with 'false' flag as it's not a listening
-         // socket but just a new connection
-         ConnectionHolderPtr newConnectionHolder( new ConnectionHolder(newSocket, false) );
-         newConnectionHolder->SetUsername();
+         // socket but just a new connection. Holder takes over the socket and starts with
+         // the default username
+         ConnectionHolderPtr newConnectionHolder = boost::make_shared<ConnectionHolder>(newSocket.Release(), false);
          AddConnection(newConnectionHolder);
 
-         // post message to notify that a new user has joined
+         // notify that a new user has joined, immediately or as a part of presence summary
+         engine::PresenceAggregator::GetInstance().OnUserJoined(newConnectionHolder->GetUsername(), socket);
+         FederationManager::GetInstance().OnLocalUserJoined(newConnectionHolder->GetUsername());
+
+         // post intro message to the newbie message
          engine::MessageDescription message;
          message.receiver = newConnectionHolder;
          message.senderSocket = socket;
          message.senderName = engine::ServerSenderName;
-         message.data = "User '" + newConnectionHolder->GetUsername() +
-               "' has joined the chat" + engine::ChatTerminationSymbol;
-         engine::TaskPtr newTask( new engine::ProcessMessageTask(message) );
-         PostSlowTask(newTask);
-
-         // post intro message to the newbie message
          message.data = std::string("\\intro") + engine::ChatTerminationSymbol;
          engine::TaskPtr introTask( new engine::ProcessMessageTask(message) );
          PostSlowTask(introTask);
@@ -309,6 +620,7 @@ void ConnectionManager::OnConnectionEvent(ConnectionHolderPtr triggeredConnectio
       {
          // launch read task on existing socket
          LOGDBG << "Launch read on socket: " << triggeredConnection->GetSocketDescriptor();
+         triggeredConnection->CountReadEvent(m_admissionPeriod);
          engine::TaskPtr newTask( new engine::ReceiveDataTask(triggeredConnection) );
          PostFastTask(newTask);
       }
@@ -319,6 +631,218 @@ void ConnectionManager::OnConnectionEvent(ConnectionHolderPtr triggeredConnectio
    }
 }
 
+void ConnectionManager::SetAdmissionLimits(const size_t queueSizeLimit, const int queueWaitLimit)
+{
+   LOGDBG << "Admission limits: queue size - " << queueSizeLimit << ", queue wait - " << queueWaitLimit << " ms";
+   m_admissionController.SetLimits(queueSizeLimit, queueWaitLimit);
+   // before initialization the timer is started by Initialize
+   if (m_managerIsInitialized)
+      UpdateAdmissionTimer();
+}
+
+void ConnectionManager::SetBusyPoll(const int spinningWorkerCount, const int socketBusyPoll, const std::vector<int>& cpus)
+{
+   m_socketBusyPoll = socketBusyPoll;
+   if (m_managerIsInitialized)
+   {
+      if (spinningWorkerCount != m_busyPollWorkerCount)
+      {
+         LOGWRN << "Busy poll mode is changed on restart only";
+      }
+      return;
+   }
+
+   LOGDBG << "Busy poll: spinning workers - " << spinningWorkerCount << ", socket - " << socketBusyPoll
+          << " us, cores - " << cpus.size();
+   m_busyPollWorkerCount = spinningWorkerCount;
+   m_eventLoopCpu = (spinningWorkerCount != 0 && !cpus.empty()) ? cpus[0] : -1;
+
+   // the first core is taken by the event loop, then go spinning workers of the fast and slow pools
+   std::vector<int> fastPoolCpus;
+   std::vector<int> slowPoolCpus;
+   for (size_t i = 1; spinningWorkerCount != 0 && i < cpus.size(); ++i)
+   {
+      if (i <= static_cast<size_t>(spinningWorkerCount))
+         fastPoolCpus.push_back(cpus[i]);
+      else
+         slowPoolCpus.push_back(cpus[i]);
+   }
+   m_fastPool->SetBusyPoll(spinningWorkerCount, fastPoolCpus);
+   m_slowPool->SetBusyPoll(spinningWorkerCount, slowPoolCpus);
+}
+
+bool ConnectionManager::IsBusyPollEnabled() const
+{
+   return m_busyPollWorkerCount != 0;
+}
+
+int ConnectionManager::GetEventLoopCpu() const
+{
+   return m_eventLoopCpu;
+}
+
+void ConnectionManager::UpdateAdmissionTimer()
+{
+   if (m_admissionController.IsEnabled() && m_admissionTimer == INVALID_DESCRIPTOR)
+   {
+      m_admissionTimer = AddTimer(AdmissionCheckInterval, boost::bind(&ConnectionManager::OnAdmissionTimer, this));
+      m_isAdmissionTimerArmed = true;
+   }
+   else if (!m_admissionController.IsEnabled() && m_admissionTimer != INVALID_DESCRIPTOR)
+   {
+      RemoveTimer(m_admissionTimer);
+      m_admissionTimer = INVALID_DESCRIPTOR;
+      m_isAdmissionTimerArmed = false;
+      ResumePausedConnections();
+      DeferAccepts(false);
+   }
+}
+
+void ConnectionManager::OnAdmissionTimer()
+{
+   const size_t queueSize = std::max(m_fastPool->GetQueueSize(), m_slowPool->GetQueueSize());
+   const int queueWait = std::max(m_fastPool->GetQueueWait(), m_slowPool->GetQueueWait());
+   const LoadLevel previousLevel = m_admissionController.GetLoadLevel();
+   const LoadLevel level = m_admissionController.Evaluate(queueSize, queueWait);
+
+   if (level != previousLevel)
+   {
+      LOGWRN << "Server load level is changed from " << previousLevel << " to " << level
+             << ", longest queue: " << queueSize << " tasks, oldest task: " << queueWait << " ms";
+   }
+
+   switch (level)
+   {
+      case NormalLoad:
+         ResumePausedConnections();
+         DeferAccepts(false);
+         break;
+      case HighLoad:
+         PauseNoisiestConnections();
+         DeferAccepts(true);
+         break;
+      case CriticalLoad:
+         // connections are accepted to be rejected with a server message, otherwise clients
+         // would wait in the overflowed backlog without any clue
+         PauseNoisiestConnections();
+         DeferAccepts(false);
+         break;
+   }
+
+   // read events are counted from scratch in the new period
+   ++m_admissionPeriod;
+
+   // nothing to watch until the next client event, idle event loop is not woken up
+   if (level == NormalLoad && queueSize == 0 && m_pausedConnections.empty())
+   {
+      if (SetTimerInterval(m_admissionTimer, 0))
+         m_isAdmissionTimerArmed = false;
+   }
+}
+
+void ConnectionManager::ArmAdmissionTimer()
+{
+   if (m_isAdmissionTimerArmed || m_admissionTimer == INVALID_DESCRIPTOR)
+      return;
+
+   if (!SetTimerInterval(m_admissionTimer, AdmissionCheckInterval))
+   {
+      LOGWRN << "Unable to restart admission timer, system error message: " << strerror(errno);
+      return;
+   }
+   m_isAdmissionTimerArmed = true;
+}
+
+void ConnectionManager::PauseNoisiestConnections()
+{
+   std::vector<std::pair<int, ConnectionHolderPtr> > candidates;
+   {
+      LOCK lock(m_activeConnectionAccessGuard);
+      for (ConnectionStorage::const_iterator it = m_activeConnections.begin();
+         it != m_activeConnections.end();
+         ++it)
+      {
+         const int readEvents = it->second->GetReadEventCount(m_admissionPeriod);
+         if (!it->second->IsListeningSocket() && readEvents >= MinNoisyReadEvents)
+            candidates.push_back(std::make_pair(readEvents, it->second));
+      }
+   }
+   if (candidates.empty())
+      return;
+
+   // the share is small, so that the quiet majority of clients is not affected, but
+   // it is taken every period while server stays overloaded
+   const size_t pauseCount = (candidates.size() * NoisyConnectionsShare + 99) / 100;
+   std::partial_sort(candidates.begin(), candidates.begin() + pauseCount, candidates.end(), IsNoisier);
+   for (size_t i = 0; i < pauseCount; ++i)
+   {
+      LOGWRN << "Pause reading from socket " << candidates[i].second->GetSocketDescriptor()
+             << ", read events: " << candidates[i].first;
+      // edge triggered connection reports data received meanwhile once it is resumed
+      ModifyConnectionEvents(candidates[i].second, EPOLLERR | EPOLLET);
+      m_pausedConnections.push_back(candidates[i].second);
+   }
+}
+
+void ConnectionManager::ResumePausedConnections()
+{
+   if (m_pausedConnections.empty())
+      return;
+
+   LOGWRN << "Resume reading from " << m_pausedConnections.size() << " paused connections";
+   ConnectionHolderPtr connection;
+   for (std::list<ConnectionWeakPtr>::const_iterator it = m_pausedConnections.begin();
+      it != m_pausedConnections.end();
+      ++it)
+   {
+      connection = it->lock();
+      if (connection.get() && !connection->IsConnectionClosed())
+         ModifyConnectionEvents(connection, EPOLLIN | EPOLLERR | EPOLLET);
+   }
+   m_pausedConnections.clear();
+}
+
+void ConnectionManager::DeferAccepts(const bool deferAccepts)
+{
+   if (m_acceptsDeferred == deferAccepts)
+      return;
+
+   m_acceptsDeferred = deferAccepts;
+   LOGWRN << (deferAccepts ? "Defer" : "Resume") << " accepting new connections";
+
+   ConnectionHolderList listeningConnections;
+   {
+      LOCK lock(m_activeConnectionAccessGuard);
+      for (ConnectionStorage::const_iterator it = m_activeConnections.begin();
+         it != m_activeConnections.end();
+         ++it)
+      {
+         if (it->second->IsListeningSocket())
+            listeningConnections.push_back(it->second);
+      }
+   }
+
+   // pending connections wait in the backlog, level triggered socket reports them once it is resumed
+   for (ConnectionHolderList::const_iterator it = listeningConnections.begin();
+      it != listeningConnections.end();
+      ++it)
+   {
+      ModifyConnectionEvents(*it, deferAccepts ? 0 : EPOLLIN | EPOLLERR);
+   }
+}
+
+void ConnectionManager::ModifyConnectionEvents(const ConnectionHolderPtr& connection, const uint32_t events)
+{
+   epoll_event event;
+   event.events = events;
+   event.data.ptr = connection->GetConnectionCarrier();
+   if (::epoll_ctl(m_epollDescriptor, EPOLL_CTL_MOD, connection->GetSocketDescriptor(), &event) != 0)
+   {
+      LOGWRN << "Unable to modify events of socket " << connection->GetSocketDescriptor()
+             << ", system error message: " << ::strerror(errno);
+   }
+}
+
 void ConnectionManager::ApplyDeleteList()
 {
    LOCK lockPending(m_pendingConnectionsAccessGuard);
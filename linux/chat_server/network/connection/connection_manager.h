@@ -9,6 +9,7 @@
 #define CS_NETWORK_CONNECTION_MANAGER_H
 
 #include "connection_holder.h"
+#include "admission_controller.h"
 #include <common/result_code.h>
 #include <thread_pool/thread_pool.h>
 // third-party
@@ -19,6 +20,7 @@
 #include <boost/thread/locks.hpp>
 #include <map>
 #include <list>
+#include <vector>
 
 namespace cs
 {
@@ -35,6 +37,23 @@ typedef std::list<SocketDescriptor> SocketList;
 /// size of the array to handle active connection events
 static const int MaxEpollEventsCount = 4096;
 
+/**
+ *  \struct    cs::network::ConnectionMemoryStatistics
+ *  \brief     Memory consumed by the client connections in the process
+ */
+struct ConnectionMemoryStatistics
+{
+   ConnectionMemoryStatistics()
+      : connectionCount(0)
+      , totalBytes(0)
+   {}
+
+   /// number of client connections
+   size_t   connectionCount;
+   /// memory consumed by the client connections and their container entries, bytes
+   size_t   totalBytes;
+};
+
 /**
  *  \class     cs::network::ConnectionManager
  *  \brief     Main class that handles all incoming/outgoing network activity
@@ -67,21 +86,74 @@ public:
     */
    void Initialize(const unsigned int backlogSize = 100 /* argument is unused since Linux 2.6.8 */);
 
+   /**
+    * Graceful part of the shutdown procedure, must be called when connections are not processed
+    * anymore. Stops accepting new connections and waits until the tasks queued in both thread pools,
+    * including the tasks they spawn, are completed, so that in-flight messages reach their receivers.
+    * @param timeout - maximum time of the drain in milliseconds, 0 means don't wait
+    * @returns - true if all tasks are completed, false if timeout expired first
+    */
+   bool Drain(const int timeout);
+
    /**
     * Shutdown procedure. Closes thread pools, removes active connections from epoll
-    * object, closes all active connections
+    * object, flushes and closes all active connections. Tasks that are still queued are dropped,
+    * use Drain before to complete them.
     */
    void Shutdown();
 
    /**
-    * Method to be used by external caller (NetworkManager) to process connections periodically.
+    * Method to be used by external caller (NetworkManager) to process connections in a loop.
     * This method is blocked for certain timeout during which it is waiting for incoming network
-    * activity. On new network event it awakes, schedules new connections to be processed and
-    * return control to the caller.
-    * @param timeout - time period to wait for incoming network activity
+    * activity or service events. On new event it awakes, schedules new connections to be processed,
+    * invokes handlers of service descriptors and return control to the caller.
+    * @param timeout - time period to wait for incoming network activity, -1 waits until an event
     */
    void ProcessConnections(const int timeout);
 
+   /**
+    * Wake up the thread blocked in ProcessConnections. Can be called from any thread.
+    */
+   void Wakeup();
+
+   /**
+    * Add service descriptor (signal, timer, foreign socket) to the epoll kernel object in Level
+    * Triggered mode. Handler is invoked from ProcessConnections, so it must never block.
+    * @param descriptor - descriptor to be monitored
+    * @param events - epoll events to be monitored
+    * @param handler - functor to be invoked with the triggered events
+    */
+   void AddEventSource(const int descriptor, const uint32_t events, EventHandler handler);
+
+   /**
+    * Change epoll events monitored for the service descriptor
+    * @param descriptor - descriptor added by AddEventSource
+    * @param events - new set of epoll events
+    */
+   void ModifyEventSource(const int descriptor, const uint32_t events);
+
+   /**
+    * Remove service descriptor from the epoll kernel object. Handler is never invoked after this
+    * call, even for the events that are already received, so it is safe to call the method from
+    * the handler itself. Descriptor is not closed.
+    * @param descriptor - descriptor added by AddEventSource
+    */
+   void RemoveEventSource(const int descriptor);
+
+   /**
+    * Create periodic timer and add it to the epoll kernel object
+    * @param interval - timer period in milliseconds
+    * @param handler - functor to be invoked on every timer expiration
+    * @returns - descriptor of the timer to be passed to RemoveTimer
+    */
+   int AddTimer(const int interval, EventHandler handler);
+
+   /**
+    * Remove timer from the epoll kernel object and close it
+    * @param timer - descriptor returned by AddTimer
+    */
+   void RemoveTimer(const int timer);
+
    /**
     * Add new connection to the list of active connections and to the epoll kernel object. From now
     * on all events fired from this connection will be handled by ConnectionManager. Current
@@ -137,6 +209,45 @@ public:
     */
    result_t SetClientUsername(const SocketDescriptor sourceSocket, const std::string& username);
 
+   /**
+    * Calculate memory consumed by the client connections, see ConnectionHolder::GetMemoryUsage
+    * @param statistics - output statistics
+    */
+   void GetMemoryStatistics(ConnectionMemoryStatistics& statistics);
+
+   /**
+    * Set limits of the admission control. Once thread pools are loaded beyond the limits reads
+    * from the noisiest connections are paused and new connections are deferred, beyond the
+    * doubled limits new connections are rejected. See AdmissionController for details
+    * @param queueSizeLimit - maximum number of tasks in a pool queue, 0 disables the limit
+    * @param queueWaitLimit - maximum time in milliseconds a task waits in a pool queue,
+    *                         0 disables the limit
+    */
+   void SetAdmissionLimits(const size_t queueSizeLimit, const int queueWaitLimit);
+
+   /**
+    * Set busy poll mode: event loop and some workers of each pool poll for new work instead of
+    * sleeping, which removes wake-up latency of every hop at the cost of fully loaded cores.
+    * Spinning settings take effect on Initialize only, socket setting is applied to new
+    * connections at any time
+    * @param spinningWorkerCount - number of spinning workers in each pool, 0 disables busy polling
+    * @param socketBusyPoll - SO_BUSY_POLL value for client sockets in microseconds, 0 disables it
+    * @param cpus - cores to bind the event loop and the spinning workers to, in this order
+    */
+   void SetBusyPoll(const int spinningWorkerCount, const int socketBusyPoll, const std::vector<int>& cpus);
+
+   /**
+    * Helper function to see if event loop should poll connections without sleeping
+    * @returns - true if busy poll mode is enabled, false otherwise
+    */
+   bool IsBusyPollEnabled() const;
+
+   /**
+    * Get core the event loop thread has to be bound to
+    * @returns - index of the core, -1 if event loop thread is not bound
+    */
+   int GetEventLoopCpu() const;
+
 private:
    /// type for commonly used lock object
    typedef boost::lock_guard<boost::mutex> LOCK;
@@ -149,6 +260,23 @@ private:
    /// Helper method to be called at the end of ProcessConnections routine to erase all pending
    /// connections
    void ApplyDeleteList();
+   /// Handler of the wake-up event, resets the event
+   void OnWakeup();
+   /// Start or stop periodic load evaluation depending on the admission limits
+   void UpdateAdmissionTimer();
+   /// Handler of the admission timer, evaluates the load and applies admission measures. Stops
+   /// the timer once pools have no queued work
+   void OnAdmissionTimer();
+   /// Restart the admission timer stopped by OnAdmissionTimer, must be called on new client events
+   void ArmAdmissionTimer();
+   /// Stop reading from the connections that produced the most of read events during the last period
+   void PauseNoisiestConnections();
+   /// Resume reading from all paused connections
+   void ResumePausedConnections();
+   /// Stop or resume accepting new connections on the listening sockets
+   void DeferAccepts(const bool deferAccepts);
+   /// Change epoll events monitored for the connection
+   void ModifyConnectionEvents(const ConnectionHolderPtr& connection, const uint32_t events);
 
    /// smart object that holds fast thread pool
    boost::scoped_ptr<thread_pool::ThreadPool>   m_fastPool;
@@ -164,8 +292,38 @@ private:
    /// pending list of connections to be closed
    SocketList                                   m_pendingConnectionsToDelete;
 
+   /// sync object to guard access to service descriptors
+   boost::mutex                                 m_eventSourcesAccessGuard;
+   /// carriers of service descriptors
+   std::map<int, ConnectionCarrierPtr>          m_eventSources;
+   /// carriers of removed service descriptors. They are kept until the end of ProcessConnections
+   /// because epoll object might have returned them already
+   std::list<ConnectionCarrierPtr>              m_retiredEventSources;
+
+   /// policy of accepting new work
+   AdmissionController                          m_admissionController;
+   /// timer of the load evaluation, INVALID_DESCRIPTOR if admission control is disabled
+   int                                          m_admissionTimer;
+   /// flag that the admission timer is running, it is stopped while pools are idle
+   bool                                         m_isAdmissionTimerArmed;
+   /// number of the current load evaluation period, read events of connections are counted per period
+   unsigned int                                 m_admissionPeriod;
+   /// connections that are not read until the load is normal
+   std::list<ConnectionWeakPtr>                 m_pausedConnections;
+   /// flag that listening sockets are not monitored
+   bool                                         m_acceptsDeferred;
+
+   /// number of spinning workers in each pool, 0 if busy poll mode is disabled
+   int                                          m_busyPollWorkerCount;
+   /// SO_BUSY_POLL value for client sockets in microseconds, 0 if disabled
+   int                                          m_socketBusyPoll;
+   /// core the event loop thread is bound to, -1 if not bound
+   int                                          m_eventLoopCpu;
+
    /// descriptor of the epoll kernel object
    EpollDescriptor                              m_epollDescriptor;
+   /// descriptor of the event used to wake up ProcessConnections
+   int                                          m_wakeupDescriptor;
    /// flag that shutdown was requested
    bool                                         m_shutdownRequested;
    /// flag that manager is initialized already
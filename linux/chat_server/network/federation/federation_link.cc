@@ -0,0 +1,172 @@
+/**
+ *  \file
+ *  \brief     FederationLink class implementation
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#include "federation_link.h"
+#include <common/exception_dispatcher.h>
+// third-party
+#include <errno.h>
+
+namespace cs
+{
+namespace network
+{
+
+static const size_t MaxDataBufferSize = 4096;
+/// maximum length of single frame, peer that sends longer frames is disconnected
+static const size_t MaximumFrameLength = 65536;
+/// maximum size of data that peer didn't read yet, slower peers are disconnected
+static const size_t MaximumPendingDataSize = 4 * 1024 * 1024;
+
+FederationLink::FederationLink(SocketWrapperPtr socket, const std::string& peerAddress, const bool isInitiator)
+   : m_peerAddress(peerAddress)
+   , m_isInitiator(isInitiator)
+   , m_isConnecting(isInitiator)
+   , m_isClosed(false)
+{
+   CHECK_ARGUMENT(socket.get(), "Empty socket!");
+   CHECK_ARGUMENT(socket->IsValid(), "Inavlid socket!");
+   m_socketWrapper = socket;
+}
+
+result_t FederationLink::ReadFrames(FrameList& frames)
+{
+   try
+   {
+      char dataBuffer[MaxDataBufferSize];
+      size_t bytesRead = 0;
+      // reserve one byte for the zero symbol added by SocketWrapper
+      result_t error = result_code::sOk;
+      while ((error = m_socketWrapper->Read(dataBuffer, MaxDataBufferSize - 1, bytesRead)) == result_code::sOk)
+         m_inData.append(dataBuffer, bytesRead);
+
+      size_t frameStart = 0;
+      size_t frameEnd = m_inData.find(FederationFrameTerminator);
+      while (frameEnd != std::string::npos)
+      {
+         frames.push_back(m_inData.substr(frameStart, frameEnd - frameStart));
+         frameStart = frameEnd + 1;
+         frameEnd = m_inData.find(FederationFrameTerminator, frameStart);
+      }
+      m_inData.erase(0, frameStart);
+
+      if (m_inData.length() >= MaximumFrameLength)
+      {
+         LOGERR << "Frame length is exceeded on link with " << m_peerAddress;
+         return result_code::eBufferOverflow;
+      }
+
+      // link is useless after a read error, so it's handled as closed
+      if (error != result_code::eNotReady)
+         return result_code::eConnectionClosed;
+      return result_code::sOk;
+   }
+   catch(const std::exception&)
+   {
+      helpers::ExceptionDispatcher::Dispatch(BOOST_CURRENT_FUNCTION);
+      return result_code::eConnectionClosed;
+   }
+}
+
+result_t FederationLink::SendFrame(const std::string& frame)
+{
+   LOCK lock(m_outDataAccessGuard);
+   if (m_isClosed)
+      return result_code::eConnectionClosed;
+
+   m_outData.append(frame);
+   m_outData.push_back(FederationFrameTerminator);
+   if (m_outData.length() > MaximumPendingDataSize)
+   {
+      LOGERR << "Pending data limit is exceeded on link with " << m_peerAddress;
+      return result_code::eBufferOverflow;
+   }
+
+   return WritePendingData();
+}
+
+result_t FederationLink::FlushPendingData()
+{
+   LOCK lock(m_outDataAccessGuard);
+   if (m_isClosed)
+      return result_code::eConnectionClosed;
+
+   return WritePendingData();
+}
+
+bool FederationLink::HasPendingData() const
+{
+   LOCK lock(m_outDataAccessGuard);
+   return !m_outData.empty();
+}
+
+result_t FederationLink::WritePendingData()
+{
+   // nothing can be written unless connection procedure is completed
+   if (m_isConnecting || m_outData.empty())
+      return result_code::sOk;
+
+   ssize_t writeResult = m_socketWrapper->Write(m_outData);
+   if (writeResult < 0)
+   {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+         return result_code::sOk;
+      LOGERR << "Unable to write to link with " << m_peerAddress << ", system error message: " << strerror(errno);
+      return result_code::eConnectionClosed;
+   }
+
+   m_outData.erase(0, writeResult);
+   return result_code::sOk;
+}
+
+void FederationLink::SetPeerNode(const std::string& peerNode)
+{
+   LOCK lock(m_peerAccessGuard);
+   m_peerNode = peerNode;
+}
+
+std::string FederationLink::GetPeerNode() const
+{
+   LOCK lock(m_peerAccessGuard);
+   return m_peerNode;
+}
+
+const std::string& FederationLink::GetPeerAddress() const
+{
+   return m_peerAddress;
+}
+
+bool FederationLink::IsInitiator() const
+{
+   return m_isInitiator;
+}
+
+bool FederationLink::IsConnecting() const
+{
+   LOCK lock(m_outDataAccessGuard);
+   return m_isConnecting;
+}
+
+void FederationLink::SetConnected()
+{
+   LOCK lock(m_outDataAccessGuard);
+   m_isConnecting = false;
+}
+
+SocketDescriptor FederationLink::GetSocketDescriptor() const
+{
+   return m_socketWrapper->GetDescriptor();
+}
+
+void FederationLink::Close()
+{
+   LOCK lock(m_outDataAccessGuard);
+   m_isClosed = true;
+   m_socketWrapper->Close();
+}
+
+} // namespace network
+} // namespace cs
@@ -0,0 +1,166 @@
+/**
+ *  \file
+ *  \brief     FederationLink class declaration
+ *  \details   Holds FederationLink class that presents server-to-server connection
+ *             between two federated chat nodes
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#ifndef CS_NETWORK_FEDERATION_LINK_H
+#define CS_NETWORK_FEDERATION_LINK_H
+
+#include <network/socket/socket_wrapper.h>
+#include <common/result_code.h>
+// third-party
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <string>
+#include <list>
+
+namespace cs
+{
+namespace network
+{
+
+class FederationLink;
+typedef boost::shared_ptr<FederationLink> FederationLinkPtr;
+/// type of container to pass list of link frames between components
+typedef std::list<std::string> FrameList;
+
+/// symbol that terminates each frame of the link protocol
+static const char FederationFrameTerminator = '\n';
+
+/**
+ *  \class     cs::network::FederationLink
+ *  \brief     Helper class that presents 'link' entity between two chat nodes
+ *  \details   Presents server-to-server connection as a summary of several items:
+ *              - instance of SocketWrapper for the opened socket
+ *              - name of the node on the other side of the link (known after handshake)
+ *              - buffers with received and not yet sent frames of link protocol
+ *             Frames are written from any thread without blocking: data that doesn't fit
+ *             into socket buffer is kept in the link and flushed by the federation thread
+ *             once the socket becomes writable.
+ */
+class FederationLink : public boost::noncopyable
+{
+public:
+   /**
+    * Constructor
+    * @param socket - smart object with the SocketWrapper to be associated with this link
+    * @param peerAddress - address of the remote node, used for logging and reconnects
+    * @param isInitiator - flag if this node has initiated the connection
+    */
+   FederationLink(SocketWrapperPtr socket, const std::string& peerAddress, const bool isInitiator);
+
+   /**
+    * Read all available data from the socket and split it into frames
+    * @param frames - output list of complete frames without terminators
+    * @returns - result code of the operation
+    *             - sOk if data was read correctly
+    *             - eBufferOverflow if peer sent a frame exceeding allowed size
+    *             - eConnectionClosed if socket was closed during the read procedure
+    */
+   result_t ReadFrames(FrameList& frames);
+
+   /**
+    * Queue frame for sending and write as much of pending data as socket accepts
+    * @param frame - frame to be sent, terminator is appended automatically
+    * @returns - result code of the operation
+    *             - sOk if frame is written or queued
+    *             - eBufferOverflow if peer doesn't read data and pending data limit is exceeded
+    *             - eConnectionClosed if socket is closed
+    */
+   result_t SendFrame(const std::string& frame);
+
+   /**
+    * Write pending data to the socket
+    * @returns - result code of the operation, see SendFrame
+    */
+   result_t FlushPendingData();
+
+   /**
+    * Helper function to see if there is data waiting for the socket to become writable
+    * @returns - true if pending data exists, false otherwise
+    */
+   bool HasPendingData() const;
+
+   /**
+    * Mark the link as established after successful handshake
+    * @param peerNode - name of the node on the other side of the link
+    */
+   void SetPeerNode(const std::string& peerNode);
+
+   /**
+    * Get name of the node on the other side of the link
+    * @returns - name of the peer node, empty string if handshake is not completed
+    */
+   std::string GetPeerNode() const;
+
+   /**
+    * Get address of the node on the other side of the link
+    * @returns - address of the peer node
+    */
+   const std::string& GetPeerAddress() const;
+
+   /**
+    * Helper function to see if the link has been opened by this node
+    * @returns - true if this node initiated connection, false otherwise
+    */
+   bool IsInitiator() const;
+
+   /**
+    * Helper function to see if the socket is still connecting to the peer
+    * @returns - true if connection is in progress, false otherwise
+    */
+   bool IsConnecting() const;
+
+   /**
+    * Mark outgoing connection as completed
+    */
+   void SetConnected();
+
+   /**
+    * Get descriptor of the wrapped socket
+    * @returns - descriptor of the wrapped socket
+    */
+   SocketDescriptor GetSocketDescriptor() const;
+
+   /**
+    * Close the link
+    */
+   void Close();
+
+private:
+   typedef boost::lock_guard<boost::mutex> LOCK;
+
+   /// write pending data, must be called under m_outDataAccessGuard
+   result_t WritePendingData();
+
+   /// socket wrapper that this link is associated with
+   SocketWrapperPtr        m_socketWrapper;
+   /// address of the remote node
+   std::string             m_peerAddress;
+   /// name of the remote node, empty until handshake is completed
+   std::string             m_peerNode;
+   /// raw data received from socket which doesn't form a complete frame yet
+   std::string             m_inData;
+   /// data waiting for the socket to become writable
+   std::string             m_outData;
+   /// sync object to guard access to the outgoing data
+   mutable boost::mutex    m_outDataAccessGuard;
+   /// sync object to guard access to the peer node name
+   mutable boost::mutex    m_peerAccessGuard;
+   /// flag that this node has initiated the connection
+   bool                    m_isInitiator;
+   /// flag that connection to the peer is in progress
+   bool                    m_isConnecting;
+   /// flag that link is closed
+   bool                    m_isClosed;
+};
+
+} // namespace network
+} // namespace cs
+
+#endif // CS_NETWORK_FEDERATION_LINK_H
@@ -0,0 +1,717 @@
+/**
+ *  \file
+ *  \brief     FederationManager class implementation
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#include "federation_manager.h"
+#include <network/connection/connection_manager.h>
+#include <config/configuration_manager.h>
+#include <common/exception_dispatcher.h>
+#include <core/data_processing/write_answer_task.h>
+// third-party
+#include <time.h>
+#include <boost/bind.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <sstream>
+
+namespace
+{
+
+/// time interval between attempts to open links to configured peers, milliseconds
+static const int ReconnectInterval = 2000;
+/// time interval between periodic snapshots of local users, milliseconds
+static const int SnapshotInterval = 10000;
+/// node is forgotten if nothing was received from it during this time, milliseconds
+static const int NodeExpirationTimeout = 3 * SnapshotInterval;
+
+/**
+ * Helper function to split address in the form 'ip:port' into separate parts
+ * @param address - string with the address
+ * @param ipAddress - output string with ip address
+ * @param port - output port number
+ * @returns - true if address is well-formed, false otherwise
+ */
+bool ParseAddress(const std::string& address, std::string& ipAddress, unsigned int& port)
+{
+   size_t delimiter = address.rfind(':');
+   if (delimiter == std::string::npos || delimiter == 0)
+      return false;
+
+   ipAddress = address.substr(0, delimiter);
+   std::istringstream stream(address.substr(delimiter + 1));
+   stream >> port;
+   return !stream.fail() && port > 0 && port < 65536;
+}
+
+/**
+ * Helper function to remove termination symbol from the chat line
+ * @param line - formatted chat line
+ * @returns - chat line without termination symbol
+ */
+std::string StripTerminator(const std::string& line)
+{
+   if (!line.empty() && line[line.length() - 1] == cs::engine::ChatTerminationSymbol)
+      return line.substr(0, line.length() - 1);
+   return line;
+}
+
+} // unnamed namespace
+
+
+namespace cs
+{
+namespace network
+{
+
+FederationManager& FederationManager::GetInstance()
+{
+   // g++ guarantees thread-safe initialization for static variable
+   static FederationManager manager;
+   return manager;
+}
+
+FederationManager::FederationManager()
+   : m_epoch(0)
+   , m_sequence(0)
+   , m_reconnectTimer(INVALID_DESCRIPTOR)
+   , m_snapshotTimer(INVALID_DESCRIPTOR)
+   , m_isEnabled(false)
+   , m_shutdownRequested(false)
+{}
+
+void FederationManager::Initialize()
+{
+   config::ConfigurationManager& configManager = config::ConfigurationManager::GetInstance();
+   std::string peers;
+   // federation settings are optional - older configuration files don't have them
+   if (configManager.GetOptionalSetting(config::NodeName, m_nodeName, "") != result_code::sOk || m_nodeName.empty())
+   {
+      LOGDBG << "Node name is not set, federation is disabled";
+      return;
+   }
+   configManager.GetOptionalSetting(config::FederationListen, m_listenAddress, "");
+   configManager.GetOptionalSetting(config::FederationPeers, peers, "");
+   boost::split(m_peerAddresses, peers, boost::is_any_of(","), boost::token_compress_on);
+   m_peerAddresses.remove(std::string(""));
+
+   LOGDBG << "Initializing FederationManager, node '" << m_nodeName << "', listen '" << m_listenAddress
+          << "', peers '" << peers << "'";
+
+   if (!m_listenAddress.empty())
+   {
+      std::string ipAddress;
+      unsigned int port = 0;
+      if (!ParseAddress(m_listenAddress, ipAddress, port))
+         THROW_INVALID_ARGUMENT << "Invalid federation listen address: " << m_listenAddress;
+
+      static const int SocketBacklogSize = 16;
+      m_listeningSocket.reset( new SocketWrapper(AF_INET, SOCK_STREAM, IPPROTO_IP) );
+      m_listeningSocket->SetSocketOption(SOL_SOCKET, SO_REUSEADDR, 1);
+      SocketAddressHolder socketAddress(ipAddress, port);
+      m_listeningSocket->Bind(socketAddress);
+      m_listeningSocket->SetNonblocking();
+      m_listeningSocket->Listen(SocketBacklogSize);
+   }
+
+   timespec now;
+   ::clock_gettime(CLOCK_REALTIME, &now);
+   m_epoch = static_cast<boost::uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+   m_isEnabled = true;
+}
+
+void FederationManager::Start()
+{
+   if (!m_isEnabled)
+      return;
+
+   LOGDBG << "Starting FederationManager";
+   ConnectionManager& connectionManager = ConnectionManager::GetInstance();
+   if (m_listeningSocket.get())
+   {
+      connectionManager.AddEventSource(m_listeningSocket->GetDescriptor(), EPOLLIN,
+         boost::bind(&FederationManager::AcceptLink, this));
+   }
+   m_reconnectTimer = connectionManager.AddTimer(ReconnectInterval, boost::bind(&FederationManager::ConnectToPeers, this));
+   m_snapshotTimer = connectionManager.AddTimer(SnapshotInterval, boost::bind(&FederationManager::OnSnapshotTimer, this));
+   ConnectToPeers();
+}
+
+void FederationManager::Shutdown()
+{
+   if (!m_shutdownRequested && m_isEnabled)
+   {
+      LOGDBG << "Shutdown FederationManager";
+      m_shutdownRequested = true;
+      ConnectionManager& connectionManager = ConnectionManager::GetInstance();
+      if (m_reconnectTimer != INVALID_DESCRIPTOR)
+         connectionManager.RemoveTimer(m_reconnectTimer);
+      if (m_snapshotTimer != INVALID_DESCRIPTOR)
+         connectionManager.RemoveTimer(m_snapshotTimer);
+      if (m_listeningSocket.get())
+         connectionManager.RemoveEventSource(m_listeningSocket->GetDescriptor());
+
+      LOCK lock(m_federationAccessGuard);
+      while (!m_links.empty())
+         CloseLink(m_links.begin()->first);
+      m_remoteNodes.clear();
+      m_isEnabled = false;
+   }
+}
+
+bool FederationManager::IsEnabled() const
+{
+   return m_isEnabled;
+}
+
+void FederationManager::RelayBroadcast(const ChatLineList& lines)
+{
+   if (!m_isEnabled)
+      return;
+
+   LOCK lock(m_federationAccessGuard);
+   for (ChatLineList::const_iterator it = lines.begin(); it != lines.end(); ++it)
+      Flood(ComposeHeader("MSG") + " " + StripTerminator(*it), INVALID_DESCRIPTOR);
+}
+
+result_t FederationManager::RelayPrivateMessage(const std::string& receiver, const std::string& node,
+   const std::string& line)
+{
+   if (!m_isEnabled)
+      return result_code::eNotFound;
+
+   LOCK lock(m_federationAccessGuard);
+   for (RemoteNodeStorage::const_iterator it = m_remoteNodes.begin(); it != m_remoteNodes.end(); ++it)
+   {
+      if ((node.empty() || it->first == node) && it->second.users.count(receiver))
+      {
+         std::string frame = ComposeHeader("PRIV") + " " + receiver + " " + StripTerminator(line);
+         // send directly towards the owner, intermediate nodes will pass it further
+         LinkStorage::iterator link = m_links.find(it->second.via);
+         if (link != m_links.end())
+            SendToLink(link->second, frame);
+         else
+            Flood(frame, INVALID_DESCRIPTOR);
+         return result_code::sOk;
+      }
+   }
+
+   return result_code::eNotFound;
+}
+
+bool FederationManager::IsLocalNode(const std::string& node) const
+{
+   // node name is set once by Initialize before federation is enabled
+   return m_isEnabled && node == m_nodeName;
+}
+
+void FederationManager::OnLocalUserJoined(const std::string& username)
+{
+   if (!m_isEnabled)
+      return;
+
+   LOCK lock(m_federationAccessGuard);
+   m_localUsers.insert(username);
+   Flood(ComposeHeader("JOIN") + " " + username, INVALID_DESCRIPTOR);
+}
+
+void FederationManager::OnLocalUserLeft(const std::string& username)
+{
+   if (!m_isEnabled || username.empty())
+      return;
+
+   LOCK lock(m_federationAccessGuard);
+   if (m_localUsers.erase(username))
+      Flood(ComposeHeader("LEAVE") + " " + username, INVALID_DESCRIPTOR);
+}
+
+void FederationManager::OnLocalUserRenamed(const std::string& oldName, const std::string& newName)
+{
+   if (!m_isEnabled)
+      return;
+
+   LOCK lock(m_federationAccessGuard);
+   m_localUsers.erase(oldName);
+   m_localUsers.insert(newName);
+   Flood(ComposeHeader("NICK") + " " + oldName + " " + newName, INVALID_DESCRIPTOR);
+}
+
+bool FederationManager::IsRemoteUsername(const std::string& username)
+{
+   if (!m_isEnabled)
+      return false;
+
+   LOCK lock(m_federationAccessGuard);
+   for (RemoteNodeStorage::const_iterator it = m_remoteNodes.begin(); it != m_remoteNodes.end(); ++it)
+   {
+      if (it->second.users.count(username))
+         return true;
+   }
+   return false;
+}
+
+void FederationManager::GetRemoteUsernames(UsernameList& usernames)
+{
+   if (!m_isEnabled)
+      return;
+
+   LOCK lock(m_federationAccessGuard);
+   for (RemoteNodeStorage::const_iterator node = m_remoteNodes.begin(); node != m_remoteNodes.end(); ++node)
+   {
+      for (UsernameSet::const_iterator it = node->second.users.begin(); it != node->second.users.end(); ++it)
+         usernames.push_back(*it + RemoteNodeSeparator + node->first);
+   }
+}
+
+void FederationManager::OnSnapshotTimer()
+{
+   LOCK lock(m_federationAccessGuard);
+   Flood(ComposeLocalSnapshot(), INVALID_DESCRIPTOR);
+   ExpireRemoteNodes();
+}
+
+void FederationManager::ConnectToPeers()
+{
+   for (std::list<std::string>::const_iterator address = m_peerAddresses.begin();
+      address != m_peerAddresses.end();
+      ++address)
+   {
+      {
+         LOCK lock(m_federationAccessGuard);
+         std::map<std::string, std::string>::const_iterator knownNode = m_peerNodeByAddress.find(*address);
+         bool isLinked = false;
+         for (LinkStorage::const_iterator it = m_links.begin(); it != m_links.end() && !isLinked; ++it)
+         {
+            // either own link to this address or any established link to the node behind it
+            isLinked = (it->second->IsInitiator() && it->second->GetPeerAddress() == *address) ||
+               (knownNode != m_peerNodeByAddress.end() && it->second->GetPeerNode() == knownNode->second);
+         }
+         if (isLinked)
+            continue;
+      }
+
+      try
+      {
+         std::string ipAddress;
+         unsigned int port = 0;
+         if (!ParseAddress(*address, ipAddress, port))
+         {
+            LOGERR << "Invalid federation peer address: " << *address;
+            continue;
+         }
+
+         LOGDBG << "Open federation link to " << *address;
+         SocketWrapperPtr socket( new SocketWrapper(AF_INET, SOCK_STREAM, IPPROTO_IP) );
+         socket->SetNonblocking();
+         socket->SetSocketOption(SOL_TCP, TCP_NODELAY, 1);
+         SocketAddressHolder socketAddress(ipAddress, port);
+         bool isConnected = socket->Connect(socketAddress);
+
+         FederationLinkPtr link( new FederationLink(socket, *address, true) );
+         AddLink(link, EPOLLIN | EPOLLOUT);
+         if (isConnected)
+            OnLinkEvent(link, EPOLLOUT);
+      }
+      catch(const std::exception&)
+      {
+         helpers::ExceptionDispatcher::Dispatch(BOOST_CURRENT_FUNCTION);
+      }
+   }
+}
+
+void FederationManager::AcceptLink()
+{
+   SocketAddressHolder remoteAddress;
+   SocketDescriptor descriptor = m_listeningSocket->Accept(remoteAddress);
+   SocketWrapperPtr socket( new SocketWrapper(descriptor) );
+   socket->SetNonblocking();
+   socket->SetSocketOption(SOL_TCP, TCP_NODELAY, 1);
+
+   std::ostringstream peerAddress;
+   peerAddress << "inbound link #" << descriptor;
+   LOGDBG << "Accept federation " << peerAddress.str();
+
+   FederationLinkPtr link( new FederationLink(socket, peerAddress.str(), false) );
+   AddLink(link, EPOLLIN);
+
+   LOCK lock(m_federationAccessGuard);
+   SendToLink(link, "HELLO " + m_nodeName + " " + boost::lexical_cast<std::string>(m_epoch));
+}
+
+void FederationManager::OnLinkEvent(FederationLinkPtr link, const uint32_t events)
+{
+   SocketDescriptor socket = link->GetSocketDescriptor();
+   if (link->IsConnecting())
+   {
+      if (events & (EPOLLERR | EPOLLHUP))
+      {
+         LOGDBG << "Unable to open federation link to " << link->GetPeerAddress();
+         LOCK lock(m_federationAccessGuard);
+         CloseLink(socket);
+         return;
+      }
+
+      if (events & EPOLLOUT)
+      {
+         link->SetConnected();
+         LOCK lock(m_federationAccessGuard);
+         SendToLink(link, "HELLO " + m_nodeName + " " + boost::lexical_cast<std::string>(m_epoch));
+         UpdateLinkEvents(link);
+      }
+      return;
+   }
+
+   if (events & EPOLLOUT)
+   {
+      LOCK lock(m_federationAccessGuard);
+      if (link->FlushPendingData() != result_code::sOk)
+      {
+         CloseLink(socket);
+         return;
+      }
+      UpdateLinkEvents(link);
+   }
+
+   if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+   {
+      FrameList frames;
+      result_t error = link->ReadFrames(frames);
+      for (FrameList::const_iterator it = frames.begin(); it != frames.end(); ++it)
+         ProcessFrame(link, *it);
+
+      if (error != result_code::sOk)
+      {
+         LOGWRN << "Federation link with " << link->GetPeerAddress() << " ('" << link->GetPeerNode() << "') is closed";
+         LOCK lock(m_federationAccessGuard);
+         CloseLink(socket);
+      }
+   }
+}
+
+void FederationManager::ProcessFrame(FederationLinkPtr link, const std::string& frame)
+{
+   std::istringstream stream(frame);
+   std::string type, node;
+   boost::uint64_t epoch = 0;
+   unsigned long sequence = 0;
+   stream >> type >> node >> epoch;
+   if (type == "HELLO")
+   {
+      ProcessHello(link, node);
+      return;
+   }
+
+   stream >> sequence;
+   if (stream.fail() || link->GetPeerNode().empty())
+   {
+      LOGWRN << "Drop malformed frame from " << link->GetPeerAddress() << ": " << frame;
+      return;
+   }
+
+   UsernameList claimedNames;
+   std::string receiver, line;
+   bool isLocalReceiver = false;
+   {
+      LOCK lock(m_federationAccessGuard);
+      // own frame has made a loop and returned back
+      if (node == m_nodeName)
+         return;
+
+      RemoteNodeStorage::iterator it = m_remoteNodes.find(node);
+      if (it == m_remoteNodes.end())
+      {
+         RemoteNode newNode;
+         newNode.epoch = epoch;
+         newNode.sequence = 0;
+         newNode.via = INVALID_DESCRIPTOR;
+         it = m_remoteNodes.insert(std::make_pair(node, newNode)).first;
+      }
+
+      // frame has already been received through another link
+      RemoteNode& remoteNode = it->second;
+      if (epoch < remoteNode.epoch || (epoch == remoteNode.epoch && sequence <= remoteNode.sequence))
+         return;
+
+      // node has been restarted, everything known about it is outdated
+      if (epoch > remoteNode.epoch)
+      {
+         remoteNode.epoch = epoch;
+         remoteNode.users.clear();
+      }
+      remoteNode.sequence = sequence;
+      remoteNode.via = link->GetSocketDescriptor();
+      remoteNode.lastUpdate = boost::get_system_time();
+
+      std::string name, newName;
+      if (type == "MSG")
+      {
+         stream.get();
+         std::getline(stream, line);
+      }
+      else if (type == "PRIV")
+      {
+         stream >> receiver;
+         stream.get();
+         std::getline(stream, line);
+         isLocalReceiver = m_localUsers.count(receiver) > 0;
+      }
+      else if (type == "USERS")
+      {
+         remoteNode.users.clear();
+         while (stream >> name)
+         {
+            remoteNode.users.insert(name);
+            if (m_localUsers.count(name))
+               claimedNames.push_back(name);
+         }
+      }
+      else if (type == "JOIN")
+      {
+         stream >> name;
+         remoteNode.users.insert(name);
+         if (m_localUsers.count(name))
+            claimedNames.push_back(name);
+      }
+      else if (type == "LEAVE")
+      {
+         stream >> name;
+         remoteNode.users.erase(name);
+      }
+      else if (type == "NICK")
+      {
+         stream >> name >> newName;
+         remoteNode.users.erase(name);
+         remoteNode.users.insert(newName);
+         if (m_localUsers.count(newName))
+            claimedNames.push_back(newName);
+      }
+      else
+      {
+         LOGWRN << "Drop unknown frame from " << link->GetPeerAddress() << ": " << frame;
+         return;
+      }
+
+      if (!isLocalReceiver)
+         Flood(frame, link->GetSocketDescriptor());
+   }
+
+   if (type == "MSG")
+      DeliverBroadcast(line);
+   else if (isLocalReceiver)
+      DeliverPrivateMessage(receiver, line);
+
+   // name belongs to the node with lower name, local user has to give it up
+   if (node < m_nodeName)
+   {
+      for (UsernameList::const_iterator it = claimedNames.begin(); it != claimedNames.end(); ++it)
+         ResolveNicknameConflict(*it, node);
+   }
+}
+
+void FederationManager::ProcessHello(FederationLinkPtr link, const std::string& peerNode)
+{
+   LOCK lock(m_federationAccessGuard);
+   SocketDescriptor socket = link->GetSocketDescriptor();
+   if (!link->GetPeerNode().empty())
+      return;
+
+   if (peerNode.empty() || peerNode == m_nodeName)
+   {
+      LOGERR << "Federation link with " << link->GetPeerAddress() << " points to the node itself";
+      CloseLink(socket);
+      return;
+   }
+
+   if (link->IsInitiator())
+      m_peerNodeByAddress[link->GetPeerAddress()] = peerNode;
+
+   // both nodes might have opened links to each other - keep the one opened by the
+   // node with the lower name, so that both sides make the same choice
+   const std::string& preferredInitiator = std::min(m_nodeName, peerNode);
+   for (LinkStorage::iterator it = m_links.begin(); it != m_links.end(); ++it)
+   {
+      if (it->first == socket || it->second->GetPeerNode() != peerNode)
+         continue;
+
+      const std::string& newInitiator = link->IsInitiator() ? m_nodeName : peerNode;
+      const std::string& oldInitiator = it->second->IsInitiator() ? m_nodeName : peerNode;
+      if (newInitiator == preferredInitiator && oldInitiator != preferredInitiator)
+      {
+         LOGDBG << "Replace duplicated federation link with node '" << peerNode << "'";
+         CloseLink(it->first);
+         break;
+      }
+
+      LOGDBG << "Drop duplicated federation link with node '" << peerNode << "'";
+      CloseLink(socket);
+      return;
+   }
+
+   LOGDBG << "Federation link with " << link->GetPeerAddress() << " ('" << peerNode << "') is established";
+   link->SetPeerNode(peerNode);
+   SendSnapshots(link);
+}
+
+void FederationManager::AddLink(FederationLinkPtr link, const uint32_t events)
+{
+   SocketDescriptor socket = link->GetSocketDescriptor();
+   ConnectionManager::GetInstance().AddEventSource(socket, events,
+      boost::bind(&FederationManager::OnLinkEvent, this, link, _1));
+
+   LOCK lock(m_federationAccessGuard);
+   m_links[socket] = link;
+}
+
+void FederationManager::CloseLink(const SocketDescriptor socket)
+{
+   LinkStorage::iterator link = m_links.find(socket);
+   if (link == m_links.end())
+      return;
+
+   ConnectionManager::GetInstance().RemoveEventSource(socket);
+   link->second->Close();
+   m_links.erase(link);
+
+   // forget nodes learned through this link, they will be re-synced by snapshots
+   // through the remaining links or after reconnect
+   RemoteNodeStorage::iterator it = m_remoteNodes.begin();
+   while (it != m_remoteNodes.end())
+   {
+      if (it->second.via == socket)
+         m_remoteNodes.erase(it++);
+      else
+         ++it;
+   }
+}
+
+void FederationManager::SendToLink(FederationLinkPtr link, const std::string& frame)
+{
+   if (link->SendFrame(frame) != result_code::sOk)
+      CloseLink(link->GetSocketDescriptor());
+   else if (link->HasPendingData())
+      UpdateLinkEvents(link);
+}
+
+void FederationManager::UpdateLinkEvents(FederationLinkPtr link)
+{
+   uint32_t events = EPOLLIN;
+   if (link->IsConnecting() || link->HasPendingData())
+      events |= EPOLLOUT;
+   ConnectionManager::GetInstance().ModifyEventSource(link->GetSocketDescriptor(), events);
+}
+
+void FederationManager::Flood(const std::string& frame, const SocketDescriptor exceptSocket)
+{
+   std::list<SocketDescriptor> failedLinks;
+   for (LinkStorage::const_iterator it = m_links.begin(); it != m_links.end(); ++it)
+   {
+      if (it->first == exceptSocket || it->second->GetPeerNode().empty())
+         continue;
+
+      if (it->second->SendFrame(frame) != result_code::sOk)
+         failedLinks.push_back(it->first);
+      else if (it->second->HasPendingData())
+         UpdateLinkEvents(it->second);
+   }
+
+   for (std::list<SocketDescriptor>::const_iterator it = failedLinks.begin(); it != failedLinks.end(); ++it)
+      CloseLink(*it);
+}
+
+std::string FederationManager::ComposeHeader(const std::string& type)
+{
+   std::ostringstream header;
+   header << type << " " << m_nodeName << " " << m_epoch << " " << ++m_sequence;
+   return header.str();
+}
+
+std::string FederationManager::ComposeLocalSnapshot()
+{
+   std::string frame = ComposeHeader("USERS");
+   for (UsernameSet::const_iterator it = m_localUsers.begin(); it != m_localUsers.end(); ++it)
+      frame += " " + *it;
+   return frame;
+}
+
+void FederationManager::SendSnapshots(FederationLinkPtr link)
+{
+   SendToLink(link, ComposeLocalSnapshot());
+   for (RemoteNodeStorage::const_iterator node = m_remoteNodes.begin(); node != m_remoteNodes.end(); ++node)
+   {
+      if (node->first == link->GetPeerNode())
+         continue;
+
+      std::ostringstream frame;
+      frame << "USERS " << node->first << " " << node->second.epoch << " " << node->second.sequence;
+      for (UsernameSet::const_iterator it = node->second.users.begin(); it != node->second.users.end(); ++it)
+         frame << " " << *it;
+      SendToLink(link, frame.str());
+   }
+}
+
+void FederationManager::ExpireRemoteNodes()
+{
+   boost::system_time expirationTime = boost::get_system_time() -
+      boost::posix_time::milliseconds(NodeExpirationTimeout);
+
+   RemoteNodeStorage::iterator it = m_remoteNodes.begin();
+   while (it != m_remoteNodes.end())
+   {
+      if (it->second.lastUpdate < expirationTime)
+      {
+         LOGWRN << "Federated node '" << it->first << "' has expired";
+         m_remoteNodes.erase(it++);
+      }
+      else
+      {
+         ++it;
+      }
+   }
+}
+
+void FederationManager::ResolveNicknameConflict(const std::string& username, const std::string& ownerNode)
+{
+   ConnectionHolderPtr holder;
+   if (ConnectionManager::GetInstance().FindConnectionByUsername(username, holder) != result_code::sOk)
+      return;
+
+   holder->SetUsername();
+   std::string newName = holder->GetUsername();
+   LOGWRN << "Nickname '" << username << "' is owned by node '" << ownerNode << "', local user is renamed to '" << newName << "'";
+   OnLocalUserRenamed(username, newName);
+
+   engine::MessageDescription message;
+   message.receiver = holder;
+   message.senderSocket = holder->GetSocketDescriptor();
+   message.senderName = engine::ServerSenderName;
+   message.data = engine::ServerSenderName + "> Nickname '" + username + "' is owned by another chat node, "
+      "you are now known as '" + newName + "'" + engine::ChatTerminationSymbol;
+   engine::TaskPtr newTask( new engine::WriteAnswerTask(message) );
+   ConnectionManager::GetInstance().PostFastTask(newTask);
+}
+
+void FederationManager::DeliverBroadcast(const std::string& line)
+{
+   engine::MessageList messageList;
+   messageList.push_back(line + engine::ChatTerminationSymbol);
+
+   engine::MessageDescription message;
+   engine::FanOutScheduler::GetInstance().PostBroadcast(message, messageList);
+}
+
+void FederationManager::DeliverPrivateMessage(const std::string& receiver, const std::string& line)
+{
+   engine::MessageDescription message;
+   if (ConnectionManager::GetInstance().FindConnectionByUsername(receiver, message.receiver) != result_code::sOk)
+      return;
+
+   message.data = line + engine::ChatTerminationSymbol;
+   engine::TaskPtr newTask( new engine::WriteAnswerTask(message) );
+   ConnectionManager::GetInstance().PostFastTask(newTask);
+}
+
+} // namespace network
+} // namespace cs
@@ -0,0 +1,245 @@
+/**
+ *  \file
+ *  \brief     FederationManager class declaration
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#ifndef CS_NETWORK_FEDERATION_MANAGER_H
+#define CS_NETWORK_FEDERATION_MANAGER_H
+
+#include "federation_link.h"
+#include <common/result_code.h>
+// third-party
+#include <sys/epoll.h>
+#include <boost/noncopyable.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <string>
+#include <list>
+#include <map>
+#include <set>
+
+namespace cs
+{
+namespace network
+{
+
+/// type of container to be used for list of usernames
+typedef std::list<std::string> UsernameList;
+/// type of container to be used for list of formatted chat lines
+typedef std::list<std::string> ChatLineList;
+/// separator of the user and node names in the name of the remote user: 'name@node'
+const char RemoteNodeSeparator = '@';
+
+/**
+ *  \class     cs::network::FederationManager
+ *  \brief     Main class that links several chat servers into one logical chat
+ *  \details   Each federated server (node) keeps links with the configured peers and
+ *             accepts links from other nodes. Nodes exchange text frames over the links:
+ *              - HELLO <node> <epoch> - handshake, first frame sent by both sides
+ *              - MSG <node> <epoch> <seq> <line> - chat line broadcasted to all users
+ *              - PRIV <node> <epoch> <seq> <receiver> <line> - private chat line
+ *              - USERS <node> <epoch> <seq> [<name> ...] - snapshot of node users
+ *              - JOIN/LEAVE <node> <epoch> <seq> <name> - user connected/disconnected
+ *              - NICK <node> <epoch> <seq> <old name> <new name> - user renamed
+ *             Every frame except HELLO is flooded to all links except the one it came from.
+ *             Loops are prevented by the origin node name, its start-up epoch and sequence
+ *             number: a frame that is not newer than the last seen one from the same origin
+ *             is dropped. Each username is owned by one node. When two nodes claim the same
+ *             name concurrently the node with the lower name keeps it and the other one
+ *             renames its local user. Snapshots are re-sent periodically and remote users
+ *             of the nodes that stopped sending them are forgotten.
+ *             Links, listening socket and timers are served by the ConnectionManager event loop.
+ *             Object implemented as a singleton and can be accessed from other
+ *             parts of application.
+ */
+class FederationManager : public boost::noncopyable
+{
+public:
+   /**
+    * Method to get access to singleton object
+    * @returns - reference to current instance of FederationManager object
+    */
+   static FederationManager& GetInstance();
+
+   /**
+    * Reads federation settings, opens listening socket for inbound links. Federation stays
+    * disabled if node name is not configured.
+    */
+   void Initialize();
+
+   /**
+    * Adds listening socket and timers to the ConnectionManager event loop and opens links
+    * to the configured peers
+    */
+   void Start();
+
+   /**
+    * Shutdown procedure. Removes federation from the event loop and closes all links
+    */
+   void Shutdown();
+
+   /**
+    * Helper function to see if federation is configured
+    * @returns - true if this node is a part of federation, false otherwise
+    */
+   bool IsEnabled() const;
+
+   /**
+    * Relay chat lines posted by local users to all federated nodes
+    * @param lines - list of formatted chat lines, each terminated with ChatTerminationSymbol
+    */
+   void RelayBroadcast(const ChatLineList& lines);
+
+   /**
+    * Relay private chat line to the node that owns receiver name
+    * @param receiver - name of the remote user
+    * @param node - name of the node the user is connected to, empty string to look the user up
+    *               on all nodes
+    * @param line - formatted chat line terminated with ChatTerminationSymbol
+    * @returns - result code of the operation:
+    *             - sOk if message is relayed
+    *             - eNotFound if no remote user with the given name exists
+    */
+   result_t RelayPrivateMessage(const std::string& receiver, const std::string& node, const std::string& line);
+
+   /**
+    * Check if name is the name of this node
+    * @param node - name to be checked
+    * @returns - true if federation is enabled and name belongs to this node, false otherwise
+    */
+   bool IsLocalNode(const std::string& node) const;
+
+   /**
+    * Register new local user and notify federated nodes
+    * @param username - name of the local user
+    */
+   void OnLocalUserJoined(const std::string& username);
+
+   /**
+    * Unregister local user and notify federated nodes
+    * @param username - name of the local user
+    */
+   void OnLocalUserLeft(const std::string& username);
+
+   /**
+    * Register nickname change of the local user and notify federated nodes
+    * @param oldName - previous name of the local user
+    * @param newName - new name of the local user
+    */
+   void OnLocalUserRenamed(const std::string& oldName, const std::string& newName);
+
+   /**
+    * Check if name is owned by a user of another node
+    * @param username - name to be checked
+    * @returns - true if name belongs to remote user, false otherwise
+    */
+   bool IsRemoteUsername(const std::string& username);
+
+   /**
+    * Get names of all remote users
+    * @param usernames - output list of names in the form 'name@node'
+    */
+   void GetRemoteUsernames(UsernameList& usernames);
+
+private:
+   typedef boost::lock_guard<boost::mutex> LOCK;
+   typedef std::map<SocketDescriptor, FederationLinkPtr> LinkStorage;
+   typedef std::set<std::string> UsernameSet;
+
+   /// state of another node as seen by this node
+   struct RemoteNode
+   {
+      /// start-up time of the node, distinguishes restarted node from the previous run
+      boost::uint64_t      epoch;
+      /// sequence number of the last accepted frame
+      unsigned long        sequence;
+      /// names of the node users
+      UsernameSet          users;
+      /// link the last frame from the node has been received through
+      SocketDescriptor     via;
+      /// time when the last frame from the node has been received
+      boost::system_time   lastUpdate;
+   };
+   typedef std::map<std::string, RemoteNode> RemoteNodeStorage;
+
+   /// restrict default constructor to meet singleton pattern
+   FederationManager();
+   /// Open links to the configured peers which are not linked yet
+   void ConnectToPeers();
+   /// Send snapshot of local users to all links and forget silent nodes
+   void OnSnapshotTimer();
+   /// Accept new inbound link
+   void AcceptLink();
+   /// Handle activity on the link
+   void OnLinkEvent(FederationLinkPtr link, const uint32_t events);
+   /// Handle single frame received through the link
+   void ProcessFrame(FederationLinkPtr link, const std::string& frame);
+   /// Handle handshake frame
+   void ProcessHello(FederationLinkPtr link, const std::string& peerNode);
+   /// Add link to the epoll set and to the list of links
+   void AddLink(FederationLinkPtr link, const uint32_t events);
+   /// Remove link and forget everything learned through it. Must be called under lock
+   void CloseLink(const SocketDescriptor socket);
+   /// Send frame through the link, closes the link on failure. Must be called under lock
+   void SendToLink(FederationLinkPtr link, const std::string& frame);
+   /// Ask for writability of the link while it has pending data. Must be called under lock
+   void UpdateLinkEvents(FederationLinkPtr link);
+   /// Send frame to all established links except the given one. Must be called under lock
+   void Flood(const std::string& frame, const SocketDescriptor exceptSocket);
+   /// Compose header of the frame originated by this node. Must be called under lock
+   std::string ComposeHeader(const std::string& type);
+   /// Compose snapshot of local users. Must be called under lock
+   std::string ComposeLocalSnapshot();
+   /// Send snapshots of all known nodes through the link. Must be called under lock
+   void SendSnapshots(FederationLinkPtr link);
+   /// Forget nodes that didn't send anything for too long. Must be called under lock
+   void ExpireRemoteNodes();
+   /// Rename local user whose name was claimed by a node with higher priority
+   void ResolveNicknameConflict(const std::string& username, const std::string& ownerNode);
+   /// Deliver chat line received from another node to local users
+   void DeliverBroadcast(const std::string& line);
+   /// Deliver private chat line received from another node to local user
+   void DeliverPrivateMessage(const std::string& receiver, const std::string& line);
+
+   /// name of this node
+   std::string                         m_nodeName;
+   /// start-up time of this node, nanoseconds of the real time clock. Seconds are not enough,
+   /// frames of a node restarted within the same second would be dropped as already received
+   boost::uint64_t                     m_epoch;
+   /// sequence number of the last frame originated by this node
+   unsigned long                       m_sequence;
+   /// address where inbound links are accepted
+   std::string                         m_listenAddress;
+   /// addresses of configured peers
+   std::list<std::string>              m_peerAddresses;
+   /// names of the nodes learned during handshake with configured peers
+   std::map<std::string, std::string>  m_peerNodeByAddress;
+   /// socket where inbound links are accepted
+   SocketWrapperPtr                    m_listeningSocket;
+   /// established and pending links
+   LinkStorage                         m_links;
+   /// state of other nodes
+   RemoteNodeStorage                   m_remoteNodes;
+   /// names of local users
+   UsernameSet                         m_localUsers;
+   /// sync object to guard access to links and federation state
+   mutable boost::mutex                m_federationAccessGuard;
+   /// timer to reconnect to the configured peers
+   int                                 m_reconnectTimer;
+   /// timer to send periodic snapshots
+   int                                 m_snapshotTimer;
+   /// flag that federation is configured, checked without locking by every chat message
+   boost::atomic<bool>                 m_isEnabled;
+   /// flag that shutdown was requested
+   boost::atomic<bool>                 m_shutdownRequested;
+};
+
+} // namespace network
+} // namespace cs
+
+#endif // CS_NETWORK_FEDERATION_MANAGER_H
@@ -14,7 +14,9 @@
 #include <common/exception_dispatcher.h>
 // third-party
 #include <netdb.h>
+#include <sched.h>
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/regex.hpp>
 
 namespace
@@ -83,6 +85,9 @@ bool IsIpV4Address(const std::string& ipAddress)
    return false;
 }
 
+/// time given to complete in-flight messages on shutdown if it is not configured, milliseconds
+const int DefaultDrainTimeout = 5000;
+
 } // unnamed namespace
 
 
@@ -92,7 +97,8 @@ namespace network
 {
 
 NetworkManager::NetworkManager()
-   : m_shutdownRequested(false)
+   : m_stopRequested(false)
+   , m_shutdownRequested(false)
 {}
 
 void NetworkManager::Initialize()
@@ -136,22 +142,56 @@ void NetworkManager::Initialize()
    for (std::list<std::string>::const_iterator it = ipAddresses.begin(); it != ipAddresses.end(); ++it)
    {
       LOGDBG << "Bind to the ip address: " << (*it);
-      SocketWrapperPtr socket( new SocketWrapper(AF_INET, SOCK_STREAM, IPPROTO_IP) );
-      socket->SetSocketOption(SOL_SOCKET, SO_REUSEADDR, 1);
+      SocketWrapper socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+      socket.SetSocketOption(SOL_SOCKET, SO_REUSEADDR, 1);
       SocketAddressHolder socketAddress(*it, localPort);
-      socket->Bind(socketAddress);
-      socket->SetNonblocking();
-      socket->Listen(SocketBacklogSize);
+      socket.Bind(socketAddress);
+      socket.SetNonblocking();
+      socket.Listen(SocketBacklogSize);
       // create a holder to store the socket and mark this holder with listener flag to distinguish it from other sockets
-      ConnectionHolderPtr connectionHolder( new ConnectionHolder(socket, true) );
+      ConnectionHolderPtr connectionHolder = boost::make_shared<ConnectionHolder>(socket.Release(), true);
       connectionManager.AddConnection(connectionHolder);
    }
 }
 
-void NetworkManager::Start()
+void NetworkManager::Run()
+{
+   try
+   {
+      LOGDBG << "Starting NetworkManager event loop";
+      ConnectionManager& connectionManager = ConnectionManager::GetInstance();
+      if (connectionManager.IsBusyPollEnabled())
+      {
+         // events are polled without sleeping in epoll_wait, the core is fully loaded by the loop
+         LOGDBG << "Event loop is busy polling";
+         if (connectionManager.GetEventLoopCpu() != -1)
+            thread_pool::BindThreadToCpu(connectionManager.GetEventLoopCpu());
+
+         while (!m_stopRequested)
+         {
+            connectionManager.ProcessConnections(0);
+            // returns at once on the dedicated core, otherwise lets workers sharing it run
+            ::sched_yield();
+         }
+      }
+      else
+      {
+         // no timeout here: shutdown requests, signals and timers wake the loop up by themselves
+         while (!m_stopRequested)
+            connectionManager.ProcessConnections(-1);
+      }
+   }
+   catch(const std::exception&)
+   {
+      helpers::ExceptionDispatcher::Dispatch(BOOST_CURRENT_FUNCTION);
+   }
+   LOGDBG << "Exiting from NetworkManager event loop";
+}
+
+void NetworkManager::Stop()
 {
-   LOGDBG << "Starting NetworkManager";
-   m_listenerThread.reset( new boost::thread( boost::bind(&NetworkManager::ListeningThreadRoutine, this) ) );
+   m_stopRequested = true;
+   ConnectionManager::GetInstance().Wakeup();
 }
 
 void NetworkManager::Shutdown()
@@ -160,32 +200,23 @@ void NetworkManager::Shutdown()
    {
       LOGDBG << "Shutdown NetworkManager";
       m_shutdownRequested = true;
-      ConnectionManager::GetInstance().Shutdown();
-      if (m_listenerThread.get())
+      m_stopRequested = true;
+
+      // drain timeout, optional setting - older configuration files don't have it.
+      // Settings are read here rather than on start-up so that reloaded value is used
+      int drainTimeout = DefaultDrainTimeout;
+      result_t error = config::ConfigurationManager::GetInstance().GetOptionalSetting(config::DrainTimeout,
+         drainTimeout, DefaultDrainTimeout);
+      if (error != result_code::sOk)
       {
-      	m_listenerThread->join();
-      	m_listenerThread.reset();
+         LOGWRN << "Unable to retrieve drain timeout, use default value: " << DefaultDrainTimeout;
+         drainTimeout = DefaultDrainTimeout;
       }
-   }
-}
 
-void NetworkManager::ListeningThreadRoutine()
-{
-   try
-   {
-      LOGDBG << "Listening thread routine";
-      // Timeout below is the maximum wait time during which connection listener will be waiting for new connections.
-      // In fact it's a time interval which we have to wait before ProcessConnections returns control back to thread routine
-      static const int connectionWaitTimeout = 100;
       ConnectionManager& connectionManager = ConnectionManager::GetInstance();
-      while (!m_shutdownRequested)
-         connectionManager.ProcessConnections(connectionWaitTimeout);
-   }
-   catch(const std::exception&)
-   {
-      helpers::ExceptionDispatcher::Dispatch(BOOST_CURRENT_FUNCTION);
+      connectionManager.Drain(drainTimeout);
+      connectionManager.Shutdown();
    }
-   LOGDBG << "Exiting from listening thread routine";
 }
 
 } // namespace network
@@ -14,6 +14,7 @@
 #include <boost/smart_ptr/scoped_ptr.hpp>
 #include <boost/function.hpp>
 #include <boost/thread.hpp>
+#include <boost/atomic.hpp>
 
 namespace cs
 {
@@ -24,8 +25,8 @@ namespace network
  * \class   cs::network::NetworkManager
  * \brief   Main class responsible for network start and shutdown
  * \details Management class responsible for network components initialize/start up/tear down
- *          procedures. Validates network settings during initialization, starts
- *          listening threads
+ *          procedures. Validates network settings during initialization, runs the event
+ *          loop that handles connections and service events (signals, timers, wake-ups)
  */
 class NetworkManager : public boost::noncopyable
 {
@@ -42,24 +43,29 @@ public:
    void Initialize();
 
    /**
-    * Startup routine, launches listening thread which will be responsible for accepting
-    * new connections.
+    * Event loop routine, accepts new connections and dispatches events of the active
+    * connections and service descriptors on the calling thread. Blocking call, returns
+    * once Stop is called.
     */
-   void Start();
+   void Run();
 
    /**
-    * Shutdown procedure, performs listening thread and the whole component shutdown
+    * Request event loop to exit. Can be called from any thread, including event handlers.
+    */
+   void Stop();
+
+   /**
+    * Shutdown procedure, performs the whole component shutdown. Stops accepting new clients,
+    * lets in-flight messages be delivered within the configured drain timeout and closes the
+    * connections. Must be called after event loop has exited.
     */
    void Shutdown();
 
 private:
-   /// Routine for the thread that listens to new incoming connections
-   void ListeningThreadRoutine();
-
+   /// flag that event loop must exit
+   boost::atomic<bool>              m_stopRequested;
    /// flag that shutdown is requested and component must shutdown
    bool                             m_shutdownRequested;
-   /// wrapper for listener thread
-   boost::scoped_ptr<boost::thread> m_listenerThread;
 };
 
 } // namespace network
@@ -19,7 +19,7 @@ namespace network
 SocketWrapper::SocketWrapper(const SocketDescriptor socket)
    : m_isClosed(false)
 {
-   if (m_socket == INVALID_DESCRIPTOR)
+   if (socket == INVALID_DESCRIPTOR)
       THROW_INVALID_ARGUMENT;
 
    m_socket = socket;
@@ -66,7 +66,7 @@ void SocketWrapper::SetNonblocking()
 SocketDescriptor SocketWrapper::Accept(SocketAddressHolder& socketAddress)
 {
    sockaddr remoteAddress;
-   socklen_t length;
+   socklen_t length = sizeof(remoteAddress);
    SocketDescriptor result = ::accept(m_socket, &remoteAddress, &length);
    if (result == INVALID_DESCRIPTOR)
       THROW_NETWORK_EXCEPTION(errno) << "Unable to accept new incoming connection";
@@ -88,20 +88,44 @@ void SocketWrapper::Listen(const int backlogSize)
       THROW_NETWORK_EXCEPTION(errno) << "Unable to set socket listening";
 }
 
-ssize_t SocketWrapper::Read(void *dataBuffer, const size_t bytesCount)
-{
-	ssize_t readResult = ::read(m_socket, dataBuffer, bytesCount);
-	if (readResult > 0)
-	{
-		// force zero symbol at the end of data to get rid of possible garbage in socket
-		((char*)dataBuffer)[readResult] = 0;
-	}
-	else if (readResult == -1)
-	{
-		if (errno != EAGAIN)
-			THROW_NETWORK_EXCEPTION(errno) << "Unable to read from socket: " << m_socket;
-	}
-	return readResult;
+bool SocketWrapper::Connect(const SocketAddressHolder& address)
+{
+   int error = ::connect(m_socket, (const sockaddr*)address, address.GetSize());
+   if (error == 0)
+      return true;
+   if (errno != EINPROGRESS)
+      THROW_NETWORK_EXCEPTION(errno) << "Unable to connect socket";
+   return false;
+}
+
+result_t SocketWrapper::Read(void *dataBuffer, const size_t bytesCount, size_t& bytesRead)
+{
+   bytesRead = 0;
+   ssize_t readResult = 0;
+   do
+   {
+      readResult = ::read(m_socket, dataBuffer, bytesCount);
+   }
+   while (readResult == -1 && errno == EINTR);
+
+   if (readResult > 0)
+   {
+      // force zero symbol at the end of data to get rid of possible garbage in socket
+      ((char*)dataBuffer)[readResult] = 0;
+      bytesRead = readResult;
+      return result_code::sOk;
+   }
+   else if (readResult == 0)
+   {
+      return result_code::eConnectionClosed;
+   }
+   else if (errno == EAGAIN || errno == EWOULDBLOCK)
+   {
+      return result_code::eNotReady;
+   }
+
+   LOGDBG << "Unable to read from socket " << m_socket << ", system error message: " << strerror(errno);
+   return result_code::eFail;
 }
 
 ssize_t SocketWrapper::Write(const std::string& dataBuffer)
@@ -135,6 +159,14 @@ void SocketWrapper::Close()
    m_socket = INVALID_DESCRIPTOR;
 }
 
+SocketDescriptor SocketWrapper::Release()
+{
+   SocketDescriptor socket = m_socket;
+   m_socket = INVALID_DESCRIPTOR;
+   m_isClosed = true;
+   return socket;
+}
+
 bool SocketWrapper::IsValid() const
 {
    return !m_isClosed && (m_socket != INVALID_DESCRIPTOR);
@@ -10,6 +10,7 @@
 
 #include "socket_address_holder.h"
 #include <network/descriptor.h>
+#include <common/result_code.h>
 // third-party
 #include <boost/noncopyable.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
@@ -95,14 +96,29 @@ public:
    void Listen(const int backlogSize);
 
    /**
-    * Read data from socket. Caller must be prepared to handle an exception if read
-    * procedure failed.
-    * @param dataBuffer - pointer to the buffer where data will be written to
-    * @param bytesCount - maximum size of the dataBuffer argument in bytes
-    * @returns - number of bytes read from socket. Value -1 is returned if given
-    *            buffer size was not enough to read all available data.
+    * Start connecting wrapped socket to the remote address. If socket is in non-blocking state
+    * connection is completed asynchronously and caller should wait for the socket to become
+    * writable. Caller must be prepared to handle exception if connection procedure failed
+    * @param address - remote address the wrapped socket should be connected to
+    * @returns - true if connection is established, false if it is still in progress
     */
-   ssize_t Read(void *dataBuffer, const size_t bytesCount);
+   bool Connect(const SocketAddressHolder& address);
+
+   /**
+    * Read data from socket. Doesn't throw, as it's called for every read event and remote
+    * side is able to trigger read errors at will
+    * @param dataBuffer - pointer to the buffer where data will be written to, one byte
+    *                     after the data is set to zero
+    * @param bytesCount - maximum number of bytes to be read, must be less than the size
+    *                     of the dataBuffer argument
+    * @param bytesRead - output argument with number of bytes read from socket
+    * @returns - result code of the operation:
+    *             - sOk if some data was read
+    *             - eNotReady if there is no more data available on non-blocking socket
+    *             - eConnectionClosed if remote end closed the connection
+    *             - eFail if read procedure failed due to some system error
+    */
+   result_t Read(void *dataBuffer, const size_t bytesCount, size_t& bytesRead);
 
    /**
     * Write data to the socket.
@@ -117,6 +133,13 @@ public:
     */
    void Close();
 
+   /**
+    * Detach descriptor from the wrapper without closing it, e.g. to hand over the socket
+    * prepared by the wrapper to another owner. Wrapper becomes invalid
+    * @returns - descriptor of the wrapped socket
+    */
+   SocketDescriptor Release();
+
    /**
     * Get descriptor of the wrapped socket
     */
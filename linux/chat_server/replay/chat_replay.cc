@@ -0,0 +1,480 @@
+/**
+ *  \file
+ *  \brief     Replay of the captured client traffic
+ *  \details   Re-drives chat server with the traffic recorded by TrafficRecorder. Frames are
+ *             sent over the given number of loopback connections keeping intervals from the
+ *             capture, optionally accelerated. Captured clients are mapped to the connections
+ *             round-robin in order of their first frame. Additional observer connection never
+ *             sends anything and receives all chat lines, delivery latency of each line is
+ *             measured from the moment the line was sent. Results are printed as JSON.
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#include <benchmark/benchmark_report.h>
+#include <capture/traffic_capture.h>
+#include <core/data_processing/message_description.h>
+#include <common/exception_dispatcher.h>
+#include <logger/logger.h>
+// third-party
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace
+{
+
+using namespace cs;
+using namespace cs::benchmark;
+
+/// size of the buffer used to drain the sockets
+static const size_t ReceiveBufferSize = 65536;
+/// separator between sender name and text of the delivered chat line
+static const std::string SenderSeparator = "> ";
+
+/**
+ *  \struct    ReplayOptions
+ *  \brief     Command line options of the replay
+ */
+struct ReplayOptions
+{
+   ReplayOptions()
+      : host("127.0.0.1")
+      , port(6667)
+      , connections(10)
+      , speed(1.0)
+      , drainTimeout(2000)
+   {}
+
+   /// capture file to be replayed
+   std::string    captureFile;
+   /// address of the server
+   std::string    host;
+   /// port of the server
+   int            port;
+   /// number of connections the captured clients are mapped to
+   long           connections;
+   /// speed multiplier, 0 means frames are sent without pauses
+   double         speed;
+   /// time to wait for the delivery of the remaining lines after the last frame, milliseconds
+   long           drainTimeout;
+   /// file to write report to, standard output is used if empty
+   std::string    outputFile;
+};
+
+/**
+ *  \struct    ReplayConnection
+ *  \brief     Connection that sends captured frames
+ */
+struct ReplayConnection
+{
+   ReplayConnection()
+      : socket(-1)
+   {}
+
+   /// descriptor of the connected socket, -1 once it is closed by the server
+   int            socket;
+   /// tail of the sent data without ChatTerminationSymbol yet
+   std::string    partialLine;
+};
+
+/**
+ *  \class     ReplaySession
+ *  \brief     Sends frames of the capture and measures delivery of the chat lines
+ */
+class ReplaySession : public boost::noncopyable
+{
+public:
+   /**
+    * Constructor, opens all connections to the server
+    * @param options - replay options
+    */
+   explicit ReplaySession(const ReplayOptions& options);
+
+   /**
+    * Destructor, closes all connections
+    */
+   ~ReplaySession();
+
+   /**
+    * Replay the whole capture and wait for the delivery of the sent chat lines
+    * @param reader - reader of the capture
+    * @param report - report to add results to
+    */
+   void Run(capture::CaptureReader& reader, BenchmarkReport& report);
+
+private:
+   /// Open new connection to the server
+   int Connect() const;
+   /// Send frame over the connection the captured client is mapped to
+   void SendFrame(const capture::FrameHeader& header, const std::string& data);
+   /// Wait for incoming data until the given time and process it
+   void Poll(const boost::uint64_t deadline);
+   /// Process chat lines received by the observer
+   void OnObserverData(const std::string& data);
+
+   /// replay options
+   const ReplayOptions&                               m_options;
+   /// connections that send frames
+   std::vector<ReplayConnection>                      m_connections;
+   /// observer connection
+   int                                                m_observer;
+   /// tail of the observer data without ChatTerminationSymbol yet
+   std::string                                        m_observerData;
+   /// index of the replay connection for each captured connection
+   std::map<boost::uint32_t, size_t>                  m_connectionMap;
+   /// send times of the chat lines not delivered yet, keyed by text of the line
+   std::map<std::string, std::deque<boost::uint64_t> > m_pendingLines;
+   /// number of chat lines not delivered yet
+   size_t                                             m_pendingLineCount;
+   /// delivery latencies of the chat lines, nanoseconds
+   std::vector<boost::uint64_t>                       m_latencies;
+   /// total number of sent chat lines
+   size_t                                             m_sentLineCount;
+   /// number of connections reopened after the server closed them
+   long                                               m_reconnectCount;
+};
+
+ReplaySession::ReplaySession(const ReplayOptions& options)
+   : m_options(options)
+   , m_connections(options.connections)
+   , m_observer(-1)
+   , m_pendingLineCount(0)
+   , m_sentLineCount(0)
+   , m_reconnectCount(0)
+{
+   m_observer = Connect();
+   for (size_t i = 0; i < m_connections.size(); ++i)
+      m_connections[i].socket = Connect();
+}
+
+ReplaySession::~ReplaySession()
+{
+   for (size_t i = 0; i < m_connections.size(); ++i)
+   {
+      if (m_connections[i].socket != -1)
+         ::close(m_connections[i].socket);
+   }
+   if (m_observer != -1)
+      ::close(m_observer);
+}
+
+int ReplaySession::Connect() const
+{
+   sockaddr_in address = sockaddr_in();
+   address.sin_family = AF_INET;
+   address.sin_port = htons(static_cast<uint16_t>(m_options.port));
+   if (::inet_pton(AF_INET, m_options.host.c_str(), &address.sin_addr) != 1)
+      THROW_INVALID_ARGUMENT << "Invalid server address: " << m_options.host;
+
+   int newSocket = ::socket(AF_INET, SOCK_STREAM, 0);
+   if (newSocket == -1)
+      THROW_NETWORK_EXCEPTION(errno) << "Unable to create socket";
+   if (::connect(newSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1)
+   {
+      int error = errno;
+      ::close(newSocket);
+      THROW_NETWORK_EXCEPTION(error) << "Unable to connect to " << m_options.host << ":" << m_options.port;
+   }
+
+   // frames must leave as they were captured, without waiting for the next one
+   int flag = 1;
+   ::setsockopt(newSocket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+   return newSocket;
+}
+
+void ReplaySession::Run(capture::CaptureReader& reader, BenchmarkReport& report)
+{
+   BenchmarkResult lagResult;
+   lagResult.name = "replay.send_lag";
+   long frameCount = 0;
+   long byteCount = 0;
+
+   capture::FrameHeader header;
+   std::string data;
+   const boost::uint64_t startTime = GetMonotonicTime();
+   result_t error = result_code::sOk;
+   while ((error = reader.ReadFrame(header, data)) == result_code::sOk)
+   {
+      const boost::uint64_t scheduledTime = m_options.speed > 0
+         ? startTime + static_cast<boost::uint64_t>(header.time / m_options.speed)
+         : startTime;
+      Poll(scheduledTime);
+
+      const boost::uint64_t sendTime = GetMonotonicTime();
+      SendFrame(header, data);
+      lagResult.samples.push_back(sendTime > scheduledTime ? sendTime - scheduledTime : 0);
+      ++frameCount;
+      byteCount += data.length();
+   }
+   if (error != result_code::eNotFound)
+   {
+      LOGWRN << "Capture file is truncated, replay is stopped after " << frameCount << " frames";
+   }
+   const boost::uint64_t replayTime = GetMonotonicTime() - startTime;
+
+   // wait for the remaining lines while they keep arriving
+   const boost::uint64_t drainTimeout = static_cast<boost::uint64_t>(m_options.drainTimeout) * 1000000;
+   size_t deliveredCount = m_latencies.size();
+   while (m_pendingLineCount != 0)
+   {
+      Poll(GetMonotonicTime() + drainTimeout);
+      if (m_latencies.size() == deliveredCount)
+         break;
+      deliveredCount = m_latencies.size();
+   }
+
+   lagResult.operations = frameCount;
+   lagResult.totalTime = replayTime;
+   lagResult.AddParameter("frames", frameCount);
+   lagResult.AddParameter("bytes", byteCount);
+   lagResult.AddParameter("connections", m_options.connections);
+   lagResult.AddParameter("speed_percent", static_cast<long>(m_options.speed * 100));
+   lagResult.AddParameter("reconnects", m_reconnectCount);
+   report.AddResult(lagResult);
+
+   BenchmarkResult latencyResult;
+   latencyResult.name = "replay.delivery_latency";
+   latencyResult.operations = m_latencies.size();
+   for (size_t i = 0; i < m_latencies.size(); ++i)
+      latencyResult.totalTime += m_latencies[i];
+   latencyResult.samples.swap(m_latencies);
+   latencyResult.AddParameter("sent_lines", static_cast<long>(m_sentLineCount));
+   latencyResult.AddParameter("lost_lines", static_cast<long>(m_pendingLineCount));
+   report.AddResult(latencyResult);
+}
+
+void ReplaySession::SendFrame(const capture::FrameHeader& header, const std::string& data)
+{
+   std::map<boost::uint32_t, size_t>::iterator mapping = m_connectionMap.find(header.connectionId);
+   if (mapping == m_connectionMap.end())
+   {
+      const size_t index = m_connectionMap.size() % m_connections.size();
+      mapping = m_connectionMap.insert(std::make_pair(header.connectionId, index)).first;
+   }
+
+   ReplayConnection& connection = m_connections[mapping->second];
+   if (connection.socket == -1)
+   {
+      // captured client has quit and another one is mapped to the same connection
+      connection.socket = Connect();
+      connection.partialLine.clear();
+      ++m_reconnectCount;
+   }
+
+   // register chat lines before sending: the observer could receive them right after
+   const boost::uint64_t sendTime = GetMonotonicTime();
+   connection.partialLine += data;
+   size_t lineStart = 0;
+   size_t lineEnd = 0;
+   while ((lineEnd = connection.partialLine.find(engine::ChatTerminationSymbol, lineStart)) != std::string::npos)
+   {
+      std::string line(connection.partialLine, lineStart, lineEnd - lineStart);
+      if (!line.empty() && line[line.length() - 1] == '\r')
+         line.erase(line.length() - 1);
+      // commands are not delivered to the other users, empty lines are skipped by the server
+      if (!line.empty() && line[0] != engine::ChatServiceSymbol)
+      {
+         m_pendingLines[line].push_back(sendTime);
+         ++m_pendingLineCount;
+         ++m_sentLineCount;
+      }
+      lineStart = lineEnd + 1;
+   }
+   connection.partialLine.erase(0, lineStart);
+
+   size_t sentBytes = 0;
+   while (sentBytes < data.length())
+   {
+      ssize_t result = ::send(connection.socket, data.data() + sentBytes, data.length() - sentBytes, MSG_NOSIGNAL);
+      if (result == -1)
+      {
+         if (errno == EINTR)
+            continue;
+         LOGWRN << "Unable to send frame of captured connection " << header.connectionId << ", error: " << errno;
+         ::close(connection.socket);
+         connection.socket = -1;
+         break;
+      }
+      sentBytes += result;
+   }
+}
+
+void ReplaySession::Poll(const boost::uint64_t deadline)
+{
+   std::vector<pollfd> descriptors;
+   descriptors.reserve(m_connections.size() + 1);
+   char buffer[ReceiveBufferSize];
+   for (;;)
+   {
+      descriptors.clear();
+      pollfd observer = {m_observer, POLLIN, 0};
+      descriptors.push_back(observer);
+      for (size_t i = 0; i < m_connections.size(); ++i)
+      {
+         // closed connections are skipped by poll
+         pollfd connection = {m_connections[i].socket, POLLIN, 0};
+         descriptors.push_back(connection);
+      }
+
+      const boost::uint64_t now = GetMonotonicTime();
+      const boost::uint64_t remaining = deadline > now ? deadline - now : 0;
+      timespec timeout;
+      timeout.tv_sec = remaining / 1000000000;
+      timeout.tv_nsec = remaining % 1000000000;
+      int readyCount = ::ppoll(&descriptors[0], descriptors.size(), &timeout, 0);
+      if (readyCount == -1 && errno != EINTR)
+         THROW_NETWORK_EXCEPTION(errno) << "Unable to poll connections";
+      if (readyCount <= 0)
+         return;
+
+      for (size_t i = 0; i < descriptors.size(); ++i)
+      {
+         if (descriptors[i].revents == 0)
+            continue;
+
+         ssize_t bytesRead = ::recv(descriptors[i].fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+         if (bytesRead > 0)
+         {
+            // replay connections receive chat lines as well, they are simply dropped
+            if (i == 0)
+               OnObserverData(std::string(buffer, bytesRead));
+            continue;
+         }
+         if (bytesRead == -1 && (errno == EAGAIN || errno == EINTR))
+            continue;
+
+         if (i == 0)
+            THROW_BASIC_EXCEPTION(result_code::eConnectionClosed) << "Observer connection is closed by the server";
+         ::close(m_connections[i - 1].socket);
+         m_connections[i - 1].socket = -1;
+      }
+   }
+}
+
+void ReplaySession::OnObserverData(const std::string& data)
+{
+   const boost::uint64_t receiveTime = GetMonotonicTime();
+   m_observerData += data;
+   size_t lineStart = 0;
+   size_t lineEnd = 0;
+   while ((lineEnd = m_observerData.find(engine::ChatTerminationSymbol, lineStart)) != std::string::npos)
+   {
+      size_t textStart = m_observerData.find(SenderSeparator, lineStart);
+      if (textStart != std::string::npos && textStart < lineEnd)
+      {
+         textStart += SenderSeparator.length();
+         std::map<std::string, std::deque<boost::uint64_t> >::iterator it =
+            m_pendingLines.find(m_observerData.substr(textStart, lineEnd - textStart));
+         // lines from the server itself and from other clients don't match
+         if (it != m_pendingLines.end())
+         {
+            m_latencies.push_back(receiveTime - it->second.front());
+            --m_pendingLineCount;
+            it->second.pop_front();
+            if (it->second.empty())
+               m_pendingLines.erase(it);
+         }
+      }
+      lineStart = lineEnd + 1;
+   }
+   m_observerData.erase(0, lineStart);
+}
+
+/**
+ * Parse command line arguments
+ * @param argc - number of arguments
+ * @param argv - array with arguments
+ * @param options - output options
+ * @returns - true if replay should be executed, false otherwise
+ */
+bool ReadCommandLineArguments(const int argc, char *argv[], ReplayOptions& options)
+{
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string argument(argv[i]);
+      if (argument == "--capture" && i + 1 < argc)
+         options.captureFile = argv[++i];
+      else if (argument == "--host" && i + 1 < argc)
+         options.host = argv[++i];
+      else if (argument == "--port" && i + 1 < argc)
+         options.port = ::atoi(argv[++i]);
+      else if (argument == "--connections" && i + 1 < argc)
+         options.connections = std::max(1L, ::strtol(argv[++i], 0, 10));
+      else if (argument == "--speed" && i + 1 < argc)
+         options.speed = std::max(0.0, ::strtod(argv[++i], 0));
+      else if (argument == "--drain" && i + 1 < argc)
+         options.drainTimeout = std::max(0L, ::strtol(argv[++i], 0, 10));
+      else if (argument == "--output" && i + 1 < argc)
+         options.outputFile = argv[++i];
+      else
+      {
+         options.captureFile.clear();
+         break;
+      }
+   }
+
+   if (options.captureFile.empty())
+   {
+      LOGEMPTY << "Usage: " << argv[0] << " --capture <capture file> [--host <address>] [--port <port>]"
+         " [--connections <number>] [--speed <multiplier, 0 - no pauses>] [--drain <milliseconds>]"
+         " [--output <json file>]";
+      return false;
+   }
+   return true;
+}
+
+} // unnamed namespace
+
+/**
+ * Entry point of the replay application
+ * @param argc - number of input arguments (handled by OS)
+ * @param argv - pointer to the array with input arguments (handled by OS)
+ * @returns - application resulting code
+ */
+int main(int argc, char *argv[])
+{
+   ReplayOptions options;
+   if (!ReadCommandLineArguments(argc, argv, options))
+      return result_code::eFail;
+
+   // keep the report clean, warnings are still printed
+   SET_LOG_LEVEL(logger::Warning);
+   ::signal(SIGPIPE, SIG_IGN);
+
+   try
+   {
+      capture::CaptureReader reader(options.captureFile);
+      BenchmarkReport report;
+      {
+         ReplaySession session(options);
+         session.Run(reader, report);
+      }
+
+      if (options.outputFile.empty())
+      {
+         report.WriteJson(std::cout);
+      }
+      else
+      {
+         std::ofstream outFile(options.outputFile.c_str());
+         report.WriteJson(outFile);
+      }
+   }
+   catch(const std::exception&)
+   {
+      return helpers::ExceptionDispatcher::Dispatch(BOOST_CURRENT_FUNCTION);
+   }
+
+   return result_code::sOk;
+}
@@ -1,7 +1,12 @@
 #include "signal_manager.h"
+#include <common/exception_dispatcher.h>
 #include <logger/logger.h>
 // third-party
 #include <execinfo.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
 
 namespace cs
 {
@@ -10,11 +15,16 @@ namespace signal
 
 SignalManager::SignalManager()
    : m_shutdownRequested(false)
-   , m_managerStarted(false)
-   , m_signalWaitTimeout(0)
+   , m_signalDescriptor(-1)
 {}
 
-void SignalManager::Initialize(const long signalWaitTimeout, const SignalHandler externalHandler)
+SignalManager::~SignalManager()
+{
+   if (m_signalDescriptor != -1)
+      ::close(m_signalDescriptor);
+}
+
+void SignalManager::Initialize(const SignalHandler externalHandler)
 {
    LOGDBG << "Initializing SignalManager";
    ::sigfillset(&m_signalSet);
@@ -22,29 +32,32 @@ void SignalManager::Initialize(const long signalWaitTimeout, const SignalHandler
    ::sigdelset(&m_signalSet, SIGFPE);
    ::pthread_sigmask(SIG_BLOCK, &m_signalSet, 0);
 
+   // blocked signals stay pending until they are read from the descriptor
+   m_signalDescriptor = ::signalfd(-1, &m_signalSet, SFD_NONBLOCK | SFD_CLOEXEC);
+   if (m_signalDescriptor == -1)
+      THROW_NETWORK_EXCEPTION(errno) << "Unable to create signal descriptor";
+
    m_handler = externalHandler;
-   m_signalWaitTimeout = signalWaitTimeout;
+}
+
+int SignalManager::GetDescriptor() const
+{
+   return m_signalDescriptor;
 }
 
 void SignalManager::ProcessSignals()
 {
-   LOGDBG << "Starting SignalManager";
-   m_managerStarted = true;
-   timespec signalTimeout;
-   signalTimeout.tv_sec = 0;	// we don't need seconds here, it's a too long delay
-   signalTimeout.tv_nsec = m_signalWaitTimeout*1000000;	// convert from milisec to nanosec
-   siginfo_t signalInfo;
-
-   while(!m_shutdownRequested)
+   signalfd_siginfo signalInfo;
+   while (!m_shutdownRequested &&
+      ::read(m_signalDescriptor, &signalInfo, sizeof(signalInfo)) == sizeof(signalInfo))
    {
-      if (::sigtimedwait(&m_signalSet, &signalInfo, &signalTimeout) > 0)
-         m_handler(signalInfo.si_signo);
+      m_handler(signalInfo.ssi_signo);
    }
 }
 
 void SignalManager::Shutdown()
 {
-   if (m_managerStarted && !m_shutdownRequested)
+   if (!m_shutdownRequested)
    {
       LOGDBG << "Shutdown SignalManager";
       m_shutdownRequested = true;
@@ -17,15 +17,18 @@ class SignalManager : public boost::noncopyable
 {
 public:
    SignalManager();
-   void Initialize(const long signalWaitTimeout, const SignalHandler externalHandler);
+   ~SignalManager();
+   void Initialize(const SignalHandler externalHandler);
+   /// descriptor becomes readable when a signal is pending, to be monitored by the event loop
+   int GetDescriptor() const;
+   /// dispatch all pending signals to the handler, never blocks
    void ProcessSignals();
    void Shutdown();
 
 private:
    bool m_shutdownRequested;
-   bool m_managerStarted;
    SignalHandler m_handler;
-   long m_signalWaitTimeout;
+   int m_signalDescriptor;
    sigset_t m_signalSet;
 };
 
@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# Checks chunked broadcast around the FanOutChunkSize (256) boundary: for each number of
+# receivers a chat_server is started, receivers connect and two lines are posted by one more
+# client. Every receiver has to get both lines, the second one proves that the first broadcast
+# was completed and didn't block the next ones. Run from the directory with the chat_server binary.
+
+SERVER=${SERVER:-./chat_server}
+PORT=${PORT:-16680}
+result=0
+
+cat > fan_out_boundary.conf <<CONF
+daemon=0
+tcp_if=127.0.0.1
+tcp_port=$PORT
+loglevel=2
+fast_pool_size=4
+slow_pool_size=2
+presence_window=0
+drain_timeout=1000
+node_name=
+federation_listen=
+federation_peers=
+trace_sample_rate=0
+trace_buffer_size=65536
+trace_file=fan_out_boundary_trace.json
+overload_queue_size=10000
+overload_queue_wait=500
+busy_poll=0
+busy_poll_socket=0
+busy_poll_cpus=
+capture_file=
+coalescing_window=0
+coalescing_bytes=16384
+CONF
+
+for receivers in 254 255 256 257 300
+do
+$SERVER --config fan_out_boundary.conf > fan_out_boundary.log 2>&1 &
+pid=$!
+sleep 1
+
+rm -f fan_out_receiver*.txt
+for i in $(seq 1 $receivers)
+do
+sleep 60 | nc 127.0.0.1 $PORT > fan_out_receiver$i.txt &
+done
+
+# wait until every receiver got its greeting
+for attempt in $(seq 1 30)
+do
+connected=$(grep -l "You have just entered" fan_out_receiver*.txt | wc -l)
+[ "$connected" -eq "$receivers" ] && break
+sleep 1
+done
+(printf "first boundary line\nsecond boundary line\n"; sleep 1) | nc 127.0.0.1 $PORT > /dev/null
+sleep 1
+
+# receivers are disconnected by the server shutdown
+kill -INT $pid
+wait $pid
+kill $(jobs -p) 2>/dev/null
+wait
+
+delivered=$(grep -l "second boundary line" fan_out_receiver*.txt | xargs -r grep -l "first boundary line" | wc -l)
+if [ "$delivered" -eq "$receivers" ]
+then
+echo "OK: $receivers receivers"
+else
+echo "FAILED: $delivered of $receivers receivers got both lines"
+result=1
+fi
+done
+
+rm -f fan_out_receiver*.txt fan_out_boundary.conf
+exit $result
@@ -0,0 +1,47 @@
+#!/bin/bash
+
+# Starts three federated chat nodes on the loopback interface linked into a ring
+# (node1 -> node2 -> node3 -> node1) and checks that a line posted on node1 reaches
+# a user connected to node3, and so does a private line addressed as 'name@node' the way
+# \listall prints remote users. Run from the directory with the chat_server binary.
+
+SERVER=${SERVER:-./chat_server}
+
+for i in 1 2 3
+do
+next=$(( i % 3 + 1 ))
+cat > federation_node$i.conf <<CONF
+daemon=0
+tcp_if=127.0.0.1
+tcp_port=1667$i
+loglevel=2
+fast_pool_size=2
+slow_pool_size=2
+node_name=node$i
+federation_listen=127.0.0.1:1700$i
+federation_peers=127.0.0.1:1700$next
+CONF
+$SERVER --config federation_node$i.conf > federation_node$i.log 2>&1 &
+pids="$pids $!"
+done
+
+# give nodes time to link with each other
+sleep 3
+
+(printf "\\\\nickname receiver\n"; sleep 4) | nc 127.0.0.1 16673 > federation_result.txt &
+receiver=$!
+sleep 2
+(printf "\\\\nickname sender\nhello over federation\n\\\\private receiver@node3 secret over federation\n"; sleep 1) | nc 127.0.0.1 16671 > /dev/null
+wait $receiver
+
+kill -INT $pids
+wait
+
+if grep -q "sender> hello over federation" federation_result.txt && grep -q "sender:private>.*secret over federation" federation_result.txt
+then
+echo "OK"
+else
+echo "FAILED"
+cat federation_result.txt
+exit 1
+fi
@@ -0,0 +1,157 @@
+/**
+ *  \file
+ *  \brief     TrafficRecorder and CaptureReader classes implementation
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#include "traffic_capture.h"
+#include <common/exception_dispatcher.h>
+#include <logger/logger.h>
+// third-party
+#include <time.h>
+#include <string.h>
+
+namespace
+{
+
+/**
+ * Helper function to read monotonic clock
+ * @returns - current value of the monotonic clock in nanoseconds
+ */
+boost::uint64_t GetMonotonicTime()
+{
+   timespec now;
+   ::clock_gettime(CLOCK_MONOTONIC, &now);
+   return static_cast<boost::uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+} // unnamed namespace
+
+
+namespace cs
+{
+namespace capture
+{
+
+/////////////////////////////////////////////////////////////////
+// TrafficRecorder
+
+TrafficRecorder& TrafficRecorder::GetInstance()
+{
+   // g++ guarantees thread-safe initialization for static variable
+   static TrafficRecorder recorder;
+   return recorder;
+}
+
+TrafficRecorder::TrafficRecorder()
+   : m_startTime(0)
+   , m_isEnabled(false)
+{}
+
+TrafficRecorder::~TrafficRecorder()
+{
+   Stop();
+}
+
+result_t TrafficRecorder::Start(const std::string& fileName)
+{
+   LOCK lock(m_fileAccessGuard);
+   if (fileName == m_fileName)
+      return result_code::sOk;
+
+   if (m_isEnabled)
+   {
+      m_isEnabled = false;
+      m_file.close();
+      LOGDBG << "Traffic capture into '" << m_fileName << "' is stopped";
+   }
+   m_fileName.clear();
+
+   if (fileName.empty())
+      return result_code::sOk;
+
+   m_file.clear();
+   m_file.open(fileName.c_str(), std::fstream::out | std::fstream::binary | std::fstream::trunc);
+   m_file.write(CaptureFileSignature, sizeof(CaptureFileSignature));
+   if (!m_file.good())
+   {
+      LOGERR << "Unable to create capture file: " << fileName;
+      m_file.close();
+      return result_code::eFail;
+   }
+
+   LOGDBG << "Traffic capture into '" << fileName << "' is started";
+   m_fileName = fileName;
+   m_startTime = GetMonotonicTime();
+   m_isEnabled = true;
+   return result_code::sOk;
+}
+
+void TrafficRecorder::Stop()
+{
+   Start("");
+}
+
+bool TrafficRecorder::IsEnabled() const
+{
+   return m_isEnabled.load(boost::memory_order_relaxed);
+}
+
+void TrafficRecorder::Record(const boost::uint32_t connectionId, const std::string& data)
+{
+   FrameHeader header;
+   header.connectionId = connectionId;
+   header.length = static_cast<boost::uint32_t>(data.length());
+
+   LOCK lock(m_fileAccessGuard);
+   if (!m_isEnabled)
+      return;
+
+   // timestamp is taken under lock, so frames in the file are ordered by time
+   header.time = GetMonotonicTime() - m_startTime;
+   m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+   m_file.write(data.data(), data.length());
+   if (!m_file.good())
+   {
+      // disk is full or alike, better lose the capture than the server
+      LOGERR << "Unable to write capture file '" << m_fileName << "', capture is stopped";
+      m_isEnabled = false;
+      m_file.close();
+      m_fileName.clear();
+   }
+}
+
+/////////////////////////////////////////////////////////////////
+// CaptureReader
+
+CaptureReader::CaptureReader(const std::string& fileName)
+   : m_file(fileName.c_str(), std::fstream::in | std::fstream::binary)
+{
+   char signature[sizeof(CaptureFileSignature)] = {0};
+   m_file.read(signature, sizeof(signature));
+   if (!m_file.good())
+      THROW_BASIC_EXCEPTION(result_code::eFail) << "Unable to read capture file: " << fileName;
+   if (::memcmp(signature, CaptureFileSignature, sizeof(signature)) != 0)
+      THROW_INVALID_ARGUMENT << "Not a capture file or unsupported version: " << fileName;
+}
+
+result_t CaptureReader::ReadFrame(FrameHeader& header, std::string& data)
+{
+   m_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+   if (m_file.gcount() == 0)
+      return result_code::eNotFound;
+   if (m_file.gcount() != sizeof(header))
+      return result_code::eFail;
+
+   data.resize(header.length);
+   if (header.length != 0)
+      m_file.read(&data[0], header.length);
+   if (m_file.gcount() != static_cast<std::streamsize>(header.length))
+      return result_code::eFail;
+
+   return result_code::sOk;
+}
+
+} // namespace capture
+} // namespace cs
@@ -0,0 +1,156 @@
+/**
+ *  \file
+ *  \brief     TrafficRecorder and CaptureReader classes declaration
+ *  \details   Holds classes to record inbound client traffic into the capture file and to read
+ *             it back for replay
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#ifndef CS_CAPTURE_TRAFFIC_CAPTURE_H
+#define CS_CAPTURE_TRAFFIC_CAPTURE_H
+
+#include <common/result_code.h>
+// third-party
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <fstream>
+#include <string>
+
+namespace cs
+{
+namespace capture
+{
+
+/// signature at the beginning of the capture file, the last digits are the format version
+static const char CaptureFileSignature[8] = {'C', 'S', 'C', 'A', 'P', '0', '0', '1'};
+
+/**
+ *  \struct    cs::capture::FrameHeader
+ *  \brief     Header of the captured frame
+ *  \details   Capture file consists of the signature followed by frames. Each frame is the header
+ *             followed by the data received from the client with one read. Fields are stored
+ *             in host byte order, so capture is read on the machine of the same architecture.
+ */
+struct FrameHeader
+{
+   /// time of the frame since the capture start, nanoseconds of the monotonic clock
+   boost::uint64_t   time;
+   /// id of the connection the frame was received on, unique within the capture
+   boost::uint32_t   connectionId;
+   /// number of data bytes following the header
+   boost::uint32_t   length;
+};
+
+/**
+ *  \class     cs::capture::TrafficRecorder
+ *  \brief     Records inbound client traffic into the capture file
+ *  \details   Data of every read from client connection is written as a frame together with
+ *             connection id and timestamp, so the traffic can be replayed later with its
+ *             original timing and mix of message sizes and commands. Writes are buffered,
+ *             file is complete once the capture is stopped.
+ *             Object implemented as a singleton and can be accessed from other
+ *             parts of application.
+ */
+class TrafficRecorder : public boost::noncopyable
+{
+public:
+   /**
+    * Method to get access to singleton object
+    * @returns - reference to current instance of TrafficRecorder object
+    */
+   static TrafficRecorder& GetInstance();
+
+   /**
+    * Destructor, stops the capture
+    */
+   ~TrafficRecorder();
+
+   /**
+    * Start capture into the given file, the current capture is stopped. Nothing is done if
+    * capture into this file is in progress already
+    * @param fileName - name of the capture file, empty name just stops the current capture
+    * @returns - result code of the operation:
+    *             - sOk if capture is started or stopped as requested
+    *             - eFail if file can't be created
+    */
+   result_t Start(const std::string& fileName);
+
+   /**
+    * Stop the capture and close the file
+    */
+   void Stop();
+
+   /**
+    * Helper function to see if capture is in progress
+    * @returns - true if frames are recorded, false otherwise
+    */
+   bool IsEnabled() const;
+
+   /**
+    * Write the frame into the capture file
+    * @param connectionId - id of the connection the data was received on
+    * @param data - data received from the client
+    */
+   void Record(const boost::uint32_t connectionId, const std::string& data);
+
+private:
+   typedef boost::lock_guard<boost::mutex> LOCK;
+
+   /// restrict default constructor to meet singleton pattern
+   TrafficRecorder();
+
+   /// capture file
+   std::ofstream     m_file;
+   /// name of the capture file, empty if capture is not in progress
+   std::string       m_fileName;
+   /// time when capture is started, nanoseconds of the monotonic clock
+   boost::uint64_t   m_startTime;
+   /// flag that capture is in progress, checked without locking on each read
+   boost::atomic<bool> m_isEnabled;
+   /// sync object to guard access to the capture file
+   boost::mutex      m_fileAccessGuard;
+};
+
+/**
+ *  \class     cs::capture::CaptureReader
+ *  \brief     Reads frames from the capture file
+ */
+class CaptureReader : public boost::noncopyable
+{
+public:
+   /**
+    * Constructor, opens the capture file. Caller must be prepared to handle exception
+    * if file can't be opened or it's not a capture file
+    * @param fileName - name of the capture file
+    */
+   explicit CaptureReader(const std::string& fileName);
+
+   /**
+    * Read the next frame
+    * @param header - output argument with the header of the frame
+    * @param data - output argument with the data of the frame
+    * @returns - result code of the operation:
+    *             - sOk if frame is read
+    *             - eNotFound if there are no more frames
+    *             - eFail if the last frame is truncated
+    */
+   result_t ReadFrame(FrameHeader& header, std::string& data);
+
+private:
+   /// capture file
+   std::ifstream     m_file;
+};
+
+} // namespace capture
+} // namespace cs
+
+/**
+ *  \namespace    cs::capture
+ *  \brief        Holds classes to capture and read back inbound client traffic
+ */
+
+#endif // CS_CAPTURE_TRAFFIC_CAPTURE_H
@@ -13,8 +13,14 @@
 // third-party
 #include <boost/current_function.hpp>
 
+/// minimum log level compiled into the application, set by LOG_MIN_LEVEL CMake option.
+/// Messages below this level are removed by the compiler, no matter what log level is set in runtime
+#ifndef CS_LOG_MIN_LEVEL
+#define CS_LOG_MIN_LEVEL cs::logger::Debug
+#endif
+
 #define LOG(level) \
-   if (level < cs::logger::Log::GetLogLevel())\
+   if (level < CS_LOG_MIN_LEVEL || level < cs::logger::Log::GetLogLevel())\
       ;\
    else\
       (cs::logger::Log(level)) << cs::logger::Delimiter << BOOST_CURRENT_FUNCTION << cs::logger::Delimiter
@@ -53,8 +53,7 @@ namespace logger
 {
 
 // by default has a warning debug level
-LevelId Log::m_allowedLevel = logger::Warning;
-boost::mutex Log::m_levelAccessGuard;
+boost::atomic<LevelId> Log::m_allowedLevel(logger::Warning);
 // log level name is hardcoded and cannot be change in current implementation
 std::string Log::m_logFileName = "application.log";
 
@@ -83,16 +82,8 @@ Log::~Log()
 
 void Log::SetLogLevel(const LevelId level)
 {
-   LOCK lock(m_levelAccessGuard);
-   m_allowedLevel = level;
+   m_allowedLevel.store(level, boost::memory_order_relaxed);
 }
 
-LevelId Log::GetLogLevel()
-{
-   LOCK lock(m_levelAccessGuard);
-   return m_allowedLevel;
-}
-
-
 } // namespace logger
 } // namespace cs
@@ -13,8 +13,7 @@
 #include <sstream>
 #include <iostream>
 #include <boost/noncopyable.hpp>
-#include <boost/thread/mutex.hpp>
-#include <boost/thread/locks.hpp>
+#include <boost/atomic.hpp>
 
 namespace cs
 {
@@ -71,10 +70,14 @@ public:
    static void SetLogLevel(LevelId level);
 
    /**
-    * Static function, can be used to retrieve current log level at any point at runtime
+    * Static function, can be used to retrieve current log level at any point at runtime.
+    * Called by every LOG statement, so it's a relaxed atomic read without any locking
     * @returns level - current log level
     */
-   static LevelId GetLogLevel();
+   static LevelId GetLogLevel()
+   {
+      return m_allowedLevel.load(boost::memory_order_relaxed);
+   }
 
    /**
     * Overloaded operator, can be used to pass new log sections and concatenate them
@@ -89,12 +92,9 @@ public:
    }
 
 private:
-   typedef boost::lock_guard<boost::mutex> LOCK;
-
-   /// minimum log level that is allowed for all instances of Log class in current application
-   static LevelId       m_allowedLevel;
-   /// mutex to provide exclusive access to log level changing methods
-   static boost::mutex  m_levelAccessGuard;
+   /// minimum log level that is allowed for all instances of Log class in current application.
+   /// Nothing else is published with the level, so relaxed ordering is enough
+   static boost::atomic<LevelId> m_allowedLevel;
    /// log file name
    static std::string   m_logFileName;
    /// log level that was requested in this instance
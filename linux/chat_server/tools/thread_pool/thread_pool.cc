@@ -10,7 +10,11 @@
 #include <logger/logger.h>
 #include <common/exception_dispatcher.h>
 // third-party
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
 #include <boost/bind.hpp>
+#include <algorithm>
 
 namespace cs
 {
@@ -24,22 +28,84 @@ static int ThreadPoolId = -1;
 /// and all instances of thread pools
 static int PoolWorkerQueueId = -1;
 
+/// time given to workers to stop if shutdown deadline is not specified, seconds
+static const int DefaultShutdownTimeout = 5;
+
+/**
+ * Helper function to read monotonic clock
+ * @returns - current value of the monotonic clock in microseconds
+ */
+static boost::uint64_t GetMonotonicTime()
+{
+   timespec now;
+   ::clock_gettime(CLOCK_MONOTONIC, &now);
+   return static_cast<boost::uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+/// maximum number of pause instructions between two checks of the queue by spinning worker
+static const int MaxSpinBackoff = 64;
+
+/**
+ * Helper function to tell the processor that calling thread is spinning, lets the sibling
+ * hyper-thread run and saves power without giving up the core
+ */
+static inline void CpuRelax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+   __asm__ __volatile__("pause" ::: "memory");
+#else
+   __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+result_t BindThreadToCpu(const int cpu)
+{
+   cpu_set_t cpuSet;
+   CPU_ZERO(&cpuSet);
+   CPU_SET(cpu, &cpuSet);
+   int error = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpuSet), &cpuSet);
+   if (error != 0)
+   {
+      LOGERR << "Unable to bind thread to CPU " << cpu << ", system error message: " << strerror(error);
+      return result_code::eFail;
+   }
+   return result_code::sOk;
+}
+
 /////////////////////////////////////////////////////////////////
 // ThreadPool
 
 ThreadPool::ThreadPool(const int maxThreadCount)
-   : m_maxThreadCount(maxThreadCount)
+   : m_activeTaskCount(0)
+   , m_queuedTaskCount(0)
+   , m_waitingWorkerCount(0)
+   , m_idleSpinnerCount(0)
+   , m_spinningWorkerCount(0)
+   , m_maxThreadCount(maxThreadCount)
    , m_poolId(++ThreadPoolId)
    , m_shutdownRequested(false)
    , m_isPoolInitialized(false)
 {}
 
+void ThreadPool::SetBusyPoll(const int spinningWorkerCount, const std::vector<int>& workerCpus)
+{
+   if (m_isPoolInitialized)
+   {
+      LOGWRN << "Busy poll settings of thread pool #" << m_poolId << " are applied on start only";
+      return;
+   }
+   m_spinningWorkerCount = std::min(spinningWorkerCount, m_maxThreadCount);
+   m_workerCpus = workerCpus;
+}
+
 void ThreadPool::Initialize()
 {
    WorkerQueuePtr worker;
    for (int i = 0; i < m_maxThreadCount; ++i)
    {
-      worker.reset( new WorkerQueue(*this) );
+      const bool isSpinning = i < m_spinningWorkerCount;
+      const int cpu = (isSpinning && static_cast<size_t>(i) < m_workerCpus.size()) ? m_workerCpus[i] : -1;
+      worker.reset( new WorkerQueue(*this, isSpinning, cpu) );
       worker->Initialize();
       m_workerQueueStorage.push_back(worker);
    }
@@ -48,42 +114,107 @@ void ThreadPool::Initialize()
 }
 
 void ThreadPool::Shutdown()
+{
+   Shutdown(boost::get_system_time() + boost::posix_time::seconds(DefaultShutdownTimeout));
+}
+
+void ThreadPool::Shutdown(const boost::system_time& deadline)
 {
    if (!m_shutdownRequested && m_isPoolInitialized)
    {
       LOGDBG << "Thread pool #" << m_poolId << " started shutdown";
-      m_shutdownRequested = true;
+      std::list<QueuedTask> droppedTasks;
+      {
+         LOCK lock(m_taskAccessGuard);
+         m_shutdownRequested = true;
+         droppedTasks.swap(m_taskList);
+         m_queuedTaskCount.store(0, boost::memory_order_relaxed);
+      }
+      // tasks are destroyed out of the lock because they might release objects
+      // that post new tasks from their destructors
+      if (!droppedTasks.empty())
+      {
+         LOGWRN << "Thread pool #" << m_poolId << " drops " << droppedTasks.size() << " unprocessed tasks";
+         droppedTasks.clear();
+      }
+
+      // signal all workers first and only then wait for them, so they are stopping concurrently
+      for (WorkerQueueStorage::const_iterator it = m_workerQueueStorage.begin();
+         it != m_workerQueueStorage.end();
+         ++it)
+      {
+         (*it)->RequestShutdown();
+      }
+      m_queueEvent.notify_all();
 
       for (WorkerQueueStorage::const_iterator it = m_workerQueueStorage.begin();
          it != m_workerQueueStorage.end();
          ++it)
       {
-         // light trick to shutdown those threads which could miss single notification because
-         // there didn't enter the wait condition by the moment we called notification.
-         m_queueEvent.notify_all();
-         (*it)->Shutdown();
+         (*it)->Join(deadline);
       }
       m_isPoolInitialized = false;
    }
 }
 
+bool ThreadPool::Drain(const boost::system_time& deadline)
+{
+   LOCK lock(m_taskAccessGuard);
+   while (!m_taskList.empty() || m_activeTaskCount != 0)
+   {
+      if (!m_idleEvent.timed_wait(lock, deadline))
+         return m_taskList.empty() && m_activeTaskCount == 0;
+   }
+   return true;
+}
+
+bool ThreadPool::IsIdle()
+{
+   LOCK lock(m_taskAccessGuard);
+   return m_taskList.empty() && m_activeTaskCount == 0;
+}
+
+size_t ThreadPool::GetQueueSize()
+{
+   LOCK lock(m_taskAccessGuard);
+   return m_taskList.size();
+}
+
+int ThreadPool::GetQueueWait()
+{
+   LOCK lock(m_taskAccessGuard);
+   if (m_taskList.empty())
+      return 0;
+
+   return static_cast<int>((GetMonotonicTime() - m_taskList.front().queuedTime) / 1000);
+}
+
 void ThreadPool::AddTask(ThreadTask task)
 {
    if (!m_isPoolInitialized)
       THROW_BASIC_EXCEPTION(result_code::eNotReady) << "Component is not initialized!";
 
-   if (m_shutdownRequested)
-   {
-      LOGWRN << "Unable to handle incoming task during system shutdown";
-      return;
-   }
-
    {
+      // flag is checked under lock so that no task is queued after shutdown has dropped the queue
       LOCK lock(m_taskAccessGuard);
-      m_taskList.push_back(task);
+      if (m_shutdownRequested)
+      {
+         LOGWRN << "Unable to handle incoming task during system shutdown";
+         return;
+      }
+      QueuedTask queuedTask;
+      queuedTask.task = task;
+      queuedTask.queuedTime = GetMonotonicTime();
+      m_taskList.push_back(queuedTask);
+      m_queuedTaskCount.store(m_taskList.size(), boost::memory_order_relaxed);
+
+      // idle spinning workers pick the tasks up by themselves, sleeping worker is woken up
+      // only if there are more tasks than spinners
+      if (m_waitingWorkerCount == 0 || static_cast<size_t>(m_idleSpinnerCount.load()) >= m_taskList.size())
+         return;
    }
 
-   m_queueEvent.notify_all();
+   m_queueEvent.notify_one();
 }
 
 int ThreadPool::GetPoolId() const
@@ -104,27 +235,72 @@ result_t ThreadPool::TryGetNewTask(WorkerQueue* caller, ThreadTask& newTask)
       if (!m_isPoolInitialized)
          caller->NotifyWorkerStarted();
 
-      m_queueEvent.wait(lock);
-
+      // flag is checked before waiting as well: shutdown notification is sent only once
+      // and worker that is not waiting by that moment would miss it
       if (m_shutdownRequested)
          return result_code::eNotFound;
+
+      // spinning starts once the pool is initialized, so that the startup barrier is not missed
+      if (caller->IsSpinning() && m_isPoolInitialized)
+      {
+         lock.unlock();
+         SpinForTask();
+         lock.lock();
+         continue;
+      }
+
+      ++m_waitingWorkerCount;
+      m_queueEvent.wait(lock);
+      --m_waitingWorkerCount;
    }
 
-   newTask = m_taskList.front();
+   newTask = m_taskList.front().task;
    m_taskList.pop_front();
+   m_queuedTaskCount.store(m_taskList.size(), boost::memory_order_relaxed);
+   ++m_activeTaskCount;
    return result_code::sOk;
 }
 
+void ThreadPool::CompleteTask()
+{
+   LOCK lock(m_taskAccessGuard);
+   --m_activeTaskCount;
+   if (m_activeTaskCount == 0 && m_taskList.empty())
+      m_idleEvent.notify_all();
+}
+
+void ThreadPool::SpinForTask()
+{
+   ++m_idleSpinnerCount;
+   // back off exponentially, but not too much: the pause between checks bounds the latency.
+   // Once backoff is at maximum the core is offered to other threads on each round, this costs
+   // nothing on the dedicated core and keeps the server alive if cores are oversubscribed
+   int backoff = 1;
+   while (m_queuedTaskCount.load(boost::memory_order_relaxed) == 0 && !m_shutdownRequested.load(boost::memory_order_relaxed))
+   {
+      for (int i = 0; i < backoff; ++i)
+         CpuRelax();
+
+      if (backoff < MaxSpinBackoff)
+         backoff *= 2;
+      else
+         ::sched_yield();
+   }
+   --m_idleSpinnerCount;
+}
+
 /////////////////////////////////////////////////////////////////
 // WorkerQueue
 
-ThreadPool::WorkerQueue::WorkerQueue(ThreadPool& parentPool)
+ThreadPool::WorkerQueue::WorkerQueue(ThreadPool& parentPool, const bool isSpinning, const int cpu)
    : m_parentPool(parentPool)
    // magic number means 2 threads: worker thread and the caller
    // who will invoke WorkerQueue::Initialize
    , m_threadBarrierSync(2)
    , m_shutdownRequested(false)
    , m_queueId(++PoolWorkerQueueId)
+   , m_isSpinning(isSpinning)
+   , m_cpu(cpu)
 {}
 
 void ThreadPool::WorkerQueue::Initialize()
@@ -144,16 +320,24 @@ void ThreadPool::WorkerQueue::NotifyWorkerStarted()
    m_threadBarrierSync.wait();
 }
 
-void ThreadPool::WorkerQueue::Shutdown()
+bool ThreadPool::WorkerQueue::IsSpinning() const
+{
+   return m_isSpinning;
+}
+
+void ThreadPool::WorkerQueue::RequestShutdown()
 {
    m_shutdownRequested = true;
-   if (m_workerThread->timed_join(boost::posix_time::seconds(5)) == false)
+}
+
+void ThreadPool::WorkerQueue::Join(const boost::system_time& deadline)
+{
+   if (m_workerThread->timed_join(deadline) == false)
    {
       // TODO: current implementation implies that Pool is stopped at the very end of
       // application. So just detach thread and exit - scheduler will kill zombie thread himself.
-      // Probably need to consider another mechanism for graceful shutdown
       LOGERR << "Unable to stop worker thread #" << m_queueId
-             << " of pool #" << m_parentPool.GetPoolId() << ", force detach";
+             << " of pool #" << m_parentPool.GetPoolId() << " by deadline, force detach";
       m_workerThread->detach();
    }
    LOGDBG << "Worker #" << m_queueId
@@ -162,6 +346,9 @@ void ThreadPool::WorkerQueue::Shutdown()
 
 void ThreadPool::WorkerQueue::ProcessTasks()
 {
+   if (m_cpu != -1)
+      BindThreadToCpu(m_cpu);
+
    ThreadTask task;
    while (!m_shutdownRequested)
    {
@@ -173,8 +360,10 @@ void ThreadPool::WorkerQueue::ProcessTasks()
       task();
 
       // Task ptr itself lives in outer scope, thus need to reset the
-      // last item from localQueue manually
+      // last item from localQueue manually. Task is reported as completed only after
+      // that, because objects it holds might post new tasks from their destructors
       task.clear();
+      m_parentPool.CompleteTask();
    }
 }
 
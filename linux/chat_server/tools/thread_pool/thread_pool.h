@@ -13,10 +13,15 @@
 #include <boost/function.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/barrier.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
 #include <boost/smart_ptr/scoped_ptr.hpp>
+#include <boost/atomic.hpp>
+#include <vector>
 
 namespace cs
 {
@@ -26,6 +31,15 @@ namespace thread_pool
 /// type of the atomic task that ThreadPool is capable handling of
 typedef boost::function<void()> ThreadTask;
 
+/**
+ * Bind calling thread to the given CPU core
+ * @param cpu - index of the core
+ * @returns - result code of the operation:
+ *             - sOk if thread is bound to the core
+ *             - eFail if system refused to bind the thread (e.g. core doesn't exist)
+ */
+result_t BindThreadToCpu(const int cpu);
+
 /**
  *  \class     cs::thread_pool::ThreadPool
  *  \brief     Simple implementation of thread pool
@@ -51,11 +65,56 @@ public:
    void Initialize();
 
    /**
-    * Execute thread pool shutdown routine. Shut down each worker one by one and emit flag
-    * that thread is not initialized anymore
+    * Make some workers poll the queue instead of sleeping, so that new task is picked up without
+    * the wake-up latency. Spinning worker occupies its core all the time, so it better be bound
+    * to the dedicated one. Must be called before Initialize, ignored afterwards
+    * @param spinningWorkerCount - number of workers that spin, the rest sleep as usual
+    * @param workerCpus - cores the spinning workers are bound to in order of their creation,
+    *                     workers beyond the list are not bound
+    */
+   void SetBusyPoll(const int spinningWorkerCount, const std::vector<int>& workerCpus);
+
+   /**
+    * Execute thread pool shutdown routine with the default deadline. See Shutdown(deadline)
     */
    void Shutdown();
 
+   /**
+    * Execute thread pool shutdown routine. Drops unprocessed tasks, requests shutdown of all
+    * workers at once and then waits for them until the common deadline, so the time of the
+    * whole routine doesn't depend on the number of workers. Workers that didn't stop by the
+    * deadline are detached. Emits flag that pool is not initialized anymore
+    * @param deadline - absolute time when waiting for workers is over
+    */
+   void Shutdown(const boost::system_time& deadline);
+
+   /**
+    * Wait until all queued tasks are processed, including the tasks added while waiting.
+    * Pool keeps accepting new tasks during the drain.
+    * @param deadline - absolute time when waiting is over
+    * @returns - true if pool has become idle, false if deadline expired first
+    */
+   bool Drain(const boost::system_time& deadline);
+
+   /**
+    * Helper function to see if pool has nothing to do
+    * @returns - true if task queue is empty and no task is being executed, false otherwise
+    */
+   bool IsIdle();
+
+   /**
+    * Get number of tasks waiting for a free worker
+    * @returns - size of the task queue
+    */
+   size_t GetQueueSize();
+
+   /**
+    * Get time the oldest queued task has been waiting for a free worker. Unlike the average
+    * waiting time it keeps growing while all workers are busy
+    * @returns - waiting time in milliseconds, 0 if queue is empty
+    */
+   int GetQueueWait();
+
    /**
     * Main method to add new tasks to the thread.
     * @param task - functor with zero input parameters that will be stored in a pool queue
@@ -77,11 +136,24 @@ private:
    typedef boost::shared_ptr<WorkerQueue> WorkerQueuePtr;
    typedef std::list<WorkerQueuePtr> WorkerQueueStorage;
 
+   /// task waiting in the queue
+   struct QueuedTask
+   {
+      /// functor to be executed
+      ThreadTask        task;
+      /// time when task is added to the queue, microseconds of the monotonic clock
+      boost::uint64_t   queuedTime;
+   };
+
    /// private method available for worker thread to captrue new task to process
    result_t TryGetNewTask(WorkerQueue* caller, ThreadTask& newTask);
+   /// private method available for worker thread to report that captured task is executed
+   void CompleteTask();
+   /// private method available for spinning worker thread to wait for new task without sleeping
+   void SpinForTask();
 
    /// list of unprocessed tasks in this pool
-   std::list<ThreadTask>      m_taskList;
+   std::list<QueuedTask>      m_taskList;
    /// container which holds all workers
    WorkerQueueStorage         m_workerQueueStorage;
    /// mutex needed to guard access to list with unprocessed tasks. Includes sync of
@@ -89,13 +161,27 @@ private:
    boost::mutex               m_taskAccessGuard;
    /// event to notify workers about new tasks or thread pool shutdown
    boost::condition_variable  m_queueEvent;
+   /// event to notify drain routine that pool has become idle
+   boost::condition_variable  m_idleEvent;
+   /// number of tasks being executed by workers at the moment
+   int                        m_activeTaskCount;
+   /// copy of the task list size, polled by spinning workers without locking
+   boost::atomic<size_t>      m_queuedTaskCount;
+   /// number of workers sleeping on the queue event
+   int                        m_waitingWorkerCount;
+   /// number of spinning workers polling the queue at the moment
+   boost::atomic<int>         m_idleSpinnerCount;
+   /// number of workers that spin instead of sleeping
+   int                        m_spinningWorkerCount;
+   /// cores the spinning workers are bound to
+   std::vector<int>           m_workerCpus;
 
    /// maximum number of threads per thread pool
    const int                  m_maxThreadCount;
    /// helper id of the pool which could help in debugging if applications uses several pools
    int                        m_poolId;
-   /// flag that shutdown was requested
-   bool                       m_shutdownRequested;
+   /// flag that shutdown was requested, polled by spinning workers without locking
+   boost::atomic<bool>        m_shutdownRequested;
    /// flag that pool is initialized
    bool                       m_isPoolInitialized;
 
@@ -106,14 +192,19 @@ private:
    class WorkerQueue
    {
    public:
-      /// Constructor which requires a reference to a parent ThreadPool object
-      WorkerQueue(ThreadPool& parentPool);
+      /// Constructor which requires a reference to a parent ThreadPool object, flag that
+      /// worker spins instead of sleeping and core to bind the worker to (-1 if not bound)
+      WorkerQueue(ThreadPool& parentPool, const bool isSpinning, const int cpu);
       /// Initialize current worker queue
       void Initialize();
-      /// Request shutdown for current worker queue
-      void Shutdown();
+      /// Request shutdown for current worker queue, doesn't wait for the worker thread
+      void RequestShutdown();
+      /// Wait for the worker thread until deadline, detach it if deadline expired
+      void Join(const boost::system_time& deadline);
       /// public method that will be invoked by
       void NotifyWorkerStarted();
+      /// Helper function to see if worker spins instead of sleeping
+      bool IsSpinning() const;
       /// Worker thread routine which grabs new tasks and exectues them
       void ProcessTasks();
 
@@ -127,6 +218,10 @@ private:
       bool                                m_shutdownRequested;
       /// helper variable to track queue number during startup and shutdown
       int                                 m_queueId;
+      /// flag that worker spins instead of sleeping
+      const bool                          m_isSpinning;
+      /// core the worker is bound to, -1 if not bound
+      const int                           m_cpu;
       /// wrapper upon the worker thread
       boost::scoped_ptr<boost::thread>    m_workerThread;
    };
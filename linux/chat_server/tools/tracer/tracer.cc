@@ -0,0 +1,205 @@
+/**
+ *  \file
+ *  \brief     Tracer class implementation
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#include "tracer.h"
+// third-party
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <fstream>
+#include <iomanip>
+
+namespace
+{
+
+/**
+ * Helper function to get id of the calling thread as it is shown by the system tools
+ * @returns - id of the current thread
+ */
+pid_t GetThreadId()
+{
+   return static_cast<pid_t>(::syscall(SYS_gettid));
+}
+
+} // unnamed namespace
+
+
+namespace cs
+{
+namespace tracer
+{
+
+boost::uint64_t GetTraceTime()
+{
+   timespec now;
+   ::clock_gettime(CLOCK_MONOTONIC, &now);
+   return static_cast<boost::uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+/////////////////////////////////////////////////////////////////
+// TraceContext
+
+TraceContext::TraceContext(const boost::uint64_t traceId)
+   : m_traceId(traceId)
+{}
+
+boost::uint64_t TraceContext::GetTraceId() const
+{
+   return m_traceId;
+}
+
+/////////////////////////////////////////////////////////////////
+// StageTrace
+
+StageTrace::StageTrace(const char* queueName, const char* stageName)
+   : m_queueName(queueName)
+   , m_stageName(stageName)
+   , m_queuedTime(0)
+{}
+
+void StageTrace::Queued(const TraceContextPtr& context)
+{
+   m_context = context;
+   if (m_context.get())
+      m_queuedTime = GetTraceTime();
+}
+
+const TraceContextPtr& StageTrace::GetContext() const
+{
+   return m_context;
+}
+
+/////////////////////////////////////////////////////////////////
+// StageScope
+
+StageScope::StageScope(const StageTrace& stage)
+   : m_stage(stage)
+   , m_startTime(0)
+{
+   if (m_stage.m_context.get())
+   {
+      m_startTime = GetTraceTime();
+      Tracer::GetInstance().AddSpan(*m_stage.m_context, m_stage.m_queueName, m_stage.m_queuedTime, m_startTime);
+   }
+}
+
+StageScope::~StageScope()
+{
+   if (m_stage.m_context.get())
+      Tracer::GetInstance().AddSpan(*m_stage.m_context, m_stage.m_stageName, m_startTime, GetTraceTime());
+}
+
+/////////////////////////////////////////////////////////////////
+// Tracer
+
+Tracer& Tracer::GetInstance()
+{
+   // g++ guarantees thread-safe initialization for static variable
+   static Tracer tracer;
+   return tracer;
+}
+
+Tracer::Tracer()
+   : m_nextSpan(0)
+   , m_isBufferWrapped(false)
+   , m_sampleRate(0)
+   , m_messageCounter(0)
+   , m_traceCounter(0)
+{}
+
+void Tracer::Configure(const int sampleRate, const size_t bufferSize)
+{
+   LOCK lock(m_spansAccessGuard);
+   // buffer is not allocated until tracing is enabled, and the spans collected already
+   // are kept when it is disabled, so they can still be dumped
+   if (sampleRate > 0 && bufferSize != m_spans.size())
+   {
+      std::vector<Span>(bufferSize).swap(m_spans);
+      m_nextSpan = 0;
+      m_isBufferWrapped = false;
+   }
+   m_sampleRate.store(m_spans.empty() ? 0 : sampleRate, boost::memory_order_relaxed);
+}
+
+bool Tracer::IsEnabled() const
+{
+   return m_sampleRate.load(boost::memory_order_relaxed) > 0;
+}
+
+TraceContextPtr Tracer::StartTrace()
+{
+   const int sampleRate = m_sampleRate.load(boost::memory_order_relaxed);
+   if (sampleRate <= 0 || (++m_messageCounter) % sampleRate != 0)
+      return TraceContextPtr();
+
+   return TraceContextPtr( new TraceContext(++m_traceCounter) );
+}
+
+void Tracer::AddSpan(const TraceContext& context, const char* name,
+   const boost::uint64_t startTime, const boost::uint64_t endTime)
+{
+   Span span;
+   span.traceId = context.GetTraceId();
+   span.name = name;
+   span.threadId = GetThreadId();
+   span.startTime = startTime;
+   span.endTime = endTime;
+
+   LOCK lock(m_spansAccessGuard);
+   if (m_spans.empty())
+      return;
+
+   m_spans[m_nextSpan] = span;
+   if (++m_nextSpan == m_spans.size())
+   {
+      m_nextSpan = 0;
+      m_isBufferWrapped = true;
+   }
+}
+
+void Tracer::WriteChromeTrace(std::ostream& out)
+{
+   // copy the buffer, so that tracing threads are not blocked while it is printed
+   std::vector<Span> spans;
+   {
+      LOCK lock(m_spansAccessGuard);
+      if (m_isBufferWrapped)
+         spans.assign(m_spans.begin() + m_nextSpan, m_spans.end());
+      spans.insert(spans.end(), m_spans.begin(), m_spans.begin() + m_nextSpan);
+   }
+
+   // each span is a pair of async events with id of the message: viewer shows all spans of the
+   // message on one track, thread that recorded the span is shown in the event details
+   const pid_t processId = ::getpid();
+   out << std::fixed << std::setprecision(3);
+   out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+   for (std::vector<Span>::const_iterator it = spans.begin(); it != spans.end(); ++it)
+   {
+      out << (it == spans.begin() ? "\n" : ",\n")
+          << "{\"name\": \"" << it->name << "\", \"cat\": \"message\", \"ph\": \"b\", \"id\": " << it->traceId
+          << ", \"pid\": " << processId << ", \"tid\": " << it->threadId
+          << ", \"ts\": " << it->startTime / 1000.0 << ", \"args\": {\"message\": " << it->traceId << "}},\n"
+          << "{\"name\": \"" << it->name << "\", \"cat\": \"message\", \"ph\": \"e\", \"id\": " << it->traceId
+          << ", \"pid\": " << processId << ", \"tid\": " << it->threadId
+          << ", \"ts\": " << it->endTime / 1000.0 << "}";
+   }
+   out << "\n]}\n";
+}
+
+result_t Tracer::Dump(const std::string& fileName)
+{
+   std::ofstream outFile(fileName.c_str(), std::fstream::out);
+   if (!outFile.good())
+      return result_code::eFail;
+
+   WriteChromeTrace(outFile);
+   outFile.close();
+   return outFile.good() ? result_code::sOk : result_code::eFail;
+}
+
+} // namespace tracer
+} // namespace cs
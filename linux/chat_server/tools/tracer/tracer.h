@@ -0,0 +1,247 @@
+/**
+ *  \file
+ *  \brief     Tracer class declaration
+ *  \details   Holds classes to trace the way of sampled messages through the thread pools
+ *  \author    Dmitry Sinelnikov
+ *  \date      2012
+ */
+
+#ifndef CS_TRACER_H
+#define CS_TRACER_H
+
+#include <common/result_code.h>
+// third-party
+#include <sys/types.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/atomic.hpp>
+#include <boost/detail/atomic_count.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cs
+{
+namespace tracer
+{
+
+/**
+ * Read the clock used for trace timestamps
+ * @returns - current value of the monotonic clock in nanoseconds
+ */
+boost::uint64_t GetTraceTime();
+
+/**
+ *  \class     cs::tracer::TraceContext
+ *  \brief     Identity of the sampled message
+ *  \details   Context is created for the sampled messages only and is shared by all the tasks
+ *             that handle the message or its answers, so their spans are grouped together.
+ */
+class TraceContext : public boost::noncopyable
+{
+public:
+   /**
+    * Constructor
+    * @param traceId - unique id of the trace
+    */
+   explicit TraceContext(const boost::uint64_t traceId);
+
+   /**
+    * Get id of the trace
+    * @returns - unique id of the trace
+    */
+   boost::uint64_t GetTraceId() const;
+
+private:
+   /// unique id of the trace
+   const boost::uint64_t   m_traceId;
+};
+
+/// type of the context carried by the message, empty if message is not sampled
+typedef boost::shared_ptr<TraceContext> TraceContextPtr;
+
+/**
+ *  \class     cs::tracer::StageTrace
+ *  \brief     Traces one stage of the message processing
+ *  \details   Stage consists of waiting in the thread pool queue and execution of the task. Object
+ *             is held by the task: it is marked as queued when the task is created and the span
+ *             of each part is recorded by StageScope in the task Execute method. Nothing is
+ *             recorded if the message is not sampled.
+ */
+class StageTrace
+{
+public:
+   /**
+    * Constructor. Names are stored as pointers, so they must be string literals
+    * @param queueName - name of the span of waiting in the queue
+    * @param stageName - name of the span of execution
+    */
+   StageTrace(const char* queueName, const char* stageName);
+
+   /**
+    * Start tracing of the stage, must be called right before the task is posted to the pool
+    * @param context - context of the message, tracing is skipped if it is empty
+    */
+   void Queued(const TraceContextPtr& context);
+
+   /**
+    * Get context of the traced message
+    * @returns - context of the message, empty if message is not sampled
+    */
+   const TraceContextPtr& GetContext() const;
+
+private:
+   friend class StageScope;
+
+   /// name of the span of waiting in the queue
+   const char*       m_queueName;
+   /// name of the span of execution
+   const char*       m_stageName;
+   /// context of the message
+   TraceContextPtr   m_context;
+   /// time when the task is posted to the pool
+   boost::uint64_t   m_queuedTime;
+};
+
+/**
+ *  \class     cs::tracer::StageScope
+ *  \brief     Records spans of the stage
+ *  \details   Constructor records the span of waiting in the queue, destructor records the span
+ *             of execution. Object is expected to be created on the stack at the beginning of
+ *             the task Execute method.
+ */
+class StageScope : public boost::noncopyable
+{
+public:
+   /**
+    * Constructor, records the span of waiting in the queue
+    * @param stage - traced stage
+    */
+   explicit StageScope(const StageTrace& stage);
+
+   /**
+    * Destructor, records the span of execution
+    */
+   ~StageScope();
+
+private:
+   /// traced stage
+   const StageTrace&    m_stage;
+   /// time when execution is started
+   boost::uint64_t      m_startTime;
+};
+
+/**
+ *  \class     cs::tracer::Tracer
+ *  \brief     Samples messages and collects spans of their processing
+ *  \details   Every N-th message gets a trace context, all other messages are not traced at all.
+ *             Spans are kept in the ring buffer of the fixed size, so only the latest ones are
+ *             available. Buffer is written in Chrome trace event format, so the capture can be
+ *             opened in chrome://tracing or any other trace viewer that supports it: spans of each
+ *             message are shown on its own track.
+ *             Object implemented as a singleton and can be accessed from other
+ *             parts of application.
+ */
+class Tracer : public boost::noncopyable
+{
+public:
+   /**
+    * Method to get access to singleton object
+    * @returns - reference to current instance of Tracer object
+    */
+   static Tracer& GetInstance();
+
+   /**
+    * Apply tracing settings. Collected spans are dropped if tracing is enabled with
+    * another buffer size
+    * @param sampleRate - one of sampleRate messages is traced, 0 disables tracing
+    * @param bufferSize - maximum number of spans kept in the buffer
+    */
+   void Configure(const int sampleRate, const size_t bufferSize);
+
+   /**
+    * Helper function to see if tracing is enabled
+    * @returns - true if messages are sampled, false otherwise
+    */
+   bool IsEnabled() const;
+
+   /**
+    * Decide if new message has to be traced
+    * @returns - context of the new trace if message is sampled, empty pointer otherwise
+    */
+   TraceContextPtr StartTrace();
+
+   /**
+    * Store span in the buffer, overwrites the oldest span if buffer is full
+    * @param context - context of the traced message
+    * @param name - name of the span, must be a string literal
+    * @param startTime - time when the span is started, nanoseconds
+    * @param endTime - time when the span is finished, nanoseconds
+    */
+   void AddSpan(const TraceContext& context, const char* name,
+      const boost::uint64_t startTime, const boost::uint64_t endTime);
+
+   /**
+    * Print spans from the buffer in Chrome trace event JSON format
+    * @param out - output stream
+    */
+   void WriteChromeTrace(std::ostream& out);
+
+   /**
+    * Print spans from the buffer to the file in Chrome trace event JSON format
+    * @param fileName - name of the output file
+    * @returns - result code of the operation:
+    *             - sOk if file is written
+    *             - eFail if file can't be created
+    */
+   result_t Dump(const std::string& fileName);
+
+private:
+   typedef boost::lock_guard<boost::mutex> LOCK;
+
+   /// single span of the message processing
+   struct Span
+   {
+      /// id of the traced message
+      boost::uint64_t   traceId;
+      /// name of the span
+      const char*       name;
+      /// id of the thread that recorded the span
+      pid_t             threadId;
+      /// time when the span is started, nanoseconds
+      boost::uint64_t   startTime;
+      /// time when the span is finished, nanoseconds
+      boost::uint64_t   endTime;
+   };
+
+   /// restrict default constructor to meet singleton pattern
+   Tracer();
+
+   /// ring buffer of spans
+   std::vector<Span>             m_spans;
+   /// position of the next span in the ring buffer
+   size_t                        m_nextSpan;
+   /// flag that ring buffer has been wrapped around
+   bool                          m_isBufferWrapped;
+   /// sync object to guard access to the ring buffer
+   boost::mutex                  m_spansAccessGuard;
+   /// one of m_sampleRate messages is traced, 0 disables tracing
+   boost::atomic<int>            m_sampleRate;
+   /// number of messages seen by StartTrace, used for sampling
+   boost::detail::atomic_count   m_messageCounter;
+   /// id of the last started trace
+   boost::detail::atomic_count   m_traceCounter;
+};
+
+} // namespace tracer
+} // namespace cs
+
+/**
+ *  \namespace    cs::tracer
+ *  \brief        Holds classes of sampled message tracing
+ */
+
+#endif // CS_TRACER_H
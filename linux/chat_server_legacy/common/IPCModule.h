@@ -8,6 +8,7 @@
 #include <boost/interprocess/ipc/message_queue.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 #include <list>
 
 //////////////////////////////////////////////////////////////////////////
@@ -26,7 +27,7 @@ namespace IPC
 		CIPCModule();
 		CIPCModule(const CIPCModule& src);
 		CIPCModule& operator= (const CIPCModule& src);
-		~CIPCModule(){;}
+		~CIPCModule();
 
 	public: // methods
 		static CIPCModule& Instance();
@@ -44,12 +45,17 @@ namespace IPC
 		boost::shared_ptr<CThreadPoolModule> m_spThreadModule;
 		std::string m_strNetworkInterface;
 		int m_iPort;
-		int m_iPipeFDs[2];
+		int m_iInstanceFD;
+		int m_iEventFD;
+		spCBaseSocket m_spListenSocket;
 		std::list<int> m_listPendingSock;
+		boost::mutex m_pendingAccess;
 
 	private: //methods
 		void SharedQueueReader();
 		void NotifySelector(int iNewDescriptor);
+		void RegisterPendingDescriptors(int epollFD);
+		void AcceptConnections(int epollFD);
 	};
 
 	//////////////////////////////////////////////////////////////////////
@@ -8,11 +8,16 @@
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
+#include <boost/thread/locks.hpp>
 #include <boost/foreach.hpp>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <netdb.h>
 #include <arpa/inet.h>
+#include <stddef.h>
+#include <algorithm>
 
 namespace IPC
 {
@@ -22,8 +27,8 @@ namespace IPC
 	CIPCModule* CIPCModule::m_pSelf = NULL;
 	ipc::interprocess_mutex CIPCModule::m_ipcAccess;
 
-	//timeout for pinging queue, in seconds
-	const static int g_iQueueTimeout = 5;
+	//suffix of the abstract socket name held by the running instance
+	const static char g_szInstanceSuffix[] = "-instance";
 	//maximum number of events selector can handle frome existing sockets
 	const static int g_iMaxEvents = 500;
 	//maximum number of queued connections on the main listening socket
@@ -35,9 +40,23 @@ namespace IPC
 	 */
 	CIPCModule::CIPCModule():
 		m_strNetworkInterface(""),
-		m_iPort(0)
+		m_iPort(0),
+		m_iInstanceFD(-1),
+		m_iEventFD(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
 	{}
 
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Destructor, releases the instance socket so that the next process could be started
+	 */
+	CIPCModule::~CIPCModule()
+	{
+		if (m_iInstanceFD != -1)
+			close(m_iInstanceFD);
+		if (m_iEventFD != -1)
+			close(m_iEventFD);
+	}
+
 	//////////////////////////////////////////////////////////////////////////
 	/*
 	 * Public method to obtain singleton instance
@@ -75,38 +94,57 @@ namespace IPC
 
 	//////////////////////////////////////////////////////////////////////////
 	/*
-	 * Tricky method to understand if previous process is still up and running. Create an IPC
-	 * queue and post a message there. Assuming a separate thread for it some limited timeout
-	 * should be enough for another process to read this message - if the process is alive. If it's not
-	 * then we will still see this message in the queue - assusme it as an answer on our question
+	 * Method to understand if previous process is still up and running. Running process holds
+	 * a socket bound to the name in the abstract namespace, kernel releases the name as soon as
+	 * the process is gone - no matter how it was terminated. So if binding fails with EADDRINUSE
+	 * another process is alive, otherwise this process becomes the holder of the name. The check
+	 * takes a single system call, shared queue is not involved and is left for configuration
+	 * messages only
 	 */
 	bool CIPCModule::IsFirstInstance()
 	{
 		try
 		{
-			try
-			{
-				scoped_lock<interprocess_mutex> lock(m_ipcAccess);
-				m_spSharedMsgQueue.reset( new message_queue(open_only,SERVER_QUEUE) );
-			}
-			catch(const ipc::interprocess_exception& ex)
-			{
-				LOGDEBUG << "Shared queue is not in place";
+			scoped_lock<interprocess_mutex> lock(m_ipcAccess);
+			if (m_iInstanceFD != -1)
 				return true;
+
+			int iSocketFD = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if (iSocketFD == -1)
+			{
+				LOGERROR << "Unable to create instance socket, err = "<<errno;
+				return false;
 			}
-			size_t sizeOld = m_spSharedMsgQueue->get_num_msg();
-			int iSignal = 1;
-			m_spSharedMsgQueue->send(&iSignal,sizeof(int),1);
-			LOGDEBUG << "Detecting (timeout="<<g_iQueueTimeout<<" sec) old process functionality";
-			sleep(g_iQueueTimeout);
-			size_t sizeNew = m_spSharedMsgQueue->get_num_msg();
-			if (sizeNew > sizeOld)
+
+			// abstract socket name starts with zero byte and is not terminated by zero
+			std::string strName(SERVER_NAME);
+			strName += g_szInstanceSuffix;
+			struct sockaddr_un stAddr;
+			memset(&stAddr, 0, sizeof(stAddr));
+			stAddr.sun_family = AF_UNIX;
+			size_t iNameLength = std::min(strName.size(), sizeof(stAddr.sun_path) - 1);
+			memcpy(stAddr.sun_path + 1, strName.c_str(), iNameLength);
+			socklen_t iAddrLength = offsetof(sockaddr_un, sun_path) + 1 + iNameLength;
+
+			if (bind(iSocketFD, (sockaddr*)&stAddr, iAddrLength) == -1)
 			{
-				LOGWARN << "Queue is ready for the new process";
-				return true;
+				int iError = errno;
+				close(iSocketFD);
+				if (iError == EADDRINUSE)
+				{
+					LOGDEBUG << "Another process seems to function properly.";
+				}
+				else
+				{
+					LOGERROR << "Unable to bind instance socket, err = "<<iError;
+				}
+				return false;
 			}
 
-			LOGDEBUG << "Another process seems to function properly.";
+			// keep the socket open for the whole process lifetime, it is inherited by the daemon
+			m_iInstanceFD = iSocketFD;
+			LOGDEBUG << "No other process is running";
+			return true;
 		}
 		CATCH
 		//in case of any issue let's treat this as not first launch since relying on 'already'
@@ -116,7 +154,7 @@ namespace IPC
 
 	//////////////////////////////////////////////////////////////////////////
 	/*
-	 * Create an IPC queue to move messages between processes
+	 * Create an IPC queue to move configuration messages between processes
 	 */
 	void CIPCModule::CreateMessageQueue()
 	{
@@ -165,9 +203,9 @@ namespace IPC
 	//////////////////////////////////////////////////////////////////////////
 	/*
 	 * Main listening routine. The aim is to open connection to dedicated network device
-	 * It works with a single socket only (create/bind and listen, syncronous I/O).
-	 * Should any new client attempts to connect to it - thread will wake up, process
-	 * connection and binds it to the ThreadModule pool.
+	 * It works with a single non-blocking socket only (create/bind and listen) and creates
+	 * the ThreadModule pool. The socket is handed over to the Selector thread which accepts
+	 * new clients in the same loop that handles the data of existing connections.
 	 */
 	void CIPCModule::StartListener(size_t iNumberOfThreads)
 	{
@@ -179,64 +217,44 @@ namespace IPC
 			struct sockaddr_in stSockAddr;
 			int SocketFD;
 
-			if ((SocketFD = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) == -1)
+			if ((SocketFD = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP)) == -1)
 			{
 				LOGERROR << "Socket creating faield, err="<<errno;
 				return;
 			}
-			//package it inside a local socket so that we could get it destroyed in case of exc.
-			CBaseSocket socketBase(SocketFD);
+			//package it inside a socket wrapper so that we could get it destroyed in case of exc.
+			spCBaseSocket spSocket(new CBaseSocket(SocketFD));
 
 			memset(&stSockAddr, 0, sizeof(stSockAddr));
 			stSockAddr.sin_family = AF_INET;
 			stSockAddr.sin_port = htons(m_iPort);
 			stSockAddr.sin_addr.s_addr = inet_addr(m_strNetworkInterface.c_str());
 
-			if (bind(socketBase,(sockaddr *)&stSockAddr, sizeof(stSockAddr)) == -1)
+			if (bind(*spSocket,(sockaddr *)&stSockAddr, sizeof(stSockAddr)) == -1)
 			{
 				LOGERROR << "Socket bind failed, err="<<errno;
 				return;
 			}
 
-			if (listen(socketBase, g_iMaxQueuedConnections) == -1)
+			if (listen(*spSocket, g_iMaxQueuedConnections) == -1)
 			{
 				LOGERROR << "Socket listen failed, err="<<errno;
 				return;
 			}
 
-			struct sockaddr_in stRemoteAddr;
-			socklen_t iSize = 0;
-			iSize = sizeof(sockaddr_in);
-
-			//main listening loop with blocking call to 'accept' method - it will not awake unless new
-			//connection is attempted to be made
-		    for(;;)
-		    {
-		    	int ConnectFD = accept(socketBase, (sockaddr*)&stRemoteAddr, &iSize);
-				if (ConnectFD == -1)
-				{
-					LOGERROR << "Socket accept failed, err = "<<errno;
-					return;
-				}
-
-				LOGDEBUG << "Accepted connection from "<<ntohs(stRemoteAddr.sin_port);
-				spCReceiveTask task;
-				task.reset(new CReceiveTask(ConnectFD));
-				tFuncSelectorNotifier func = boost::bind(&CIPCModule::NotifySelector,this,_1);
-				task->AssignSelectorNotifier(func);
-				m_spThreadModule->AddTask(task);
-		    }
+			//from now on connections are accepted by the selector thread
+			m_spListenSocket = spSocket;
+			NotifySelector(SocketFD);
 		}
 		CATCH
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 	/*
-	 * Selector is designed as a second thread, very similar to listener thread. The only and
-	 * the main difference is that listener thread is working with one socket only and handles
-	 * incoming connections only. Meanwhile selector has a list of already opened sockets
-	 * (previously opened by listener) and works with them. Also it performs write operations when
-	 * we need to respond to the client
+	 * Selector is designed as a second thread. It has a list of already opened sockets
+	 * and works with them, including the listening socket - new clients are accepted
+	 * right here and their sockets are added to the same epoll set without any hand-off
+	 * to another thread. Also it sends data kept for the clients which were not ready to receive it
 	 */
 	void CIPCModule::StartSelector()
 	{
@@ -253,16 +271,16 @@ namespace IPC
 				return;
 			}
 
-			if (pipe(m_iPipeFDs) == -1)
+			if (m_iEventFD == -1)
 			{
-				LOGFATAL << "Unable to create signaling self-pipe, err" <<errno;
+				LOGFATAL << "Unable to create signaling event descriptor";
 				return;
 			}
 
-			//add reading end of pipe to controlling events
-			event.data.fd = m_iPipeFDs[0];
+			//add event descriptor to controlling events
+			event.data.fd = m_iEventFD;
 			event.events = EPOLLIN | EPOLLET;
-			if (epoll_ctl(epollFD, EPOLL_CTL_ADD, m_iPipeFDs[0], &event) == -1)
+			if (epoll_ctl(epollFD, EPOLL_CTL_ADD, m_iEventFD, &event) == -1)
 			{
 				LOGERROR << "Unable to set descriptor controller, err = " <<errno;
 				return;
@@ -275,50 +293,41 @@ namespace IPC
 				iNumDescriptors = epoll_wait(epollFD, arrEvents.get(), g_iMaxEvents, -1);
 				for (int i = 0; i < iNumDescriptors; ++i)
 				{
-					if ((arrEvents[i].events & EPOLLERR) ||
+					if (m_iEventFD == arrEvents[i].data.fd)
+					{
+						LOGDEBUG << "Event signal, let's register pending descriptors";
+						RegisterPendingDescriptors(epollFD);
+					}
+					else if (m_spListenSocket && (*m_spListenSocket == arrEvents[i].data.fd))
+					{
+						AcceptConnections(epollFD);
+					}
+					else if ((arrEvents[i].events & EPOLLERR) ||
 						(arrEvents[i].events & EPOLLHUP) ||
-						(!(arrEvents[i].events & EPOLLIN))	)
+						(!(arrEvents[i].events & (EPOLLIN | EPOLLOUT)))	)
 					{
-						// an error has occured on this fd, or the socket is not ready for reading
+						// an error has occured on this fd, or the socket is not ready for I/O
 						LOGWARN << "Error in epoll_wait, err = "<<errno<<". Forse closing desc:"<<arrEvents[i].data.fd;
 
 						m_spThreadModule->RemoveTaskBySocket(arrEvents[i].data.fd);
 						continue;
 					}
-					else if (m_iPipeFDs[0] == arrEvents[i].data.fd)
+					else
 					{
-						LOGDEBUG << "Pipe signal, let's handle new socket";
-
-						uint64_t value;
-						if (read(m_iPipeFDs[0],&value,sizeof(value)) == -1)
+						// socket became writable, send data kept while it was busy
+						if (arrEvents[i].events & EPOLLOUT)
 						{
-							LOGERROR << "Error while reading from pipe ("<<m_iPipeFDs[0]<<"), err= "<<errno;
+							m_spThreadModule->FlushPendingOutput(arrEvents[i].data.fd);
 						}
 
-						// lock array with new pending sockets
+						if (arrEvents[i].events & EPOLLIN)
 						{
-							scoped_lock<interprocess_mutex> lock(m_ipcAccess);
-							BOOST_FOREACH(int iSocketFD, m_listPendingSock)
+							LOGDEBUG << "Process data from existing connection, socketFD:"<<arrEvents[i].data.fd;
+							spCReceiveTask spTask;
+							if (m_spThreadModule->FindTaskBySocket(arrEvents[i].data.fd,spTask))
 							{
-								LOGDEBUG << "Process socketFD: "<<iSocketFD;
-								event.data.fd = iSocketFD;
-								event.events = EPOLLIN | EPOLLET;
-								if (epoll_ctl(epollFD, EPOLL_CTL_ADD, iSocketFD, &event) == -1)
-								{
-									LOGERROR << "Unable to set descriptor controller, err = " <<errno;
-									continue;
-								}
+								m_spThreadModule->RenewTask(spTask);
 							}
-							m_listPendingSock.clear();
-						}
-					}
-					else
-					{
-						LOGDEBUG << "Process data from existing connection, socketFD:"<<arrEvents[i].data.fd;
-						spCReceiveTask spTask;
-						if (m_spThreadModule->FindTaskBySocket(arrEvents[i].data.fd,spTask))
-						{
-							m_spThreadModule->RenewTask(spTask);
 						}
 					}
 				} //for (... signalled descriptors ...)
@@ -327,6 +336,97 @@ namespace IPC
 		CATCH
 	}
 
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Take all descriptors queued by other threads at once and add them to the epoll set.
+	 * Is called by the Selector thread when event descriptor is signalled
+	 * @param epollFD - in, epoll descriptor of the selector
+	 */
+	void CIPCModule::RegisterPendingDescriptors(int epollFD)
+	{
+		try
+		{
+			//reading resets the counter, so a single wake up covers all notifications made so far
+			uint64_t value;
+			if ((read(m_iEventFD,&value,sizeof(value)) == -1) && (errno != EAGAIN))
+			{
+				LOGERROR << "Error while reading from event descriptor ("<<m_iEventFD<<"), err= "<<errno;
+			}
+
+			std::list<int> listPendingSock;
+			{
+				boost::lock_guard<boost::mutex> lock(m_pendingAccess);
+				listPendingSock.swap(m_listPendingSock);
+			}
+
+			struct epoll_event event;
+			BOOST_FOREACH(int iSocketFD, listPendingSock)
+			{
+				LOGDEBUG << "Process socketFD: "<<iSocketFD;
+				event.data.fd = iSocketFD;
+				event.events = EPOLLIN | EPOLLET;
+				if (epoll_ctl(epollFD, EPOLL_CTL_ADD, iSocketFD, &event) == -1)
+				{
+					LOGERROR << "Unable to set descriptor controller, err = " <<errno;
+				}
+			}
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Accept all connections queued on the listening socket. Listening socket is edge-triggered,
+	 * so accepting is done until the queue is empty. Tasks of the whole batch are passed to the
+	 * ThreadModule pool at once and the sockets are added to the epoll set, their data is handled
+	 * as soon as it arrives
+	 * @param epollFD - in, epoll descriptor of the selector
+	 */
+	void CIPCModule::AcceptConnections(int epollFD)
+	{
+		try
+		{
+			tListReceiveTasks listTasks;
+			for(;;)
+			{
+				struct sockaddr_in stRemoteAddr;
+				socklen_t iSize = sizeof(sockaddr_in);
+				int ConnectFD = accept4(*m_spListenSocket, (sockaddr*)&stRemoteAddr, &iSize, SOCK_NONBLOCK | SOCK_CLOEXEC);
+				if (ConnectFD == -1)
+				{
+					if (errno == EINTR)
+						continue;
+					if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+					{
+						LOGERROR << "Socket accept failed, err = "<<errno;
+					}
+					break;
+				}
+
+				LOGDEBUG << "Accepted connection from "<<ntohs(stRemoteAddr.sin_port);
+				listTasks.push_back(spCReceiveTask(new CReceiveTask(ConnectFD)));
+			}
+
+			if (listTasks.empty())
+				return;
+
+			//tasks must be known before epoll reports data of their sockets
+			m_spThreadModule->AddTasks(listTasks);
+
+			struct epoll_event event;
+			BOOST_FOREACH(const spCReceiveTask& spTask, listTasks)
+			{
+				event.data.fd = spTask->GetDescriptor();
+				event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+				if (epoll_ctl(epollFD, EPOLL_CTL_ADD, event.data.fd, &event) == -1)
+				{
+					LOGERROR << "Unable to set descriptor controller, err = " <<errno;
+					m_spThreadModule->RemoveTaskBySocket(event.data.fd);
+				}
+			}
+		}
+		CATCH
+	}
 
 	//////////////////////////////////////////////////////////////////////////
 	/*
@@ -356,11 +456,10 @@ namespace IPC
 
 	//////////////////////////////////////////////////////////////////////////
 	/*
-	 * Inter-thread method, used to notify Selector thread about new incoming connections
-	 * which were established by the Listener thread. Notification is performed via unnamed pipe.
-	 * Write-end of the pipe belongs to the worker thread which was handling new incoming conn recenly
-	 * Read-end of the pipe belongs to the Selector thread which is constantly waiting for 'read'
-	 * event via blocking call to the epoll_wait method
+	 * Inter-thread method, used to notify Selector thread about descriptors to be added to its
+	 * epoll set, e.g. the listening socket opened by the Listener thread. Descriptor is queued
+	 * and the event descriptor is signalled; notifications made before the Selector thread wakes
+	 * up are merged by the kernel and handled as one batch
 	 */
 	void CIPCModule::NotifySelector(int iNewDescriptor)
 	{
@@ -368,21 +467,14 @@ namespace IPC
 		{
 			LOGDEBUG << "Notify," << iNewDescriptor;
 			{
-				scoped_lock<interprocess_mutex> lock(m_ipcAccess);
+				boost::lock_guard<boost::mutex> lock(m_pendingAccess);
 				m_listPendingSock.push_back(iNewDescriptor);
 			}
 
-			//check write-end of the pipe
-			if (m_iPipeFDs[1] == 0)
-			{
-				LOGFATAL << "Error while handling existing connection";
-				return;
-			}
-
-			uint64_t value = 0;
-			if (write(m_iPipeFDs[1],&value,sizeof(value)) == -1)
+			uint64_t value = 1;
+			if (write(m_iEventFD,&value,sizeof(value)) == -1)
 			{
-				LOGERROR << "Error while writing to pipe ("<<m_iPipeFDs[1]<<"), err= "<<errno;
+				LOGERROR << "Error while writing to event descriptor ("<<m_iEventFD<<"), err= "<<errno;
 			}
 		}
 		CATCH
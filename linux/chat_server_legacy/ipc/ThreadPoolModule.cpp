@@ -8,6 +8,8 @@
 #include <boost/thread/locks.hpp>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <iterator>
 
 using namespace trc;
 
@@ -22,6 +24,8 @@ namespace IPC
 	const size_t g_iMinPoolSize = 2;
 	//max size of the thread pool (max number of worker threads)
 	const size_t g_iMaxPoolSize = 10;
+	//max size of data kept for a socket which is not ready for writing
+	const size_t g_iMaxPendingOutput = 1024 * 1024;
 	// delmiter for text parsing
 	const std::string g_strServiseStrBegin = "$\\";
 	const char g_strServiseStrEnd = '\r';
@@ -63,6 +67,74 @@ namespace IPC
 		CATCH
 	}
 
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Non-blocking send of the data to the socket. If socket is not ready to accept all the data
+	 * the rest is kept and sent by FlushPendingOutput when socket becomes writable again. Data
+	 * which is kept already goes first, so the order of messages is preserved
+	 * @param strData - in, data to be sent
+	 */
+	void CBaseSocket::Send(const std::string& strData)
+	{
+		try
+		{
+			boost::lock_guard<boost::mutex> lock(m_outputAccess);
+			size_t iSent = 0;
+			if (m_strPendingOutput.empty())
+			{
+				ssize_t iResult = send(m_iSocketDescriptor,strData.c_str(),strData.length(),MSG_NOSIGNAL);
+				if (iResult != -1)
+				{
+					iSent = iResult;
+				}
+				else if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+				{
+					LOGERROR << "Error while sending data to the remote socket ("<<m_iSocketDescriptor<<"), err="<<errno;
+					return;
+				}
+			}
+
+			if (iSent == strData.length())
+				return;
+
+			if (m_strPendingOutput.length() + strData.length() - iSent > g_iMaxPendingOutput)
+			{
+				LOGWARN << "Pending output limit reached, data to the socket "<<m_iSocketDescriptor<<" is dropped";
+				return;
+			}
+			m_strPendingOutput.append(strData,iSent,std::string::npos);
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Send data kept by previous Send calls, is called when socket becomes writable. Whatever
+	 * the socket does not accept is kept until the next call
+	 */
+	void CBaseSocket::FlushPendingOutput()
+	{
+		try
+		{
+			boost::lock_guard<boost::mutex> lock(m_outputAccess);
+			while (!m_strPendingOutput.empty())
+			{
+				ssize_t iResult = send(m_iSocketDescriptor,m_strPendingOutput.c_str(),m_strPendingOutput.length(),MSG_NOSIGNAL);
+				if (iResult == -1)
+				{
+					if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+					{
+						LOGERROR << "Error while sending pending data to the remote socket ("<<m_iSocketDescriptor<<"), err="<<errno;
+						m_strPendingOutput.clear();
+					}
+					return;
+				}
+				m_strPendingOutput.erase(0,iResult);
+			}
+		}
+		CATCH
+	}
+
 	//////////////////////////////////////////////////////////////////////////
 	/*
 	 * Main routine responsible for reading user's data and re-sending it back to other connected clients
@@ -84,6 +156,9 @@ namespace IPC
 			{
 				if ( (iByteCount = recv(m_spSocket->GetDescriptor(),szBuffer,g_iMaxBufferSize,0)) == -1)
 				{
+					//socket is non-blocking, all available data has been read
+					if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+						break;
 					LOGERROR << "Error while reading from the socket, socketDesc="<<m_spSocket->GetDescriptor()<<", err="<<errno;
 					break;
 				}
@@ -103,24 +178,22 @@ namespace IPC
 			{
 				//detect message overflow
 				strBuffer.assign("\n --- Service message: Message limit reached ---\n");
-				if (write(GetDescriptor(),strBuffer.c_str(),strBuffer.length()) == -1)
-				{
-					LOGERROR << "Error while sending 'limited data' message ("<<GetDescriptor()<<"), err="<<errno;
-				}
+				m_spSocket->Send(strBuffer);
 			}
 			else if (!strBuffer.empty())
 			{
-				//make copy of active sockets in order to perform send operation. No need to block parent thread
-				//pool while we do resend
-				tListActiveSockets listSockets;
-				m_ptrThreadPool->GetConnectionList(listSockets);
+				//take snapshot of active sockets in order to perform send operation. Snapshot is never
+				//changed, so there is no need to block parent thread pool while we do resend
+				spActiveSockets spSockets;
+				m_ptrThreadPool->GetConnectionList(spSockets);
 				size_t npos = 0;
 
-				std::list<std::string> strListOfMessages;
+				//user data without service strings, sent to every socket at once
+				std::string strMessages;
 				npos = strBuffer.find(g_strServiseStrBegin);
 				while (npos != std::string::npos)
 				{
-					strListOfMessages.push_back(strBuffer.substr(0,npos));
+					strMessages.append(strBuffer,0,npos);
 					strBuffer.erase(0,npos+g_strServiseStrBegin.length());
 					npos = strBuffer.find(g_strServiseStrEnd);
 					if (npos == std::string::npos)
@@ -129,30 +202,19 @@ namespace IPC
 						strBuffer.erase(0,npos+1);
 					npos = strBuffer.find(g_strServiseStrBegin);
 				}
-				if (!strBuffer.empty())
-					strListOfMessages.push_back(strBuffer);
+				strMessages.append(strBuffer);
 
-				BOOST_FOREACH(int iSocket,listSockets)
+				if (!strMessages.empty())
 				{
-					if (GetDescriptor() != iSocket)
+					BOOST_FOREACH(const spCBaseSocket& spSocket,*spSockets)
 					{
-						BOOST_FOREACH(const std::string& str, strListOfMessages)
-						{
-							if (write(iSocket,str.c_str(),str.length()) == -1)
-							{
-								LOGERROR << "Error while sending data to the remote socket ("<<iSocket<<"), err="<<errno;
-							}
-						}
+						if (spSocket != m_spSocket)
+							spSocket->Send(strMessages);
 					}
 				}
 			}
 
 			m_bIsTaskCompleted = true;
-			if (!m_bIsNotified)
-			{
-				m_bIsNotified = true;
-				m_funcHandler(m_spSocket->GetDescriptor());
-			}
 		}
 		CATCH
 	}
@@ -178,6 +240,7 @@ namespace IPC
 				iPoolSize = g_iMaxPoolSize;
 			}
 
+			m_spActiveSockets.reset(new tVectorActiveSockets());
 			m_spThreadPool.reset(new pool());
 			m_spThreadPool->size_controller().resize(iPoolSize);
 		}
@@ -186,18 +249,23 @@ namespace IPC
 
 	//////////////////////////////////////////////////////////////////////////
 	/*
-	 * Adding task to the thread pool via assigning tasks to the thread queue
-	 * @param spTask - in, reference to the wrapped task to be queued
+	 * Adding tasks of newly accepted connections to the internal containers. Tasks are not scheduled
+	 * here, selector does it as soon as data arrives. The whole batch is added under a single lock
+	 * @param listTasks - in, wrapped tasks to be added
 	 */
-	void CThreadPoolModule::AddTask(const spCReceiveTask& spTask)
+	void CThreadPoolModule::AddTasks(const tListReceiveTasks& listTasks)
 	{
 		try
 		{
 			boost::lock_guard<boost::mutex> lock(m_Access);
-			spTask->AssignParrent(this);
-			m_mapReceiveTasks[spTask->GetDescriptor()] = spTask;
-			m_listActiveSockets.push_back(spTask->GetDescriptor());
-			RenewTask(spTask);
+			boost::shared_ptr<tVectorActiveSockets> spSockets(new tVectorActiveSockets(*m_spActiveSockets));
+			BOOST_FOREACH(const spCReceiveTask& spTask, listTasks)
+			{
+				spTask->AssignParrent(this);
+				m_mapReceiveTasks[spTask->GetDescriptor()] = spTask;
+				spSockets->push_back(spTask->GetSocket());
+			}
+			m_spActiveSockets = spSockets;
 		}
 		CATCH
 	}
@@ -264,34 +332,57 @@ namespace IPC
 				if (iter->second->GetDescriptor() == iSocketFD)
 				{
 					LOGDEBUG << "Erasing task for socket = " << iSocketFD;
-					m_mapReceiveTasks.erase(iSocketFD);
+					const spCBaseSocket spSocket = iter->second->GetSocket();
+					m_mapReceiveTasks.erase(iter);
+
+					//sockets in use by running broadcasts are closed when their snapshot is released
+					boost::shared_ptr<tVectorActiveSockets> spSockets(new tVectorActiveSockets());
+					spSockets->reserve(m_spActiveSockets->size());
+					std::remove_copy(m_spActiveSockets->begin(),m_spActiveSockets->end(),
+								std::back_inserter(*spSockets),spSocket);
+					m_spActiveSockets = spSockets;
 				}
 			}
+		}
+		CATCH
+	}
 
-			tIterListActiveSockets iterSock  = std::find(m_listActiveSockets.begin(),
-								m_listActiveSockets.end(),iSocketFD);
-			if (iterSock != m_listActiveSockets.end())
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Send data kept for the socket, is called by selector when socket becomes writable
+	 * @param iSocketFD - in, socket file descriptor
+	 */
+	void CThreadPoolModule::FlushPendingOutput(int iSocketFD)
+	{
+		try
+		{
+			spCBaseSocket spSocket;
 			{
-				m_listActiveSockets.erase(iterSock);
+				boost::lock_guard<boost::mutex> lock(m_Access);
+				tIterMapReceiveTasks iter = m_mapReceiveTasks.find(iSocketFD);
+				if (iter == m_mapReceiveTasks.end())
+					return;
+				spSocket = iter->second->GetSocket();
 			}
+			spSocket->FlushPendingOutput();
 		}
 		CATCH
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 	/*
-	 * Get copy of the socket's list to some external container. Done to be useful for
-	 * running tasks if they need to resend some data to another nodes. This will make the copy
-	 * of list of sockets and return mutex so that consequent operations on this list are not blocked
-	 * @param copy - in/out, reference to the container where  internal socket list will be copied to
+	 * Get snapshot of the active sockets. Done to be useful for running tasks if they need to
+	 * resend some data to another nodes. Snapshot is immutable and is replaced as a whole when
+	 * connection is added or removed, so only the reference is taken under the mutex and
+	 * consequent operations on the list are not blocked
+	 * @param snapshot - in/out, reference which will point to the current snapshot
 	 */
-	void CThreadPoolModule::GetConnectionList(tListActiveSockets& copy)
+	void CThreadPoolModule::GetConnectionList(spActiveSockets& snapshot)
 	{
 		try
 		{
 			boost::lock_guard<boost::mutex> lock(m_Access);
-			copy.resize(m_listActiveSockets.size());
-			std::copy(m_listActiveSockets.begin(),m_listActiveSockets.end(),copy.begin());
+			snapshot = m_spActiveSockets;
 		}
 		CATCH
 	}
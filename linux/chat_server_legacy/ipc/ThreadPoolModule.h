@@ -6,12 +6,12 @@
 //thirdparty
 #include <list>
 #include <map>
-#include <boost/function.hpp>
+#include <vector>
+#include <string>
 #include <boost/thread/mutex.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
 #include <boost/smart_ptr/weak_ptr.hpp>
 #include <threadpool/threadpool.hpp>
-#include <boost/thread/mutex.hpp>
 
 namespace IPC
 {
@@ -22,10 +22,10 @@ namespace IPC
 	typedef boost::shared_ptr<CReceiveTask> spCReceiveTask;
 	typedef boost::shared_ptr<CBaseSocket> spCBaseSocket;
 	typedef std::map<int,spCReceiveTask> tMapReceiveTasks;
-	typedef std::list<int> tListActiveSockets;
-	typedef tListActiveSockets::iterator tIterListActiveSockets;
+	typedef std::list<spCReceiveTask> tListReceiveTasks;
+	typedef std::vector<spCBaseSocket> tVectorActiveSockets;
+	typedef boost::shared_ptr<const tVectorActiveSockets> spActiveSockets;
 	typedef tMapReceiveTasks::iterator tIterMapReceiveTasks;
-	typedef boost::function<void(int)> tFuncSelectorNotifier;
 
 	//////////////////////////////////////////////////////////////////////////
 	class CBaseSocket
@@ -38,9 +38,13 @@ namespace IPC
 		virtual ~CBaseSocket();
 		int GetDescriptor() {return m_iSocketDescriptor;}
 		operator int() const {return m_iSocketDescriptor;}
+		void Send(const std::string& strData);
+		void FlushPendingOutput();
 
 	private:
 		int m_iSocketDescriptor;
+		std::string m_strPendingOutput;
+		boost::mutex m_outputAccess;
 	};
 
 	//////////////////////////////////////////////////////////////////////////
@@ -51,25 +55,22 @@ namespace IPC
 
 	public:
 		CReceiveTask(int iSocketDesc):
-			m_bIsTaskCompleted(false),
-			m_bIsNotified(false)
+			m_bIsTaskCompleted(true)
 		{
 			m_spSocket.reset(new CBaseSocket(iSocketDesc));
 		}
 
 		void ReceiveData();
-		void AssignSelectorNotifier(const tFuncSelectorNotifier& func) {m_funcHandler = func;}
 		void AssignParrent(CThreadPoolModule* ptrParent) { m_ptrThreadPool = ptrParent; }
 		bool IsCompleted() { return m_bIsTaskCompleted; }
 		int GetDescriptor() { return m_spSocket->GetDescriptor(); }
+		const spCBaseSocket& GetSocket() { return m_spSocket; }
 
 	private:
 		CThreadPoolModule* m_ptrThreadPool;
 		spCBaseSocket m_spSocket;
 
 		bool m_bIsTaskCompleted;
-		bool m_bIsNotified;
-		tFuncSelectorNotifier m_funcHandler;
 	};
 
 	//////////////////////////////////////////////////////////////////////////
@@ -82,15 +83,16 @@ namespace IPC
 
 	public: //methods
 		CThreadPoolModule(size_t iPoolSize);
-		void AddTask(const spCReceiveTask& spTask);
+		void AddTasks(const tListReceiveTasks& listTasks);
 		void RenewTask(const spCReceiveTask& spTask);
 		bool FindTaskBySocket(int iSocketFD, spCReceiveTask& spTarget);
 		void RemoveTaskBySocket(int iSocketFD);
-		void GetConnectionList(tListActiveSockets& copy);
+		void FlushPendingOutput(int iSocketFD);
+		void GetConnectionList(spActiveSockets& snapshot);
 
 	private: //members
 		tMapReceiveTasks m_mapReceiveTasks;
-		tListActiveSockets m_listActiveSockets;
+		spActiveSockets m_spActiveSockets;
 		boost::shared_ptr<boost::threadpool::pool> m_spThreadPool;
 		boost::mutex m_Access;
 	};
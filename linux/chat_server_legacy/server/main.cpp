@@ -91,7 +91,10 @@ int main(int argc, char *argv[])
 					<< "Please verify configuration file format is correct";
 		}
 
-		if ( (iDaemonMode == 1) && ipc->IsFirstInstance())
+		// instance socket is bound on every start, so that a process running in the foreground
+		// is detected by the following ones as well
+		bool bIsFirstInstance = ipc->IsFirstInstance();
+		if ( (iDaemonMode == 1) && bIsFirstInstance)
 		{
 			LOGDEBUG << "Launching daemon";
 			if (daemon(0,0) < 0)
@@ -0,0 +1,333 @@
+//native
+#include "ProcessData.h"
+//thirdparty
+#include <time.h>
+#include <stdlib.h>
+#include <list>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <boost/spirit/home/classic.hpp>
+#include <boost/algorithm/string.hpp>
+
+//////////////////////////////////////////////////////////////////////////
+/*
+ * Benchmark of the request parser. Former Spirit.Classic grammar is kept here as the reference:
+ * both parsers run over the same set of requests, results are compared first and then each parser
+ * is timed the way it is used by the worker thread
+ */
+namespace Reference
+{
+	//////////////////////////////////////////////////////////////////////////
+	using namespace boost::spirit;
+	using namespace classic;
+	using namespace std;
+
+	typedef  std::pair<std::string, std::string>    Entry;
+	typedef  std::list<Entry>            Entries;
+	typedef  std::pair<std::string, Entries>   RequestData;
+	typedef  std::list<RequestData>           RequestMessage;
+
+	//////////////////////////////////////////////////////////////////////////
+	struct add_section
+	{
+		add_section( RequestMessage & data ) : data_(data) {}
+		void operator()(const char* p, const char* q) const
+		{
+			string s(p,q);
+			boost::algorithm::trim(s);
+			data_.push_back( RequestData( s, Entries() ) );
+		}
+
+		RequestMessage & data_;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	struct add_key
+	{
+		add_key( RequestMessage & data ) : data_(data) {}
+
+		void operator()(const char* p, const char* q) const
+		{
+			string s(p,q);
+			boost::algorithm::trim(s);
+			data_.back().second.push_back( Entry( s, string() ) );
+		}
+
+		RequestMessage & data_;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	struct add_value
+	{
+		add_value( RequestMessage & data ) : data_(data) {}
+		void operator()(const char* p, const char* q) const
+		{
+			data_.back().second.back().second.assign(p, q);
+		}
+
+		RequestMessage & data_;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	struct append_value
+	{
+		append_value( RequestMessage & data ) : data_(data) {}
+		void operator()(const char* p, const char* q) const
+		{
+			data_.back().second.back().second.append(p, q);
+		}
+
+		void operator()(const char& ch) const
+		{
+			data_.back().second.back().second += ch;
+		}
+
+		RequestMessage & data_;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	struct requestdata_parser : public grammar<requestdata_parser>
+	{
+		requestdata_parser(RequestMessage & data) : data_(data) {}
+
+		template <typename ScannerT>
+		struct definition
+		{
+			rule<ScannerT> requestdata, section, entryUsr, entryMail, paramName,
+						serviceData,  username, mail;
+			rule<ScannerT> const& start() const { return requestdata; }
+
+			definition(requestdata_parser const& self)
+			{
+				requestdata = *section;
+
+				section = *blank_p
+						>> serviceData[add_section(self.data_)]
+						>> entryUsr
+						>> *entryMail;
+
+				entryUsr = paramName
+						>> username[add_value(self.data_)]
+						>> *blank_p
+						>> *ch_p(';');
+
+				entryMail = paramName
+						>> mail[add_value(self.data_)]
+						>> ch_p('@')[append_value(self.data_)]
+						>> mail[append_value(self.data_)]
+						>> *blank_p
+						>> *ch_p(';');
+
+				paramName = *blank_p
+						>> serviceData[add_key(self.data_)]
+						>> *blank_p
+						>> ch_p('=')
+						>> *blank_p;
+
+				serviceData = +(alpha_p);
+				username  = +(alnum_p | chset<>(" .") );
+				mail = +(alnum_p | chset<>("-_.") );
+			}
+		};
+
+		RequestMessage & data_;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	struct first_is
+	{
+		first_is(std::string const& s) : s_(s) {}
+		template< class Pair >
+		bool operator()(Pair const& p) const { return p.first == s_; }
+		string const& s_;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	bool find_value( RequestMessage const& msg, string const& s, string const& p, string & res )
+	{
+		RequestMessage::const_iterator sit = find_if(msg.begin(), msg.end(), first_is(s));
+		if (sit == msg.end())
+			return false;
+
+		Entries::const_iterator it = find_if(sit->second.begin(), sit->second.end(), first_is(p));
+		if (it == sit->second.end())
+			return false;
+
+		res = it->second;
+		return true;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/**
+	 * Former parser: grammar object is built once per task and its data is cleaned between requests
+	 */
+	class CGrammarParser
+	{
+	public: //methods
+		CGrammarParser(): m_parser(m_Data) {}
+
+		//////////////////////////////////////////////////////////////////////////
+		/*
+		 * Parse one request with the grammar and extract its values the way the worker did it
+		 * @param strRequest - in, request line with the terminator
+		 * @param iRequestID - in/out, recognized request or -1
+		 * @param strUsername - in/out, username
+		 * @param strEmail - in/out, email (REGISTER only)
+		 */
+		void Parse(const std::string& strRequest, int& iRequestID, std::string& strUsername, std::string& strEmail)
+		{
+			m_Data.clear();
+			parse(strRequest.c_str(), m_parser, nothing_p);
+
+			iRequestID = IPC::eREQUEST_UNDEFINED;
+			strUsername.clear();
+			strEmail.clear();
+			if (find_value(m_Data,"REGISTER","username",strUsername) && find_value(m_Data,"REGISTER","email",strEmail))
+				iRequestID = IPC::eREQUEST_REGISTER;
+			else if (find_value(m_Data,"GET","username",strUsername))
+				iRequestID = IPC::eREQUEST_GET;
+			else
+				strUsername.clear();
+			boost::trim(strUsername);
+			boost::trim(strEmail);
+		}
+
+	private: //members
+		RequestMessage m_Data;
+		requestdata_parser m_parser;
+	};
+}
+
+//////////////////////////////////////////////////////////////////////////
+//requests the benchmark runs over, roughly the mix of a busy server with some garbage
+static const char* g_szRequests[] =
+{
+	"REGISTER username=john.smith; email=john.smith@example.com\r\n",
+	"GET username=john.smith\r\n",
+	"  GET   username =  alice  \r\n",
+	"REGISTER username=Bob 2nd;email=bob_2-nd@mail.example.org;\r\n",
+	"GET username=user12345678901234567890\r\n",
+	"REGISTER username=carol; email=carol-at-example.com\r\n",
+	"GET user=dave\r\n",
+	"HELLO username=eve\r\n",
+	"REGISTER username=frank\r\n",
+	"GET username=\r\n"
+};
+
+//////////////////////////////////////////////////////////////////////////
+/*
+ * Get monotonic time in nanoseconds
+ * @return double - current time
+ */
+static double GetTimeNsec()
+{
+	struct timespec tsNow;
+	clock_gettime(CLOCK_MONOTONIC,&tsNow);
+	return tsNow.tv_sec*1e9 + tsNow.tv_nsec;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/*
+ * Check that both parsers yield the same request for every line. Former grammar kept values of
+ * partially matched entries (empty username, email without '@') and left them to the worker
+ * checks, so such requests are counted as unrecognized for both parsers
+ * @param vecRequests - in, request lines
+ * @return bool - true if results are the same
+ */
+static bool CompareParsers(const std::vector<std::string>& vecRequests)
+{
+	Reference::CGrammarParser grammarParser;
+	bool bIsSame = true;
+	for (size_t i = 0; i < vecRequests.size(); ++i)
+	{
+		int iRequestID;
+		std::string strUsername, strEmail;
+		grammarParser.Parse(vecRequests[i],iRequestID,strUsername,strEmail);
+		if (strUsername.empty() || (iRequestID == IPC::eREQUEST_REGISTER && strEmail.find('@') == std::string::npos))
+			iRequestID = IPC::eREQUEST_UNDEFINED;
+
+		IPC::SRequest request;
+		const char* szRequest = vecRequests[i].c_str();
+		IPC::CProcessData::Parse(szRequest,szRequest+vecRequests[i].find("\r\n"),request);
+		int iParsedID = request.m_iRequestID;
+		if (request.m_refUsername.empty() || (iParsedID == IPC::eREQUEST_REGISTER && request.m_refEmail.empty()))
+			iParsedID = IPC::eREQUEST_UNDEFINED;
+
+		bool bIsMatched = (iParsedID == iRequestID);
+		if (bIsMatched && iRequestID != IPC::eREQUEST_UNDEFINED)
+		{
+			bIsMatched = (request.m_refUsername == strUsername) &&
+					(iRequestID != IPC::eREQUEST_REGISTER || request.m_refEmail == strEmail);
+		}
+		if (!bIsMatched)
+		{
+			std::cout << "Mismatch for request: " << vecRequests[i].substr(0,vecRequests[i].length()-2) << std::endl;
+			bIsSame = false;
+		}
+	}
+	return bIsSame;
+}
+
+//////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[])
+{
+	int iIterations = (argc > 1) ? atoi(argv[1]) : 100000;
+	if (iIterations <= 0)
+		iIterations = 100000;
+
+	std::vector<std::string> vecRequests(g_szRequests,g_szRequests + sizeof(g_szRequests)/sizeof(g_szRequests[0]));
+	if (!CompareParsers(vecRequests))
+		return 1;
+
+	//the whole batch of requests is received as one buffer, former grammar got a copy of each line
+	std::string strBuffer;
+	for (size_t i = 0; i < vecRequests.size(); ++i)
+		strBuffer += vecRequests[i];
+	const size_t ulRequests = (size_t)iIterations*vecRequests.size();
+
+	Reference::CGrammarParser grammarParser;
+	size_t ulChecksum = 0;
+	double dStart = GetTimeNsec();
+	for (int iIter = 0; iIter < iIterations; ++iIter)
+	{
+		size_t posRequest = 0;
+		size_t posTerm = strBuffer.find("\r\n");
+		while (posTerm != std::string::npos)
+		{
+			int iRequestID;
+			std::string strUsername, strEmail;
+			grammarParser.Parse(strBuffer.substr(posRequest,posTerm+2-posRequest),iRequestID,strUsername,strEmail);
+			ulChecksum += iRequestID + strUsername.length() + strEmail.length();
+			posRequest = posTerm + 2;
+			posTerm = strBuffer.find("\r\n",posRequest);
+		}
+	}
+	double dGrammarNsec = (GetTimeNsec() - dStart)/ulRequests;
+
+	dStart = GetTimeNsec();
+	for (int iIter = 0; iIter < iIterations; ++iIter)
+	{
+		size_t posRequest = 0;
+		size_t posTerm = strBuffer.find("\r\n");
+		const char* szBuffer = strBuffer.data();
+		while (posTerm != std::string::npos)
+		{
+			IPC::SRequest request;
+			IPC::CProcessData::Parse(szBuffer+posRequest,szBuffer+posTerm,request);
+			ulChecksum -= request.m_iRequestID + request.m_refUsername.length() + request.m_refEmail.length();
+			posRequest = posTerm + 2;
+			posTerm = strBuffer.find("\r\n",posRequest);
+		}
+	}
+	double dParserNsec = (GetTimeNsec() - dStart)/ulRequests;
+
+	std::cout << "Requests parsed by each parser:\t" << ulRequests << std::endl;
+	std::cout << "Spirit.Classic grammar:\t" << dGrammarNsec << " ns/request" << std::endl;
+	std::cout << "Single-pass parser:\t" << dParserNsec << " ns/request" << std::endl;
+	std::cout << "Speedup:\t" << dGrammarNsec/dParserNsec << "x" << std::endl;
+	//checksum keeps the loops from being optimized out
+	std::cout << "Checksum:\t" << ulChecksum << std::endl;
+	return 0;
+}
@@ -34,6 +34,9 @@ namespace Config
 		eCONFIG_DATA_FILE,
 		eCONFIG_SLEEP,
 		eCONFIG_LOG_LEVEL,
+		eCONFIG_DATA_INDEX,
+		eCONFIG_DATA_SYNC,
+		eCONFIG_UDP_READERS,
 
 		//additional comamnd-line params
 		eCONFIG_KILL_PROCESS,
@@ -8,7 +8,6 @@
 #include <boost/interprocess/ipc/message_queue.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
-#include <list>
 
 //////////////////////////////////////////////////////////////////////////
 namespace IPC
@@ -35,23 +34,27 @@ namespace IPC
 		void CreateMessageQueue();
 		void SetupThreadPool(size_t iMaxNumberOfThreads, const std::string& strDataRegisterFile, int iSendTimeout);
 		void SetupIPSettings();
+		bool SetupTCPSelector();
 		void StartTCPListener();
 		void StartTCPSelector();
 		void StartUDPListener();
+		void StartUDPBatchReader();
 		void ApplyServerOptionsRemotely();
 		void SetSendTimeout(int iSendTimeout) { m_spThreadModule->SetSendTimeout(iSendTimeout); }
 		void SetDataPath(const std::string& strDataPath) { m_spThreadModule->SetDataPath(strDataPath); }
 		void SetMaintenanceMode(int iMode) { m_spThreadModule->SetMaintenance(iMode); }
+		void SetDataIndexMode(int iMode) { m_spThreadModule->SetDataIndex(iMode); }
+		void SetDataSyncMode(int iMode) { m_spThreadModule->SetDataSync(iMode); }
 
 	private: //members
 		static CIPCModule* m_pSelf;
 		static boost::mutex m_ipcAccess;
-		boost::mutex m_localAccess;
 		boost::shared_ptr<ipc::message_queue> m_spSharedMsgQueue;
 		boost::shared_ptr<CThreadPoolModule> m_spThreadModule;
 		boost::shared_ptr<ipc::managed_shared_memory> m_spMemorySegment;
-		std::list<int> m_listPendingSockets;
-		int m_iSelectorPipe[2];
+		//selector descriptors are created before any TCP connection is accepted
+		int m_iSelectorEpoll;
+		int m_iSelectorEvent;
 
 		//IP settings
 		std::string m_strTCPNetworkAddress;
@@ -64,6 +67,7 @@ namespace IPC
 
 	private: //methods
 		void NotifySelector(int iNewDescriptor);
+		bool BindUDPSocket(CBaseSocket& baseUDPSocket, bool bIsReusePort);
 		void SharedQueueReader();
 		void GetIPAddressFromLocalAdaptor(const std::string& strNetworkInterface, std::string& strIpAddress);
 	};
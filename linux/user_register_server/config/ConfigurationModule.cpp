@@ -30,6 +30,9 @@ namespace Config
 		"datafile",
 		"sleep",
 		"loglevel",
+		"dataindex",
+		"datasync",
+		"udpreaders",
 		"kill",
 		"threadpool"
 	};
@@ -38,6 +41,8 @@ namespace Config
 	const size_t g_iMinPoolSize = 2;
 	//max size of the thread pool (max number of worker threads)
 	const size_t g_iMaxPoolSize = 20;
+	//max number of batched UDP readers (each one has its own socket)
+	const int g_iMaxUDPReaders = 16;
 	//hardcode max IP port
 	const int g_iMaxIPport = 65535;
 
@@ -147,6 +152,9 @@ namespace Config
 				("sleep",po::value<int>(),"amount of time before responding to client (0..xxxx in milliseconds, default is 1000)")
 				("maint",po::value<int>(),"switch server to maintenance mode")
 				("loglevel",po::value<int>(),"specify server log level (0=Debug, 1=Warning, 2=Error, 3=Fatal)")
+				("dataindex",po::value<int>(),"keep in-memory index of the data file (0=scan file on each request, 1=use index). Applied on start only")
+				("udpreaders",po::value<int>(),"number of batched UDP readers with own sockets (0=single UDP socket read datagram by datagram). Applied on start only")
+				("datasync",po::value<int>(),"sync data file to the disk after each batch of registrations (0=no, 1=yes). Applied on start only")
 				("kill","terminate instance of process if any is running in daemon mode")
 				("daemon","run process in daemon mode");
 			hidden.add_options()
@@ -294,6 +302,9 @@ namespace Config
 			m_mapDefaultSettings[eCONFIG_SLEEP] = 1000;
 			m_mapDefaultSettings[eCONFIG_MAINT] = 0;
 			m_mapDefaultSettings[eCONFIG_LOG_LEVEL] = 2;
+			m_mapDefaultSettings[eCONFIG_DATA_INDEX] = 0;
+			m_mapDefaultSettings[eCONFIG_DATA_SYNC] = 0;
+			m_mapDefaultSettings[eCONFIG_UDP_READERS] = 0;
 			m_mapDefaultSettings[eCONFIG_THREAD_POOL] = 10;
 		}
 		catch(...)
@@ -435,6 +446,8 @@ namespace Config
 				}
 				case eCONFIG_DAEMON_MODE:
 				case eCONFIG_MAINT:
+				case eCONFIG_DATA_INDEX:
+				case eCONFIG_DATA_SYNC:
 				{
 					int iValue = 0;
 					int iDefaultValue = 0;
@@ -489,6 +502,17 @@ namespace Config
 					SetSetting<int>(iParamIndex,iValue);
 					break;
 				}
+				case eCONFIG_UDP_READERS:
+				{
+					int iValue = 0;
+					int iDefaultValue = 0;
+					GetDefaultValue<int>(iParamIndex,iDefaultValue);
+					if (!CureParameter<int>(iParamIndex,iValue) || iValue > g_iMaxUDPReaders || iValue < 0)
+						iValue = iDefaultValue;
+
+					SetSetting<int>(iParamIndex,iValue);
+					break;
+				}
 				default:
 					LOGERROR << "Unknown parameter id while checking parameters: "<<iParamIndex;
 			}
@@ -0,0 +1,243 @@
+//native
+#include "DataIndex.h"
+#include "Logger.h"
+//thirdparty
+#include <fstream>
+#include <errno.h>
+#include <string.h>
+#include <boost/thread/locks.hpp>
+
+using namespace trc;
+
+namespace IPC
+{
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Compare metadata of two files
+	 * @param src - in, metadata to compare with
+	 * @return bool - true if both describe the same state of the same file
+	 */
+	bool CDataIndex::SFileKey::operator== (const SFileKey& src) const
+	{
+		return m_bIsPresent == src.m_bIsPresent &&
+			m_device == src.m_device &&
+			m_inode == src.m_inode &&
+			m_size == src.m_size &&
+			m_mtime == src.m_mtime &&
+			m_mtimeNsec == src.m_mtimeNsec &&
+			m_strPath == src.m_strPath;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Overloaded constructor, index is empty until the first lookup
+	 * @param fileAccess - in, sync object which guards data register file
+	 */
+	CDataIndex::CDataIndex(boost::shared_mutex& fileAccess):
+		m_iRecords(0),
+		m_bIsValid(false),
+		m_fileAccess(fileAccess)
+	{}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Find user record. Index is rebuilt before the lookup if file was changed since the last one
+	 * @param strDataRegisterFile - in, data register file
+	 * @param strUsername - in, username to find
+	 * @param strEmail - in/out, email of the user if record is found
+	 * @param bIsPresent - in/out, true if record is found
+	 * @return int - number of records in the file, -1 if file cannot be read
+	 */
+	int CDataIndex::Find(const std::string& strDataRegisterFile, const std::string& strUsername, std::string& strEmail, bool& bIsPresent)
+	{
+		bIsPresent = false;
+		try
+		{
+			SFileKey key;
+			if (!ReadFileKey(strDataRegisterFile,key))
+				return -1;
+
+			{
+				boost::shared_lock<boost::shared_mutex> lock(m_indexAccess);
+				if (m_bIsValid && (m_fileKey == key))
+					return Probe(strUsername,strEmail,bIsPresent);
+			}
+
+			boost::lock_guard<boost::shared_mutex> lock(m_indexAccess);
+			//somebody could rebuild index while we were waiting for the lock
+			if (!(m_bIsValid && (m_fileKey == key)) && !Rebuild(key))
+				return -1;
+			return Probe(strUsername,strEmail,bIsPresent);
+		}
+		catch(...)
+		{
+			LOGERROR << "Exception while searching data index for: " << strUsername;
+		}
+		return -1;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Append user records to the file with a single write and add them to the index. If file was
+	 * changed by someone else since the index was built, index is left to be rebuilt by the next lookup
+	 * @param strDataRegisterFile - in, data register file
+	 * @param vecRecords - in, new records
+	 * @return bool - true if records were written to the file
+	 */
+	bool CDataIndex::Append(const std::string& strDataRegisterFile, const tVectorRecords& vecRecords)
+	{
+		try
+		{
+			boost::lock_guard<boost::shared_mutex> lock(m_indexAccess);
+			SFileKey key;
+			bool bIsCurrent = ReadFileKey(strDataRegisterFile,key) && m_bIsValid && (m_fileKey == key);
+			{
+				boost::lock_guard<boost::shared_mutex> lockFile(m_fileAccess);
+				std::ofstream dataOut(strDataRegisterFile.c_str(), std::fstream::app);
+				if (!dataOut.good())
+				{
+					LOGERROR << "Error while writing to file: "<< strDataRegisterFile;
+					return false;
+				}
+				dataOut << FormatRecords(vecRecords) << std::flush;
+				if (!dataOut.good())
+				{
+					LOGERROR << "Error while writing to file: "<< strDataRegisterFile;
+					m_bIsValid = false;
+					return false;
+				}
+			}
+
+			if (bIsCurrent && ReadFileKey(strDataRegisterFile,key))
+			{
+				m_mapRecords.insert(vecRecords.begin(),vecRecords.end());
+				m_iRecords += vecRecords.size();
+				m_fileKey = key;
+			}
+			else
+			{
+				m_bIsValid = false;
+			}
+			return true;
+		}
+		catch(...)
+		{
+			LOGERROR << "Exception while appending records, count=" << vecRecords.size();
+		}
+		return false;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Compose lines of the data register file for the given records
+	 * @param vecRecords - in, records to be written
+	 * @return string - one 'username;email' line per record
+	 */
+	std::string CDataIndex::FormatRecords(const tVectorRecords& vecRecords)
+	{
+		std::string strRecords;
+		for (tVectorRecords::const_iterator iter = vecRecords.begin(); iter != vecRecords.end(); ++iter)
+			strRecords.append(iter->first).append(1,g_cRecordSeparator).append(iter->second).append(1,'\n');
+		return strRecords;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Get metadata of the data register file. Missing file is treated as an empty one
+	 * @param strDataRegisterFile - in, data register file
+	 * @param key - in/out, file metadata
+	 * @return bool - false if file metadata cannot be read
+	 */
+	bool CDataIndex::ReadFileKey(const std::string& strDataRegisterFile, SFileKey& key)
+	{
+		struct stat fileStat;
+		key.m_strPath = strDataRegisterFile;
+		if (stat(strDataRegisterFile.c_str(),&fileStat) == -1)
+		{
+			if (errno != ENOENT)
+			{
+				LOGERROR << "Unable to read metadata of file: " << strDataRegisterFile << ", err=" << errno;
+				return false;
+			}
+			memset(&fileStat,0,sizeof(fileStat));
+			key.m_bIsPresent = false;
+		}
+		else
+		{
+			key.m_bIsPresent = true;
+		}
+
+		key.m_device = fileStat.st_dev;
+		key.m_inode = fileStat.st_ino;
+		key.m_size = fileStat.st_size;
+		key.m_mtime = fileStat.st_mtim.tv_sec;
+		key.m_mtimeNsec = fileStat.st_mtim.tv_nsec;
+		return true;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Read the whole file into the index. Should be called under exclusive index lock. The first
+	 * record of the user wins, as it was with the sequential scan of the file
+	 * @param key - in, metadata of the file read just before
+	 * @return bool - true if index was rebuilt
+	 */
+	bool CDataIndex::Rebuild(const SFileKey& key)
+	{
+		m_bIsValid = false;
+		m_mapRecords.clear();
+		m_iRecords = 0;
+
+		if (key.m_bIsPresent)
+		{
+			boost::shared_lock<boost::shared_mutex> lock(m_fileAccess);
+			std::ifstream dataIn(key.m_strPath.c_str(), std::fstream::in);
+			if (!dataIn.good())
+			{
+				LOGERROR << "Unable to read file: " << key.m_strPath;
+				return false;
+			}
+
+			std::string strLine;
+			while (std::getline(dataIn,strLine))
+			{
+				++m_iRecords;
+				size_t posSeparator = strLine.find(g_cRecordSeparator);
+				if (posSeparator != std::string::npos)
+					m_mapRecords.insert(std::make_pair(strLine.substr(0,posSeparator),strLine.substr(posSeparator+1)));
+			}
+
+			if (dataIn.bad())
+			{
+				LOGERROR << "Error while reading file: " << key.m_strPath;
+				return false;
+			}
+		}
+
+		LOGDEBUG << "Data index is rebuilt, records="<<m_iRecords<<", file="<<key.m_strPath;
+		m_fileKey = key;
+		m_bIsValid = true;
+		return true;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Look for the user in the index. Should be called under index lock
+	 * @param strUsername - in, username to find
+	 * @param strEmail - in/out, email of the user if record is found
+	 * @param bIsPresent - in/out, true if record is found
+	 * @return int - number of records in the file
+	 */
+	int CDataIndex::Probe(const std::string& strUsername, std::string& strEmail, bool& bIsPresent)
+	{
+		tMapRecords::const_iterator iter = m_mapRecords.find(strUsername);
+		if (iter != m_mapRecords.end())
+		{
+			bIsPresent = true;
+			strEmail = iter->second;
+		}
+		return m_iRecords;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+}
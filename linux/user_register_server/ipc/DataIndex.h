@@ -0,0 +1,75 @@
+
+#ifndef DATAINDEX_H_
+#define DATAINDEX_H_
+
+//thirdparty
+#include <string>
+#include <vector>
+#include <utility>
+#include <sys/stat.h>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+namespace IPC
+{
+	//////////////////////////////////////////////////////////////////////////
+	//separator between username and email in the data register file
+	const char g_cRecordSeparator = ';';
+	//records to be appended to the data register file (username, email)
+	typedef std::vector<std::pair<std::string, std::string> > tVectorRecords;
+
+	//////////////////////////////////////////////////////////////////////////
+	/**
+	 * In-memory index of the data register file. File is read once into a hash keyed by username
+	 * and is read again only if the file was changed. Every lookup checks file metadata (inode, size,
+	 * modification time) with a single 'stat' call, so external edits of the file (even on NFS) and
+	 * deletion of the file are detected without reading it
+	 */
+	class CDataIndex
+	{
+	private: //permit no copy and default creation
+		CDataIndex();
+		CDataIndex(const CDataIndex& src);
+		CDataIndex& operator= (const CDataIndex& src);
+
+	public: //methods
+		CDataIndex(boost::shared_mutex& fileAccess);
+		virtual ~CDataIndex(){;}
+		int Find(const std::string& strDataRegisterFile, const std::string& strUsername, std::string& strEmail, bool& bIsPresent);
+		bool Append(const std::string& strDataRegisterFile, const tVectorRecords& vecRecords);
+		static std::string FormatRecords(const tVectorRecords& vecRecords);
+
+	private: //types
+		typedef boost::unordered_map<std::string, std::string> tMapRecords;
+
+		//file metadata the index was built for
+		struct SFileKey
+		{
+			std::string m_strPath;
+			bool m_bIsPresent;
+			dev_t m_device;
+			ino_t m_inode;
+			off_t m_size;
+			time_t m_mtime;
+			long m_mtimeNsec;
+
+			bool operator== (const SFileKey& src) const;
+		};
+
+	private: //methods
+		bool ReadFileKey(const std::string& strDataRegisterFile, SFileKey& key);
+		bool Rebuild(const SFileKey& key);
+		int Probe(const std::string& strUsername, std::string& strEmail, bool& bIsPresent);
+
+	private: //members
+		tMapRecords m_mapRecords;
+		int m_iRecords;
+		bool m_bIsValid;
+		SFileKey m_fileKey;
+		boost::shared_mutex m_indexAccess;
+		boost::shared_mutex& m_fileAccess;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+} //namespace IPC
+#endif /* DATAINDEX_H_ */
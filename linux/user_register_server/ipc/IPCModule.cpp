@@ -3,6 +3,7 @@
 #include "IPCModule.h"
 #include "Logger.h"
 #include "ConfigurationModule.h"
+#include "UDPBatch.h"
 // third-party
 #include <boost/interprocess/sync/named_mutex.hpp>
 #include <boost/interprocess/sync/named_condition.hpp>
@@ -12,10 +13,10 @@
 #include <boost/date_time/posix_time/ptime.hpp>
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
-#include <boost/foreach.hpp>
 #include <string>
 #include <sys/socket.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <sys/ioctl.h>
@@ -48,7 +49,8 @@ namespace IPC
 	 * Default constructor
 	 */
 	CIPCModule::CIPCModule():
-		m_iSelectorPipe{0,0},
+		m_iSelectorEpoll(-1),
+		m_iSelectorEvent(-1),
 		m_strTCPNetworkAddress(""),
 		m_strUDPNetworkAddress(""),
 		m_iTCPPort(0),
@@ -92,8 +94,11 @@ namespace IPC
 				LOGEMPTY << "\nDeadline statistics:"<<
 				"\n\tsummary connections accepted:\t"<<m_ulSummaryAcceptedConn<<
 				"\n\tparsing succeded:\t"<<m_ulSummaryOfParsing<<
-				"\n\tpending-to-open sockets:\t"<<m_listPendingSockets.size()<<
 				"\n\tpending-to-close sockets:\t"<<m_spThreadModule->GetNumberOfPendingSockets()<<
+				"\n\tunsent deferred responses:\t"<<m_spThreadModule->GetNumberOfDeferredResponses()<<
+				"\n\tunreplayed parked requests:\t"<<m_spThreadModule->GetNumberOfParkedRequests()<<
+				"\n\tregister batches written:\t"<<m_spThreadModule->GetNumberOfRegisterBatches()<<
+				"\n\tregistered records:\t"<<m_spThreadModule->GetNumberOfRegisteredRecords()<<
 				"\n\tundeleted tasks:\t"<<m_spThreadModule->GetNumberOfTasks()<<std::endl;
 
 			delete m_pSelf;
@@ -333,6 +338,56 @@ namespace IPC
 		LOGDEBUG << "Exit TCP listener thread";
 	}
 
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Create UDP socket and bind it to the configured network interface/port
+	 * @param baseUDPSocket - in/out, wrapper which gets the socket
+	 * @param bIsReusePort - in, true if several sockets are going to be bound to the same port
+	 * @return bool - true if socket is bound
+	 */
+	bool CIPCModule::BindUDPSocket(CBaseSocket& baseUDPSocket, bool bIsReusePort)
+	{
+		//package socket inside a class so that we could get it closed in case of exception/return
+		if ((baseUDPSocket = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1)
+		{
+			LOGFATAL << "Socket creating failed, err="<<errno;
+			return false;
+		}
+
+		int iReusePort = 1;
+		if (bIsReusePort && setsockopt(baseUDPSocket,SOL_SOCKET,SO_REUSEPORT,&iReusePort,sizeof(iReusePort)) == -1)
+		{
+			LOGFATAL << "Unable to share UDP port between sockets, err="<<errno;
+			return false;
+		}
+
+		struct sockaddr_in stSockAddr;
+		memset(&stSockAddr, 0, sizeof(stSockAddr));
+		stSockAddr.sin_family = PF_INET;
+		stSockAddr.sin_port = htons(m_iUDPPort);
+		in_addr_t addr = inet_addr(m_strUDPNetworkAddress.c_str());
+		if (addr == INADDR_NONE)
+		{
+			CConfigurationModule& config = CConfigurationModule::Instance();
+			std::string strAddr;
+			config.GetDefaultValue<std::string>(eCONFIG_UDP_IF,strAddr);
+			LOGERROR << "Internet address ("<<m_strUDPNetworkAddress<<") is invalid, try switching to default value ("<<strAddr<<")";
+			if ( (addr = inet_addr(strAddr.c_str())) == INADDR_NONE)
+			{
+				LOGFATAL << "Unable to switch to default value, err="<<errno;
+				return false;
+			}
+		}
+
+		stSockAddr.sin_addr.s_addr = addr;
+		if (bind(baseUDPSocket,(sockaddr *)&stSockAddr, sizeof(stSockAddr)) == -1)
+		{
+			LOGFATAL << "Socket bind failed, err="<<errno;
+			return false;
+		}
+		return true;
+	}
+
 	//////////////////////////////////////////////////////////////////////////
 	/*
 	 * Main UDP-oriented listening routine. The aim is to open connection to dedicated network interface/port
@@ -345,37 +400,8 @@ namespace IPC
 		{
 			LOGDEBUG << "Start UDP listening";
 			CBaseSocket baseUDPSocket;
-			//package socket inside a class so that we could get it closed in case of exception/return
-			if ((baseUDPSocket = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1)
-			{
-				LOGFATAL << "Socket creating failed, err="<<errno;
+			if (!BindUDPSocket(baseUDPSocket,false))
 				return;
-			}
-
-			struct sockaddr_in stSockAddr;
-			memset(&stSockAddr, 0, sizeof(stSockAddr));
-			stSockAddr.sin_family = PF_INET;
-			stSockAddr.sin_port = htons(m_iUDPPort);
-			in_addr_t addr = inet_addr(m_strUDPNetworkAddress.c_str());
-			if (addr == INADDR_NONE)
-			{
-				CConfigurationModule& config = CConfigurationModule::Instance();
-				std::string strAddr;
-				config.GetDefaultValue<std::string>(eCONFIG_UDP_IF,strAddr);
-				LOGERROR << "Internet address ("<<m_strUDPNetworkAddress<<") is invalid, try switching to default value ("<<strAddr<<")";
-				if ( (addr = inet_addr(strAddr.c_str())) == INADDR_NONE)
-				{
-					LOGFATAL << "Unable to switch to default value, err="<<errno;
-					return;
-				}
-			}
-
-			stSockAddr.sin_addr.s_addr = addr;
-			if (bind(baseUDPSocket,(sockaddr *)&stSockAddr, sizeof(stSockAddr)) == -1)
-			{
-				LOGFATAL << "Socket bind failed, err="<<errno;
-				return;
-			}
 
 			int iBytesRead = 0;
 			char szBuffer[g_iMaxBufferSize] = {0};
@@ -404,7 +430,7 @@ namespace IPC
 				}
 				else
 				{
-					strBuffer.assign(szBuffer);
+					strBuffer.assign(szBuffer,iBytesRead);
 					m_spThreadModule->AddTask(baseUDPSocket,sockRemote,strBuffer);
 				}
 			}
@@ -415,63 +441,145 @@ namespace IPC
 
 	//////////////////////////////////////////////////////////////////////////
 	/*
-	 * Selector is designed as a TCP-helper thread, very similar to TCP listener thread. The only and
-	 * the main difference is that listener thread is working with one socket only and handles
-	 * incoming connections only. Meanwhile selector has a list of already opened sockets
-	 * (previously opened by listener) and works with them.
-	 * List of active/monitoring sockets is passed to the epoll_wait function which will wake up every time
-	 * any socket in a list has data to read. This function is used with the Level Triggered event
-	 * (Edge Trigger is not specified therefore LT is used by default) which means that epoll_wait will
-	 * wake up infinite number of times unless all sockets have no data to read. Once socket has any data to read
-	 * - it is deleted from the list of monitored sockets, data is processed in a separate thread and then
-	 * socket is returned back to the epoll_wait list of monitored sockets.
+	 * Batched UDP reading routine, several of them are run on their own sockets bound to the same
+	 * port, so that the kernel spreads clients between the readers. Datagrams are read with 'recvmmsg'
+	 * straight into the pooled buffers and the whole batch is passed to one thread of the thread pool
 	 */
-	void CIPCModule::StartTCPSelector()
+	void CIPCModule::StartUDPBatchReader()
 	{
 		try
 		{
-			LOGDEBUG << "Start Selector thread";
-			int epollFD;
-			struct epoll_event event;
-			boost::scoped_array<epoll_event> arrEvents(new epoll_event[g_iMaxEvents]);
+			LOGDEBUG << "Start batched UDP reader";
+			CBaseSocket baseUDPSocket;
+			if (!BindUDPSocket(baseUDPSocket,true))
+				return;
+
+			boost::shared_ptr<CUDPBatchPool> spBatchPool(new CUDPBatchPool());
+			struct mmsghdr arrMessages[g_iMaxDatagrams];
+			struct iovec arrData[g_iMaxDatagrams];
+			while(true)
+			{
+				spSUDPBatch spBatch = spBatchPool->Acquire();
+				spBatch->m_iSocketDesc = baseUDPSocket;
+				memset(arrMessages,0,sizeof(arrMessages));
+				for (unsigned int i = 0; i < g_iMaxDatagrams; ++i)
+				{
+					arrData[i].iov_base = spBatch->m_szBuffers[i];
+					arrData[i].iov_len = g_iMaxBufferSize;
+					arrMessages[i].msg_hdr.msg_iov = &arrData[i];
+					arrMessages[i].msg_hdr.msg_iovlen = 1;
+					arrMessages[i].msg_hdr.msg_name = &spBatch->m_udpClients[i];
+					arrMessages[i].msg_hdr.msg_namelen = sizeof(spBatch->m_udpClients[i]);
+				}
+
+				//wait for the first datagram only, then take whatever is already queued
+				int iCount = recvmmsg(baseUDPSocket,arrMessages,g_iMaxDatagrams,MSG_WAITFORONE,NULL);
+				if (iCount <= 0)
+				{
+					if (iCount == -1 && errno != EINTR)
+						LOGERROR << "Reading UDP datagrams failed, err = "<<errno;
+					continue;
+				}
+
+				for (int i = 0; i < iCount; ++i)
+				{
+					if (arrMessages[i].msg_len == 0)
+						continue;
+					//compact the batch, empty datagrams are skipped
+					unsigned int iIndex = spBatch->m_iCount++;
+					if (iIndex != (unsigned int)i)
+					{
+						memcpy(spBatch->m_szBuffers[iIndex],spBatch->m_szBuffers[i],arrMessages[i].msg_len);
+						spBatch->m_udpClients[iIndex] = spBatch->m_udpClients[i];
+					}
+					spBatch->m_iLengths[iIndex] = arrMessages[i].msg_len;
+				}
 
-			epollFD = epoll_create1(0);
-			if (epollFD == -1)
+				if (spBatch->m_iCount)
+					m_spThreadModule->AddTask(spBatch);
+			}
+		}
+		CATCH
+		LOGDEBUG << "Exit batched UDP reader thread";
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Create descriptors of the TCP selector: epoll instance which monitors opened sockets and
+	 * eventfd which wakes the selector up once a worker closes the socket. Should be invoked before
+	 * the TCP listener and selector threads are launched, as workers use epoll instance directly
+	 * @return bool - true if selector is ready
+	 */
+	bool CIPCModule::SetupTCPSelector()
+	{
+		try
+		{
+			if ((m_iSelectorEpoll = epoll_create1(EPOLL_CLOEXEC)) == -1)
 			{
 				LOGFATAL << "Unable to setup selector, err=" <<errno;
-				return;
+				return false;
 			}
 
-			if (pipe(m_iSelectorPipe) == -1)
+			if ((m_iSelectorEvent = eventfd(0,EFD_CLOEXEC)) == -1)
 			{
-				LOGFATAL << "Unable to create signaling self-pipe, err=" <<errno;
-				return;
+				LOGFATAL << "Unable to create signaling eventfd, err=" <<errno;
+				return false;
 			}
 
-			//add reading end of pipe to controlling events
-			event.data.fd = m_iSelectorPipe[0];
+			//add eventfd to controlling events, it's the only descriptor which is not one-shot
+			struct epoll_event event;
+			event.data.fd = m_iSelectorEvent;
 			event.events = EPOLLIN;
-			if (epoll_ctl(epollFD, EPOLL_CTL_ADD, m_iSelectorPipe[0], &event) == -1)
+			if (epoll_ctl(m_iSelectorEpoll, EPOLL_CTL_ADD, m_iSelectorEvent, &event) == -1)
 			{
 				LOGFATAL << "Unable to add descriptor controller, err=" <<errno;
+				return false;
+			}
+			return true;
+		}
+		CATCH
+		return false;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Selector is designed as a TCP-helper thread, very similar to TCP listener thread. The only and
+	 * the main difference is that listener thread is working with one socket only and handles
+	 * incoming connections only. Meanwhile selector has a list of already opened sockets
+	 * (previously opened by listener) and works with them.
+	 * Sockets are registered in epoll with EPOLLONESHOT, so once socket has any data to read it's
+	 * disarmed by the kernel itself and data is processed in a separate thread. Worker thread rearms the
+	 * socket with EPOLL_CTL_MOD when it's done, selector is not involved. Selector is woken up by the
+	 * eventfd only when workers closed some sockets, then all closed tasks are reclaimed at once.
+	 */
+	void CIPCModule::StartTCPSelector()
+	{
+		try
+		{
+			LOGDEBUG << "Start Selector thread";
+			if (m_iSelectorEpoll == -1 || m_iSelectorEvent == -1)
+			{
+				LOGFATAL << "Selector is not set up";
 				return;
 			}
 
+			struct epoll_event event;
+			boost::scoped_array<epoll_event> arrEvents(new epoll_event[g_iMaxEvents]);
 			int iNumDescriptors;
 			while (true)
 			{
-				iNumDescriptors = epoll_wait(epollFD, arrEvents.get(), g_iMaxEvents, -1);
+				iNumDescriptors = epoll_wait(m_iSelectorEpoll, arrEvents.get(), g_iMaxEvents, -1);
 
 				//came from wait - assume some socket in a list of descriptors triggered
-				//any of waited events
+				//any of waited events or some sockets were closed
 				m_ulSummaryOfParsing += m_spThreadModule->RemovePendingTasks();
 
 				//No go through all triggered socket descriptors and find out what's going on with each of them
 				//Three main cases are reviewed below:
 				// a. Error occurred against a descriptor
-				// b. Descriptor is a self-pipe so we need to add one new socket to the monitoring list
-				// c. Descriptor is an active socket with some data to read - need to remove it from monitoring list
-				//    and process data in a separate thread
+				// b. Descriptor is an eventfd, closed sockets are already reclaimed above - just reset the counter
+				// c. Descriptor is an active socket with some data to read - it's disarmed already, so simply
+				//    process data in a separate thread
 				for (int i = 0; i < iNumDescriptors; ++i)
 				{
 					// Case a. (error)
@@ -483,44 +591,22 @@ namespace IPC
 						LOGWARN << "Error in epoll_wait, err = "<<errno<<". Forse closing desc:"<<arrEvents[i].data.fd;
 						unsigned long ulTemp = 0;
 
-						if (epoll_ctl(epollFD, EPOLL_CTL_DEL, arrEvents[i].data.fd, &event) == -1)
+						if (epoll_ctl(m_iSelectorEpoll, EPOLL_CTL_DEL, arrEvents[i].data.fd, &event) == -1)
 						{
 							LOGERROR << "Unable to remove descriptor ("<<arrEvents[i].data.fd<<") controller #1, err="<<errno;
 						}
 						m_spThreadModule->RemoveTaskBySocket(arrEvents[i].data.fd,ulTemp);
 						continue;
 					}
-					// Case b. (self-pipe, new socket arrived)
-					else if (m_iSelectorPipe[0] == arrEvents[i].data.fd)
+					// Case b. (eventfd, some sockets were closed)
+					else if (m_iSelectorEvent == arrEvents[i].data.fd)
 					{
-						LOGDEBUG << "Pipe signal, handle new socket";
+						LOGDEBUG << "Eventfd signal, closed sockets are reclaimed";
 
-						int value;
-						if (read(m_iSelectorPipe[0],&value,sizeof(value)) == -1)
+						uint64_t ulValue;
+						if (read(m_iSelectorEvent,&ulValue,sizeof(ulValue)) == -1)
 						{
-							LOGERROR << "Error while reading from pipe ("<<m_iSelectorPipe[0]<<"), err= "<<errno;
-							continue;
-						}
-
-						//less than zero means socket is closed - simply skip it
-						if (value < 0)
-							continue;
-
-						{
-							// lock array with new pending sockets
-							boost::lock_guard<boost::mutex> lock(m_localAccess);
-							BOOST_FOREACH(int iSocketFD, m_listPendingSockets)
-							{
-								LOGDEBUG << "Process socketFD: "<<iSocketFD;
-								event.data.fd = iSocketFD;
-								event.events = EPOLLIN;
-								if (epoll_ctl(epollFD, EPOLL_CTL_ADD, iSocketFD, &event) == -1)
-								{
-									LOGERROR << "Unable to set descriptor controller, err = " <<errno;
-									continue;
-								}
-							}
-							m_listPendingSockets.clear();
+							LOGERROR << "Error while reading from eventfd ("<<m_iSelectorEvent<<"), err= "<<errno;
 						}
 					}
 					// Case c. (new data is available in one of the opened active sockets)
@@ -530,10 +616,6 @@ namespace IPC
 						spCTCPReceiveTask spTask;
 						if (m_spThreadModule->FindTaskBySocket(arrEvents[i].data.fd,spTask))
 						{
-							if (epoll_ctl(epollFD, EPOLL_CTL_DEL, arrEvents[i].data.fd, &event) == -1)
-							{
-								LOGERROR << "Unable to remove descriptor ("<<arrEvents[i].data.fd<<") controller #2, err="<<errno;
-							}
 							m_spThreadModule->RenewTask(spTask);
 						}
 					}
@@ -574,6 +656,9 @@ namespace IPC
 				{
 					case eCONFIG_KILL_PROCESS:
 					case eCONFIG_DAEMON_MODE:
+					case eCONFIG_DATA_INDEX:
+					case eCONFIG_DATA_SYNC:
+					case eCONFIG_UDP_READERS:
 						//this params are to be skipped, not intended for sending this out
 						break;
 					case eCONFIG_DATA_FILE:
@@ -625,35 +710,36 @@ namespace IPC
 
 	//////////////////////////////////////////////////////////////////////////
 	/*
-	 * Inter-thread method, used to notify TCPSelector thread about new incoming connections
-	 * which were established by the Listener thread. Notification is performed via unnamed pipe.
-	 * Write-end of the pipe belongs to the worker thread which was handling new incoming conn recently
-	 * Read-end of the pipe belongs to the Selector thread which is constantly waiting for 'read'
-	 * event via blocking call to the epoll_wait method
-	 * @param iNewDescriptor - in, new descriptor to be propagated to the TCPSelector monitoring list
+	 * Inter-thread method, invoked by the worker thread once it's done with the socket. Opened socket
+	 * is (re)armed in the epoll instance of TCPSelector right from the worker: it's modified in place and
+	 * added only if it's a new connection accepted by the Listener thread. Closed socket is left in the
+	 * pending-to-close list of thread pool and selector is woken up via eventfd to reclaim it
+	 * @param iDescriptor - in, descriptor to be monitored by the TCPSelector, negative if socket is closed
 	 */
-	void CIPCModule::NotifySelector(int iNewDescriptor)
+	void CIPCModule::NotifySelector(int iDescriptor)
 	{
 		try
 		{
-			LOGDEBUG << "Notify," << iNewDescriptor;
-			if (iNewDescriptor > 0)
-			{
-				boost::lock_guard<boost::mutex> lock(m_localAccess);
-				m_listPendingSockets.push_back(iNewDescriptor);
-			}
-
-			//check write-end of the pipe
-			if (m_iSelectorPipe[1] == 0)
+			LOGDEBUG << "Notify," << iDescriptor;
+			if (iDescriptor < 0)
 			{
-				LOGFATAL << "Error while handling write-end of the pipe.";
+				uint64_t ulValue = 1;
+				if (write(m_iSelectorEvent,&ulValue,sizeof(ulValue)) == -1)
+				{
+					LOGERROR << "Error while writing to eventfd ("<<m_iSelectorEvent<<"), err= "<<errno;
+				}
 				return;
 			}
 
-			int value = iNewDescriptor;
-			if (write(m_iSelectorPipe[1],&value,sizeof(value)) == -1)
+			struct epoll_event event;
+			event.data.fd = iDescriptor;
+			event.events = EPOLLIN | EPOLLONESHOT;
+			if (epoll_ctl(m_iSelectorEpoll, EPOLL_CTL_MOD, iDescriptor, &event) == -1)
 			{
-				LOGERROR << "Error while writing to pipe ("<<m_iSelectorPipe[1]<<"), err= "<<errno;
+				if (errno != ENOENT || epoll_ctl(m_iSelectorEpoll, EPOLL_CTL_ADD, iDescriptor, &event) == -1)
+				{
+					LOGERROR << "Unable to set descriptor ("<<iDescriptor<<") controller, err = " <<errno;
+				}
 			}
 		}
 		CATCH
@@ -0,0 +1,183 @@
+//native
+#include "MaintenanceQueue.h"
+#include "Logger.h"
+//thirdparty
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+
+using namespace trc;
+
+namespace IPC
+{
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Overloaded constructor, launches expiry thread
+	 * @param funcDispatcher - in, routine to pass replayed requests to the thread pool
+	 * @param ulMaxRequests - in, max number of requests kept in the queue
+	 * @param iMaxAgeSec - in, max time request is kept in the queue, in seconds
+	 */
+	CMaintenanceQueue::CMaintenanceQueue(const tFuncDispatcher& funcDispatcher, unsigned long ulMaxRequests, int iMaxAgeSec):
+		m_funcDispatcher(funcDispatcher),
+		m_ulMaxRequests(ulMaxRequests),
+		m_tdMaxAge(boost::posix_time::seconds(iMaxAgeSec)),
+		m_ulParkedRequests(0),
+		m_bIsMaintenance(false),
+		m_bNeedExit(false),
+		m_threadExpiry(boost::bind(&CMaintenanceQueue::ExpiryThread,this))
+	{}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Destructor, stops expiry thread. Requests which are still parked are dropped
+	 */
+	CMaintenanceQueue::~CMaintenanceQueue()
+	{
+		try
+		{
+			{
+				boost::lock_guard<boost::mutex> lock(m_Access);
+				m_bNeedExit = true;
+			}
+			m_condExpire.notify_one();
+			m_threadExpiry.join();
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Park the request if maintenance mode is on. Request which doesn't fit in the queue is
+	 * rejected at once
+	 * @param funcReplay - in, routine to process the request once maintenance is over
+	 * @param funcReject - in, routine to reject the request
+	 * @param iRequests - in, number of client requests held by the routines
+	 * @return bool - true if request is taken by the queue, false if it should be processed now
+	 */
+	bool CMaintenanceQueue::Park(const tFuncParked& funcReplay, const tFuncParked& funcReject, unsigned int iRequests)
+	{
+		try
+		{
+			{
+				boost::lock_guard<boost::mutex> lock(m_Access);
+				if (!m_bIsMaintenance)
+					return false;
+
+				if (m_ulParkedRequests + iRequests <= m_ulMaxRequests)
+				{
+					SParkedRequest request;
+					request.m_ptExpire = boost::get_system_time() + m_tdMaxAge;
+					request.m_iRequests = iRequests;
+					request.m_funcReplay = funcReplay;
+					request.m_funcReject = funcReject;
+					m_dequeRequests.push_back(request);
+					m_ulParkedRequests += iRequests;
+					//expiry thread waits for the oldest request only
+					if (m_dequeRequests.size() == 1)
+						m_condExpire.notify_one();
+					return true;
+				}
+			}
+
+			LOGWARN << "Maintenance queue is full, reject " << iRequests << " request(s)";
+			funcReject();
+			return true;
+		}
+		CATCH
+		return false;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Turn maintenance mode on or off. Once it's off all parked requests are passed to the thread
+	 * pool in arrival order; queue is locked meanwhile so that new requests are not processed earlier
+	 * @param bIsMaintenance - in, true to turn maintenance mode on
+	 */
+	void CMaintenanceQueue::SetMaintenance(bool bIsMaintenance)
+	{
+		try
+		{
+			boost::lock_guard<boost::mutex> lock(m_Access);
+			m_bIsMaintenance = bIsMaintenance;
+			if (m_bIsMaintenance || m_dequeRequests.empty())
+				return;
+
+			LOGDEBUG << "Maintenance is over, replay " << m_ulParkedRequests << " request(s)";
+			for (tDequeRequests::const_iterator iter = m_dequeRequests.begin(); iter != m_dequeRequests.end(); ++iter)
+				m_funcDispatcher(iter->m_funcReplay);
+			m_dequeRequests.clear();
+			m_ulParkedRequests = 0;
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Get maintenance mode
+	 * @return bool - true if maintenance mode is on
+	 */
+	bool CMaintenanceQueue::IsMaintenance()
+	{
+		boost::lock_guard<boost::mutex> lock(m_Access);
+		return m_bIsMaintenance;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Get number of parked requests, used for statistics
+	 * @return uLong - number of client requests in the queue
+	 */
+	unsigned long CMaintenanceQueue::GetNumberOfRequests()
+	{
+		boost::lock_guard<boost::mutex> lock(m_Access);
+		return m_ulParkedRequests;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Main routine of the expiry thread. Requests are parked in arrival order and expire in the same
+	 * order, so the thread sleeps until the oldest request expires and rejects all expired ones
+	 */
+	void CMaintenanceQueue::ExpiryThread()
+	{
+		try
+		{
+			LOGDEBUG << "Maintenance queue started";
+			std::vector<tFuncParked> vecExpired;
+			boost::unique_lock<boost::mutex> lock(m_Access);
+			while (!m_bNeedExit)
+			{
+				if (m_dequeRequests.empty())
+				{
+					m_condExpire.wait(lock);
+					continue;
+				}
+
+				boost::posix_time::ptime ptCurrent = boost::get_system_time();
+				if (m_dequeRequests.front().m_ptExpire > ptCurrent)
+				{
+					m_condExpire.timed_wait(lock,m_dequeRequests.front().m_ptExpire);
+					continue;
+				}
+
+				while (!m_dequeRequests.empty() && (m_dequeRequests.front().m_ptExpire <= ptCurrent))
+				{
+					vecExpired.push_back(m_dequeRequests.front().m_funcReject);
+					m_ulParkedRequests -= m_dequeRequests.front().m_iRequests;
+					m_dequeRequests.pop_front();
+				}
+
+				//reject without the lock, so that workers could park new requests meanwhile
+				lock.unlock();
+				LOGWARN << "Reject " << vecExpired.size() << " expired parked request(s)";
+				for (std::vector<tFuncParked>::const_iterator iter = vecExpired.begin(); iter != vecExpired.end(); ++iter)
+					(*iter)();
+				vecExpired.clear();
+				lock.lock();
+			}
+		}
+		CATCH
+		LOGDEBUG << "Exit maintenance queue thread";
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+}
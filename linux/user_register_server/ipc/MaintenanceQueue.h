@@ -0,0 +1,74 @@
+
+#ifndef MAINTENANCEQUEUE_H_
+#define MAINTENANCEQUEUE_H_
+
+//thirdparty
+#include <deque>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace IPC
+{
+	//////////////////////////////////////////////////////////////////////////
+	//routine of the parked request, holds everything request needs to be processed or rejected
+	typedef boost::function<void()> tFuncParked;
+	//routine which passes replayed request to the thread pool
+	typedef boost::function<void(const tFuncParked&)> tFuncDispatcher;
+
+	//request received in maintenance mode
+	struct SParkedRequest
+	{
+		boost::posix_time::ptime m_ptExpire;
+		unsigned int m_iRequests;
+		tFuncParked m_funcReplay;
+		tFuncParked m_funcReject;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	/**
+	 * Class which keeps requests received in maintenance mode, so that worker threads return to the
+	 * pool instead of waiting for the maintenance to be over. Requests are replayed in arrival order
+	 * once maintenance is turned off. Queue is bounded: request which doesn't fit or waits for too
+	 * long is rejected, which is supposed to answer 'Service Unavailable' to the client
+	 */
+	class CMaintenanceQueue
+	{
+	private: //permit no copy and default creation
+		CMaintenanceQueue();
+		CMaintenanceQueue(const CMaintenanceQueue& src);
+		CMaintenanceQueue& operator= (const CMaintenanceQueue& src);
+
+	public: //methods
+		CMaintenanceQueue(const tFuncDispatcher& funcDispatcher, unsigned long ulMaxRequests, int iMaxAgeSec);
+		virtual ~CMaintenanceQueue();
+		bool Park(const tFuncParked& funcReplay, const tFuncParked& funcReject, unsigned int iRequests);
+		void SetMaintenance(bool bIsMaintenance);
+		bool IsMaintenance();
+		unsigned long GetNumberOfRequests();
+
+	private: //methods
+		void ExpiryThread();
+
+	private: //types
+		typedef std::deque<SParkedRequest> tDequeRequests;
+
+	private: //members
+		tFuncDispatcher m_funcDispatcher;
+		unsigned long m_ulMaxRequests;
+		boost::posix_time::time_duration m_tdMaxAge;
+		tDequeRequests m_dequeRequests;
+		unsigned long m_ulParkedRequests;
+		bool m_bIsMaintenance;
+		bool m_bNeedExit;
+		boost::mutex m_Access;
+		boost::condition_variable m_condExpire;
+		boost::thread m_threadExpiry;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+} //namespace IPC
+#endif /* MAINTENANCEQUEUE_H_ */
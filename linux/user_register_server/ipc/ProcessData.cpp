@@ -1,190 +1,158 @@
-
 //native
 #include "ProcessData.h"
-#include "Logger.h"
-//thirdparty
-#include <boost/spirit/home/classic.hpp>
-#include <boost/algorithm/string.hpp>
 
 //////////////////////////////////////////////////////////////////////////
 
 namespace IPC
 {
 	//////////////////////////////////////////////////////////////////////////
-	using namespace boost::spirit;
-	using namespace classic;
-	using namespace std;
-	using namespace trc;
-
-	//////////////////////////////////////////////////////////////////////////
-	struct add_section
+	//struct with the requests type
+	static const char* g_szRequestNames[] =
 	{
-		add_section( RequestMessage & data ) : data_(data) {}
-		void operator()(const char* p, const char* q) const
-		{
-			string s(p,q);
-			boost::algorithm::trim(s);
-			data_.push_back( RequestData( s, Entries() ) );
-		}
-
-		RequestMessage & data_;
+		"REGISTER",
+		"GET"
 	};
 
-	//////////////////////////////////////////////////////////////////////////
-	struct add_key
-	{
-		add_key( RequestMessage & data ) : data_(data) {}
-
-		void operator()(const char* p, const char* q) const
-		{
-			string s(p,q);
-			boost::algorithm::trim(s);
-			data_.back().second.push_back( Entry( s, string() ) );
-		}
-
-		RequestMessage & data_;
-	};
+	//username tag
+	static const char* g_szUsernameTag = "username";
+	//email tag
+	static const char* g_szEmailTag = "email";
 
 	//////////////////////////////////////////////////////////////////////////
-	struct add_value
-	{
-		add_value( RequestMessage & data ) : data_(data) {}
-		void operator()(const char* p, const char* q) const
-		{
-			data_.back().second.back().second.assign(p, q);
-		}
-
-		RequestMessage & data_;
-	};
-
-	//////////////////////////////////////////////////////////////////////////
-	struct append_value
-	{
-		append_value( RequestMessage & data ) : data_(data) {}
-		void operator()(const char* p, const char* q) const
-		{
-			data_.back().second.back().second.append(p, q);
-		}
-
-		void operator()(const char& ch) const
-		{
-			data_.back().second.back().second += ch;
-		}
-
-		RequestMessage & data_;
-	};
+	//character classes of the request, same as the 'C' locale ones used by the former grammar
+	static inline bool IsBlank(char ch) { return ch == ' ' || ch == '\t'; }
+	static inline bool IsAlpha(char ch) { return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z'); }
+	static inline bool IsAlnum(char ch) { return IsAlpha(ch) || (ch >= '0' && ch <= '9'); }
+	static inline bool IsUsername(char ch) { return IsAlnum(ch) || ch == ' ' || ch == '.'; }
+	static inline bool IsMail(char ch) { return IsAlnum(ch) || ch == '-' || ch == '_' || ch == '.'; }
+	static inline bool IsSeparator(char ch) { return ch == ';'; }
 
 	//////////////////////////////////////////////////////////////////////////
-	struct requestdata_parser : public grammar<requestdata_parser>
+	/*
+	 * Skip symbols of the given class
+	 * @param szPos - in, current position
+	 * @param szEnd - in, end of the buffer
+	 * @param funcIsMatched - in, character class
+	 * @return const char* - first position which doesn't match the class
+	 */
+	static inline const char* SkipWhile(const char* szPos, const char* szEnd, bool (*funcIsMatched)(char))
 	{
-		requestdata_parser(RequestMessage & data) : data_(data) {}
-
-		template <typename ScannerT>
-		struct definition
-		{
-			rule<ScannerT> requestdata, section, entryUsr, entryMail, paramName,
-						serviceData,  username, mail;
-			rule<ScannerT> const& start() const { return requestdata; }
-
-			definition(requestdata_parser const& self)
-			{
-				requestdata = *section;
-
-				section = *blank_p
-						>> serviceData[add_section(self.data_)]
-						>> entryUsr
-						>> *entryMail;
-
-				entryUsr = paramName
-						>> username[add_value(self.data_)]
-						>> *blank_p
-						>> *ch_p(';');
-
-				entryMail = paramName
-						>> mail[add_value(self.data_)]
-						>> ch_p('@')[append_value(self.data_)]
-						>> mail[append_value(self.data_)]
-						>> *blank_p
-						>> *ch_p(';');
-
-				paramName = *blank_p
-						>> serviceData[add_key(self.data_)]
-						>> *blank_p
-						>> ch_p('=')
-						>> *blank_p;
-
-				serviceData = +(alpha_p);
-				username  = +(alnum_p | chset<>(" .") );
-				mail = +(alnum_p | chset<>("-_.") );
-			}
-		};
-
-		RequestMessage & data_;
-	};
-
-	//////////////////////////////////////////////////////////////////////////
-	struct first_is
-	{
-		first_is(std::string const& s) : s_(s) {}
-		template< class Pair >
-		bool operator()(Pair const& p) const { return p.first == s_; }
-		string const& s_;
-	};
+		while (szPos != szEnd && funcIsMatched(*szPos))
+			++szPos;
+		return szPos;
+	}
 
 	//////////////////////////////////////////////////////////////////////////
-	bool find_value( RequestMessage const& msg, string const& s, string const& p, string & res )
+	/*
+	 * Parse '<blanks>key<blanks>=<blanks>' part of the entry
+	 * @param szPos - in/out, current position, moved past the part if it's parsed
+	 * @param szEnd - in, end of the buffer
+	 * @param refKey - in/out, key of the entry
+	 * @return bool - true if part is parsed
+	 */
+	static bool ParseKey(const char*& szPos, const char* szEnd, tStringRef& refKey)
 	{
-		RequestMessage::const_iterator sit = find_if(msg.begin(), msg.end(), first_is(s));
-		if (sit == msg.end())
+		const char* szKey = SkipWhile(szPos,szEnd,IsBlank);
+		const char* szCurrent = SkipWhile(szKey,szEnd,IsAlpha);
+		if (szCurrent == szKey)
 			return false;
+		refKey = tStringRef(szKey,szCurrent-szKey);
 
-		Entries::const_iterator it = find_if(sit->second.begin(), sit->second.end(), first_is(p));
-		if (it == sit->second.end())
+		szCurrent = SkipWhile(szCurrent,szEnd,IsBlank);
+		if (szCurrent == szEnd || *szCurrent != '=')
 			return false;
-
-		res = it->second;
+		szPos = SkipWhile(szCurrent+1,szEnd,IsBlank);
 		return true;
 	}
 
 	//////////////////////////////////////////////////////////////////////////
-	CProcessData::CProcessData()
+	/*
+	 * Parse '<blanks>command' part of the request
+	 * @param szPos - in/out, current position, moved past the command
+	 * @param szEnd - in, end of the buffer
+	 * @return int - request ID, eREQUEST_UNDEFINED if command is unknown
+	 */
+	static int ParseCommand(const char*& szPos, const char* szEnd)
 	{
-		try
+		const char* szCommand = SkipWhile(szPos,szEnd,IsBlank);
+		szPos = SkipWhile(szCommand,szEnd,IsAlpha);
+		tStringRef refCommand(szCommand,szPos-szCommand);
+		for (int iRequestIndex = eREQUEST_UNDEFINED+1; iRequestIndex < eREQUEST_COUNT; ++iRequestIndex)
 		{
-			m_spParser.reset(new requestdata_parser(m_Data));
+			if (refCommand == g_szRequestNames[iRequestIndex])
+				return iRequestIndex;
 		}
-		CATCH
+		return eREQUEST_UNDEFINED;
 	}
 
 	//////////////////////////////////////////////////////////////////////////
-	bool CProcessData::Parse(const std::string& strTargetString)
+	/*
+	 * Get type of the request without parsing its entries, used to classify requests before they are processed
+	 * @param szBegin - in, beginning of the request
+	 * @param szEnd - in, end of the request
+	 * @return int - request ID, eREQUEST_UNDEFINED if request type is not recognized
+	 */
+	int CProcessData::GetRequestID(const char* szBegin, const char* szEnd)
 	{
-		try
-		{
-			parse_info<> info = parse(strTargetString.c_str(), *m_spParser.get(), nothing_p);
-			if (!info.hit)
-			{
-				LOGWARN << "Error parsing input string";
-			}
-			else
-				return true;
-		}
-		CATCH
-		return false;
+		return ParseCommand(szBegin,szEnd);
 	}
 
 	//////////////////////////////////////////////////////////////////////////
-	bool CProcessData::GetValue(const char* szRequestType, const char* szRequestField, std::string& strReturnValue)
+	/*
+	 * Parse the request. Only the first occurrence of each known key is kept, username is
+	 * returned without trailing spaces
+	 * @param szBegin - in, beginning of the request
+	 * @param szEnd - in, end of the request
+	 * @param request - in/out, parsed request
+	 * @return bool - true if request type is recognized
+	 */
+	bool CProcessData::Parse(const char* szBegin, const char* szEnd, SRequest& request)
 	{
-		try
+		request.m_refUsername.clear();
+		request.m_refEmail.clear();
+
+		const char* szPos = szBegin;
+		request.m_iRequestID = ParseCommand(szPos,szEnd);
+		if (request.m_iRequestID == eREQUEST_UNDEFINED)
+			return false;
+
+		tStringRef refKey;
+		for (bool bIsFirstEntry = true; ParseKey(szPos,szEnd,refKey); bIsFirstEntry = false)
 		{
-			if (find_value(m_Data,szRequestType,szRequestField,strReturnValue) )
-				return true;
+			const char* szValue = szPos;
+			if (bIsFirstEntry)
+			{
+				szPos = SkipWhile(szPos,szEnd,IsUsername);
+				if (szPos == szValue)
+					break;
+			}
 			else
-				return false;
+			{
+				szPos = SkipWhile(szPos,szEnd,IsMail);
+				if (szPos == szValue || szPos == szEnd || *szPos != '@')
+					break;
+				const char* szDomain = szPos+1;
+				szPos = SkipWhile(szDomain,szEnd,IsMail);
+				if (szPos == szDomain)
+					break;
+			}
+
+			tStringRef refValue(szValue,szPos-szValue);
+			if (refKey == g_szUsernameTag && request.m_refUsername.empty())
+			{
+				while (!refValue.empty() && refValue.back() == ' ')
+					refValue.remove_suffix(1);
+				request.m_refUsername = refValue;
+			}
+			else if (refKey == g_szEmailTag && request.m_refEmail.empty())
+			{
+				request.m_refEmail = refValue;
+			}
+
+			szPos = SkipWhile(szPos,szEnd,IsBlank);
+			szPos = SkipWhile(szPos,szEnd,IsSeparator);
 		}
-		CATCH
-		return false;
+		return true;
 	}
 
 	//////////////////////////////////////////////////////////////////////////
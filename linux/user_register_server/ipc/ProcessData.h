@@ -3,38 +3,50 @@
 #define PROCESSDATA_H_
 
 //thirdparty
-#include <list>
-#include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/utility/string_ref.hpp>
 
 namespace IPC
 {
 	//////////////////////////////////////////////////////////////////////////
-	typedef  std::pair<std::string, std::string>    Entry;
-	typedef  std::list<Entry>            Entries;
-	typedef  std::pair<std::string, Entries>   RequestData;
-	typedef  std::list<RequestData>           RequestMessage;
+	//view into the buffer of the request, valid until the buffer is changed
+	typedef boost::string_ref tStringRef;
 
-	//////////////////////////////////////////////////////////////////////////
-	struct requestdata_parser;
+	enum etRequestID
+	{
+		eREQUEST_UNDEFINED = - 1,
+		//request ID according to the names in global array
+		eREQUEST_REGISTER,
+		eREQUEST_GET,
+
+		eREQUEST_COUNT
+	};
 
+	//parsed request, username and email point into the parsed buffer
+	struct SRequest
+	{
+		int m_iRequestID;
+		tStringRef m_refUsername;
+		tStringRef m_refEmail;
+	};
 
+	//////////////////////////////////////////////////////////////////////////
+	/**
+	 * Single-pass parser of the client requests. Request line looks like
+	 * 'REGISTER username=<name>; email=<mail>@<domain>' or 'GET username=<name>', the first
+	 * entry holds letters, digits, spaces and dots, the rest are emails. Like the grammar it replaces,
+	 * parser stops at the first symbol it doesn't expect and keeps what was recognized so far.
+	 * Nothing is copied or allocated: results point into the parsed buffer
+	 */
 	class CProcessData
 	{
-	private: //permit no copy
+	private: //permit no creation, parser has no state
+		CProcessData();
 		CProcessData(const CProcessData& src);
 		CProcessData& operator= (const CProcessData& src);
 
 	public: //methods
-		CProcessData();
-		virtual ~CProcessData(){;}
-
-		bool Parse(const std::string& strTargetString);
-		bool GetValue(const char* szRequestType, const char* szRequestField, std::string& strReturnValue);
-		void Clean() { m_Data.clear(); }
-
-	private: //members
-		RequestMessage m_Data;
-		boost::shared_ptr<requestdata_parser> m_spParser; //  Our parser
+		static bool Parse(const char* szBegin, const char* szEnd, SRequest& request);
+		static int GetRequestID(const char* szBegin, const char* szEnd);
 	};
 
 } /* namespace IPC */
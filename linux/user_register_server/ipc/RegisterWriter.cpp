@@ -0,0 +1,336 @@
+//native
+#include "RegisterWriter.h"
+#include "ThreadPoolModule.h"
+#include "Logger.h"
+//thirdparty
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fstream>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/unordered_set.hpp>
+
+using namespace trc;
+
+namespace IPC
+{
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Overloaded constructor, launches writer thread
+	 * @param fileAccess - in, sync object which guards data register file
+	 * @param iMaxRecords - in, max number of records in the data register file
+	 */
+	CRegisterWriter::CRegisterWriter(boost::shared_mutex& fileAccess, int iMaxRecords):
+		m_bSyncData(false),
+		m_iMaxRecords(iMaxRecords),
+		m_ulBatches(0),
+		m_ulRecords(0),
+		m_bNeedExit(false),
+		m_fileAccess(fileAccess),
+		m_threadWriter(boost::bind(&CRegisterWriter::WriterThread,this))
+	{}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Destructor, stops writer thread. Registrations which are not written yet are failed
+	 */
+	CRegisterWriter::~CRegisterWriter()
+	{
+		try
+		{
+			{
+				boost::lock_guard<boost::mutex> lock(m_Access);
+				m_bNeedExit = true;
+			}
+			m_condPending.notify_one();
+			m_threadWriter.join();
+
+			boost::lock_guard<boost::mutex> lock(m_Access);
+			for (std::list<spSRegistration>::const_iterator iter = m_listPending.begin(); iter != m_listPending.end(); ++iter)
+			{
+				(*iter)->m_result = eREGISTER_FAILED;
+				(*iter)->m_bIsCommitted = true;
+			}
+			m_listPending.clear();
+			m_condCommitted.notify_all();
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Put the registration into the next batch and wait until the batch is written
+	 * @param strDataRegisterFile - in, data register file
+	 * @param strUsername - in, username of the new record
+	 * @param strEmail - in, email of the new record
+	 * @return etRegisterResult - result of the registration
+	 */
+	etRegisterResult CRegisterWriter::Register(const std::string& strDataRegisterFile, const std::string& strUsername, const std::string& strEmail)
+	{
+		try
+		{
+			spSRegistration spRegistration(new SRegistration());
+			spRegistration->m_strDataRegisterFile = strDataRegisterFile;
+			spRegistration->m_strUsername = strUsername;
+			spRegistration->m_strEmail = strEmail;
+			spRegistration->m_result = eREGISTER_UNDEFINED;
+			spRegistration->m_bIsCommitted = false;
+
+			boost::unique_lock<boost::mutex> lock(m_Access);
+			if (m_bNeedExit)
+				return eREGISTER_FAILED;
+
+			m_listPending.push_back(spRegistration);
+			m_condPending.notify_one();
+			while (!spRegistration->m_bIsCommitted)
+				m_condCommitted.wait(lock);
+			return spRegistration->m_result;
+		}
+		CATCH
+		return eREGISTER_FAILED;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Set index of the data register file, lookups and appends of the next batches go through it
+	 * @param spDataIndex - in, index or empty pointer if index mode is off
+	 */
+	void CRegisterWriter::SetDataIndex(const boost::shared_ptr<CDataIndex>& spDataIndex)
+	{
+		boost::lock_guard<boost::mutex> lock(m_Access);
+		m_spDataIndex = spDataIndex;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Turn on syncing the data register file to the disk after each batch
+	 * @param iDataSync - in, sync mode, either 0 or 1
+	 */
+	void CRegisterWriter::SetDataSync(int iDataSync)
+	{
+		boost::lock_guard<boost::mutex> lock(m_Access);
+		m_bSyncData = (iDataSync != 0);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Get number of batches written, used for statistics
+	 * @return uLong - number of batches
+	 */
+	unsigned long CRegisterWriter::GetNumberOfBatches()
+	{
+		boost::lock_guard<boost::mutex> lock(m_Access);
+		return m_ulBatches;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Get number of records written, used for statistics
+	 * @return uLong - number of records
+	 */
+	unsigned long CRegisterWriter::GetNumberOfRecords()
+	{
+		boost::lock_guard<boost::mutex> lock(m_Access);
+		return m_ulRecords;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Main routine of the writer thread. Takes all pending registrations for the same file as one
+	 * batch; registrations which arrive meanwhile form the next batch
+	 */
+	void CRegisterWriter::WriterThread()
+	{
+		try
+		{
+			LOGDEBUG << "Register writer started";
+			tVectorRegistrations vecBatch;
+			boost::unique_lock<boost::mutex> lock(m_Access);
+			while (!m_bNeedExit)
+			{
+				if (m_listPending.empty())
+				{
+					m_condPending.wait(lock);
+					continue;
+				}
+
+				//data file may be changed in maintenance mode, batch never spans two files
+				const std::string strDataRegisterFile = m_listPending.front()->m_strDataRegisterFile;
+				std::list<spSRegistration>::iterator iter = m_listPending.begin();
+				while (iter != m_listPending.end())
+				{
+					if ((*iter)->m_strDataRegisterFile == strDataRegisterFile)
+					{
+						vecBatch.push_back(*iter);
+						iter = m_listPending.erase(iter);
+					}
+					else
+						++iter;
+				}
+				boost::shared_ptr<CDataIndex> spDataIndex = m_spDataIndex;
+				bool bSyncData = m_bSyncData;
+
+				//write without the lock, so that workers could queue the next batch meanwhile
+				lock.unlock();
+				CommitBatch(vecBatch,spDataIndex,bSyncData);
+				lock.lock();
+
+				++m_ulBatches;
+				for (tVectorRegistrations::const_iterator iterBatch = vecBatch.begin(); iterBatch != vecBatch.end(); ++iterBatch)
+				{
+					if ((*iterBatch)->m_result == eREGISTER_DONE)
+						++m_ulRecords;
+					(*iterBatch)->m_bIsCommitted = true;
+				}
+				vecBatch.clear();
+				m_condCommitted.notify_all();
+			}
+		}
+		CATCH
+		LOGDEBUG << "Exit register writer thread";
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Resolve and write one batch. Result of each registration is set here
+	 * @param vecBatch - in, registrations for the same data register file
+	 * @param spDataIndex - in, index of the file, empty if index mode is off
+	 * @param bSyncData - in, true if file has to be synced to the disk
+	 */
+	void CRegisterWriter::CommitBatch(const tVectorRegistrations& vecBatch, const boost::shared_ptr<CDataIndex>& spDataIndex, bool bSyncData)
+	{
+		try
+		{
+			const std::string& strDataRegisterFile = vecBatch.front()->m_strDataRegisterFile;
+			tVectorRecords vecRecords;
+			if (ResolveBatch(vecBatch,spDataIndex,vecRecords))
+			{
+				bool bIsWritten = true;
+				if (!vecRecords.empty())
+				{
+					bIsWritten = spDataIndex ? spDataIndex->Append(strDataRegisterFile,vecRecords) : WriteRecords(strDataRegisterFile,vecRecords);
+					if (bIsWritten && bSyncData)
+						bIsWritten = SyncFile(strDataRegisterFile);
+				}
+
+				LOGDEBUG << "Register batch committed, size="<<vecBatch.size()<<", records="<<vecRecords.size()<<", written="<<bIsWritten;
+				for (tVectorRegistrations::const_iterator iter = vecBatch.begin(); iter != vecBatch.end(); ++iter)
+				{
+					if ((*iter)->m_result == eREGISTER_UNDEFINED)
+						(*iter)->m_result = bIsWritten ? eREGISTER_DONE : eREGISTER_FAILED;
+				}
+				return;
+			}
+		}
+		CATCH
+
+		for (tVectorRegistrations::const_iterator iter = vecBatch.begin(); iter != vecBatch.end(); ++iter)
+			(*iter)->m_result = eREGISTER_FAILED;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Decide which registrations of the batch are accepted. File is looked up once per batch,
+	 * registrations are checked against the file and against ones accepted earlier in the same batch.
+	 * Rejected registrations get their result, accepted ones are left undefined
+	 * @param vecBatch - in, registrations for the same data register file
+	 * @param spDataIndex - in, index of the file, empty if index mode is off
+	 * @param vecRecords - in/out, records to be appended to the file
+	 * @return bool - false if file cannot be read
+	 */
+	bool CRegisterWriter::ResolveBatch(const tVectorRegistrations& vecBatch, const boost::shared_ptr<CDataIndex>& spDataIndex, tVectorRecords& vecRecords)
+	{
+		const std::string& strDataRegisterFile = vecBatch.front()->m_strDataRegisterFile;
+		std::vector<bool> vecIsPresent(vecBatch.size(),false);
+		std::string strEmail;
+		int iLines = 0;
+		if (spDataIndex)
+		{
+			for (size_t i = 0; i < vecBatch.size(); ++i)
+			{
+				bool bIsPresent = false;
+				iLines = spDataIndex->Find(strDataRegisterFile,vecBatch[i]->m_strUsername,strEmail,bIsPresent);
+				if (iLines == -1)
+					return false;
+				vecIsPresent[i] = bIsPresent;
+			}
+		}
+		else
+		{
+			std::list<std::string> listRecords;
+			iLines = CBaseTask::ReadFile(strDataRegisterFile,listRecords);
+			if (iLines == -1)
+				return false;
+			for (size_t i = 0; i < vecBatch.size(); ++i)
+				vecIsPresent[i] = CBaseTask::FindInRecords(listRecords,vecBatch[i]->m_strUsername,strEmail);
+		}
+
+		iLines = std::min(iLines,m_iMaxRecords);
+		boost::unordered_set<std::string> setAccepted;
+		for (size_t i = 0; i < vecBatch.size(); ++i)
+		{
+			const SRegistration& registration = *vecBatch[i];
+			if (iLines + (int)vecRecords.size() >= m_iMaxRecords)
+			{
+				vecBatch[i]->m_result = eREGISTER_OVERLOADED;
+			}
+			else if (vecIsPresent[i] || !setAccepted.insert(registration.m_strUsername).second)
+			{
+				vecBatch[i]->m_result = eREGISTER_CONFLICT;
+			}
+			else
+			{
+				vecRecords.push_back(std::make_pair(registration.m_strUsername,registration.m_strEmail));
+			}
+		}
+		return true;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Append records to the data register file with a single write
+	 * @param strDataRegisterFile - in, data register file
+	 * @param vecRecords - in, new records
+	 * @return bool - true if records were written to the file
+	 */
+	bool CRegisterWriter::WriteRecords(const std::string& strDataRegisterFile, const tVectorRecords& vecRecords)
+	{
+		std::string strRecords = CDataIndex::FormatRecords(vecRecords);
+		boost::lock_guard<boost::shared_mutex> lock(m_fileAccess);
+		std::ofstream dataOut(strDataRegisterFile.c_str(), std::fstream::app);
+		if (dataOut.good())
+		{
+			dataOut << strRecords << std::flush;
+			if (dataOut.good())
+				return true;
+		}
+		LOGERROR << "Error while writing to file: "<< strDataRegisterFile;
+		return false;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Flush data of the register file to the disk. Done without the file lock, so readers
+	 * are not blocked while the disk (or NFS server) commits the data
+	 * @param strDataRegisterFile - in, data register file
+	 * @return bool - true if data is synced
+	 */
+	bool CRegisterWriter::SyncFile(const std::string& strDataRegisterFile)
+	{
+		int iFileDesc = open(strDataRegisterFile.c_str(),O_RDONLY|O_CLOEXEC);
+		if (iFileDesc == -1)
+		{
+			LOGERROR << "Unable to open file for sync: "<< strDataRegisterFile<<", err="<<errno;
+			return false;
+		}
+		bool bIsSynced = (fdatasync(iFileDesc) == 0);
+		if (!bIsSynced)
+			LOGERROR << "Unable to sync file: "<< strDataRegisterFile<<", err="<<errno;
+		close(iFileDesc);
+		return bIsSynced;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+}
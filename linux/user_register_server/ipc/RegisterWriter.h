@@ -0,0 +1,90 @@
+
+#ifndef REGISTERWRITER_H_
+#define REGISTERWRITER_H_
+
+//native
+#include "DataIndex.h"
+//thirdparty
+#include <list>
+#include <vector>
+#include <string>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+
+namespace IPC
+{
+	//////////////////////////////////////////////////////////////////////////
+	//result of the registration, decided by the writer thread
+	enum etRegisterResult
+	{
+		eREGISTER_UNDEFINED = - 1,
+		eREGISTER_DONE,
+		eREGISTER_CONFLICT,
+		eREGISTER_OVERLOADED,
+		eREGISTER_FAILED
+	};
+
+	//registration waiting for its batch to be committed
+	struct SRegistration
+	{
+		std::string m_strDataRegisterFile;
+		std::string m_strUsername;
+		std::string m_strEmail;
+		etRegisterResult m_result;
+		bool m_bIsCommitted;
+	};
+	typedef boost::shared_ptr<SRegistration> spSRegistration;
+	typedef std::vector<spSRegistration> tVectorRegistrations;
+
+	//////////////////////////////////////////////////////////////////////////
+	/**
+	 * Class which appends new records to the data register file from a single writer thread.
+	 * Registrations which arrive while a batch is being written are collected into the next batch,
+	 * so that the file is opened (and optionally synced) once per batch rather than once per record.
+	 * Conflicts and the records limit are resolved against the file and the batch itself, and
+	 * worker thread gets the result only when its batch is written
+	 */
+	class CRegisterWriter
+	{
+	private: //permit no copy and default creation
+		CRegisterWriter();
+		CRegisterWriter(const CRegisterWriter& src);
+		CRegisterWriter& operator= (const CRegisterWriter& src);
+
+	public: //methods
+		CRegisterWriter(boost::shared_mutex& fileAccess, int iMaxRecords);
+		virtual ~CRegisterWriter();
+		etRegisterResult Register(const std::string& strDataRegisterFile, const std::string& strUsername, const std::string& strEmail);
+		void SetDataIndex(const boost::shared_ptr<CDataIndex>& spDataIndex);
+		void SetDataSync(int iDataSync);
+		unsigned long GetNumberOfBatches();
+		unsigned long GetNumberOfRecords();
+
+	private: //methods
+		void WriterThread();
+		void CommitBatch(const tVectorRegistrations& vecBatch, const boost::shared_ptr<CDataIndex>& spDataIndex, bool bSyncData);
+		bool ResolveBatch(const tVectorRegistrations& vecBatch, const boost::shared_ptr<CDataIndex>& spDataIndex, tVectorRecords& vecRecords);
+		bool WriteRecords(const std::string& strDataRegisterFile, const tVectorRecords& vecRecords);
+		bool SyncFile(const std::string& strDataRegisterFile);
+
+	private: //members
+		std::list<spSRegistration> m_listPending;
+		boost::shared_ptr<CDataIndex> m_spDataIndex;
+		bool m_bSyncData;
+		int m_iMaxRecords;
+		unsigned long m_ulBatches;
+		unsigned long m_ulRecords;
+		bool m_bNeedExit;
+		boost::shared_mutex& m_fileAccess;
+		boost::mutex m_Access;
+		boost::condition_variable m_condPending;
+		boost::condition_variable m_condCommitted;
+		boost::thread m_threadWriter;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+} //namespace IPC
+#endif /* REGISTERWRITER_H_ */
@@ -0,0 +1,246 @@
+//native
+#include "ResponseScheduler.h"
+#include "UDPBatch.h"
+#include "Logger.h"
+//thirdparty
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+
+using namespace trc;
+
+namespace IPC
+{
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Default constructor, launches timer thread
+	 */
+	CResponseScheduler::CResponseScheduler():
+		m_ulSequence(0),
+		m_bNeedExit(false),
+		m_threadTimer(boost::bind(&CResponseScheduler::TimerThread,this))
+	{}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Destructor, stops timer thread. Responses which are not sent yet are dropped
+	 */
+	CResponseScheduler::~CResponseScheduler()
+	{
+		try
+		{
+			{
+				boost::lock_guard<boost::mutex> lock(m_Access);
+				m_bNeedExit = true;
+			}
+			m_condWake.notify_one();
+			m_threadTimer.join();
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Put the response in the heap, timer thread is woken up only if the response has to be sent
+	 * earlier than any other kept response
+	 * @param spResponse - in, response with the wake time set
+	 */
+	void CResponseScheduler::Schedule(const spSDeferredResponse& spResponse)
+	{
+		try
+		{
+			bool bIsEarliest = false;
+			{
+				boost::lock_guard<boost::mutex> lock(m_Access);
+				spResponse->m_ulSequence = ++m_ulSequence;
+				m_queueResponses.push(spResponse);
+				bIsEarliest = (m_queueResponses.top() == spResponse);
+			}
+			if (bIsEarliest)
+				m_condWake.notify_one();
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Get number of responses waiting to be sent, used for statistics
+	 * @return uLong - number of kept responses
+	 */
+	unsigned long CResponseScheduler::GetNumberOfResponses()
+	{
+		boost::lock_guard<boost::mutex> lock(m_Access);
+		return m_queueResponses.size();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Send the response to the client, either TCP or UDP one
+	 * @param response - in, response to be sent
+	 * @param iFlags - in, flags for the send operation
+	 */
+	void CResponseScheduler::Send(const SDeferredResponse& response, int iFlags)
+	{
+		try
+		{
+			if (response.m_bIsUDPSocket)
+			{
+				if (sendto(response.m_iSocketDesc,response.m_strResponse.c_str(),response.m_strResponse.length(),iFlags,
+						(sockaddr*)&response.m_udpClient,sizeof(response.m_udpClient)) == -1)
+				{
+					LOGERROR << "Error while sending data to the remote UDP socket ("<<response.m_iSocketDesc<<"), err="<<errno;
+				}
+			}
+			else
+			{
+				if (send(response.m_iSocketDesc,response.m_strResponse.c_str(),response.m_strResponse.length(),iFlags) == -1)
+				{
+					LOGERROR << "Error while sending data to the remote TCP socket ("<<response.m_iSocketDesc<<"), err="<<errno;
+				}
+			}
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	//order of the responses for batch sending: UDP ones are grouped by socket
+	static bool IsSentBefore(const SDeferredResponse* pLeft, const SDeferredResponse* pRight)
+	{
+		if (pLeft->m_bIsUDPSocket != pRight->m_bIsUDPSocket)
+			return pRight->m_bIsUDPSocket;
+		return pLeft->m_iSocketDesc < pRight->m_iSocketDesc;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Send several responses. TCP responses are sent one by one, UDP responses for the same
+	 * socket are sent with 'sendmmsg' calls. Order of the responses for one socket is kept
+	 * @param vecResponses - in/out, responses to be sent, reordered by the socket
+	 * @param iFlags - in, flags for the send operation
+	 */
+	void CResponseScheduler::Send(tVectorResponsePtrs& vecResponses, int iFlags)
+	{
+		try
+		{
+			std::stable_sort(vecResponses.begin(),vecResponses.end(),IsSentBefore);
+
+			struct mmsghdr arrMessages[g_iMaxDatagrams];
+			struct iovec arrData[g_iMaxDatagrams];
+			size_t i = 0;
+			while (i < vecResponses.size())
+			{
+				const SDeferredResponse* pFirst = vecResponses[i];
+				if (!pFirst->m_bIsUDPSocket)
+				{
+					Send(*pFirst,iFlags);
+					++i;
+					continue;
+				}
+
+				unsigned int iCount = 0;
+				for ( ; i < vecResponses.size() && iCount < g_iMaxDatagrams &&
+						vecResponses[i]->m_iSocketDesc == pFirst->m_iSocketDesc; ++i, ++iCount)
+				{
+					const SDeferredResponse* pResponse = vecResponses[i];
+					arrData[iCount].iov_base = const_cast<char*>(pResponse->m_strResponse.data());
+					arrData[iCount].iov_len = pResponse->m_strResponse.length();
+					memset(&arrMessages[iCount],0,sizeof(arrMessages[iCount]));
+					arrMessages[iCount].msg_hdr.msg_name = const_cast<tSockAddr*>(&pResponse->m_udpClient);
+					arrMessages[iCount].msg_hdr.msg_namelen = sizeof(pResponse->m_udpClient);
+					arrMessages[iCount].msg_hdr.msg_iov = &arrData[iCount];
+					arrMessages[iCount].msg_hdr.msg_iovlen = 1;
+				}
+				SendDatagrams(pFirst->m_iSocketDesc,arrMessages,iCount,iFlags);
+			}
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Send prepared datagrams, 'sendmmsg' is repeated until all of them are sent. Datagram which
+	 * cannot be sent is skipped, the rest are dropped only if socket buffer is full
+	 * @param iSocketDesc - in, UDP socket
+	 * @param pMessages - in, datagrams to be sent
+	 * @param iCount - in, number of datagrams
+	 * @param iFlags - in, flags for the send operation
+	 */
+	void CResponseScheduler::SendDatagrams(int iSocketDesc, struct mmsghdr* pMessages, unsigned int iCount, int iFlags)
+	{
+		unsigned int iSent = 0;
+		while (iSent < iCount)
+		{
+			int iResult = sendmmsg(iSocketDesc,pMessages+iSent,iCount-iSent,iFlags);
+			if (iResult > 0)
+			{
+				iSent += iResult;
+				continue;
+			}
+
+			if (iResult == -1 && errno == EINTR)
+				continue;
+			LOGERROR << "Error while sending data to the remote UDP socket ("<<iSocketDesc<<"), err="<<errno;
+			if (iResult == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				break;
+			++iSent;
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Main routine of the timer thread. Sleeps until the earliest response is due, then sends all
+	 * due responses. Sending is non-blocking so that one slow client doesn't delay responses
+	 * to others; responses are small, so a socket buffer without room for them means client
+	 * doesn't read anything anyway
+	 */
+	void CResponseScheduler::TimerThread()
+	{
+		try
+		{
+			LOGDEBUG << "Response scheduler started";
+			std::vector<spSDeferredResponse> vecDueResponses;
+			tVectorResponsePtrs vecSendResponses;
+			boost::unique_lock<boost::mutex> lock(m_Access);
+			while (!m_bNeedExit)
+			{
+				if (m_queueResponses.empty())
+				{
+					m_condWake.wait(lock);
+					continue;
+				}
+
+				boost::posix_time::ptime ptCurrent = boost::get_system_time();
+				if (m_queueResponses.top()->m_ptWake > ptCurrent)
+				{
+					m_condWake.timed_wait(lock,m_queueResponses.top()->m_ptWake);
+					continue;
+				}
+
+				while (!m_queueResponses.empty() && (m_queueResponses.top()->m_ptWake <= ptCurrent))
+				{
+					vecDueResponses.push_back(m_queueResponses.top());
+					m_queueResponses.pop();
+				}
+
+				//send without the lock, so that workers could schedule new responses meanwhile
+				lock.unlock();
+				for (std::vector<spSDeferredResponse>::const_iterator iter = vecDueResponses.begin();
+						iter != vecDueResponses.end(); ++iter)
+				{
+					vecSendResponses.push_back(iter->get());
+				}
+				Send(vecSendResponses,MSG_DONTWAIT|MSG_NOSIGNAL);
+				vecSendResponses.clear();
+				vecDueResponses.clear();
+				lock.lock();
+			}
+		}
+		CATCH
+		LOGDEBUG << "Exit response scheduler thread";
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+}
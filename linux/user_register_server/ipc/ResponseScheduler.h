@@ -0,0 +1,92 @@
+
+#ifndef RESPONSESCHEDULER_H_
+#define RESPONSESCHEDULER_H_
+
+//thirdparty
+#include <queue>
+#include <vector>
+#include <string>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace IPC
+{
+	//////////////////////////////////////////////////////////////////////////
+	//some forward typedefs
+	class CBaseSocket;
+	typedef boost::shared_ptr<CBaseSocket> spCBaseSocket;
+	typedef struct sockaddr_in tSockAddr;
+
+	//////////////////////////////////////////////////////////////////////////
+	/**
+	 * Response which is already composed but has to be kept until the 'sleep' interval
+	 * is over. TCP response holds the socket wrapper, so the socket is not closed (and its
+	 * descriptor is not reused by another client) until response is sent
+	 */
+	struct SDeferredResponse
+	{
+		boost::posix_time::ptime m_ptWake;
+		unsigned long m_ulSequence;
+		int m_iSocketDesc;
+		bool m_bIsUDPSocket;
+		tSockAddr m_udpClient;
+		spCBaseSocket m_spSocket;
+		std::string m_strResponse;
+	};
+	typedef boost::shared_ptr<SDeferredResponse> spSDeferredResponse;
+	typedef std::vector<SDeferredResponse> tVectorResponses;
+	typedef std::vector<const SDeferredResponse*> tVectorResponsePtrs;
+
+	//////////////////////////////////////////////////////////////////////////
+	/**
+	 * Class which keeps deferred responses in a heap ordered by the wake time and sends them
+	 * from a single timer thread. Worker threads of the pool just schedule a response and return
+	 * to the pool, so number of responses per second doesn't depend on the 'sleep' setting
+	 */
+	class CResponseScheduler
+	{
+	private: //permit no copy
+		CResponseScheduler(const CResponseScheduler& src);
+		CResponseScheduler& operator= (const CResponseScheduler& src);
+
+	public: //methods
+		CResponseScheduler();
+		virtual ~CResponseScheduler();
+		void Schedule(const spSDeferredResponse& spResponse);
+		unsigned long GetNumberOfResponses();
+		static void Send(const SDeferredResponse& response, int iFlags);
+		static void Send(tVectorResponsePtrs& vecResponses, int iFlags);
+
+	private: //methods
+		void TimerThread();
+		static void SendDatagrams(int iSocketDesc, struct mmsghdr* pMessages, unsigned int iCount, int iFlags);
+
+	private: //types
+		struct SWakeLater
+		{
+			bool operator() (const spSDeferredResponse& left, const spSDeferredResponse& right) const
+			{
+				if (left->m_ptWake != right->m_ptWake)
+					return left->m_ptWake > right->m_ptWake;
+				return left->m_ulSequence > right->m_ulSequence;
+			}
+		};
+		typedef std::priority_queue<spSDeferredResponse, std::vector<spSDeferredResponse>, SWakeLater> tQueueResponses;
+
+	private: //members
+		tQueueResponses m_queueResponses;
+		unsigned long m_ulSequence;
+		bool m_bNeedExit;
+		boost::mutex m_Access;
+		boost::condition_variable m_condWake;
+		boost::thread m_threadTimer;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+} //namespace IPC
+#endif /* RESPONSESCHEDULER_H_ */
@@ -1,6 +1,7 @@
 
 //native
 #include "ThreadPoolModule.h"
+#include "UDPBatch.h"
 #include "Logger.h"
 //thirdparty
 #include <fcntl.h>
@@ -13,6 +14,7 @@
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
 
 using namespace trc;
 
@@ -20,8 +22,6 @@ namespace IPC
 {
 	using namespace boost::threadpool;
 	boost::shared_mutex CBaseTask::m_sharedFileAccess;
-	boost::condition_variable CBaseTask::m_condMaintenance;
-	boost::mutex CBaseTask::m_mutexMaintenance;
 
 	//////////////////////////////////////////////////////////////////////////
 	//terminating symbol
@@ -30,31 +30,16 @@ namespace IPC
 	const size_t g_iMaxUsernameLength = 160;
 	//max message length
 	const int g_iMaxMessageLength = 4*g_iMaxBufferSize;
-	//username tag
-	const std::string g_strUsernameTag = "username";
-	//email tag
-	const std::string g_strEmailTag = "email";
 	//max records in a file
 	const int g_iMaxRecords = 100;
+	//max number of requests kept while maintenance mode is on
+	const unsigned long g_iMaxParkedRequests = 1000;
+	//max time request is kept while maintenance mode is on, in seconds
+	const int g_iMaxParkedSeconds = 30;
+	//max number of tasks scheduled later which are taken from the thread queue ahead of a write task
+	const unsigned long g_iMaxWriteOvertakes = 100;
 
 
-	//struct with the requests type
-	static const char* g_szRequestNames[] =
-	{
-		"REGISTER",
-		"GET"
-	};
-
-	enum etRequestID
-	{
-		eREQUEST_UNDEFINED = - 1,
-		//request ID according to the names in global array
-		eREQUEST_REGISTER,
-		eREQUEST_GET,
-
-		eREQUEST_COUNT
-	};
-
 	typedef enum _etResponseCode
 	{
 		eRESPONSE_UNDEFINED = - 1,
@@ -142,18 +127,6 @@ namespace IPC
 	{
 		try
 		{
-			try
-			{
-				//in case of maintenance mode this function freezes the whole thread
-				//unless process is killed or maintenance mode is not turned off via command line option
-				if (m_ptrThreadPool->GetMaintenance())
-				{
-					boost::unique_lock<boost::mutex> lock(m_mutexMaintenance);
-					m_condMaintenance.wait(lock);
-				}
-			}
-			CATCH
-
 			//need local time to maintain the 'sleep' interval before sending data back to the client
 			boost::posix_time::ptime timeStart = boost::get_system_time();
 			int iTimeout = m_ptrThreadPool->GetSendTimeout();
@@ -172,181 +145,112 @@ namespace IPC
 				{
 					strResponseMessage = m_ptrThreadPool->GetResponseMessage(eRESPONSE_BAD_REQUEST);
 					m_strMsgBuffer.clear();
-					SleepBeforeSend(timeStart,iTimeout);
-					if (bIsUDPSocket)
-					{
-						if (sendto(m_iSocketDesc,strResponseMessage.c_str(),strResponseMessage.length(),0,(sockaddr*)&m_udpClient,sizeof(m_udpClient)) == -1)
-						{
-							LOGERROR << "Error #1 while sending data to the remote UDP socket ("<<m_iSocketDesc<<"), err="<<errno;
-						}
-					}
-					else
-					{
-						if (write(m_iSocketDesc,strResponseMessage.c_str(),strResponseMessage.length()) == -1)
-						{
-							LOGERROR << "Error #2 while writing data to the remote TCP socket ("<<m_iSocketDesc<<"), err="<<errno;
-						}
-					}
+					SendResponse(strResponseMessage,timeStart,iTimeout,bIsUDPSocket);
 				}
 			}
 			else
 			{
 				// 2. Once termination symbol is found let's parse
 				LOGDEBUG << "Termination found";
-				std::list<std::string> strListRequests;
-				std::string strTempMessage("");
+				//requests are parsed in place, buffer is cut once all complete requests are handled
+				size_t posRequest = 0;
+				SRequest request;
 				eResponseCode respCode = eRESPONSE_UNDEFINED;
-				int iRequestIndex = -1;
-				bool bStopParsing = false;
 				std::string strUsername(""), strEmail("");
 				while (posTerm != std::string::npos)
 				{
-					//capture temp message, starting from zero position up to termination symbol
-					posTerm += g_strRequestTerminator.length();
-					strTempMessage = m_strMsgBuffer.substr(0,posTerm);
-					m_strMsgBuffer.erase(0,posTerm);
-					posTerm = m_strMsgBuffer.find(g_strRequestTerminator);
-
-					if (m_spProcessData->Parse(strTempMessage))
+					const char* szRequest = m_strMsgBuffer.data();
+					if (CProcessData::Parse(szRequest+posRequest,szRequest+posTerm,request))
 					{
-						//request seems to be parsed, let's traverse through the tree of params-values to see
-						//if parser got something useful for us
-						for (iRequestIndex = eREQUEST_UNDEFINED+1; iRequestIndex < eREQUEST_COUNT && !bStopParsing; ++iRequestIndex)
+						//each request should have different logic in terms of parsing the file
+						switch (request.m_iRequestID)
 						{
-							//each request should have different logic in terms of parsing the file
-							switch (iRequestIndex)
-							{
-								case eREQUEST_REGISTER:
-									try
+							case eREQUEST_REGISTER:
+								try
+								{
+									if (!request.m_refUsername.empty() && !request.m_refEmail.empty())
 									{
-										if (m_spProcessData->GetValue(g_szRequestNames[iRequestIndex],g_strUsernameTag.c_str(),strUsername) &&
-											m_spProcessData->GetValue(g_szRequestNames[iRequestIndex],g_strEmailTag.c_str(),strEmail) )
+										if ((request.m_refUsername.length() > g_iMaxUsernameLength) ||
+												request.m_refEmail.find('@') == tStringRef::npos)
 										{
-											bStopParsing = true;
-											boost::trim(strUsername);
-											boost::trim(strEmail);
-											if (strUsername.empty() || strEmail.empty() || (strUsername.length() > g_iMaxUsernameLength) ||
-													strEmail.find('@') == std::string::npos)
-											{
-												respCode = eRESPONSE_NOT_ACCEPTABLE;
-												break;
-											}
-
-											std::list<std::string> listRecords;
-											int iLines = ReadFile(listRecords);
-
-											if (iLines == g_iMaxRecords)
-											{
-												respCode = eRESPONSE_OVERLOADED;
-												break;
-											}
-
-											if ( iLines == -1)
-											{
-												respCode = eRESPONSE_SERVICE_UNAVAILABLE;
-												break;
-											}
-
-											bool bIsPresent = false;
-											strUsername += ";";
-											BOOST_FOREACH(const std::string& strTemp, listRecords)
-											{
-												if (strTemp.find(strUsername) != std::string::npos)
-												{
-													bIsPresent = true;
-													break;
-												}
-											}
-
-											if (!bIsPresent)
-											{
-												boost::lock_guard<boost::shared_mutex> lock(m_sharedFileAccess);
-												std::ofstream dataOut(m_strDataRegisterFile, std::fstream::app);
-												if (dataOut.good())
-												{
-													dataOut << strUsername << strEmail << std::endl;
-													respCode = eRESPONSE_OK;
-												}
-												else
-												{
-													LOGERROR << "Error while writing to file: "<< m_strDataRegisterFile;
-													respCode = eRESPONSE_SERVICE_UNAVAILABLE;
-												}
-											}
-											else
-											{
-												respCode = eRESPONSE_CONFLICT;
-											}
-											++m_ulSuccededParsing;
-										} // if (m_spProcessData->GetValue ...
-									}
-									catch(...)
-									{
-										LOGERROR << "Exception while processing request id: "<< iRequestIndex;
-										respCode = eRESPONSE_SERVICE_UNAVAILABLE;
-									}
-									break;
-								case eREQUEST_GET:
-									try
-									{
-										if (m_spProcessData->GetValue(g_szRequestNames[iRequestIndex],g_strUsernameTag.c_str(),strUsername))
+											respCode = eRESPONSE_NOT_ACCEPTABLE;
+											break;
+										}
+
+										strUsername.assign(request.m_refUsername.data(),request.m_refUsername.length());
+										strEmail.assign(request.m_refEmail.data(),request.m_refEmail.length());
+										//writer checks the record against the file and the other registrations of its batch
+										etRegisterResult result = m_ptrThreadPool->RegisterRecord(m_strDataRegisterFile,strUsername,strEmail);
+
+										if (result == eREGISTER_OVERLOADED)
 										{
-											bStopParsing = true;
-											boost::trim(strUsername);
-											if (strUsername.empty() || (strUsername.length() > g_iMaxUsernameLength))
-											{
-												respCode = eRESPONSE_NOT_ACCEPTABLE;
-												break;
-											}
-
-											++m_ulSuccededParsing;
-											std::list<std::string> listRecords;
-											int iLines = ReadFile(listRecords);
-
-											if ( iLines == -1)
-											{
-												respCode = eRESPONSE_SERVICE_UNAVAILABLE;
-												break;
-											}
-
-											bool bIsPresent = false;
-											strUsername += ";";
-											BOOST_FOREACH(const std::string& strTemp, listRecords)
-											{
-												if (strTemp.find(strUsername) != std::string::npos)
-												{
-													bIsPresent = true;
-													strEmail = strTemp.substr(strUsername.length(),strTemp.length()-strUsername.length());
-													break;
-												}
-											}
-
-											if (bIsPresent)
-											{
-												respCode = eRESPONSE_OK;
-											}
-											else
-											{
-												respCode = eRESPONSE_NOT_FOUND;
-											}
-
-											++m_ulSuccededParsing;
+											respCode = eRESPONSE_OVERLOADED;
+											break;
 										}
-									}
-									catch(...)
+
+										if (result != eREGISTER_DONE && result != eREGISTER_CONFLICT)
+										{
+											respCode = eRESPONSE_SERVICE_UNAVAILABLE;
+											break;
+										}
+
+										respCode = (result == eREGISTER_DONE) ? eRESPONSE_OK : eRESPONSE_CONFLICT;
+										++m_ulSuccededParsing;
+									} // if (!request.m_refUsername.empty() ...
+								}
+								catch(...)
+								{
+									LOGERROR << "Exception while processing request id: "<< request.m_iRequestID;
+									respCode = eRESPONSE_SERVICE_UNAVAILABLE;
+								}
+								break;
+							case eREQUEST_GET:
+								try
+								{
+									if (!request.m_refUsername.empty())
 									{
-										LOGERROR << "Exception while processing request id: "<< iRequestIndex;
-										respCode = eRESPONSE_SERVICE_UNAVAILABLE;
+										if (request.m_refUsername.length() > g_iMaxUsernameLength)
+										{
+											respCode = eRESPONSE_NOT_ACCEPTABLE;
+											break;
+										}
+
+										++m_ulSuccededParsing;
+										strUsername.assign(request.m_refUsername.data(),request.m_refUsername.length());
+										bool bIsPresent = false;
+										int iLines = FindRecord(strUsername,strEmail,bIsPresent);
+
+										if ( iLines == -1)
+										{
+											respCode = eRESPONSE_SERVICE_UNAVAILABLE;
+											break;
+										}
+
+										if (bIsPresent)
+										{
+											respCode = eRESPONSE_OK;
+										}
+										else
+										{
+											respCode = eRESPONSE_NOT_FOUND;
+										}
+
+										++m_ulSuccededParsing;
 									}
-									break;
-								default:
+								}
+								catch(...)
 								{
-									LOGERROR << "Trying to handle unknown request type";
-									respCode = eRESPONSE_BAD_REQUEST;
+									LOGERROR << "Exception while processing request id: "<< request.m_iRequestID;
+									respCode = eRESPONSE_SERVICE_UNAVAILABLE;
 								}
-							} // switch (iRequestIndex)
-						} // for (iRequestIndex = ...
-					} //if (m_spProcessData->Parse(strTempMessage))
+								break;
+							default:
+							{
+								LOGERROR << "Trying to handle unknown request type";
+								respCode = eRESPONSE_BAD_REQUEST;
+							}
+						} // switch (request.m_iRequestID)
+					} //if (CProcessData::Parse(...))
 
 					if (respCode == eRESPONSE_UNDEFINED)
 					{
@@ -360,7 +264,7 @@ namespace IPC
 
 					if (respCode == eRESPONSE_OK)
 					{
-						if (iRequestIndex-1 == eREQUEST_GET)
+						if (request.m_iRequestID == eREQUEST_GET)
 							strResponseMessage += " " + strEmail;
 						else
 							strResponseMessage += " OK";
@@ -369,48 +273,49 @@ namespace IPC
 
 					strResponseMessage += g_strRequestTerminator;
 
-					SleepBeforeSend(timeStart,iTimeout);
 					//do the 'send' staff and get ready for the new cycle
-					if (bIsUDPSocket)
-					{
-						if (sendto(m_iSocketDesc,strResponseMessage.c_str(),strResponseMessage.length(),0,(sockaddr*)&m_udpClient,sizeof(m_udpClient)) == -1)
-						{
-							LOGERROR << "Error #2 while sending data to the remote UDP socket ("<<m_iSocketDesc<<"), err="<<errno;
-						}
-					}
-					else
-					{
-						if (write(m_iSocketDesc,strResponseMessage.c_str(),strResponseMessage.length()) == -1)
-						{
-							LOGERROR << "Error #2 while sending data to the remote TCP socket ("<<m_iSocketDesc<<"), err="<<errno;
-						}
-					}
+					SendResponse(strResponseMessage,timeStart,iTimeout,bIsUDPSocket);
 
 					//prepare for parsing, cleanup for new cycle
-					if (posTerm != std::string::npos)
-					{
-						bStopParsing = false;
-						strUsername = "";
-						strEmail = "";
-						m_spProcessData->Clean();
-						strListRequests.clear();
-						iRequestIndex = -1;
-						strTempMessage = "";
-						respCode = eRESPONSE_UNDEFINED;
-					}
+					posRequest = posTerm + g_strRequestTerminator.length();
+					posTerm = m_strMsgBuffer.find(g_strRequestTerminator,posRequest);
+					respCode = eRESPONSE_UNDEFINED;
 				} // while (posTerm != std::string::npos)
+				m_strMsgBuffer.erase(0,posRequest);
 			} //if (posTerm != std::string::npos) - when we hot terminating symbol
 		}
 		CATCH
 	}
 
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Check if any complete request in the buffer writes to the data register file, such
+	 * requests are processed only by the limited number of worker threads
+	 * @return bool - true if buffer has REGISTER request
+	 */
+	bool CBaseTask::HasWriteRequests()
+	{
+		const char* szBuffer = m_strMsgBuffer.data();
+		size_t posRequest = 0;
+		size_t posTerm = m_strMsgBuffer.find(g_strRequestTerminator);
+		while (posTerm != std::string::npos)
+		{
+			if (CProcessData::GetRequestID(szBuffer+posRequest,szBuffer+posTerm) == eREQUEST_REGISTER)
+				return true;
+			posRequest = posTerm + g_strRequestTerminator.length();
+			posTerm = m_strMsgBuffer.find(g_strRequestTerminator,posRequest);
+		}
+		return false;
+	}
+
 	//////////////////////////////////////////////////////////////////////////
 	/*
 	 * Small routine to read file and count number of lines from it
+	 * @param strDataRegisterFile - in, data register file
 	 * @param listRecords - list where the contents of the file will be copied to
 	 * @return int - number of lines received from the file
 	 */
-	int CBaseTask::ReadFile(std::list<std::string>& listRecords)
+	int CBaseTask::ReadFile(const std::string& strDataRegisterFile, std::list<std::string>& listRecords)
 	{
 		int iLinesRead = -1;
 		try
@@ -419,7 +324,7 @@ namespace IPC
 			std::string strTemp;
 
 			boost::shared_lock<boost::shared_mutex> lock(m_sharedFileAccess);
-			std::ifstream dataIn(m_strDataRegisterFile, std::fstream::in);
+			std::ifstream dataIn(strDataRegisterFile, std::fstream::in);
 			if (dataIn.good())
 			{
 				while(!dataIn.eof() && (iLinesRead <= g_iMaxRecords))
@@ -441,20 +346,96 @@ namespace IPC
 
 	//////////////////////////////////////////////////////////////////////////
 	/*
-	 * Function to calc and put the thread to sleep if necessary (maintain the 'sleep' period)
-	 * @param ptStart - time the message was received and started to be processed
-	 * @param iTimeout - timeout we need to wait before sending the message back to client
-	 * See if this sleep interval already elapsed and we need to send the data back immediately
+	 * Find the record of the user in the data register file. In index mode the in-memory index
+	 * is used, otherwise the file is read and scanned line by line
+	 * @param strUsername - in, username to find
+	 * @param strEmail - in/out, email of the user if record is found
+	 * @param bIsPresent - in/out, true if record is found
+	 * @return int - number of records in the file (up to the max records), -1 if file cannot be read
+	 */
+	int CBaseTask::FindRecord(const std::string& strUsername, std::string& strEmail, bool& bIsPresent)
+	{
+		bIsPresent = false;
+		boost::shared_ptr<CDataIndex> spDataIndex = m_ptrThreadPool->GetDataIndex();
+		if (spDataIndex)
+		{
+			int iLines = spDataIndex->Find(m_strDataRegisterFile,strUsername,strEmail,bIsPresent);
+			return std::min(iLines,g_iMaxRecords);
+		}
+
+		std::list<std::string> listRecords;
+		int iLines = ReadFile(m_strDataRegisterFile,listRecords);
+		if (iLines == -1)
+			return iLines;
+
+		bIsPresent = FindInRecords(listRecords,strUsername,strEmail);
+		return iLines;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Scan records read from the data register file for the user
+	 * @param listRecords - in, lines of the file
+	 * @param strUsername - in, username to find
+	 * @param strEmail - in/out, email of the user if record is found
+	 * @return bool - true if record is found
 	 */
-	void CBaseTask::SleepBeforeSend(const boost::posix_time::ptime& ptStart, int iTimeout)
+	bool CBaseTask::FindInRecords(const std::list<std::string>& listRecords, const std::string& strUsername, std::string& strEmail)
+	{
+		std::string strRecordPrefix = strUsername + g_cRecordSeparator;
+		BOOST_FOREACH(const std::string& strTemp, listRecords)
+		{
+			if (strTemp.find(strRecordPrefix) != std::string::npos)
+			{
+				strEmail = strTemp.substr(strRecordPrefix.length(),strTemp.length()-strRecordPrefix.length());
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Function to send the response back to the client keeping the 'sleep' period. If the period
+	 * is not over yet the response is passed to the response scheduler and the worker thread returns
+	 * to the pool at once, otherwise the response is sent immediately. Once a response of the task
+	 * is deferred, all following ones go through the scheduler not earlier than the previous one,
+	 * so pipelined responses don't overtake each other
+	 * @param strResponse - in, response message to be sent
+	 * @param ptStart - in, time the message was received and started to be processed
+	 * @param iTimeout - in, timeout we need to wait before sending the message back to client
+	 * @param bIsUDPSocket - in, flag that we are in UDP stream
+	 */
+	void CBaseTask::SendResponse(const std::string& strResponse, const boost::posix_time::ptime& ptStart, int iTimeout, bool bIsUDPSocket)
 	{
 		try
 		{
-			boost::posix_time::ptime ptWake = ptStart + boost::posix_time::milliseconds(iTimeout);
-			boost::posix_time::ptime ptCurrent = boost::get_system_time();
-			if (ptWake > ptCurrent)
+			SDeferredResponse response;
+			response.m_ptWake = ptStart + boost::posix_time::milliseconds(iTimeout);
+			response.m_ulSequence = 0;
+			response.m_iSocketDesc = m_iSocketDesc;
+			response.m_bIsUDPSocket = bIsUDPSocket;
+			if (bIsUDPSocket)
+				response.m_udpClient = m_udpClient;
+			response.m_strResponse = strResponse;
+
+			bool bIsDeferring = !m_ptLastDeferred.is_not_a_date_time();
+			if (bIsDeferring && response.m_ptWake < m_ptLastDeferred)
+				response.m_ptWake = m_ptLastDeferred;
+
+			if (bIsDeferring || response.m_ptWake > boost::get_system_time())
 			{
-				boost::this_thread::sleep(ptWake - ptCurrent);
+				m_ptLastDeferred = response.m_ptWake;
+				response.m_spSocket = GetSocket();
+				m_ptrThreadPool->ScheduleResponse(spSDeferredResponse(new SDeferredResponse(response)));
+			}
+			else if (m_pResponseBatch)
+			{
+				m_pResponseBatch->push_back(response);
+			}
+			else
+			{
+				CResponseScheduler::Send(response,MSG_NOSIGNAL);
 			}
 		}
 		CATCH
@@ -497,18 +478,9 @@ namespace IPC
 				LOGDEBUG << "Client is dead, remove task and close the socket";
 
 				//check if internal buffer from previous reads is not empty - consider this as bad uncompleted request
+				//data register file is not touched, so there is no need to wait for the maintenance to be over
 				if (!m_strMsgBuffer.empty())
 				{
-					if (m_ptrThreadPool->GetMaintenance())
-					{
-						try
-						{
-							boost::unique_lock<boost::mutex> lock(m_mutexMaintenance);
-							m_condMaintenance.wait(lock);
-						}
-						CATCH
-					}
-
 					std::string strResponseMessage("");
 					strResponseMessage = m_ptrThreadPool->GetResponseMessage(eRESPONSE_BAD_REQUEST);
 					strResponseMessage += g_strRequestTerminator;
@@ -531,7 +503,10 @@ namespace IPC
 					//read and written to the buffer was different
 					m_strMsgBuffer.erase(iBufSize,m_strMsgBuffer.length() - iBufSize);
 				}
-				ProcessData();
+
+				//socket is not monitored until parked or delayed data is processed
+				if (!HandleData())
+					return;
 			} //else if ( iByteCount = recv(...) > 0)
 
 			m_bIsTaskCompleted = true;
@@ -542,6 +517,128 @@ namespace IPC
 		m_bIsTaskCompleted = true;
 	}
 
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Replay data parked in maintenance mode. Data is parked once again if maintenance mode
+	 * was turned on meanwhile
+	 */
+	void CTCPReceiveTask::ReplayData()
+	{
+		m_bIsTaskCompleted = false;
+		try
+		{
+			if (!HandleData())
+				return;
+			m_bIsTaskCompleted = true;
+			m_funcHandler(m_spSocket->GetDescriptor());
+		}
+		CATCH
+		//set it anyway, in case if exception occurred
+		m_bIsTaskCompleted = true;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Reject data parked in maintenance mode: every complete request gets 'Service Unavailable',
+	 * uncompleted one is kept for the next read
+	 */
+	void CTCPReceiveTask::RejectData()
+	{
+		try
+		{
+			std::string strResponse;
+			std::string strRejected = m_ptrThreadPool->GetResponseMessage(eRESPONSE_SERVICE_UNAVAILABLE) + g_strRequestTerminator;
+			size_t posRequest = 0;
+			size_t posTerm = m_strMsgBuffer.find(g_strRequestTerminator);
+			while (posTerm != std::string::npos)
+			{
+				strResponse += strRejected;
+				posRequest = posTerm + g_strRequestTerminator.length();
+				posTerm = m_strMsgBuffer.find(g_strRequestTerminator,posRequest);
+			}
+			m_strMsgBuffer.erase(0,posRequest);
+
+			//rejection doesn't wait for the 'sleep' period, but must not overtake deferred responses
+			if (!strResponse.empty())
+				SendResponse(strResponse,boost::get_system_time(),0,false);
+			m_bIsTaskCompleted = true;
+			m_funcHandler(m_spSocket->GetDescriptor());
+		}
+		CATCH
+		//set it anyway, in case if exception occurred
+		m_bIsTaskCompleted = true;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Pass the data to the maintenance queue if maintenance mode is on
+	 * @return bool - true if data is taken by the queue, false if it should be processed now
+	 */
+	bool CTCPReceiveTask::ParkData()
+	{
+		return m_ptrThreadPool->ParkRequest(boost::bind(&CTCPReceiveTask::ReplayData,shared_from_this()),
+				boost::bind(&CTCPReceiveTask::RejectData,shared_from_this()));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Process received data unless it's parked or has to wait for the free writer slot
+	 * @return bool - true if data is processed and socket can be monitored again
+	 */
+	bool CTCPReceiveTask::HandleData()
+	{
+		if (ParkData())
+			return false;
+
+		if (!HasWriteRequests())
+		{
+			ProcessData();
+			return true;
+		}
+
+		if (!m_ptrThreadPool->AcquireWriter(boost::bind(&CTCPReceiveTask::WriteData,shared_from_this())))
+			return false;
+		return ProcessWrites();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Process data with REGISTER requests, writer slot is taken by the caller and released here
+	 * @return bool - true if data is processed, false if it's parked
+	 */
+	bool CTCPReceiveTask::ProcessWrites()
+	{
+		bool bIsParked = false;
+		try
+		{
+			bIsParked = ParkData();
+			if (!bIsParked)
+				ProcessData();
+		}
+		CATCH
+		m_ptrThreadPool->ReleaseWriter();
+		return !bIsParked;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Process data which waited for the free writer slot, slot is handed over to the task
+	 */
+	void CTCPReceiveTask::WriteData()
+	{
+		m_bIsTaskCompleted = false;
+		try
+		{
+			if (!ProcessWrites())
+				return;
+			m_bIsTaskCompleted = true;
+			m_funcHandler(m_spSocket->GetDescriptor());
+		}
+		CATCH
+		//set it anyway, in case if exception occurred
+		m_bIsTaskCompleted = true;
+	}
+
 	//////////////////////////////////////////////////////////////////////////
 	/*
 	 * Overloaded constructor for the Thread Pool Module. Requires non-zero thread pool size
@@ -552,11 +649,19 @@ namespace IPC
 	 */
 	CThreadPoolModule::CThreadPoolModule(size_t iPoolSize, const std::string& strDataRegisterFile, int iSendTimeout):
 		m_strDataRegisterFile(strDataRegisterFile),
-		m_iSendTimeout(iSendTimeout)
+		m_iSendTimeout(iSendTimeout),
+		//registrations may take half of the pool at most, the rest is left for the reads
+		m_iMaxWriters(std::max<size_t>(1,iPoolSize/2)),
+		m_iActiveWriters(0),
+		m_ulTaskSequence(0)
 	{
 		try
 		{
-			m_spThreadPool.reset(new pool());
+			m_spResponseScheduler.reset(new CResponseScheduler());
+			m_spRegisterWriter.reset(new CRegisterWriter(CBaseTask::m_sharedFileAccess,g_iMaxRecords));
+			m_spMaintenanceQueue.reset(new CMaintenanceQueue(boost::bind(&CThreadPoolModule::DispatchTask,this,_1),
+					g_iMaxParkedRequests,g_iMaxParkedSeconds));
+			m_spThreadPool.reset(new tPrioPool());
 			m_spThreadPool->size_controller().resize(iPoolSize);
 
 			std::ostringstream out;
@@ -617,7 +722,22 @@ namespace IPC
 			// The main thread function (CThreadPoolModule::ProcessUDPData) accepts parameters by value (not by reference).
 			// This gives some overhead for temporary objects construction but we need because thread should accept
 			// unchanged values to start working with - references are not ok in this case. We could create CBaseTask
-			m_spThreadPool->schedule(boost::bind(&CThreadPoolModule::ProcessUDPData,this, iUDPSocket, udpClient, strBuffer));
+			Schedule(eTASK_PRIORITY_READ,boost::bind(&CThreadPoolModule::ProcessUDPData,this, iUDPSocket, udpClient, strBuffer));
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Adding datagrams read by the batched UDP reader to the thread queue, whole batch is
+	 * processed by one worker
+	 * @param spBatch - in, datagrams read from one UDP socket
+	 */
+	void CThreadPoolModule::AddTask(const spSUDPBatch& spBatch)
+	{
+		try
+		{
+			Schedule(eTASK_PRIORITY_READ,boost::bind(&CThreadPoolModule::ProcessUDPBatch,this,spBatch));
 		}
 		CATCH
 	}
@@ -631,7 +751,7 @@ namespace IPC
 	{
 		try
 		{
-			m_spThreadPool->schedule(boost::bind(&CTCPReceiveTask::ReceiveData,spTask));
+			Schedule(eTASK_PRIORITY_READ,boost::bind(&CTCPReceiveTask::ReceiveData,spTask));
 		}
 		CATCH
 	}
@@ -648,15 +768,193 @@ namespace IPC
 		try
 		{
 			LOGDEBUG << "Accepting new connection on UDP";
+			if (ParkRequest(boost::bind(&CThreadPoolModule::ProcessUDPData,this,iUDPSocket,udpClient,strBuffer),
+					boost::bind(&CThreadPoolModule::RejectUDPData,this,iUDPSocket,udpClient)))
+			{
+				return;
+			}
+
 			CBaseTask baseTask(iUDPSocket);
 			baseTask.AssignParrent(this);
 			baseTask.AssignUDPInfo(udpClient);
 			baseTask.AssignMessageBuffer(strBuffer);
+			if (baseTask.HasWriteRequests())
+			{
+				if (AcquireWriter(boost::bind(&CThreadPoolModule::WriteUDPData,this,iUDPSocket,udpClient,strBuffer)))
+					WriteUDPData(iUDPSocket,udpClient,strBuffer);
+				return;
+			}
 			baseTask.ProcessData(true);
 		}
 		CATCH
 	}
 
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Process UDP data with REGISTER requests, writer slot is taken by the caller and released here
+	 * @param iUDPSocket - in, UDP socket number, will be requied for sending data back
+	 * @param udpClient - in, client the datagram came from
+	 * @param strBuffer - in, string with the message
+	 */
+	void CThreadPoolModule::WriteUDPData(int iUDPSocket, tSockAddr udpClient, std::string strBuffer)
+	{
+		try
+		{
+			if (!ParkRequest(boost::bind(&CThreadPoolModule::ProcessUDPData,this,iUDPSocket,udpClient,strBuffer),
+					boost::bind(&CThreadPoolModule::RejectUDPData,this,iUDPSocket,udpClient)))
+			{
+				CBaseTask baseTask(iUDPSocket);
+				baseTask.AssignParrent(this);
+				baseTask.AssignUDPInfo(udpClient);
+				baseTask.AssignMessageBuffer(strBuffer);
+				baseTask.ProcessData(true);
+			}
+		}
+		CATCH
+		ReleaseWriter();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Send responses collected while the batch was processed
+	 * @param vecBatchResponses - in/out, responses of the batch, cleared once sent
+	 */
+	static void SendBatchResponses(tVectorResponses& vecBatchResponses)
+	{
+		if (vecBatchResponses.empty())
+			return;
+
+		tVectorResponsePtrs vecResponses;
+		vecResponses.reserve(vecBatchResponses.size());
+		for (tVectorResponses::const_iterator iter = vecBatchResponses.begin(); iter != vecBatchResponses.end(); ++iter)
+			vecResponses.push_back(&(*iter));
+		CResponseScheduler::Send(vecResponses,MSG_NOSIGNAL);
+		vecBatchResponses.clear();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Main thread routine to process batch of UDP datagrams. One task object is reused for all
+	 * datagrams, responses which are not deferred are sent back together once batch is processed.
+	 * Datagrams with REGISTER requests are moved to the beginning of the batch and processed once
+	 * writer slot is taken, the rest are answered at once
+	 * @param spBatch - in, datagrams read from one UDP socket
+	 */
+	void CThreadPoolModule::ProcessUDPBatch(spSUDPBatch spBatch)
+	{
+		try
+		{
+			if (ParkRequest(boost::bind(&CThreadPoolModule::ProcessUDPBatch,this,spBatch),
+					boost::bind(&CThreadPoolModule::RejectUDPBatch,this,spBatch),spBatch->m_iCount))
+			{
+				return;
+			}
+
+			CBaseTask baseTask(spBatch->m_iSocketDesc);
+			baseTask.AssignParrent(this);
+			baseTask.AssignResponseBatch(&spBatch->m_vecResponses);
+			unsigned int iWrites = 0;
+			for (unsigned int i = 0; i < spBatch->m_iCount; ++i)
+			{
+				baseTask.AssignUDPInfo(spBatch->m_udpClients[i]);
+				baseTask.AssignMessageBuffer(spBatch->m_szBuffers[i],spBatch->m_iLengths[i]);
+				if (baseTask.HasWriteRequests())
+				{
+					if (iWrites != i)
+					{
+						memcpy(spBatch->m_szBuffers[iWrites],spBatch->m_szBuffers[i],spBatch->m_iLengths[i]);
+						spBatch->m_iLengths[iWrites] = spBatch->m_iLengths[i];
+						spBatch->m_udpClients[iWrites] = spBatch->m_udpClients[i];
+					}
+					++iWrites;
+					continue;
+				}
+				baseTask.ProcessData(true);
+			}
+			SendBatchResponses(spBatch->m_vecResponses);
+
+			spBatch->m_iCount = iWrites;
+			if (iWrites && AcquireWriter(boost::bind(&CThreadPoolModule::WriteUDPBatch,this,spBatch)))
+				WriteUDPBatch(spBatch);
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Process batch of UDP datagrams with REGISTER requests, writer slot is taken by the caller
+	 * and released here
+	 * @param spBatch - in, datagrams read from one UDP socket
+	 */
+	void CThreadPoolModule::WriteUDPBatch(spSUDPBatch spBatch)
+	{
+		try
+		{
+			if (!ParkRequest(boost::bind(&CThreadPoolModule::ProcessUDPBatch,this,spBatch),
+					boost::bind(&CThreadPoolModule::RejectUDPBatch,this,spBatch),spBatch->m_iCount))
+			{
+				CBaseTask baseTask(spBatch->m_iSocketDesc);
+				baseTask.AssignParrent(this);
+				baseTask.AssignResponseBatch(&spBatch->m_vecResponses);
+				for (unsigned int i = 0; i < spBatch->m_iCount; ++i)
+				{
+					baseTask.AssignUDPInfo(spBatch->m_udpClients[i]);
+					baseTask.AssignMessageBuffer(spBatch->m_szBuffers[i],spBatch->m_iLengths[i]);
+					baseTask.ProcessData(true);
+				}
+				SendBatchResponses(spBatch->m_vecResponses);
+			}
+		}
+		CATCH
+		ReleaseWriter();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Reject UDP datagram parked in maintenance mode with 'Service Unavailable'
+	 * @param iUDPSocket - in, UDP socket number
+	 * @param udpClient - in, client the datagram came from
+	 */
+	void CThreadPoolModule::RejectUDPData(int iUDPSocket, tSockAddr udpClient)
+	{
+		try
+		{
+			SDeferredResponse response;
+			response.m_iSocketDesc = iUDPSocket;
+			response.m_bIsUDPSocket = true;
+			response.m_udpClient = udpClient;
+			response.m_strResponse = GetResponseMessage(eRESPONSE_SERVICE_UNAVAILABLE) + g_strRequestTerminator;
+			CResponseScheduler::Send(response,MSG_NOSIGNAL);
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Reject batch of UDP datagrams parked in maintenance mode, every datagram gets 'Service Unavailable'
+	 * @param spBatch - in, datagrams read from one UDP socket
+	 */
+	void CThreadPoolModule::RejectUDPBatch(spSUDPBatch spBatch)
+	{
+		try
+		{
+			SDeferredResponse response;
+			response.m_iSocketDesc = spBatch->m_iSocketDesc;
+			response.m_bIsUDPSocket = true;
+			response.m_strResponse = GetResponseMessage(eRESPONSE_SERVICE_UNAVAILABLE) + g_strRequestTerminator;
+			spBatch->m_vecResponses.assign(spBatch->m_iCount,response);
+
+			tVectorResponsePtrs vecResponses;
+			for (unsigned int i = 0; i < spBatch->m_iCount; ++i)
+			{
+				spBatch->m_vecResponses[i].m_udpClient = spBatch->m_udpClients[i];
+				vecResponses.push_back(&spBatch->m_vecResponses[i]);
+			}
+			CResponseScheduler::Send(vecResponses,MSG_NOSIGNAL);
+		}
+		CATCH
+	}
+
 	//////////////////////////////////////////////////////////////////////////
 	/*
 	 * Routine to find existing tasks based on the socket descriptor. ThreadPoolModule maintains the
@@ -742,7 +1040,8 @@ namespace IPC
 	//////////////////////////////////////////////////////////////////////////
 	/*
 	 * Routine to traverse through the internal container with pending sockets and
-	 * delete them and tasks assocated with them if possible
+	 * delete them and tasks assocated with them if possible. All closed sockets are reclaimed
+	 * at once, the ones which tasks are not completed yet are left for the next call
 	 * @return uLong - summary of succeeded parsings for all tasks
 	 *
 	 */
@@ -752,20 +1051,22 @@ namespace IPC
 		try
 		{
 			boost::lock_guard<boost::recursive_mutex> lock(m_RemoveAccess);
-			if (!m_listPendingRemoveSockets.size())
+			if (m_listPendingRemoveSockets.empty())
 				return ulSuccededParsing;
 
-			std::list<int>::iterator iterDeleter;
+			unsigned long ulTaskParsing = 0;
 			std::list<int>::iterator iterIndexer = m_listPendingRemoveSockets.begin();
 			while (iterIndexer != m_listPendingRemoveSockets.end())
 			{
-				iterDeleter = iterIndexer;
-				++iterIndexer;
-				if (RemoveTaskBySocket(*iterDeleter,ulSuccededParsing))
+				if (RemoveTaskBySocket(*iterIndexer,ulTaskParsing))
 				{
 					LOGDEBUG << "Erasing socket from pending list";
-					m_listPendingRemoveSockets.remove(*iterDeleter);
-					return ulSuccededParsing;
+					ulSuccededParsing += ulTaskParsing;
+					iterIndexer = m_listPendingRemoveSockets.erase(iterIndexer);
+				}
+				else
+				{
+					++iterIndexer;
 				}
 			}
 		}
@@ -796,16 +1097,113 @@ namespace IPC
 
 	//////////////////////////////////////////////////////////////////////////
 	/*
-	 * Function to set maintenance mode for the whole pool of tasks (both TCP and UDP)
+	 * Function to turn on in-memory index of the data register file. Should be called before
+	 * any task is processed
+	 * @param iDataIndex - index mode, either 0 or 1
+	 */
+	void CThreadPoolModule::SetDataIndex(int iDataIndex)
+	{
+		try
+		{
+			if (iDataIndex)
+				m_spDataIndex.reset(new CDataIndex(CBaseTask::m_sharedFileAccess));
+			else
+				m_spDataIndex.reset();
+			m_spRegisterWriter->SetDataIndex(m_spDataIndex);
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Function to set maintenance mode for the whole pool of tasks (both TCP and UDP). Requests
+	 * received meanwhile are parked and replayed once maintenance mode is turned off
 	 * @param iMaint - maintenance mode, either 0 or 1
 	 */
 	void CThreadPoolModule::SetMaintenance(int iMaint)
 	{
 		try
 		{
-			m_iMaintenance = iMaint;
-			if (m_iMaintenance == 0)
-				CBaseTask::m_condMaintenance.notify_all();
+			m_spMaintenanceQueue->SetMaintenance(iMaint != 0);
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Pass the task to the thread queue, used to replay requests parked in maintenance mode
+	 * @param funcTask - in, task routine
+	 */
+	void CThreadPoolModule::DispatchTask(const tFuncParked& funcTask)
+	{
+		try
+		{
+			Schedule(eTASK_PRIORITY_READ,funcTask);
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Pass the task to the thread queue with the priority of its request class. Tasks of the same
+	 * class are taken in the order they were scheduled. Write task is placed behind the tasks
+	 * scheduled after it, but not behind more than g_iMaxWriteOvertakes of them: under steady reads
+	 * write task holding the writer slot would wait forever otherwise
+	 * @param ePriority - in, request class of the task
+	 * @param funcTask - in, task routine
+	 */
+	void CThreadPoolModule::Schedule(etTaskPriority ePriority, const boost::threadpool::task_func& funcTask)
+	{
+		unsigned long ulOrder = 0;
+		{
+			boost::lock_guard<boost::mutex> lock(m_ScheduleAccess);
+			ulOrder = ++m_ulTaskSequence;
+		}
+		if (ePriority == eTASK_PRIORITY_WRITE)
+			ulOrder += g_iMaxWriteOvertakes;
+		m_spThreadPool->schedule(CPrioTask(ulOrder,funcTask));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Take writer slot to process REGISTER requests. If all slots are taken the write task is kept
+	 * until some slot is released, so that worker thread returns to the pool and serves reads meanwhile
+	 * @param funcWrite - in, routine to be scheduled with the writer slot handed over
+	 * @return bool - true if slot is taken and requests can be processed now
+	 */
+	bool CThreadPoolModule::AcquireWriter(const tFuncParked& funcWrite)
+	{
+		boost::lock_guard<boost::mutex> lock(m_WriterAccess);
+		if (m_iActiveWriters < m_iMaxWriters)
+		{
+			++m_iActiveWriters;
+			return true;
+		}
+		m_listPendingWrites.push_back(funcWrite);
+		return false;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Release writer slot. Slot is handed over to the oldest waiting write task, which is scheduled
+	 * with the low priority so that reads queued meanwhile are served first, up to the limit
+	 */
+	void CThreadPoolModule::ReleaseWriter()
+	{
+		try
+		{
+			tFuncParked funcWrite;
+			{
+				boost::lock_guard<boost::mutex> lock(m_WriterAccess);
+				if (m_listPendingWrites.empty())
+				{
+					--m_iActiveWriters;
+					return;
+				}
+				funcWrite = m_listPendingWrites.front();
+				m_listPendingWrites.pop_front();
+			}
+			Schedule(eTASK_PRIORITY_WRITE,funcWrite);
 		}
 		CATCH
 	}
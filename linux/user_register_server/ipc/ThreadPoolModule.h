@@ -4,6 +4,10 @@
 
 //native
 #include "ProcessData.h"
+#include "ResponseScheduler.h"
+#include "DataIndex.h"
+#include "RegisterWriter.h"
+#include "MaintenanceQueue.h"
 //thirdparty
 #include <list>
 #include <map>
@@ -13,8 +17,8 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
-#include <boost/thread/condition_variable.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/smart_ptr/enable_shared_from_this.hpp>
 #include <threadpool/threadpool.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
@@ -26,15 +30,57 @@ namespace IPC
 	const int g_iMaxBufferSize = 1600;
 
 	//some forward typedefs
-	class CBaseSocket;
 	class CTCPReceiveTask;
 	class CThreadPoolModule;
+	struct SUDPBatch;
 	typedef boost::shared_ptr<CTCPReceiveTask> spCTCPReceiveTask;
-	typedef boost::shared_ptr<CBaseSocket> spCBaseSocket;
+	typedef boost::shared_ptr<SUDPBatch> spSUDPBatch;
 	typedef std::map<int,spCTCPReceiveTask> tMapReceiveTasks;
 	typedef tMapReceiveTasks::iterator tIterMapReceiveTasks;
 	typedef boost::function<void(int)> tFuncSelectorNotifier;
-	typedef struct sockaddr_in tSockAddr;
+
+	//request classes, task of the higher class is taken from the thread queue first unless the task
+	//of the lower class has been overtaken by too many tasks already, see CThreadPoolModule::Schedule
+	enum etTaskPriority
+	{
+		//tasks which write to the data register file, waiting for the free writer slot
+		eTASK_PRIORITY_WRITE = 0,
+		//reading the sockets, reading the data register file
+		eTASK_PRIORITY_READ
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	/**
+	 * Task of the thread queue for prio_scheduler. Unlike prio_task_func tasks are taken in the
+	 * ascending order of their keys, so that tasks with equal priority go in the order of scheduling
+	 */
+	class CPrioTask
+	{
+	public:
+		typedef void result_type;
+
+		CPrioTask(unsigned long ulOrder, const boost::threadpool::task_func& funcTask):
+			m_ulOrder(ulOrder),
+			m_funcTask(funcTask)
+		{}
+
+		void operator() (void) const
+		{
+			if (m_funcTask)
+				m_funcTask();
+		}
+
+		bool operator< (const CPrioTask& rhs) const
+		{
+			return m_ulOrder > rhs.m_ulOrder;
+		}
+
+	private:
+		unsigned long m_ulOrder;
+		boost::threadpool::task_func m_funcTask;
+	};
+	typedef boost::threadpool::thread_pool<CPrioTask, boost::threadpool::prio_scheduler, boost::threadpool::static_size,
+			boost::threadpool::resize_controller, boost::threadpool::wait_for_all_tasks> tPrioPool;
 
 	//////////////////////////////////////////////////////////////////////////
 	/**
@@ -82,36 +128,43 @@ namespace IPC
 			m_strMsgBuffer(""),
 			m_strDataRegisterFile(""),
 			m_ulSuccededParsing(0),
-			m_iSocketDesc(iSocketDesc)
-		{
-			m_spProcessData.reset(new CProcessData());
-		}
+			m_iSocketDesc(iSocketDesc),
+			m_pResponseBatch(NULL)
+		{}
+		virtual ~CBaseTask(){;}
 
 	public: //methods
 		void ProcessData(bool bIsUDPSocket = false);
-		int ReadFile(std::list<std::string>& listRecords);
+		bool HasWriteRequests();
+		int FindRecord(const std::string& strUsername, std::string& strEmail, bool& bIsPresent);
+		static int ReadFile(const std::string& strDataRegisterFile, std::list<std::string>& listRecords);
+		static bool FindInRecords(const std::list<std::string>& listRecords, const std::string& strUsername, std::string& strEmail);
 		void AssignParrent(CThreadPoolModule* ptrParent) { m_ptrThreadPool = ptrParent; }
 		int GetDescriptor() { return m_iSocketDesc; }
 		bool IsCompleted() { return m_bIsTaskCompleted; }
 		unsigned long GetParsingStatistics() {return m_ulSuccededParsing; }
 		void AssignMessageBuffer(const std::string& strBuf) { m_strMsgBuffer = strBuf; }
+		void AssignMessageBuffer(const char* szBuf, size_t iLength) { m_strMsgBuffer.assign(szBuf,iLength); }
+		void AssignResponseBatch(tVectorResponses* pResponses) { m_pResponseBatch = pResponses; }
 		void AssignUDPInfo(const tSockAddr& udpClient) { m_udpClient = udpClient; }
-		void SleepBeforeSend(const boost::posix_time::ptime& ptStart, int iTimeout);
+		void SendResponse(const std::string& strResponse, const boost::posix_time::ptime& ptStart, int iTimeout, bool bIsUDPSocket);
+		virtual spCBaseSocket GetSocket() { return spCBaseSocket(); }
 
 	public: //members
-		static boost::condition_variable m_condMaintenance;
+		static boost::shared_mutex m_sharedFileAccess;
 
 	protected: //members
-		static boost::shared_mutex m_sharedFileAccess;
-		static boost::mutex m_mutexMaintenance;
 		CThreadPoolModule* m_ptrThreadPool;
-		boost::shared_ptr<CProcessData> m_spProcessData;
 		bool m_bIsTaskCompleted;
 		std::string m_strMsgBuffer;
 		std::string m_strDataRegisterFile;
 		unsigned long m_ulSuccededParsing;
 		int m_iSocketDesc;
 		tSockAddr m_udpClient;
+		//immediate responses are collected here instead of being sent, if set
+		tVectorResponses* m_pResponseBatch;
+		//wake time of the last deferred response, not_a_date_time if no response was deferred yet
+		boost::posix_time::ptime m_ptLastDeferred;
 	};
 
 	//////////////////////////////////////////////////////////////////////////
@@ -120,7 +173,7 @@ namespace IPC
 	 * from a client, marking task for deletion if remote client is closed. TCP clients are handled
 	 * within this kind of task as opposite to UDP clients which can be handled within CBaseTask
 	 */
-	class CTCPReceiveTask: public CBaseTask
+	class CTCPReceiveTask: public CBaseTask, public boost::enable_shared_from_this<CTCPReceiveTask>
 	{
 	private: //permit no copy and default creation
 		CTCPReceiveTask();
@@ -137,8 +190,17 @@ namespace IPC
 		}
 
 		void ReceiveData();
+		void ReplayData();
+		void RejectData();
+		void WriteData();
 		void AssignSelectorNotifier(const tFuncSelectorNotifier& func) {m_funcHandler = func;}
 		int GetDescriptor() { return m_spSocket->GetDescriptor(); }
+		virtual spCBaseSocket GetSocket() { return m_spSocket; }
+
+	private: //methods
+		bool ParkData();
+		bool HandleData();
+		bool ProcessWrites();
 
 	private:
 		spCBaseSocket m_spSocket;
@@ -164,13 +226,34 @@ namespace IPC
 		CThreadPoolModule(size_t iPoolSize, const std::string& strDataRegisterFile, int iSendTimeout);
 		void AddTask(const spCTCPReceiveTask& spTask);
 		void AddTask(int iUDPSocket, const tSockAddr& udpClient, const std::string& strBuffer);
+		void AddTask(const spSUDPBatch& spBatch);
 		void RenewTask(const spCTCPReceiveTask& spTask);
 		void ProcessUDPData(int iUDPSocket, tSockAddr udpClient, std::string strBuffer);
+		void ProcessUDPBatch(spSUDPBatch spBatch);
+		void RejectUDPData(int iUDPSocket, tSockAddr udpClient);
+		void RejectUDPBatch(spSUDPBatch spBatch);
+		void WriteUDPData(int iUDPSocket, tSockAddr udpClient, std::string strBuffer);
+		void WriteUDPBatch(spSUDPBatch spBatch);
+		bool AcquireWriter(const tFuncParked& funcWrite);
+		void ReleaseWriter();
+		bool ParkRequest(const tFuncParked& funcReplay, const tFuncParked& funcReject, unsigned int iRequests = 1)
+		{
+			return m_spMaintenanceQueue->Park(funcReplay,funcReject,iRequests);
+		}
+		unsigned long GetNumberOfParkedRequests() { return m_spMaintenanceQueue->GetNumberOfRequests(); }
 		bool FindTaskBySocket(int iSocketFD, spCTCPReceiveTask& spTarget);
 		bool RemoveTaskBySocket(int iSocketFD, unsigned long& ulSuccededParsing);
 		void AddPendingRemove(int iSocketFD);
 		unsigned long RemovePendingTasks();
 		std::string GetResponseMessage(int iResponseCode);
+		void ScheduleResponse(const spSDeferredResponse& spResponse) { m_spResponseScheduler->Schedule(spResponse); }
+		unsigned long GetNumberOfDeferredResponses() { return m_spResponseScheduler->GetNumberOfResponses(); }
+		etRegisterResult RegisterRecord(const std::string& strDataRegisterFile, const std::string& strUsername, const std::string& strEmail)
+		{
+			return m_spRegisterWriter->Register(strDataRegisterFile,strUsername,strEmail);
+		}
+		unsigned long GetNumberOfRegisterBatches() { return m_spRegisterWriter->GetNumberOfBatches(); }
+		unsigned long GetNumberOfRegisteredRecords() { return m_spRegisterWriter->GetNumberOfRecords(); }
 		unsigned long GetNumberOfTasks() { return m_mapReceiveTasks.size(); }
 		unsigned long GetNumberOfPendingSockets() { return m_listPendingRemoveSockets.size(); }
 
@@ -180,7 +263,14 @@ namespace IPC
 		void SetDataPath(const std::string& strDataPath) { m_strDataRegisterFile = strDataPath; }
 		std::string GetDataPath() { return m_strDataRegisterFile; }
 		void SetMaintenance(int iMaint);
-		int GetMaintenance() { return m_iMaintenance; }
+		int GetMaintenance() { return m_spMaintenanceQueue->IsMaintenance() ? 1 : 0; }
+		void SetDataIndex(int iDataIndex);
+		boost::shared_ptr<CDataIndex> GetDataIndex() { return m_spDataIndex; }
+		void SetDataSync(int iDataSync) { m_spRegisterWriter->SetDataSync(iDataSync); }
+
+	private: //methods
+		void DispatchTask(const tFuncParked& funcTask);
+		void Schedule(etTaskPriority ePriority, const boost::threadpool::task_func& funcTask);
 
 	private: //members
 		tMapReceiveTasks m_mapReceiveTasks;
@@ -188,8 +278,20 @@ namespace IPC
 		std::map<int,std::string> m_mapResponseMessages;
 		std::string m_strDataRegisterFile;
 		int m_iSendTimeout;
-		int m_iMaintenance;
-		boost::shared_ptr<boost::threadpool::pool> m_spThreadPool;
+		boost::shared_ptr<CDataIndex> m_spDataIndex;
+		//declared before the pool: tasks finished by the pool on destruction may still schedule responses
+		//wait for registrations, park requests and take writer slots
+		boost::shared_ptr<CResponseScheduler> m_spResponseScheduler;
+		boost::shared_ptr<CRegisterWriter> m_spRegisterWriter;
+		boost::shared_ptr<CMaintenanceQueue> m_spMaintenanceQueue;
+		//write tasks waiting for the free writer slot
+		std::list<tFuncParked> m_listPendingWrites;
+		size_t m_iMaxWriters;
+		size_t m_iActiveWriters;
+		unsigned long m_ulTaskSequence;
+		boost::mutex m_WriterAccess;
+		boost::mutex m_ScheduleAccess;
+		boost::shared_ptr<tPrioPool> m_spThreadPool;
 		boost::shared_mutex m_sharedTaskAccess;
 		boost::recursive_mutex m_RemoveAccess;
 	};
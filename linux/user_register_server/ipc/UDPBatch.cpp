@@ -0,0 +1,73 @@
+//native
+#include "UDPBatch.h"
+#include "Logger.h"
+//thirdparty
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+
+using namespace trc;
+
+namespace IPC
+{
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Destructor, frees batches kept in the pool
+	 */
+	CUDPBatchPool::~CUDPBatchPool()
+	{
+		try
+		{
+			for (std::vector<SUDPBatch*>::const_iterator iter = m_vecFreeBatches.begin(); iter != m_vecFreeBatches.end(); ++iter)
+				delete *iter;
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Take free batch from the pool, new one is allocated only if the pool is empty
+	 * @return spSUDPBatch - batch which is returned to the pool once released
+	 */
+	spSUDPBatch CUDPBatchPool::Acquire()
+	{
+		SUDPBatch* pBatch = NULL;
+		{
+			boost::lock_guard<boost::mutex> lock(m_Access);
+			if (!m_vecFreeBatches.empty())
+			{
+				pBatch = m_vecFreeBatches.back();
+				m_vecFreeBatches.pop_back();
+			}
+		}
+
+		if (pBatch == NULL)
+			pBatch = new SUDPBatch();
+		pBatch->m_iCount = 0;
+		pBatch->m_vecResponses.clear();
+		return spSUDPBatch(pBatch,boost::bind(&CUDPBatchPool::Release,shared_from_this(),_1));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 * Return batch to the pool, extra batches allocated at the peak load are freed
+	 * @param pBatch - in, batch released by the last owner
+	 */
+	void CUDPBatchPool::Release(SUDPBatch* pBatch)
+	{
+		try
+		{
+			{
+				boost::lock_guard<boost::mutex> lock(m_Access);
+				if (m_vecFreeBatches.size() < g_iMaxPooledBatches)
+				{
+					m_vecFreeBatches.push_back(pBatch);
+					return;
+				}
+			}
+			delete pBatch;
+		}
+		CATCH
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,62 @@
+
+#ifndef UDPBATCH_H_
+#define UDPBATCH_H_
+
+//native
+#include "ThreadPoolModule.h"
+//thirdparty
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/smart_ptr/enable_shared_from_this.hpp>
+
+namespace IPC
+{
+	//////////////////////////////////////////////////////////////////////////
+	//max number of datagrams read (or sent) with one system call
+	const unsigned int g_iMaxDatagrams = 32;
+	//max number of free batches kept by the pool of one reader
+	const size_t g_iMaxPooledBatches = 64;
+
+	//////////////////////////////////////////////////////////////////////////
+	/**
+	 * Datagrams read from a UDP socket with one 'recvmmsg' call. Batch is processed by one worker
+	 * thread and the immediate responses are sent back with one 'sendmmsg' call
+	 */
+	struct SUDPBatch
+	{
+		int m_iSocketDesc;
+		unsigned int m_iCount;
+		char m_szBuffers[g_iMaxDatagrams][g_iMaxBufferSize];
+		unsigned int m_iLengths[g_iMaxDatagrams];
+		tSockAddr m_udpClients[g_iMaxDatagrams];
+		tVectorResponses m_vecResponses;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	/**
+	 * Pool of datagram batches of one UDP reader, so that the buffers are not allocated per datagram.
+	 * Batch goes back to the pool once the worker releases it; pool is kept alive by its batches
+	 */
+	class CUDPBatchPool: public boost::enable_shared_from_this<CUDPBatchPool>
+	{
+	private: //permit no copy
+		CUDPBatchPool(const CUDPBatchPool& src);
+		CUDPBatchPool& operator= (const CUDPBatchPool& src);
+
+	public: //methods
+		CUDPBatchPool() {;}
+		virtual ~CUDPBatchPool();
+		spSUDPBatch Acquire();
+
+	private: //methods
+		void Release(SUDPBatch* pBatch);
+
+	private: //members
+		std::vector<SUDPBatch*> m_vecFreeBatches;
+		boost::mutex m_Access;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+} //namespace IPC
+#endif /* UDPBATCH_H_ */
@@ -111,18 +111,36 @@ int main(int argc, char *argv[])
 			int iSendTimeout;
 			int iMaintMode;
 			int iThreadPoolSize;
+			int iDataIndex;
+			int iDataSync;
+			int iUDPReaders;
 			config->GetSetting(eCONFIG_DATA_FILE,strDataRegisterFile);
 			config->GetSetting(eCONFIG_SLEEP,iSendTimeout);
 			config->GetSetting(eCONFIG_MAINT,iMaintMode);
 			config->GetSetting(eCONFIG_THREAD_POOL,iThreadPoolSize);
+			config->GetSetting(eCONFIG_DATA_INDEX,iDataIndex);
+			config->GetSetting(eCONFIG_DATA_SYNC,iDataSync);
+			config->GetSetting(eCONFIG_UDP_READERS,iUDPReaders);
 			ipc->SetupThreadPool(iThreadPoolSize,strDataRegisterFile,iSendTimeout);
 			ipc->SetMaintenanceMode(iMaintMode);
+			ipc->SetDataIndexMode(iDataIndex);
+			ipc->SetDataSyncMode(iDataSync);
 			ipc->SetupIPSettings();
+			ipc->SetupTCPSelector();
 			//launch TCP stuff
 			boost::thread threadTCPListener( boost::bind(&CIPCModule::StartTCPListener,ipc.get()) );
 			boost::thread threadTCPSelector( boost::bind(&CIPCModule::StartTCPSelector,ipc.get()) );
 			//launch UDP stuff
-			boost::thread threadUDPListener( boost::bind(&CIPCModule::StartUDPListener,ipc.get()) );
+			boost::thread_group groupUDPReaders;
+			if (iUDPReaders > 0)
+			{
+				for (int i = 0; i < iUDPReaders; ++i)
+					groupUDPReaders.create_thread( boost::bind(&CIPCModule::StartUDPBatchReader,ipc.get()) );
+			}
+			else
+			{
+				groupUDPReaders.create_thread( boost::bind(&CIPCModule::StartUDPListener,ipc.get()) );
+			}
 
 			using namespace boost::interprocess;
 			boost::shared_ptr<named_mutex> spMutex(new named_mutex(open_or_create, SERVER_CLOSE_MUTEX), boost::bind(&named_mutex::remove,SERVER_CLOSE_MUTEX));
@@ -0,0 +1,53 @@
+#!/bin/bash
+
+# Checks that a TCP connection is still served after its parked request is rejected. The server
+# is started in maintenance mode, so the request is parked and gets 'Service Unavailable' once it
+# has waited in the maintenance queue for too long. The second request sent on the same
+# connection has to be parked and rejected the same way: the socket must be monitored again after
+# the rejection. Run as: test_scripts/maintenance_reject.sh <path to user-reg-server binary>
+
+SERVER=${1:-./user-reg-server}
+PORT=${PORT:-16665}
+# max time request is kept parked, see g_iMaxParkedSeconds, plus a margin
+WAIT_REJECT=35
+result=0
+
+# config file is looked up next to the binary, so the server is run from a scratch directory
+WORKDIR=$(mktemp -d)
+cp "$SERVER" $WORKDIR/user-reg-server
+cat > $WORKDIR/user-reg-server.conf <<CONF
+loglevel=2
+daemon=0
+tcp_if=lo
+tcp_port=$PORT
+udp_if=lo
+udp_port=$PORT
+sleep=0
+maint=1
+dataindex=0
+datasync=0
+udpreaders=0
+CONF
+
+$WORKDIR/user-reg-server > $WORKDIR/server.log 2>&1 &
+pid=$!
+sleep 1
+
+exec 3<>/dev/tcp/127.0.0.1/$PORT
+for request in 1 2
+do
+printf 'GET username=parked\r\n' >&3
+if read -t $WAIT_REJECT -r response <&3 && [[ "$response" == 503* ]]
+then
+echo "OK: request $request rejected"
+else
+echo "FAILED: no 'Service Unavailable' for request $request"
+result=1
+fi
+done
+
+exec 3>&-
+kill -INT $pid
+wait $pid
+rm -rf $WORKDIR
+exit $result